@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// A loopback HTTP server that stands in for the Evernote service. It speaks the Thrift binary protocol for
+// the UserStore and NoteStore methods the SDK uses, over a synthetic account: personal notebooks, notes and
+// tags, notebooks shared from another user (linked notebooks) and, optionally, a business. Latency,
+// bandwidth caps, errors and rate limiting can be injected for every call or per method.
+//
+// Point a session at it with a developer token:
+//
+//   [ENSession setSharedSessionDeveloperToken:server.authenticationToken noteStoreUrl:server.noteStoreUrl];
+//
+// The session then finds the user store on the same host (see -[ENSession userStoreUrl]). Store clients
+// can also be created directly against -noteStoreUrlForShard: and userStoreUrl.
+//
+// Each connection is served by its own thread, so injected latency holds a thread per in-flight call.
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/** Faults the server injects. Rates are fractions of calls, from 0 to 1; zero turns a fault off. */
+@interface ENEDAMStubFaults : NSObject <NSCopying>
+
+/** Delay added before every response, plus a uniformly distributed extra of up to latencyJitter. */
+@property (nonatomic, assign) NSTimeInterval latency;
+@property (nonatomic, assign) NSTimeInterval latencyJitter;
+
+/** Per-connection cap on request and response transfer, in bytes per second. Zero is unlimited. */
+@property (nonatomic, assign) NSUInteger bandwidthBytesPerSecond;
+
+/** Calls answered with EDAMSystemException INTERNAL_ERROR. */
+@property (nonatomic, assign) double systemErrorRate;
+
+/** Calls answered with HTTP 503 and no Thrift payload. */
+@property (nonatomic, assign) double transportErrorRate;
+
+/** Calls answered with EDAMSystemException RATE_LIMIT_REACHED, regardless of call rate. */
+@property (nonatomic, assign) double rateLimitRate;
+
+/** Calls beyond this many per second, across all connections, are answered with RATE_LIMIT_REACHED.
+ Zero is unlimited. */
+@property (nonatomic, assign) NSUInteger maximumCallsPerSecond;
+
+/** The rateLimitDuration, in seconds, sent with rate limit errors. Defaults to the rest of the current
+ second's window, rounded up. */
+@property (nonatomic, assign) int32_t rateLimitDuration;
+
+@end
+
+/** Shape of the synthetic account. Generated deterministically from `seed` when the server starts. */
+@interface ENEDAMStubDataset : NSObject
+
++ (instancetype)datasetWithNotebookCount:(NSUInteger)notebookCount noteCount:(NSUInteger)noteCount;
+
+/** Personal notebooks and the notes spread across them. Defaults 10 and 1000. */
+@property (nonatomic, assign) NSUInteger notebookCount;
+@property (nonatomic, assign) NSUInteger noteCount;
+
+/** Personal tags, each note carrying up to two. Default 20. */
+@property (nonatomic, assign) NSUInteger tagCount;
+
+/** Notebooks shared into the account by another user, each holding notesPerLinkedNotebook notes. Defaults 2 and 50. */
+@property (nonatomic, assign) NSUInteger linkedNotebookCount;
+@property (nonatomic, assign) NSUInteger notesPerLinkedNotebook;
+
+/** Business notebooks the user has joined. The user belongs to a business only when this is non-zero. Default 0. */
+@property (nonatomic, assign) NSUInteger businessNotebookCount;
+@property (nonatomic, assign) NSUInteger notesPerBusinessNotebook;
+
+/** Approximate ENML length of each note, and the resources attached to each, in bytes. Defaults 2048, 0 and 64K. */
+@property (nonatomic, assign) NSUInteger noteContentLength;
+@property (nonatomic, assign) NSUInteger resourcesPerNote;
+@property (nonatomic, assign) NSUInteger resourceLength;
+
+@property (nonatomic, assign) uint32_t seed;
+
+@end
+
+@interface ENEDAMStubServer : NSObject
+
+- (instancetype)initWithDataset:(ENEDAMStubDataset *)dataset;
+
+@property (nonatomic, strong, readonly) ENEDAMStubDataset * dataset;
+
+/** Binds 127.0.0.1 and starts serving. Port 0 picks a free port. */
+- (BOOL)startOnPort:(uint16_t)port error:(NSError **)error;
+- (void)stop;
+
+@property (nonatomic, assign, readonly) uint16_t port;
+
+/** "127.0.0.1:<port>", the form the session host override takes. */
+@property (nonatomic, copy, readonly) NSString * host;
+@property (nonatomic, copy, readonly) NSString * userStoreUrl;
+
+/** The personal account's note store and authentication token. */
+@property (nonatomic, copy, readonly) NSString * noteStoreUrl;
+@property (nonatomic, copy, readonly) NSString * authenticationToken;
+
+- (NSString *)noteStoreUrlForShard:(NSString *)shardId;
+
+/** Faults applied to every call, unless the method has its own. */
+@property (atomic, copy) ENEDAMStubFaults * faults;
+- (void)setFaults:(nullable ENEDAMStubFaults *)faults forMethod:(NSString *)methodName;
+
+/** Calls served so far, by method name, and the bytes that went over the wire. */
+- (NSDictionary<NSString *, NSNumber *> *)callCounts;
+@property (atomic, assign, readonly) uint64_t bytesReceived;
+@property (atomic, assign, readonly) uint64_t bytesSent;
+- (void)resetStatistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
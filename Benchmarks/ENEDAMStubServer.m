@@ -0,0 +1,1561 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENEDAMStubServer.h"
+#import <netinet/in.h>
+#import <netinet/tcp.h>
+#import <sys/socket.h>
+#import <unistd.h>
+#import "EDAM.h"
+#import "ENThrift.h"
+#import "NSData+EvernoteSDK.h"
+
+static NSString * const ENEDAMStubPersonalShardId = @"s1";
+static NSString * const ENEDAMStubBusinessShardId = @"s2";
+static NSString * const ENEDAMStubSharerShardId = @"s3";
+
+static const EDAMUserID ENEDAMStubUserId = 1;
+static const EDAMUserID ENEDAMStubSharerUserId = 2;
+static const int32_t ENEDAMStubBusinessId = 1;
+
+// Transfers are paced in chunks of this size when a bandwidth cap is set.
+static const NSUInteger ENEDAMStubPacingChunkLength = 16 * 1024;
+
+#pragma mark - Faults and dataset
+
+@implementation ENEDAMStubFaults
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    ENEDAMStubFaults * copy = [[[self class] allocWithZone:zone] init];
+    copy.latency = self.latency;
+    copy.latencyJitter = self.latencyJitter;
+    copy.bandwidthBytesPerSecond = self.bandwidthBytesPerSecond;
+    copy.systemErrorRate = self.systemErrorRate;
+    copy.transportErrorRate = self.transportErrorRate;
+    copy.rateLimitRate = self.rateLimitRate;
+    copy.maximumCallsPerSecond = self.maximumCallsPerSecond;
+    copy.rateLimitDuration = self.rateLimitDuration;
+    return copy;
+}
+
+@end
+
+@implementation ENEDAMStubDataset
+
++ (instancetype)datasetWithNotebookCount:(NSUInteger)notebookCount noteCount:(NSUInteger)noteCount
+{
+    ENEDAMStubDataset * dataset = [[ENEDAMStubDataset alloc] init];
+    dataset.notebookCount = notebookCount;
+    dataset.noteCount = noteCount;
+    return dataset;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.notebookCount = 10;
+        self.noteCount = 1000;
+        self.tagCount = 20;
+        self.linkedNotebookCount = 2;
+        self.notesPerLinkedNotebook = 50;
+        self.notesPerBusinessNotebook = 50;
+        self.noteContentLength = 2048;
+        self.resourceLength = 64 * 1024;
+        self.seed = 1;
+    }
+    return self;
+}
+
+@end
+
+#pragma mark - Shards
+
+// One service shard: a user's account, with every object in update sequence order for sync.
+@interface ENEDAMStubShard : NSObject
+@property (nonatomic, copy) NSString * shardId;
+@property (nonatomic, strong) EDAMUser * user;
+@property (nonatomic, copy) NSString * authenticationToken;
+@property (nonatomic, assign) int32_t updateCount;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, EDAMNotebook *> * notebooks;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, EDAMTag *> * tags;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, EDAMNote *> * notes;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, EDAMResource *> * resources;
+@property (nonatomic, strong) NSMutableArray<EDAMSharedNotebook *> * sharedNotebooks;
+@property (nonatomic, strong) NSMutableArray<EDAMLinkedNotebook *> * linkedNotebooks;
+// Notebooks, tags, notes and linked notebooks ordered by updateSequenceNum. An object that changes moves to the end.
+@property (nonatomic, strong) NSMutableArray * changes;
+@end
+
+@implementation ENEDAMStubShard
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.notebooks = [[NSMutableDictionary alloc] init];
+        self.tags = [[NSMutableDictionary alloc] init];
+        self.notes = [[NSMutableDictionary alloc] init];
+        self.resources = [[NSMutableDictionary alloc] init];
+        self.sharedNotebooks = [[NSMutableArray alloc] init];
+        self.linkedNotebooks = [[NSMutableArray alloc] init];
+        self.changes = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (int32_t)recordChange:(id)object
+{
+    self.updateCount++;
+    if ([object valueForKey:@"updateSequenceNum"]) {
+        [self.changes removeObjectIdenticalTo:object];
+    }
+    [object setValue:@(self.updateCount) forKey:@"updateSequenceNum"];
+    [self.changes addObject:object];
+    return self.updateCount;
+}
+
+// Index of the first change with a USN above afterUSN.
+- (NSUInteger)indexOfFirstChangeAfterUSN:(int32_t)afterUSN
+{
+    NSUInteger low = 0, high = self.changes.count;
+    while (low < high) {
+        NSUInteger middle = (low + high) / 2;
+        if ([[self.changes[middle] valueForKey:@"updateSequenceNum"] intValue] <= afterUSN) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+- (EDAMNotebook *)defaultNotebook
+{
+    for (EDAMNotebook * notebook in self.notebooks.allValues) {
+        if (notebook.defaultNotebook.boolValue) {
+            return notebook;
+        }
+    }
+    return self.notebooks.allValues.firstObject;
+}
+
+@end
+
+#pragma mark - Method table
+
+@interface ENEDAMStubCall : NSObject
+@property (nonatomic, strong) NSDictionary * arguments;
+// The shard whose note store was called. Nil for the user store.
+@property (nonatomic, strong) ENEDAMStubShard * shard;
+@end
+
+@implementation ENEDAMStubCall
+@end
+
+typedef id (^ENEDAMStubHandler)(ENEDAMStubCall * call);
+
+// What a generated Thrift processor knows about a method: how to read its arguments and where its result
+// and each exception go in the reply.
+@interface ENEDAMStubMethod : NSObject
+@property (nonatomic, copy) NSString * name;
+@property (nonatomic, strong) NSArray<FATField *> * argumentFields;
+@property (nonatomic, strong) FATField * resultField;
+@property (nonatomic, strong) NSArray<FATField *> * exceptionFields;
+@property (nonatomic, copy) ENEDAMStubHandler handler;
+@end
+
+@implementation ENEDAMStubMethod
+
+- (FATField *)fieldForExceptionClass:(Class)exceptionClass
+{
+    for (FATField * field in self.exceptionFields) {
+        if (field.structClass == exceptionClass) {
+            return field;
+        }
+    }
+    return nil;
+}
+
+@end
+
+static FATField * ENEDAMStubField(uint32_t index, uint32_t type, NSString * name)
+{
+    return [FATField fieldWithIndex:index type:type optional:NO name:name];
+}
+
+static FATField * ENEDAMStubStructField(uint32_t index, NSString * name, Class structClass)
+{
+    return [FATField fieldWithIndex:index type:TType_STRUCT optional:NO name:name structClass:structClass];
+}
+
+static FATField * ENEDAMStubStructListField(uint32_t index, NSString * name, Class structClass)
+{
+    return [FATField fieldWithIndex:index type:TType_LIST optional:NO name:name
+                         valueField:[FATField fieldWithIndex:0 type:TType_STRUCT optional:YES name:nil structClass:structClass]];
+}
+
+static FATField * ENEDAMStubTokenField(uint32_t index)
+{
+    return ENEDAMStubField(index, TType_STRING, @"authenticationToken");
+}
+
+static FATField * ENEDAMStubSuccessField(Class structClass)
+{
+    return ENEDAMStubStructField(0, @"success", structClass);
+}
+
+// Exception fields in declaration order, numbered from 1 as in the IDL. Terminate with nil.
+static NSArray<FATField *> * ENEDAMStubExceptions(Class exceptionClass, ...)
+{
+    NSMutableArray * fields = [NSMutableArray array];
+    va_list classes;
+    va_start(classes, exceptionClass);
+    for (Class aClass = exceptionClass; aClass != nil; aClass = va_arg(classes, Class)) {
+        NSString * name = nil;
+        if (aClass == [EDAMUserException class]) {
+            name = @"userException";
+        } else if (aClass == [EDAMSystemException class]) {
+            name = @"systemException";
+        } else {
+            name = @"notFoundException";
+        }
+        [fields addObject:ENEDAMStubStructField((uint32_t)fields.count + 1, name, aClass)];
+    }
+    va_end(classes);
+    return fields;
+}
+
+#pragma mark - Helpers
+
+static int64_t ENEDAMStubNow(void)
+{
+    return (int64_t)([[NSDate date] timeIntervalSince1970] * 1000.0);
+}
+
+// xorshift32: cheap, and reproducible for a given seed.
+static uint32_t ENEDAMStubRandom(uint32_t * state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static BOOL ENEDAMStubRoll(double rate)
+{
+    return rate > 0 && (arc4random() / (double)UINT32_MAX) < rate;
+}
+
+static NSString * ENEDAMStubGuid(NSString * kind, NSUInteger index)
+{
+    unsigned long long hash = 1469598103934665603ULL;
+    for (NSUInteger i = 0; i < kind.length; i++) {
+        hash = (hash ^ [kind characterAtIndex:i]) * 1099511628211ULL;
+    }
+    return [NSString stringWithFormat:@"%08llx-%04llx-4000-8000-%012lx", hash & 0xffffffffULL, (hash >> 32) & 0xffffULL, (unsigned long)index];
+}
+
+static NSString * ENEDAMStubAuthenticationToken(NSString * shardId, EDAMUserID userId, NSString * scope)
+{
+    NSString * token = [NSString stringWithFormat:@"S=%@:U=%x:E=%llx:C=stub:P=1:A=en-stub:V=2:H=%08x",
+                        shardId, userId, (unsigned long long)(ENEDAMStubNow() + 86400000LL), arc4random()];
+    return scope ? [token stringByAppendingFormat:@":N=%@", scope] : token;
+}
+
+static NSArray<NSString *> * ENEDAMStubWords(void)
+{
+    static NSArray * words = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        words = @[@"alpha", @"budget", @"cedar", @"delta", @"ember", @"fjord", @"granite", @"harbor", @"indigo", @"juniper",
+                  @"kestrel", @"lantern", @"meadow", @"nimbus", @"orchid", @"pebble", @"quartz", @"river", @"saffron", @"tundra",
+                  @"umber", @"vellum", @"willow", @"xenon", @"yarrow", @"zephyr"];
+    });
+    return words;
+}
+
+static NSString * ENEDAMStubSentence(uint32_t * random, NSUInteger wordCount)
+{
+    NSArray * words = ENEDAMStubWords();
+    NSMutableArray * sentence = [NSMutableArray arrayWithCapacity:wordCount];
+    for (NSUInteger i = 0; i < wordCount; i++) {
+        [sentence addObject:words[ENEDAMStubRandom(random) % words.count]];
+    }
+    return [sentence componentsJoinedByString:@" "];
+}
+
+static NSString * ENEDAMStubENML(uint32_t * random, NSUInteger length, NSArray<EDAMResource *> * resources)
+{
+    NSMutableString * enml = [NSMutableString stringWithString:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                              @"<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\"><en-note>"];
+    while (enml.length < length) {
+        [enml appendFormat:@"<div>%@.</div>", ENEDAMStubSentence(random, 12)];
+    }
+    for (EDAMResource * resource in resources) {
+        [enml appendFormat:@"<en-media type=\"%@\" hash=\"%@\"/>", resource.mime, [resource.data.bodyHash enlowercaseHexDigits]];
+    }
+    [enml appendString:@"</en-note>"];
+    return enml;
+}
+
+// What the service sends for a note outside of getNote: no content and no resource bodies.
+static EDAMNote * ENEDAMStubNoteWithoutBodies(EDAMNote * note, BOOL includeResources)
+{
+    EDAMNote * copy = [note copy];
+    copy.content = nil;
+    if (!includeResources) {
+        copy.resources = nil;
+        return copy;
+    }
+    NSMutableArray * resources = [NSMutableArray arrayWithCapacity:note.resources.count];
+    for (EDAMResource * resource in note.resources) {
+        EDAMResource * resourceCopy = [resource copy];
+        resourceCopy.data = [resource.data copy];
+        resourceCopy.data.body = nil;
+        [resources addObject:resourceCopy];
+    }
+    copy.resources = resources.count ? resources : nil;
+    return copy;
+}
+
+static void ENEDAMStubSleepUntil(CFAbsoluteTime deadline)
+{
+    CFAbsoluteTime remaining = deadline - CFAbsoluteTimeGetCurrent();
+    if (remaining > 0) {
+        usleep((useconds_t)(remaining * 1e6));
+    }
+}
+
+#pragma mark - Server
+
+@interface ENEDAMStubServer ()
+@property (nonatomic, strong, readwrite) ENEDAMStubDataset * dataset;
+@property (nonatomic, assign, readwrite) uint16_t port;
+@property (atomic, assign, readwrite) uint64_t bytesReceived;
+@property (atomic, assign, readwrite) uint64_t bytesSent;
+@property (nonatomic, strong) dispatch_source_t listenSource;
+@property (nonatomic, strong) NSMutableSet<NSNumber *> * connections;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, ENEDAMStubFaults *> * methodFaults;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> * mutableCallCounts;
+@property (nonatomic, strong) NSDictionary<NSString *, ENEDAMStubMethod *> * userStoreMethods;
+@property (nonatomic, strong) NSDictionary<NSString *, ENEDAMStubMethod *> * noteStoreMethods;
+// Guarded by @synchronized(self.shards).
+@property (nonatomic, strong) NSMutableDictionary<NSString *, ENEDAMStubShard *> * shards;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, ENEDAMStubShard *> * shardsByToken;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSString *> * sharedNotebookGlobalIdsByToken;
+// Guarded by @synchronized(self.methodFaults).
+@property (nonatomic, assign) CFAbsoluteTime rateWindowStart;
+@property (nonatomic, assign) NSUInteger rateWindowCalls;
+@end
+
+@implementation ENEDAMStubServer
+
+- (instancetype)initWithDataset:(ENEDAMStubDataset *)dataset
+{
+    self = [super init];
+    if (self) {
+        self.dataset = dataset;
+        self.faults = [[ENEDAMStubFaults alloc] init];
+        self.connections = [[NSMutableSet alloc] init];
+        self.methodFaults = [[NSMutableDictionary alloc] init];
+        self.mutableCallCounts = [[NSMutableDictionary alloc] init];
+        self.shards = [[NSMutableDictionary alloc] init];
+        self.shardsByToken = [[NSMutableDictionary alloc] init];
+        self.sharedNotebookGlobalIdsByToken = [[NSMutableDictionary alloc] init];
+        [self registerUserStoreMethods];
+        [self registerNoteStoreMethods];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+- (BOOL)startOnPort:(uint16_t)port error:(NSError **)error
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (fd < 0 ||
+        bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (struct sockaddr *)&address, &addressLength) != 0) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NO;
+    }
+    self.port = ntohs(address.sin_port);
+
+    @synchronized(self.shards) {
+        if (self.shards.count == 0) {
+            [self generateDataset];
+        }
+    }
+
+    dispatch_queue_t queue = dispatch_queue_create("com.evernote.sdk.stub-server.accept", DISPATCH_QUEUE_SERIAL);
+    self.listenSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)fd, 0, queue);
+    __weak ENEDAMStubServer * weakSelf = self;
+    dispatch_source_set_event_handler(self.listenSource, ^{
+        int connection = accept(fd, NULL, NULL);
+        ENEDAMStubServer * server = weakSelf;
+        if (connection < 0 || !server) {
+            if (connection >= 0) {
+                close(connection);
+            }
+            return;
+        }
+        int on = 1;
+        setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        @synchronized(server.connections) {
+            [server.connections addObject:@(connection)];
+        }
+        [NSThread detachNewThreadWithBlock:^{
+            [server serveConnection:connection];
+        }];
+    });
+    dispatch_source_set_cancel_handler(self.listenSource, ^{
+        close(fd);
+    });
+    dispatch_resume(self.listenSource);
+    return YES;
+}
+
+- (void)stop
+{
+    if (self.listenSource) {
+        dispatch_source_cancel(self.listenSource);
+        self.listenSource = nil;
+    }
+    // Connection threads see end of stream and close their sockets.
+    @synchronized(self.connections) {
+        for (NSNumber * connection in self.connections) {
+            shutdown(connection.intValue, SHUT_RDWR);
+        }
+    }
+}
+
+- (NSString *)host
+{
+    return [NSString stringWithFormat:@"127.0.0.1:%u", self.port];
+}
+
+- (NSString *)userStoreUrl
+{
+    return [NSString stringWithFormat:@"http://%@/edam/user", self.host];
+}
+
+- (NSString *)noteStoreUrlForShard:(NSString *)shardId
+{
+    return [NSString stringWithFormat:@"http://%@/shard/%@/notestore", self.host, shardId];
+}
+
+- (NSString *)noteStoreUrl
+{
+    return [self noteStoreUrlForShard:ENEDAMStubPersonalShardId];
+}
+
+- (NSString *)authenticationToken
+{
+    @synchronized(self.shards) {
+        return self.shards[ENEDAMStubPersonalShardId].authenticationToken;
+    }
+}
+
+- (void)setFaults:(ENEDAMStubFaults *)faults forMethod:(NSString *)methodName
+{
+    @synchronized(self.methodFaults) {
+        self.methodFaults[methodName] = [faults copy];
+    }
+}
+
+- (ENEDAMStubFaults *)faultsForMethod:(NSString *)methodName
+{
+    @synchronized(self.methodFaults) {
+        return self.methodFaults[methodName] ?: self.faults;
+    }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)callCounts
+{
+    @synchronized(self.mutableCallCounts) {
+        return [self.mutableCallCounts copy];
+    }
+}
+
+- (void)resetStatistics
+{
+    @synchronized(self.mutableCallCounts) {
+        [self.mutableCallCounts removeAllObjects];
+        self.bytesReceived = 0;
+        self.bytesSent = 0;
+    }
+}
+
+#pragma mark - HTTP
+
+- (void)serveConnection:(int)fd
+{
+    NSMutableData * pending = [[NSMutableData alloc] init];
+    while (YES) {
+        @autoreleasepool {
+            NSString * path = nil;
+            NSData * body = nil;
+            CFAbsoluteTime start = 0;
+            if (![self readRequestFromConnection:fd pending:pending path:&path body:&body start:&start]) {
+                break;
+            }
+            NSInteger status = 200;
+            ENEDAMStubFaults * faults = nil;
+            NSData * response = [self responseForPath:path body:body status:&status faults:&faults];
+            if (faults.bandwidthBytesPerSecond > 0) {
+                ENEDAMStubSleepUntil(start + (double)body.length / faults.bandwidthBytesPerSecond);
+            }
+            NSString * reason = (status == 200) ? @"OK" : (status == 404) ? @"Not Found" : (status == 400) ? @"Bad Request" : @"Service Unavailable";
+            NSString * header = [NSString stringWithFormat:@"HTTP/1.1 %ld %@\r\nContent-Type: application/x-thrift\r\nContent-Length: %lu\r\n\r\n",
+                                 (long)status, reason, (unsigned long)response.length];
+            NSMutableData * message = [[header dataUsingEncoding:NSASCIIStringEncoding] mutableCopy];
+            [message appendData:response];
+            if (![self writeData:message toConnection:fd bytesPerSecond:faults.bandwidthBytesPerSecond]) {
+                break;
+            }
+            @synchronized(self.mutableCallCounts) {
+                self.bytesReceived += body.length;
+                self.bytesSent += response.length;
+            }
+        }
+    }
+    @synchronized(self.connections) {
+        [self.connections removeObject:@(fd)];
+    }
+    close(fd);
+}
+
+// Reads one request, leaving any bytes of the next in `pending`. Returns NO at end of stream.
+- (BOOL)readRequestFromConnection:(int)fd
+                          pending:(NSMutableData *)pending
+                             path:(NSString **)path
+                             body:(NSData **)body
+                            start:(CFAbsoluteTime *)start
+{
+    static NSData * headerTerminator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        headerTerminator = [@"\r\n\r\n" dataUsingEncoding:NSASCIIStringEncoding];
+    });
+
+    uint8_t buffer[64 * 1024];
+    *start = CFAbsoluteTimeGetCurrent();
+    NSRange terminator;
+    while ((terminator = [pending rangeOfData:headerTerminator options:0 range:NSMakeRange(0, pending.length)]).location == NSNotFound) {
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            return NO;
+        }
+        if (pending.length == 0) {
+            *start = CFAbsoluteTimeGetCurrent();
+        }
+        [pending appendBytes:buffer length:(NSUInteger)count];
+    }
+
+    NSString * header = [[NSString alloc] initWithData:[pending subdataWithRange:NSMakeRange(0, terminator.location)] encoding:NSISOLatin1StringEncoding];
+    NSArray * lines = [header componentsSeparatedByString:@"\r\n"];
+    NSArray * requestLine = [lines.firstObject componentsSeparatedByString:@" "];
+    *path = requestLine.count > 1 ? requestLine[1] : @"";
+    NSUInteger contentLength = 0;
+    for (NSString * line in lines) {
+        if ([line.lowercaseString hasPrefix:@"content-length:"]) {
+            contentLength = (NSUInteger)[[line substringFromIndex:15] integerValue];
+        }
+    }
+
+    NSUInteger bodyStart = NSMaxRange(terminator);
+    while (pending.length < bodyStart + contentLength) {
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            return NO;
+        }
+        [pending appendBytes:buffer length:(NSUInteger)count];
+    }
+    *body = [pending subdataWithRange:NSMakeRange(bodyStart, contentLength)];
+    [pending replaceBytesInRange:NSMakeRange(0, bodyStart + contentLength) withBytes:NULL length:0];
+    return YES;
+}
+
+- (BOOL)writeData:(NSData *)data toConnection:(int)fd bytesPerSecond:(NSUInteger)bytesPerSecond
+{
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    NSUInteger written = 0;
+    while (written < data.length) {
+        NSUInteger length = data.length - written;
+        if (bytesPerSecond > 0) {
+            length = MIN(length, ENEDAMStubPacingChunkLength);
+        }
+        ssize_t count = send(fd, (const uint8_t *)data.bytes + written, length, 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        written += (NSUInteger)count;
+        if (bytesPerSecond > 0) {
+            ENEDAMStubSleepUntil(start + (double)written / bytesPerSecond);
+        }
+    }
+    return YES;
+}
+
+#pragma mark - Thrift
+
+- (NSData *)responseForPath:(NSString *)path body:(NSData *)body status:(NSInteger *)status faults:(ENEDAMStubFaults **)faults
+{
+    NSDictionary * methods = nil;
+    ENEDAMStubShard * shard = nil;
+    NSArray * components = [path componentsSeparatedByString:@"/"];
+    if ([path isEqualToString:@"/edam/user"]) {
+        methods = self.userStoreMethods;
+    } else if (components.count == 4 && [components[1] isEqualToString:@"shard"] && [components[3] isEqualToString:@"notestore"]) {
+        methods = self.noteStoreMethods;
+        @synchronized(self.shards) {
+            shard = self.shards[components[2]];
+        }
+    }
+    if (!methods || (methods == self.noteStoreMethods && !shard)) {
+        *status = 404;
+        return [NSData data];
+    }
+
+    ENTMemoryBuffer * input = [[ENTMemoryBuffer alloc] initWithData:body];
+    ENTMemoryBuffer * output = [[ENTMemoryBuffer alloc] init];
+    ENTBinaryProtocol * inProtocol = [[ENTBinaryProtocol alloc] initWithTransport:input];
+    ENTBinaryProtocol * outProtocol = [[ENTBinaryProtocol alloc] initWithTransport:output strictRead:YES strictWrite:YES];
+
+    NSString * name = nil;
+    int type = 0;
+    int sequenceID = 0;
+    @try {
+        [inProtocol readMessageBeginReturningName:&name type:&type sequenceID:&sequenceID];
+    }
+    @catch (NSException * exception) {
+        *status = 400;
+        return [NSData data];
+    }
+
+    *faults = [self faultsForMethod:name];
+    @synchronized(self.mutableCallCounts) {
+        self.mutableCallCounts[name] = @([self.mutableCallCounts[name] unsignedLongLongValue] + 1);
+    }
+    if ((*faults).latency > 0 || (*faults).latencyJitter > 0) {
+        usleep((useconds_t)(((*faults).latency + (*faults).latencyJitter * (arc4random() / (double)UINT32_MAX)) * 1e6));
+    }
+    if (ENEDAMStubRoll((*faults).transportErrorRate)) {
+        *status = 503;
+        return [NSData data];
+    }
+
+    ENEDAMStubMethod * method = methods[name];
+    if (!method) {
+        [ENTProtocolUtil skipType:TType_STRUCT onProtocol:inProtocol];
+        [ENTProtocolUtil sendException:[ENTApplicationException exceptionWithType:ENTApplicationException_UNKNOWN_METHOD
+                                                                           reason:[NSString stringWithFormat:@"Unknown method %@", name]]
+                            forMessage:name
+                            sequenceID:sequenceID
+                            toProtocol:outProtocol];
+        return [output getBuffer];
+    }
+
+    @try {
+        ENEDAMStubCall * call = [[ENEDAMStubCall alloc] init];
+        call.arguments = [ENTProtocolUtil readArgumentsFromProtocol:inProtocol withFields:method.argumentFields];
+        call.shard = shard;
+
+        EDAMSystemException * injected = [self injectedExceptionWithFaults:*faults];
+        if (injected && [method fieldForExceptionClass:[EDAMSystemException class]]) {
+            @throw injected;
+        }
+
+        id result = nil;
+        @synchronized(self.shards) {
+            result = method.handler(call);
+        }
+        [ENTProtocolUtil sendReply:name
+                        sequenceID:sequenceID
+                        toProtocol:outProtocol
+                        withResult:[FATArgument argumentWithField:method.resultField value:result]];
+    }
+    @catch (FATException * exception) {
+        FATField * field = [method fieldForExceptionClass:[exception class]];
+        if (field) {
+            [ENTProtocolUtil sendReply:name sequenceID:sequenceID toProtocol:outProtocol withResult:[FATArgument argumentWithField:field value:exception]];
+        } else {
+            [ENTProtocolUtil sendException:[ENTApplicationException exceptionWithType:ENTApplicationException_INTERNAL_ERROR reason:exception.description]
+                                forMessage:name sequenceID:sequenceID toProtocol:outProtocol];
+        }
+    }
+    @catch (NSException * exception) {
+        [ENTProtocolUtil sendException:[ENTApplicationException exceptionWithType:ENTApplicationException_INTERNAL_ERROR reason:exception.reason]
+                            forMessage:name sequenceID:sequenceID toProtocol:outProtocol];
+    }
+    return [output getBuffer];
+}
+
+- (EDAMSystemException *)injectedExceptionWithFaults:(ENEDAMStubFaults *)faults
+{
+    int32_t rateLimitDuration = 0;
+    if (faults.maximumCallsPerSecond > 0) {
+        @synchronized(self.methodFaults) {
+            CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+            if (now - self.rateWindowStart >= 1.0) {
+                self.rateWindowStart = now;
+                self.rateWindowCalls = 0;
+            }
+            if (++self.rateWindowCalls > faults.maximumCallsPerSecond) {
+                rateLimitDuration = (int32_t)ceil(1.0 - (now - self.rateWindowStart));
+            }
+        }
+    }
+    if (rateLimitDuration == 0 && ENEDAMStubRoll(faults.rateLimitRate)) {
+        rateLimitDuration = 1;
+    }
+    if (rateLimitDuration > 0) {
+        EDAMSystemException * exception = [[EDAMSystemException alloc] init];
+        exception.errorCode = @(EDAMErrorCode_RATE_LIMIT_REACHED);
+        exception.rateLimitDuration = @(faults.rateLimitDuration ?: MAX(rateLimitDuration, 1));
+        return exception;
+    }
+    if (ENEDAMStubRoll(faults.systemErrorRate)) {
+        EDAMSystemException * exception = [[EDAMSystemException alloc] init];
+        exception.errorCode = @(EDAMErrorCode_INTERNAL_ERROR);
+        exception.message = @"Injected failure";
+        return exception;
+    }
+    return nil;
+}
+
+#pragma mark - Authentication
+
+static EDAMUserException * ENEDAMStubUserException(int errorCode, NSString * parameter)
+{
+    EDAMUserException * exception = [[EDAMUserException alloc] init];
+    exception.errorCode = @(errorCode);
+    exception.parameter = parameter;
+    return exception;
+}
+
+static EDAMNotFoundException * ENEDAMStubNotFoundException(NSString * identifier, NSString * key)
+{
+    EDAMNotFoundException * exception = [[EDAMNotFoundException alloc] init];
+    exception.identifier = identifier;
+    exception.key = key;
+    return exception;
+}
+
+// The shard a token belongs to. A note store only accepts tokens for its own shard.
+- (ENEDAMStubShard *)shardForCall:(ENEDAMStubCall *)call
+{
+    ENEDAMStubShard * shard = self.shardsByToken[call.arguments[@"authenticationToken"] ?: @""];
+    if (!shard || (call.shard && shard != call.shard)) {
+        @throw ENEDAMStubUserException(EDAMErrorCode_INVALID_AUTH, @"authenticationToken");
+    }
+    return shard;
+}
+
+- (EDAMAuthenticationResult *)authenticationResultForShard:(ENEDAMStubShard *)shard token:(NSString *)token
+{
+    EDAMAuthenticationResult * result = [[EDAMAuthenticationResult alloc] init];
+    result.currentTime = @(ENEDAMStubNow());
+    result.expiration = @(ENEDAMStubNow() + 86400000LL);
+    result.authenticationToken = token;
+    result.user = shard.user;
+    result.noteStoreUrl = [self noteStoreUrlForShard:shard.shardId];
+    result.webApiUrlPrefix = [NSString stringWithFormat:@"http://%@/shard/%@/", self.host, shard.shardId];
+    return result;
+}
+
+#pragma mark - UserStore
+
+- (void)registerUserStoreMethods
+{
+    NSMutableDictionary * methods = [NSMutableDictionary dictionary];
+    __weak ENEDAMStubServer * weakSelf = self;
+
+    [self addMethod:@"checkVersion" to:methods
+          arguments:@[ENEDAMStubField(1, TType_STRING, @"clientName"), ENEDAMStubField(2, TType_I16, @"edamVersionMajor"), ENEDAMStubField(3, TType_I16, @"edamVersionMinor")]
+             result:ENEDAMStubField(0, TType_BOOL, @"success")
+         exceptions:@[]
+            handler:^id(ENEDAMStubCall * call) {
+                return @YES;
+            }];
+
+    [self addMethod:@"getBootstrapInfo" to:methods
+          arguments:@[ENEDAMStubField(1, TType_STRING, @"locale")]
+             result:ENEDAMStubSuccessField([EDAMBootstrapInfo class])
+         exceptions:@[]
+            handler:^id(ENEDAMStubCall * call) {
+                EDAMBootstrapSettings * settings = [[EDAMBootstrapSettings alloc] init];
+                settings.serviceHost = weakSelf.host;
+                settings.marketingUrl = @"http://127.0.0.1/";
+                settings.supportUrl = @"http://127.0.0.1/";
+                settings.accountEmailDomain = @"example.com";
+                EDAMBootstrapProfile * profile = [[EDAMBootstrapProfile alloc] init];
+                profile.name = @"Evernote";
+                profile.settings = settings;
+                EDAMBootstrapInfo * info = [[EDAMBootstrapInfo alloc] init];
+                info.profiles = @[profile];
+                return info;
+            }];
+
+    [self addMethod:@"getUser" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubSuccessField([EDAMUser class])
+         exceptions:ENEDAMStubExceptions([EDAMUserException class], [EDAMSystemException class], nil)
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf shardForCall:call].user;
+            }];
+
+    [self addMethod:@"getNoteStoreUrl" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubField(0, TType_STRING, @"success")
+         exceptions:ENEDAMStubExceptions([EDAMUserException class], [EDAMSystemException class], nil)
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf noteStoreUrlForShard:[weakSelf shardForCall:call].shardId];
+            }];
+
+    [self addMethod:@"authenticateToBusiness" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubSuccessField([EDAMAuthenticationResult class])
+         exceptions:ENEDAMStubExceptions([EDAMUserException class], [EDAMSystemException class], nil)
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubShard * shard = [weakSelf shardForCall:call];
+                ENEDAMStubShard * business = weakSelf.shards[ENEDAMStubBusinessShardId];
+                if (![shard.shardId isEqualToString:ENEDAMStubPersonalShardId] || !business) {
+                    @throw ENEDAMStubUserException(EDAMErrorCode_PERMISSION_DENIED, @"authenticationToken");
+                }
+                return [weakSelf authenticationResultForShard:business token:business.authenticationToken];
+            }];
+
+    [self addMethod:@"getPublicUserInfo" to:methods
+          arguments:@[ENEDAMStubField(1, TType_STRING, @"username")]
+             result:ENEDAMStubSuccessField([EDAMPublicUserInfo class])
+         exceptions:ENEDAMStubExceptions([EDAMNotFoundException class], [EDAMSystemException class], [EDAMUserException class], nil)
+            handler:^id(ENEDAMStubCall * call) {
+                for (ENEDAMStubShard * shard in weakSelf.shards.allValues) {
+                    if ([shard.user.username isEqualToString:call.arguments[@"username"]]) {
+                        EDAMPublicUserInfo * info = [[EDAMPublicUserInfo alloc] init];
+                        info.userId = shard.user.id;
+                        info.shardId = shard.shardId;
+                        info.privilege = shard.user.privilege;
+                        info.username = shard.user.username;
+                        info.noteStoreUrl = [weakSelf noteStoreUrlForShard:shard.shardId];
+                        return info;
+                    }
+                }
+                @throw ENEDAMStubNotFoundException(@"User.username", call.arguments[@"username"]);
+            }];
+
+    self.userStoreMethods = methods;
+}
+
+- (void)addMethod:(NSString *)name
+               to:(NSMutableDictionary *)methods
+        arguments:(NSArray<FATField *> *)arguments
+           result:(FATField *)result
+       exceptions:(NSArray<FATField *> *)exceptions
+          handler:(ENEDAMStubHandler)handler
+{
+    ENEDAMStubMethod * method = [[ENEDAMStubMethod alloc] init];
+    method.name = name;
+    method.argumentFields = arguments;
+    method.resultField = result;
+    method.exceptionFields = exceptions;
+    method.handler = handler;
+    methods[name] = method;
+}
+
+#pragma mark - NoteStore
+
+- (void)registerNoteStoreMethods
+{
+    NSMutableDictionary * methods = [NSMutableDictionary dictionary];
+    __weak ENEDAMStubServer * weakSelf = self;
+    NSArray * userSystem = ENEDAMStubExceptions([EDAMUserException class], [EDAMSystemException class], nil);
+    NSArray * userSystemNotFound = ENEDAMStubExceptions([EDAMUserException class], [EDAMSystemException class], [EDAMNotFoundException class], nil);
+    NSArray * userNotFoundSystem = ENEDAMStubExceptions([EDAMUserException class], [EDAMNotFoundException class], [EDAMSystemException class], nil);
+
+    [self addMethod:@"getSyncState" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubSuccessField([EDAMSyncState class])
+         exceptions:userSystem
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf syncStateForShard:[weakSelf shardForCall:call]];
+            }];
+
+    [self addMethod:@"getSyncChunk" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_I32, @"afterUSN"), ENEDAMStubField(3, TType_I32, @"maxEntries"), ENEDAMStubField(4, TType_BOOL, @"fullSyncOnly")]
+             result:ENEDAMStubSuccessField([EDAMSyncChunk class])
+         exceptions:userSystem
+            handler:^id(ENEDAMStubCall * call) {
+                EDAMSyncChunkFilter * filter = [[EDAMSyncChunkFilter alloc] init];
+                filter.includeNotes = filter.includeNoteResources = filter.includeNoteAttributes = @YES;
+                filter.includeNotebooks = filter.includeTags = filter.includeLinkedNotebooks = @YES;
+                return [weakSelf syncChunkForShard:[weakSelf shardForCall:call]
+                                          afterUSN:[call.arguments[@"afterUSN"] intValue]
+                                        maxEntries:[call.arguments[@"maxEntries"] intValue]
+                                            filter:filter];
+            }];
+
+    [self addMethod:@"getFilteredSyncChunk" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_I32, @"afterUSN"), ENEDAMStubField(3, TType_I32, @"maxEntries"), ENEDAMStubStructField(4, @"filter", [EDAMSyncChunkFilter class])]
+             result:ENEDAMStubSuccessField([EDAMSyncChunk class])
+         exceptions:userSystem
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf syncChunkForShard:[weakSelf shardForCall:call]
+                                          afterUSN:[call.arguments[@"afterUSN"] intValue]
+                                        maxEntries:[call.arguments[@"maxEntries"] intValue]
+                                            filter:call.arguments[@"filter"] ?: [[EDAMSyncChunkFilter alloc] init]];
+            }];
+
+    [self addMethod:@"getLinkedNotebookSyncState" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubStructField(2, @"linkedNotebook", [EDAMLinkedNotebook class])]
+             result:ENEDAMStubSuccessField([EDAMSyncState class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubShard * shard = [weakSelf shardForCall:call];
+                [weakSelf sharedNotebookInShard:shard forLinkedNotebook:call.arguments[@"linkedNotebook"]];
+                return [weakSelf syncStateForShard:shard];
+            }];
+
+    [self addMethod:@"getLinkedNotebookSyncChunk" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubStructField(2, @"linkedNotebook", [EDAMLinkedNotebook class]),
+                      ENEDAMStubField(3, TType_I32, @"afterUSN"), ENEDAMStubField(4, TType_I32, @"maxEntries"), ENEDAMStubField(5, TType_BOOL, @"fullSyncOnly")]
+             result:ENEDAMStubSuccessField([EDAMSyncChunk class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubShard * shard = [weakSelf shardForCall:call];
+                EDAMSharedNotebook * sharedNotebook = [weakSelf sharedNotebookInShard:shard forLinkedNotebook:call.arguments[@"linkedNotebook"]];
+                EDAMSyncChunkFilter * filter = [[EDAMSyncChunkFilter alloc] init];
+                filter.includeNotes = filter.includeNoteResources = filter.includeNoteAttributes = filter.includeNotebooks = @YES;
+                filter.notebookGuids = [NSSet setWithObject:sharedNotebook.notebookGuid];
+                return [weakSelf syncChunkForShard:shard
+                                          afterUSN:[call.arguments[@"afterUSN"] intValue]
+                                        maxEntries:[call.arguments[@"maxEntries"] intValue]
+                                            filter:filter];
+            }];
+
+    ENEDAMStubHandler listNotebooks = ^id(ENEDAMStubCall * call) {
+        return [weakSelf shardForCall:call].notebooks.allValues;
+    };
+    [self addMethod:@"listNotebooks" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubStructListField(0, @"success", [EDAMNotebook class])
+         exceptions:userSystem
+            handler:listNotebooks];
+    [self addMethod:@"listAccessibleBusinessNotebooks" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubStructListField(0, @"success", [EDAMNotebook class])
+         exceptions:userSystem
+            handler:listNotebooks];
+
+    [self addMethod:@"getNotebook" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid")]
+             result:ENEDAMStubSuccessField([EDAMNotebook class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                EDAMNotebook * notebook = [weakSelf shardForCall:call].notebooks[call.arguments[@"guid"] ?: @""];
+                if (!notebook) {
+                    @throw ENEDAMStubNotFoundException(@"Notebook.guid", call.arguments[@"guid"]);
+                }
+                return notebook;
+            }];
+
+    [self addMethod:@"getDefaultNotebook" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubSuccessField([EDAMNotebook class])
+         exceptions:userSystem
+            handler:^id(ENEDAMStubCall * call) {
+                return [[weakSelf shardForCall:call] defaultNotebook];
+            }];
+
+    [self addMethod:@"listTags" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubStructListField(0, @"success", [EDAMTag class])
+         exceptions:userSystem
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf shardForCall:call].tags.allValues;
+            }];
+
+    [self addMethod:@"listLinkedNotebooks" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubStructListField(0, @"success", [EDAMLinkedNotebook class])
+         exceptions:userNotFoundSystem
+            handler:^id(ENEDAMStubCall * call) {
+                NSMutableArray * linkedNotebooks = [NSMutableArray array];
+                for (EDAMLinkedNotebook * linkedNotebook in [weakSelf shardForCall:call].linkedNotebooks) {
+                    EDAMLinkedNotebook * copy = [linkedNotebook copy];
+                    copy.noteStoreUrl = [weakSelf noteStoreUrlForShard:linkedNotebook.shardId];
+                    copy.webApiUrlPrefix = [NSString stringWithFormat:@"http://%@/shard/%@/", weakSelf.host, linkedNotebook.shardId];
+                    [linkedNotebooks addObject:copy];
+                }
+                return linkedNotebooks;
+            }];
+
+    [self addMethod:@"listSharedNotebooks" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubStructListField(0, @"success", [EDAMSharedNotebook class])
+         exceptions:userNotFoundSystem
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf shardForCall:call].sharedNotebooks;
+            }];
+
+    [self addMethod:@"authenticateToSharedNotebook" to:methods
+          arguments:@[ENEDAMStubField(1, TType_STRING, @"shareKeyOrGlobalId"), ENEDAMStubTokenField(2)]
+             result:ENEDAMStubSuccessField([EDAMAuthenticationResult class])
+         exceptions:userNotFoundSystem
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubServer * server = weakSelf;
+                if (!server.shardsByToken[call.arguments[@"authenticationToken"] ?: @""]) {
+                    @throw ENEDAMStubUserException(EDAMErrorCode_INVALID_AUTH, @"authenticationToken");
+                }
+                NSString * globalId = call.arguments[@"shareKeyOrGlobalId"];
+                for (EDAMSharedNotebook * sharedNotebook in call.shard.sharedNotebooks) {
+                    if ([sharedNotebook.globalId isEqualToString:globalId]) {
+                        NSString * token = ENEDAMStubAuthenticationToken(call.shard.shardId, call.shard.user.id.intValue, globalId);
+                        server.shardsByToken[token] = call.shard;
+                        server.sharedNotebookGlobalIdsByToken[token] = globalId;
+                        return [server authenticationResultForShard:call.shard token:token];
+                    }
+                }
+                @throw ENEDAMStubNotFoundException(@"SharedNotebook.id", globalId);
+            }];
+
+    [self addMethod:@"getSharedNotebookByAuth" to:methods
+          arguments:@[ENEDAMStubTokenField(1)]
+             result:ENEDAMStubSuccessField([EDAMSharedNotebook class])
+         exceptions:userNotFoundSystem
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubShard * shard = [weakSelf shardForCall:call];
+                NSString * globalId = weakSelf.sharedNotebookGlobalIdsByToken[call.arguments[@"authenticationToken"]];
+                for (EDAMSharedNotebook * sharedNotebook in shard.sharedNotebooks) {
+                    if ([sharedNotebook.globalId isEqualToString:globalId]) {
+                        return sharedNotebook;
+                    }
+                }
+                @throw ENEDAMStubUserException(EDAMErrorCode_PERMISSION_DENIED, @"authenticationToken");
+            }];
+
+    [self addMethod:@"getPublicNotebook" to:methods
+          arguments:@[ENEDAMStubField(1, TType_I32, @"userId"), ENEDAMStubField(2, TType_STRING, @"publicUri")]
+             result:ENEDAMStubSuccessField([EDAMNotebook class])
+         exceptions:ENEDAMStubExceptions([EDAMSystemException class], [EDAMNotFoundException class], nil)
+            handler:^id(ENEDAMStubCall * call) {
+                @throw ENEDAMStubNotFoundException(@"Publishing.uri", call.arguments[@"publicUri"]);
+            }];
+
+    [self addMethod:@"findNotesMetadata" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubStructField(2, @"filter", [EDAMNoteFilter class]),
+                      ENEDAMStubField(3, TType_I32, @"offset"), ENEDAMStubField(4, TType_I32, @"maxNotes"),
+                      ENEDAMStubStructField(5, @"resultSpec", [EDAMNotesMetadataResultSpec class])]
+             result:ENEDAMStubSuccessField([EDAMNotesMetadataList class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf notesMetadataForShard:[weakSelf shardForCall:call]
+                                                filter:call.arguments[@"filter"]
+                                                offset:[call.arguments[@"offset"] intValue]
+                                              maxNotes:[call.arguments[@"maxNotes"] intValue]
+                                            resultSpec:call.arguments[@"resultSpec"]];
+            }];
+
+    [self addMethod:@"getNote" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid"), ENEDAMStubField(3, TType_BOOL, @"withContent"),
+                      ENEDAMStubField(4, TType_BOOL, @"withResourcesData"), ENEDAMStubField(5, TType_BOOL, @"withResourcesRecognition"),
+                      ENEDAMStubField(6, TType_BOOL, @"withResourcesAlternateData")]
+             result:ENEDAMStubSuccessField([EDAMNote class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf noteForCall:call withContent:[call.arguments[@"withContent"] boolValue] withResourcesData:[call.arguments[@"withResourcesData"] boolValue]];
+            }];
+
+    [self addMethod:@"getNoteWithResultSpec" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid"), ENEDAMStubStructField(3, @"resultSpec", [EDAMNoteResultSpec class])]
+             result:ENEDAMStubSuccessField([EDAMNote class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                EDAMNoteResultSpec * resultSpec = call.arguments[@"resultSpec"];
+                return [weakSelf noteForCall:call withContent:resultSpec.includeContent.boolValue withResourcesData:resultSpec.includeResourcesData.boolValue];
+            }];
+
+    [self addMethod:@"getNoteContent" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid")]
+             result:ENEDAMStubField(0, TType_STRING, @"success")
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf noteForCall:call withContent:YES withResourcesData:NO].content;
+            }];
+
+    [self addMethod:@"getResource" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid"), ENEDAMStubField(3, TType_BOOL, @"withData"),
+                      ENEDAMStubField(4, TType_BOOL, @"withRecognition"), ENEDAMStubField(5, TType_BOOL, @"withAttributes"),
+                      ENEDAMStubField(6, TType_BOOL, @"withAlternateData")]
+             result:ENEDAMStubSuccessField([EDAMResource class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                EDAMResource * resource = [weakSelf shardForCall:call].resources[call.arguments[@"guid"] ?: @""];
+                if (!resource) {
+                    @throw ENEDAMStubNotFoundException(@"Resource.guid", call.arguments[@"guid"]);
+                }
+                if ([call.arguments[@"withData"] boolValue]) {
+                    return resource;
+                }
+                EDAMResource * copy = [resource copy];
+                copy.data = [resource.data copy];
+                copy.data.body = nil;
+                return copy;
+            }];
+
+    [self addMethod:@"createNote" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubStructField(2, @"note", [EDAMNote class])]
+             result:ENEDAMStubSuccessField([EDAMNote class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf storeNote:call.arguments[@"note"] inShard:[weakSelf shardForCall:call] creating:YES];
+            }];
+
+    [self addMethod:@"updateNote" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubStructField(2, @"note", [EDAMNote class])]
+             result:ENEDAMStubSuccessField([EDAMNote class])
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                return [weakSelf storeNote:call.arguments[@"note"] inShard:[weakSelf shardForCall:call] creating:NO];
+            }];
+
+    [self addMethod:@"deleteNote" to:methods
+          arguments:@[ENEDAMStubTokenField(1), ENEDAMStubField(2, TType_STRING, @"guid")]
+             result:ENEDAMStubField(0, TType_I32, @"success")
+         exceptions:userSystemNotFound
+            handler:^id(ENEDAMStubCall * call) {
+                ENEDAMStubShard * shard = [weakSelf shardForCall:call];
+                EDAMNote * note = shard.notes[call.arguments[@"guid"] ?: @""];
+                if (!note) {
+                    @throw ENEDAMStubNotFoundException(@"Note.guid", call.arguments[@"guid"]);
+                }
+                note.active = @NO;
+                note.deleted = @(ENEDAMStubNow());
+                return @([shard recordChange:note]);
+            }];
+
+    self.noteStoreMethods = methods;
+}
+
+#pragma mark - NoteStore implementation
+
+- (EDAMSyncState *)syncStateForShard:(ENEDAMStubShard *)shard
+{
+    EDAMSyncState * state = [[EDAMSyncState alloc] init];
+    state.currentTime = @(ENEDAMStubNow());
+    state.fullSyncBefore = @0;
+    state.updateCount = @(shard.updateCount);
+    state.uploaded = @0;
+    return state;
+}
+
+// Examines up to maxEntries changes after afterUSN and returns those the filter admits.
+- (EDAMSyncChunk *)syncChunkForShard:(ENEDAMStubShard *)shard afterUSN:(int32_t)afterUSN maxEntries:(int32_t)maxEntries filter:(EDAMSyncChunkFilter *)filter
+{
+    NSMutableArray * notes = [NSMutableArray array];
+    NSMutableArray * notebooks = [NSMutableArray array];
+    NSMutableArray * tags = [NSMutableArray array];
+    NSMutableArray * linkedNotebooks = [NSMutableArray array];
+    NSSet * notebookGuids = filter.notebookGuids;
+
+    NSUInteger start = [shard indexOfFirstChangeAfterUSN:afterUSN];
+    NSUInteger end = MIN(shard.changes.count, start + (NSUInteger)MAX(maxEntries, 0));
+    for (NSUInteger i = start; i < end; i++) {
+        id change = shard.changes[i];
+        if ([change isKindOfClass:[EDAMNote class]]) {
+            EDAMNote * note = change;
+            if (filter.includeNotes.boolValue && (!notebookGuids || [notebookGuids containsObject:note.notebookGuid])) {
+                [notes addObject:ENEDAMStubNoteWithoutBodies(note, filter.includeNoteResources.boolValue)];
+            }
+        } else if ([change isKindOfClass:[EDAMNotebook class]]) {
+            if (filter.includeNotebooks.boolValue && (!notebookGuids || [notebookGuids containsObject:[change guid]])) {
+                [notebooks addObject:change];
+            }
+        } else if ([change isKindOfClass:[EDAMTag class]]) {
+            if (filter.includeTags.boolValue && !notebookGuids) {
+                [tags addObject:change];
+            }
+        } else if ([change isKindOfClass:[EDAMLinkedNotebook class]]) {
+            if (filter.includeLinkedNotebooks.boolValue && !notebookGuids) {
+                [linkedNotebooks addObject:change];
+            }
+        }
+    }
+
+    EDAMSyncChunk * chunk = [[EDAMSyncChunk alloc] init];
+    chunk.currentTime = @(ENEDAMStubNow());
+    chunk.updateCount = @(shard.updateCount);
+    if (end > start) {
+        chunk.chunkHighUSN = [shard.changes[end - 1] valueForKey:@"updateSequenceNum"];
+    }
+    chunk.notes = notes.count ? notes : nil;
+    chunk.notebooks = notebooks.count ? notebooks : nil;
+    chunk.tags = tags.count ? tags : nil;
+    chunk.linkedNotebooks = linkedNotebooks.count ? linkedNotebooks : nil;
+    return chunk;
+}
+
+- (EDAMSharedNotebook *)sharedNotebookInShard:(ENEDAMStubShard *)shard forLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+{
+    for (EDAMSharedNotebook * sharedNotebook in shard.sharedNotebooks) {
+        if ([sharedNotebook.globalId isEqualToString:linkedNotebook.sharedNotebookGlobalId]) {
+            return sharedNotebook;
+        }
+    }
+    @throw ENEDAMStubNotFoundException(@"LinkedNotebook.sharedNotebookGlobalId", linkedNotebook.sharedNotebookGlobalId);
+}
+
+// Title matching stands in for search: every word in the filter must appear in the title or content.
+- (EDAMNotesMetadataList *)notesMetadataForShard:(ENEDAMStubShard *)shard
+                                          filter:(EDAMNoteFilter *)filter
+                                          offset:(int32_t)offset
+                                        maxNotes:(int32_t)maxNotes
+                                      resultSpec:(EDAMNotesMetadataResultSpec *)resultSpec
+{
+    NSArray * words = [filter.words.lowercaseString componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+    NSMutableArray * matches = [NSMutableArray array];
+    for (EDAMNote * note in shard.notes.allValues) {
+        if (note.active.boolValue != filter.inactive.boolValue && !(filter.notebookGuid && ![filter.notebookGuid isEqualToString:note.notebookGuid])) {
+            BOOL matched = YES;
+            for (NSString * word in words) {
+                if (word.length > 0 && ![note.title.lowercaseString containsString:word] && ![note.content containsString:word]) {
+                    matched = NO;
+                    break;
+                }
+            }
+            if (matched) {
+                [matches addObject:note];
+            }
+        }
+    }
+
+    NSString * sortKey = @"updated";
+    switch (filter.order.intValue) {
+        case NoteSortOrder_CREATED: sortKey = @"created"; break;
+        case NoteSortOrder_TITLE: sortKey = @"title"; break;
+        case NoteSortOrder_UPDATE_SEQUENCE_NUMBER: sortKey = @"updateSequenceNum"; break;
+        default: break;
+    }
+    [matches sortUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:sortKey ascending:filter.ascending.boolValue],
+                                    [NSSortDescriptor sortDescriptorWithKey:@"guid" ascending:YES]]];
+
+    NSMutableArray * metadata = [NSMutableArray array];
+    for (NSUInteger i = (NSUInteger)MAX(offset, 0); i < matches.count && metadata.count < (NSUInteger)MAX(maxNotes, 0); i++) {
+        EDAMNote * note = matches[i];
+        EDAMNoteMetadata * entry = [[EDAMNoteMetadata alloc] init];
+        entry.guid = note.guid;
+        entry.title = resultSpec.includeTitle.boolValue ? note.title : nil;
+        entry.contentLength = resultSpec.includeContentLength.boolValue ? note.contentLength : nil;
+        entry.created = resultSpec.includeCreated.boolValue ? note.created : nil;
+        entry.updated = resultSpec.includeUpdated.boolValue ? note.updated : nil;
+        entry.deleted = resultSpec.includeDeleted.boolValue ? note.deleted : nil;
+        entry.updateSequenceNum = resultSpec.includeUpdateSequenceNum.boolValue ? note.updateSequenceNum : nil;
+        entry.notebookGuid = resultSpec.includeNotebookGuid.boolValue ? note.notebookGuid : nil;
+        entry.tagGuids = resultSpec.includeTagGuids.boolValue ? note.tagGuids : nil;
+        entry.attributes = resultSpec.includeAttributes.boolValue ? note.attributes : nil;
+        [metadata addObject:entry];
+    }
+
+    EDAMNotesMetadataList * list = [[EDAMNotesMetadataList alloc] init];
+    list.startIndex = @(offset);
+    list.totalNotes = @((int32_t)matches.count);
+    list.notes = metadata;
+    list.updateCount = @(shard.updateCount);
+    return list;
+}
+
+- (EDAMNote *)noteForCall:(ENEDAMStubCall *)call withContent:(BOOL)withContent withResourcesData:(BOOL)withResourcesData
+{
+    EDAMNote * note = [self shardForCall:call].notes[call.arguments[@"guid"] ?: @""];
+    if (!note) {
+        @throw ENEDAMStubNotFoundException(@"Note.guid", call.arguments[@"guid"]);
+    }
+    if (withResourcesData) {
+        if (withContent) {
+            return note;
+        }
+        EDAMNote * copy = [note copy];
+        copy.content = nil;
+        return copy;
+    }
+    EDAMNote * copy = ENEDAMStubNoteWithoutBodies(note, YES);
+    copy.content = withContent ? note.content : nil;
+    return copy;
+}
+
+- (EDAMNote *)storeNote:(EDAMNote *)note inShard:(ENEDAMStubShard *)shard creating:(BOOL)creating
+{
+    if (note.title.length == 0) {
+        @throw ENEDAMStubUserException(EDAMErrorCode_BAD_DATA_FORMAT, @"Note.title");
+    }
+    EDAMNote * existing = creating ? nil : shard.notes[note.guid ?: @""];
+    if (!creating && !existing) {
+        @throw ENEDAMStubNotFoundException(@"Note.guid", note.guid);
+    }
+    NSString * notebookGuid = note.notebookGuid ?: existing.notebookGuid ?: [shard defaultNotebook].guid;
+    if (!shard.notebooks[notebookGuid ?: @""]) {
+        @throw ENEDAMStubNotFoundException(@"Note.notebookGuid", notebookGuid);
+    }
+
+    EDAMNote * stored = creating ? [[EDAMNote alloc] init] : existing;
+    int64_t now = ENEDAMStubNow();
+    if (creating) {
+        stored.guid = [[NSUUID UUID] UUIDString].lowercaseString;
+        stored.created = note.created ?: @(now);
+        stored.active = @YES;
+    }
+    stored.title = note.title;
+    stored.notebookGuid = notebookGuid;
+    stored.updated = note.updated ?: @(now);
+    stored.tagGuids = note.tagGuids ?: existing.tagGuids;
+    stored.attributes = note.attributes ?: existing.attributes;
+    if (note.content) {
+        NSData * contentData = [note.content dataUsingEncoding:NSUTF8StringEncoding];
+        stored.content = note.content;
+        stored.contentHash = [contentData enmd5];
+        stored.contentLength = @((int32_t)contentData.length);
+    }
+    if (note.resources) {
+        for (EDAMResource * resource in existing.resources) {
+            [shard.resources removeObjectForKey:resource.guid];
+        }
+        NSMutableArray * resources = [NSMutableArray arrayWithCapacity:note.resources.count];
+        for (EDAMResource * resource in note.resources) {
+            EDAMResource * storedResource = [resource copy];
+            storedResource.guid = storedResource.guid ?: [[NSUUID UUID] UUIDString].lowercaseString;
+            storedResource.noteGuid = stored.guid;
+            storedResource.active = @YES;
+            storedResource.updateSequenceNum = @(shard.updateCount + 1);
+            if (storedResource.data.body && !storedResource.data.bodyHash) {
+                storedResource.data.bodyHash = [storedResource.data.body enmd5];
+                storedResource.data.size = @((int32_t)storedResource.data.body.length);
+            }
+            shard.resources[storedResource.guid] = storedResource;
+            [resources addObject:storedResource];
+        }
+        stored.resources = resources;
+    }
+    shard.notes[stored.guid] = stored;
+    [shard recordChange:stored];
+    return ENEDAMStubNoteWithoutBodies(stored, YES);
+}
+
+#pragma mark - Dataset generation
+
+- (ENEDAMStubShard *)addShard:(NSString *)shardId userId:(EDAMUserID)userId username:(NSString *)username
+{
+    ENEDAMStubShard * shard = [[ENEDAMStubShard alloc] init];
+    shard.shardId = shardId;
+    shard.authenticationToken = ENEDAMStubAuthenticationToken(shardId, userId, nil);
+
+    EDAMUser * user = [[EDAMUser alloc] init];
+    user.id = @(userId);
+    user.username = username;
+    user.name = [username capitalizedString];
+    user.email = [username stringByAppendingString:@"@example.com"];
+    user.privilege = @(PrivilegeLevel_NORMAL);
+    user.serviceLevel = @(ServiceLevel_PREMIUM);
+    user.created = @(ENEDAMStubNow() - 86400000LL * 365);
+    user.active = @YES;
+    user.shardId = shardId;
+    user.accounting = [[EDAMAccounting alloc] init];
+    user.accounting.uploadLimit = @(10LL * 1024 * 1024 * 1024);
+    shard.user = user;
+
+    self.shards[shardId] = shard;
+    self.shardsByToken[shard.authenticationToken] = shard;
+    return shard;
+}
+
+- (NSArray<EDAMNotebook *> *)addNotebooks:(NSUInteger)count named:(NSString *)name toShard:(ENEDAMStubShard *)shard
+{
+    NSMutableArray * notebooks = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        EDAMNotebook * notebook = [[EDAMNotebook alloc] init];
+        notebook.guid = ENEDAMStubGuid([shard.shardId stringByAppendingString:@"/notebook"], i);
+        notebook.name = [NSString stringWithFormat:@"%@ %lu", name, (unsigned long)(i + 1)];
+        notebook.defaultNotebook = @(i == 0 && [shard.shardId isEqualToString:ENEDAMStubPersonalShardId]);
+        notebook.serviceCreated = notebook.serviceUpdated = @(ENEDAMStubNow());
+        shard.notebooks[notebook.guid] = notebook;
+        [shard recordChange:notebook];
+        [notebooks addObject:notebook];
+    }
+    return notebooks;
+}
+
+- (void)addNotes:(NSUInteger)count toNotebooks:(NSArray<EDAMNotebook *> *)notebooks inShard:(ENEDAMStubShard *)shard random:(uint32_t *)random
+{
+    ENEDAMStubDataset * dataset = self.dataset;
+    NSArray * tags = shard.tags.allValues;
+    NSUInteger firstIndex = shard.notes.count;
+    for (NSUInteger i = 0; i < count && notebooks.count > 0; i++) {
+        NSUInteger index = firstIndex + i;
+        EDAMNote * note = [[EDAMNote alloc] init];
+        note.guid = ENEDAMStubGuid([shard.shardId stringByAppendingString:@"/note"], index);
+        note.title = [NSString stringWithFormat:@"Note %lu %@", (unsigned long)(index + 1), ENEDAMStubSentence(random, 3)];
+        note.notebookGuid = notebooks[i % notebooks.count].guid;
+        note.created = @(ENEDAMStubNow() - (int64_t)(ENEDAMStubRandom(random) % 31536000) * 1000LL);
+        note.updated = @(note.created.longLongValue + (int64_t)(ENEDAMStubRandom(random) % 86400) * 1000LL);
+        note.active = @YES;
+        if (tags.count > 0) {
+            NSMutableOrderedSet * tagGuids = [NSMutableOrderedSet orderedSet];
+            for (uint32_t t = ENEDAMStubRandom(random) % 3; t > 0; t--) {
+                [tagGuids addObject:[tags[ENEDAMStubRandom(random) % tags.count] guid]];
+            }
+            note.tagGuids = tagGuids.count ? tagGuids.array : nil;
+        }
+
+        NSMutableArray * resources = [NSMutableArray arrayWithCapacity:dataset.resourcesPerNote];
+        for (NSUInteger r = 0; r < dataset.resourcesPerNote; r++) {
+            NSMutableData * body = [NSMutableData dataWithLength:dataset.resourceLength];
+            uint32_t * words = body.mutableBytes;
+            for (NSUInteger w = 0; w < dataset.resourceLength / sizeof(uint32_t); w++) {
+                words[w] = ENEDAMStubRandom(random);
+            }
+            EDAMResource * resource = [[EDAMResource alloc] init];
+            resource.guid = ENEDAMStubGuid([shard.shardId stringByAppendingString:@"/resource"], index * dataset.resourcesPerNote + r);
+            resource.noteGuid = note.guid;
+            resource.mime = @"application/octet-stream";
+            resource.active = @YES;
+            resource.data = [[EDAMData alloc] init];
+            resource.data.body = body;
+            resource.data.bodyHash = [body enmd5];
+            resource.data.size = @((int32_t)body.length);
+            shard.resources[resource.guid] = resource;
+            [resources addObject:resource];
+        }
+        note.resources = resources.count ? resources : nil;
+
+        note.content = ENEDAMStubENML(random, dataset.noteContentLength, resources);
+        NSData * contentData = [note.content dataUsingEncoding:NSUTF8StringEncoding];
+        note.contentHash = [contentData enmd5];
+        note.contentLength = @((int32_t)contentData.length);
+        shard.notes[note.guid] = note;
+        int32_t usn = [shard recordChange:note];
+        for (EDAMResource * resource in resources) {
+            resource.updateSequenceNum = @(usn);
+        }
+    }
+}
+
+// Must be called with the shards lock held.
+- (void)generateDataset
+{
+    ENEDAMStubDataset * dataset = self.dataset;
+    uint32_t random = dataset.seed ?: 1;
+
+    ENEDAMStubShard * personal = [self addShard:ENEDAMStubPersonalShardId userId:ENEDAMStubUserId username:@"stub"];
+    for (NSUInteger i = 0; i < dataset.tagCount; i++) {
+        EDAMTag * tag = [[EDAMTag alloc] init];
+        tag.guid = ENEDAMStubGuid(@"s1/tag", i);
+        tag.name = [NSString stringWithFormat:@"%@-%lu", ENEDAMStubWords()[i % ENEDAMStubWords().count], (unsigned long)i];
+        personal.tags[tag.guid] = tag;
+        [personal recordChange:tag];
+    }
+    NSArray * notebooks = [self addNotebooks:MAX(dataset.notebookCount, 1) named:@"Notebook" toShard:personal];
+    [self addNotes:dataset.noteCount toNotebooks:notebooks inShard:personal random:&random];
+
+    // Notebooks another user shares into the account.
+    if (dataset.linkedNotebookCount > 0) {
+        ENEDAMStubShard * sharer = [self addShard:ENEDAMStubSharerShardId userId:ENEDAMStubSharerUserId username:@"stub-sharer"];
+        NSArray * sharedNotebooks = [self addNotebooks:dataset.linkedNotebookCount named:@"Shared notebook" toShard:sharer];
+        [self addNotes:dataset.notesPerLinkedNotebook * sharedNotebooks.count toNotebooks:sharedNotebooks inShard:sharer random:&random];
+        [self shareNotebooks:sharedNotebooks fromShard:sharer intoShard:personal businessId:nil];
+    }
+
+    // A business the user belongs to, with notebooks they have joined.
+    if (dataset.businessNotebookCount > 0) {
+        ENEDAMStubShard * business = [self addShard:ENEDAMStubBusinessShardId userId:ENEDAMStubUserId username:@"stub"];
+        for (EDAMUser * user in @[personal.user, business.user]) {
+            user.accounting.businessId = @(ENEDAMStubBusinessId);
+            user.accounting.businessName = @"Stub Business";
+        }
+        NSArray * businessNotebooks = [self addNotebooks:dataset.businessNotebookCount named:@"Business notebook" toShard:business];
+        [self addNotes:dataset.notesPerBusinessNotebook * businessNotebooks.count toNotebooks:businessNotebooks inShard:business random:&random];
+        [self shareNotebooks:businessNotebooks fromShard:business intoShard:personal businessId:@(ENEDAMStubBusinessId)];
+    }
+}
+
+- (void)shareNotebooks:(NSArray<EDAMNotebook *> *)notebooks fromShard:(ENEDAMStubShard *)owner intoShard:(ENEDAMStubShard *)recipient businessId:(NSNumber *)businessId
+{
+    for (EDAMNotebook * notebook in notebooks) {
+        EDAMSharedNotebook * sharedNotebook = [[EDAMSharedNotebook alloc] init];
+        sharedNotebook.id = @(owner.sharedNotebooks.count + 1);
+        sharedNotebook.userId = owner.user.id;
+        sharedNotebook.notebookGuid = notebook.guid;
+        sharedNotebook.email = recipient.user.email;
+        sharedNotebook.recipientUserId = recipient.user.id;
+        sharedNotebook.recipientUsername = recipient.user.username;
+        sharedNotebook.sharerUserId = owner.user.id;
+        sharedNotebook.globalId = ENEDAMStubGuid([owner.shardId stringByAppendingString:@"/share"], owner.sharedNotebooks.count);
+        sharedNotebook.privilege = @(SharedNotebookPrivilegeLevel_MODIFY_NOTEBOOK_PLUS_ACTIVITY);
+        sharedNotebook.notebookModifiable = @YES;
+        sharedNotebook.serviceCreated = sharedNotebook.serviceUpdated = @(ENEDAMStubNow());
+        [owner.sharedNotebooks addObject:sharedNotebook];
+
+        EDAMLinkedNotebook * linkedNotebook = [[EDAMLinkedNotebook alloc] init];
+        linkedNotebook.guid = ENEDAMStubGuid([recipient.shardId stringByAppendingString:@"/linked"], recipient.linkedNotebooks.count);
+        linkedNotebook.shareName = notebook.name;
+        linkedNotebook.username = owner.user.username;
+        linkedNotebook.shardId = owner.shardId;
+        linkedNotebook.sharedNotebookGlobalId = sharedNotebook.globalId;
+        linkedNotebook.businessId = businessId;
+        [recipient.linkedNotebooks addObject:linkedNotebook];
+        [recipient recordChange:linkedNotebook];
+    }
+}
+
+@end
@@ -0,0 +1,619 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Headless suite for the SDK's CPU hot paths: Thrift binary encode/decode of notes, sync chunks and note
+// metadata lists, service error replies, ENML generation, HTML to ENML, ENML to HTML, resource MD5,
+// preferences store writes and local searches.
+// Each case runs for a fixed time and prints one JSON line with throughput, allocations and peak memory.
+//
+//   ENSDKBenchmarkSuite [--list] [--case <name or name/size>] [--seconds <n>]
+//
+// Peak memory is the process high-water mark, so run one case per process (as run_benchmarks.sh does)
+// to attribute it to that case.
+
+#import <Foundation/Foundation.h>
+#import <mach/mach.h>
+#import <sys/resource.h>
+#import "EDAM.h"
+#import "ENTBinaryProtocol.h"
+#import "ENTTransport.h"
+#import "ENTAsyncInvocation.h"
+#import "ENSDKPrivate.h"
+#import "ENHTMLtoENMLConverter.h"
+#import "ENMLUtility.h"
+#import "NSData+EvernoteSDK.h"
+#import "ENNoteIndex.h"
+#import "ENNoteSearchQuery.h"
+
+@interface ENPreferencesStore (Benchmark)
+- (id)initWithURL:(NSURL *)fileURL;
+@end
+
+#pragma mark - Allocation counting
+
+// libmalloc calls this hook, when set, for every allocation and free in every zone.
+typedef void (ENMallocLogger)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numHotFramesToSkip);
+extern ENMallocLogger * malloc_logger;
+
+#define EN_MALLOC_LOG_TYPE_ALLOCATE   2
+#define EN_MALLOC_LOG_TYPE_DEALLOCATE 4
+
+static uint64_t ENBenchmarkAllocationCount = 0;
+static uint64_t ENBenchmarkAllocationBytes = 0;
+
+static void ENBenchmarkMallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t numHotFramesToSkip)
+{
+    if (!(type & EN_MALLOC_LOG_TYPE_ALLOCATE)) {
+        return;
+    }
+    // A realloc logs both flags and carries its new size in arg3; plain allocations carry it in arg2.
+    uintptr_t size = (type & EN_MALLOC_LOG_TYPE_DEALLOCATE) ? arg3 : arg2;
+    __atomic_add_fetch(&ENBenchmarkAllocationCount, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ENBenchmarkAllocationBytes, size, __ATOMIC_RELAXED);
+}
+
+static uint64_t ENBenchmarkPeakResidentBytes(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (uint64_t)usage.ru_maxrss; // bytes on Darwin
+}
+
+static uint64_t ENBenchmarkFootprintBytes(void)
+{
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.phys_footprint;
+}
+
+#pragma mark - Harness
+
+@interface ENBenchmarkCase : NSObject
+@property (nonatomic, copy) NSString * name;
+@property (nonatomic, copy) NSString * size;
+// Bytes processed per iteration, for MB/s. Zero if throughput is only reported in operations.
+@property (nonatomic, assign) uint64_t bytesPerIteration;
+@property (nonatomic, copy) void (^setUp)(ENBenchmarkCase * benchmarkCase);
+@property (nonatomic, copy) void (^body)(void);
+@end
+
+@implementation ENBenchmarkCase
++ (instancetype)caseWithName:(NSString *)name size:(NSString *)size setUp:(void (^)(ENBenchmarkCase *))setUp
+{
+    ENBenchmarkCase * benchmarkCase = [[ENBenchmarkCase alloc] init];
+    benchmarkCase.name = name;
+    benchmarkCase.size = size;
+    benchmarkCase.setUp = setUp;
+    return benchmarkCase;
+}
+
+- (NSString *)identifier
+{
+    return [NSString stringWithFormat:@"%@/%@", self.name, self.size];
+}
+
+- (NSString *)runForSeconds:(double)seconds
+{
+    @autoreleasepool {
+        self.setUp(self);
+    }
+    // One untimed iteration to fault in code and caches.
+    @autoreleasepool {
+        self.body();
+    }
+
+    uint64_t iterations = 0;
+    ENBenchmarkAllocationCount = 0;
+    ENBenchmarkAllocationBytes = 0;
+    malloc_logger = ENBenchmarkMallocLogger;
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    CFAbsoluteTime elapsed = 0;
+    do {
+        @autoreleasepool {
+            self.body();
+        }
+        iterations++;
+        elapsed = CFAbsoluteTimeGetCurrent() - start;
+    } while (elapsed < seconds);
+    malloc_logger = NULL;
+
+    NSMutableDictionary * result = [NSMutableDictionary dictionary];
+    result[@"benchmark"] = self.name;
+    result[@"size"] = self.size;
+    result[@"iterations"] = @(iterations);
+    result[@"seconds"] = @(elapsed);
+    result[@"ops_per_s"] = @(iterations / elapsed);
+    if (self.bytesPerIteration > 0) {
+        result[@"bytes_per_op"] = @(self.bytesPerIteration);
+        result[@"mb_per_s"] = @(self.bytesPerIteration * iterations / elapsed / (1024.0 * 1024.0));
+    }
+    result[@"allocs_per_op"] = @((double)ENBenchmarkAllocationCount / iterations);
+    result[@"alloc_bytes_per_op"] = @((double)ENBenchmarkAllocationBytes / iterations);
+    result[@"peak_rss_bytes"] = @(ENBenchmarkPeakResidentBytes());
+    result[@"footprint_bytes"] = @(ENBenchmarkFootprintBytes());
+    NSString * commit = [[NSProcessInfo processInfo] environment][@"EN_BENCHMARK_COMMIT"];
+    if (commit) {
+        result[@"commit"] = commit;
+    }
+    NSData * json = [NSJSONSerialization dataWithJSONObject:result options:NSJSONWritingSortedKeys error:NULL];
+    return [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+}
+@end
+
+#pragma mark - Thrift
+
+// Transport over an in-memory buffer, so encode and decode run without a network.
+@interface ENBenchmarkMemoryTransport : NSObject <ENTTransport>
+@property (nonatomic, strong) NSMutableData * buffer;
+@property (nonatomic, assign) NSUInteger readOffset;
+@end
+
+@implementation ENBenchmarkMemoryTransport
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.buffer = [NSMutableData data];
+    }
+    return self;
+}
+
+- (int)readAll:(uint8_t *)buf offset:(int)off length:(int)len
+{
+    if (self.readOffset + len > self.buffer.length) {
+        @throw [ENTTransportException exceptionWithReason:@"Read past end of buffer"];
+    }
+    [self.buffer getBytes:buf + off range:NSMakeRange(self.readOffset, len)];
+    self.readOffset += len;
+    return len;
+}
+
+- (void)write:(const uint8_t *)data offset:(unsigned int)offset length:(unsigned int)length
+{
+    [self.buffer appendBytes:data + offset length:length];
+}
+
+- (void)flush
+{
+}
+
+- (void)cancel
+{
+}
+@end
+
+static NSData * ENBenchmarkEncode(id object)
+{
+    ENBenchmarkMemoryTransport * transport = [[ENBenchmarkMemoryTransport alloc] init];
+    ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
+    [ENTProtocolUtil writeObject:object ontoProtocol:protocol];
+    return transport.buffer;
+}
+
+static id ENBenchmarkDecode(NSData * data, Class objectClass)
+{
+    ENBenchmarkMemoryTransport * transport = [[ENBenchmarkMemoryTransport alloc] init];
+    [transport.buffer setData:data];
+    ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
+    id object = [[objectClass alloc] init];
+    [ENTProtocolUtil readFromProtocol:protocol ontoObject:object];
+    return object;
+}
+
+// A getNote reply carrying EDAMNotFoundException, as syncs and lookups get for notes that are gone.
+static NSData * ENBenchmarkNotFoundReply(NSString * guid)
+{
+    ENBenchmarkMemoryTransport * transport = [[ENBenchmarkMemoryTransport alloc] init];
+    ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
+    EDAMNotFoundException * notFound = [[EDAMNotFoundException alloc] init];
+    notFound.identifier = @"Note.guid";
+    notFound.key = guid;
+    FATField * field = [FATField fieldWithIndex:3 type:TType_STRUCT optional:NO name:@"notFoundException" structClass:[EDAMNotFoundException class]];
+    [ENTProtocolUtil sendReply:@"getNote" sequenceID:0 toProtocol:protocol withResult:[FATArgument argumentWithField:field value:notFound]];
+    return transport.buffer;
+}
+
+#pragma mark - Fixtures
+
+static NSData * ENBenchmarkRandomData(NSUInteger length)
+{
+    NSMutableData * data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+static NSString * ENBenchmarkGuid(NSUInteger i)
+{
+    return [NSString stringWithFormat:@"%08lx-0000-4000-8000-%012lx", (unsigned long)i, (unsigned long)(i * 7919)];
+}
+
+// Plain text of roughly the given length, in short lines with some markup-significant characters.
+static NSString * ENBenchmarkText(NSUInteger length)
+{
+    NSString * line = @"The quick brown fox & the lazy dog <jumped> over \"42\" fences, café déjà vu.\n";
+    NSMutableString * text = [NSMutableString stringWithCapacity:length + line.length];
+    while (text.length < length) {
+        [text appendString:line];
+    }
+    return text;
+}
+
+static NSString * ENBenchmarkENML(NSUInteger length)
+{
+    return [[ENNoteContent noteContentWithString:ENBenchmarkText(length)] enmlWithNote:nil];
+}
+
+static NSString * ENBenchmarkHTML(NSUInteger length)
+{
+    NSString * block = @"<div class=\"para\"><p>Some <b>bold</b> and <i>italic</i> text with a <a href=\"https://example.com/path?q=1&amp;r=2\">link</a>.</p>"
+                       @"<ul><li>one</li><li>two</li></ul><table><tr><td>cell</td><td style=\"color:red\">cell</td></tr></table>"
+                       @"<script>ignored()</script><img src=\"https://example.com/i.png\" width=\"10\"></div>\n";
+    NSMutableString * html = [NSMutableString stringWithString:@"<html><head><title>t</title></head><body>"];
+    while (html.length < length) {
+        [html appendString:block];
+    }
+    [html appendString:@"</body></html>"];
+    return html;
+}
+
+static EDAMNote * ENBenchmarkNote(NSUInteger i, NSUInteger contentLength, NSUInteger resourceCount, NSUInteger resourceLength)
+{
+    EDAMNote * note = [[EDAMNote alloc] init];
+    note.guid = ENBenchmarkGuid(i);
+    note.title = [NSString stringWithFormat:@"Benchmark note %lu", (unsigned long)i];
+    note.created = @(1400000000000LL + (long long)i);
+    note.updated = @(1400000000000LL + (long long)i * 2);
+    note.updateSequenceNum = @((int32_t)i + 1);
+    note.notebookGuid = ENBenchmarkGuid(i % 10);
+    note.tagGuids = @[ENBenchmarkGuid(i % 5), ENBenchmarkGuid(i % 7)];
+    if (contentLength > 0) {
+        note.content = ENBenchmarkENML(contentLength);
+        NSData * contentData = [note.content dataUsingEncoding:NSUTF8StringEncoding];
+        note.contentHash = [contentData enmd5];
+        note.contentLength = @((int32_t)contentData.length);
+    }
+    NSMutableArray * resources = [NSMutableArray arrayWithCapacity:resourceCount];
+    for (NSUInteger r = 0; r < resourceCount; r++) {
+        EDAMResource * resource = [[EDAMResource alloc] init];
+        resource.guid = ENBenchmarkGuid(i * 100 + r);
+        resource.noteGuid = note.guid;
+        resource.mime = @"image/png";
+        resource.data = [[EDAMData alloc] init];
+        resource.data.body = ENBenchmarkRandomData(resourceLength);
+        resource.data.bodyHash = [resource.data.body enmd5];
+        resource.data.size = @((int32_t)resourceLength);
+        [resources addObject:resource];
+    }
+    note.resources = resources;
+    return note;
+}
+
+static EDAMSyncChunk * ENBenchmarkSyncChunk(NSUInteger noteCount)
+{
+    EDAMSyncChunk * chunk = [[EDAMSyncChunk alloc] init];
+    chunk.currentTime = @(1400000000000LL);
+    chunk.chunkHighUSN = @((int32_t)noteCount);
+    chunk.updateCount = @((int32_t)noteCount * 2);
+    NSMutableArray * notes = [NSMutableArray arrayWithCapacity:noteCount];
+    for (NSUInteger i = 0; i < noteCount; i++) {
+        [notes addObject:ENBenchmarkNote(i, 0, 0, 0)];
+    }
+    NSMutableArray * notebooks = [NSMutableArray array];
+    for (NSUInteger i = 0; i < MAX(noteCount / 10, 1); i++) {
+        EDAMNotebook * notebook = [[EDAMNotebook alloc] init];
+        notebook.guid = ENBenchmarkGuid(i);
+        notebook.name = [NSString stringWithFormat:@"Notebook %lu", (unsigned long)i];
+        notebook.updateSequenceNum = @((int32_t)i);
+        [notebooks addObject:notebook];
+    }
+    NSMutableArray * tags = [NSMutableArray array];
+    for (NSUInteger i = 0; i < MAX(noteCount / 5, 1); i++) {
+        EDAMTag * tag = [[EDAMTag alloc] init];
+        tag.guid = ENBenchmarkGuid(i);
+        tag.name = [NSString stringWithFormat:@"tag-%lu", (unsigned long)i];
+        tag.updateSequenceNum = @((int32_t)i);
+        [tags addObject:tag];
+    }
+    chunk.notes = notes;
+    chunk.notebooks = notebooks;
+    chunk.tags = tags;
+    return chunk;
+}
+
+static EDAMNotesMetadataList * ENBenchmarkMetadataList(NSUInteger noteCount)
+{
+    EDAMNotesMetadataList * list = [[EDAMNotesMetadataList alloc] init];
+    list.startIndex = @0;
+    list.totalNotes = @((int32_t)noteCount);
+    list.updateCount = @((int32_t)noteCount);
+    NSMutableArray * notes = [NSMutableArray arrayWithCapacity:noteCount];
+    for (NSUInteger i = 0; i < noteCount; i++) {
+        EDAMNoteMetadata * metadata = [[EDAMNoteMetadata alloc] init];
+        metadata.guid = ENBenchmarkGuid(i);
+        metadata.title = [NSString stringWithFormat:@"Benchmark note %lu", (unsigned long)i];
+        metadata.created = @(1400000000000LL + (long long)i);
+        metadata.updated = @(1400000000000LL + (long long)i * 2);
+        metadata.updateSequenceNum = @((int32_t)i + 1);
+        metadata.notebookGuid = ENBenchmarkGuid(i % 10);
+        metadata.largestResourceSize = @((int32_t)(i * 31) % 100000);
+        [notes addObject:metadata];
+    }
+    list.notes = notes;
+    return list;
+}
+
+#pragma mark - Cases
+
+static void ENBenchmarkAddThriftCases(NSMutableArray * cases, NSString * name, NSString * size, Class objectClass, id (^makeObject)(void))
+{
+    __block id object = nil;
+    __block NSData * encoded = nil;
+    ENBenchmarkCase * encode = [ENBenchmarkCase caseWithName:[@"thrift_encode_" stringByAppendingString:name] size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+        object = makeObject();
+        benchmarkCase.bytesPerIteration = ENBenchmarkEncode(object).length;
+    }];
+    encode.body = ^{
+        ENBenchmarkEncode(object);
+    };
+    [cases addObject:encode];
+
+    ENBenchmarkCase * decode = [ENBenchmarkCase caseWithName:[@"thrift_decode_" stringByAppendingString:name] size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+        encoded = ENBenchmarkEncode(makeObject());
+        benchmarkCase.bytesPerIteration = encoded.length;
+    }];
+    decode.body = ^{
+        ENBenchmarkDecode(encoded, objectClass);
+    };
+    [cases addObject:decode];
+
+    // Downloaded and sent back unchanged, as when a note is fetched, edited elsewhere and uploaded.
+    ENBenchmarkCase * roundTrip = [ENBenchmarkCase caseWithName:[@"thrift_round_trip_" stringByAppendingString:name] size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+        encoded = ENBenchmarkEncode(makeObject());
+        benchmarkCase.bytesPerIteration = encoded.length;
+    }];
+    roundTrip.body = ^{
+        ENBenchmarkEncode(ENBenchmarkDecode(encoded, objectClass));
+    };
+    [cases addObject:roundTrip];
+}
+
+static NSArray * ENBenchmarkCases(NSString * temporaryDirectory)
+{
+    NSMutableArray * cases = [NSMutableArray array];
+
+    NSDictionary * noteSizes = @{@"small" : @[@2048, @0, @0],
+                                 @"medium" : @[@(64 * 1024), @2, @(128 * 1024)],
+                                 @"large" : @[@(1024 * 1024), @8, @(512 * 1024)]};
+    for (NSString * size in @[@"small", @"medium", @"large"]) {
+        NSArray * shape = noteSizes[size];
+        ENBenchmarkAddThriftCases(cases, @"note", size, [EDAMNote class], ^id{
+            return ENBenchmarkNote(1, [shape[0] unsignedIntegerValue], [shape[1] unsignedIntegerValue], [shape[2] unsignedIntegerValue]);
+        });
+    }
+    for (NSNumber * count in @[@10, @100, @1000]) {
+        NSString * size = [count stringValue];
+        ENBenchmarkAddThriftCases(cases, @"sync_chunk", size, [EDAMSyncChunk class], ^id{
+            return ENBenchmarkSyncChunk([count unsignedIntegerValue]);
+        });
+        ENBenchmarkAddThriftCases(cases, @"notes_metadata_list", size, [EDAMNotesMetadataList class], ^id{
+            return ENBenchmarkMetadataList([count unsignedIntegerValue]);
+        });
+    }
+
+    // A not-found reply taken to an NSError the way store clients used to, raised out of the call and caught
+    // around the invocation, and the way they do now, handed back by the invocation as a value.
+    for (NSString * size in @[@"exception", @"value"]) {
+        BOOL returnsServiceExceptions = [size isEqualToString:@"value"];
+        NSString * guid = ENBenchmarkGuid(1);
+        __block ENBenchmarkMemoryTransport * inTransport = nil;
+        __block ENBenchmarkMemoryTransport * outTransport = nil;
+        __block EDAMNoteStoreClient * client = nil;
+        ENBenchmarkCase * serviceError = [ENBenchmarkCase caseWithName:@"thrift_service_error" size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+            inTransport = [[ENBenchmarkMemoryTransport alloc] init];
+            [inTransport.buffer setData:ENBenchmarkNotFoundReply(guid)];
+            outTransport = [[ENBenchmarkMemoryTransport alloc] init];
+            client = [[EDAMNoteStoreClient alloc] initWithInProtocol:[[ENTBinaryProtocol alloc] initWithTransport:inTransport]
+                                                         outProtocol:[[ENTBinaryProtocol alloc] initWithTransport:outTransport]];
+        }];
+        serviceError.body = ^{
+            inTransport.readOffset = 0;
+            outTransport.buffer.length = 0;
+            ENTAsyncInvocation * invocation = [[ENTAsyncInvocation alloc] initWithBlock:^{
+                [client getNote:@"token" guid:guid withContent:NO withResourcesData:NO withResourcesRecognition:NO withResourcesAlternateData:NO];
+            }];
+            invocation.returnsServiceExceptions = returnsServiceExceptions;
+            NSError * error = nil;
+            @try {
+                [invocation runWithResumeHandler:^{}];
+                error = [ENError errorFromException:invocation.serviceException];
+            }
+            @catch (NSException * exception) {
+                error = [ENError errorFromException:exception];
+            }
+            if (error.code != ENErrorCodeNotFound) {
+                @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"Expected a not-found error" userInfo:nil];
+            }
+        };
+        [cases addObject:serviceError];
+    }
+
+    for (NSNumber * length in @[@1024, @(64 * 1024), @(1024 * 1024)]) {
+        NSString * size = [length stringValue];
+
+        __block NSString * text = nil;
+        ENBenchmarkCase * enml = [ENBenchmarkCase caseWithName:@"enml_from_plain_text" size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+            text = ENBenchmarkText([length unsignedIntegerValue]);
+            benchmarkCase.bytesPerIteration = [text lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        }];
+        enml.body = ^{
+            [[ENNoteContent noteContentWithString:text] enmlWithNote:nil];
+        };
+        [cases addObject:enml];
+
+        __block NSString * html = nil;
+        ENBenchmarkCase * htmlToENML = [ENBenchmarkCase caseWithName:@"html_to_enml" size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+            html = ENBenchmarkHTML([length unsignedIntegerValue]);
+            benchmarkCase.bytesPerIteration = [html lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        }];
+        htmlToENML.body = ^{
+            [[[ENHTMLtoENMLConverter alloc] init] enmlFromHTMLContent:html];
+        };
+        [cases addObject:htmlToENML];
+
+        __block NSString * enmlContent = nil;
+        ENBenchmarkCase * enmlToHTML = [ENBenchmarkCase caseWithName:@"enml_to_html" size:size setUp:^(ENBenchmarkCase * benchmarkCase) {
+            enmlContent = ENBenchmarkENML([length unsignedIntegerValue]);
+            benchmarkCase.bytesPerIteration = [enmlContent lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+        }];
+        enmlToHTML.body = ^{
+            // The converter parses on a global queue and completes on the main queue, so spin the main run loop.
+            __block BOOL done = NO;
+            ENMLUtility * utility = [[ENMLUtility alloc] init];
+            [utility generateHTMLFromENML:enmlContent completion:^(NSString * result, NSError * error) {
+                done = YES;
+            }];
+            while (!done) {
+                CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.001, true);
+            }
+        };
+        [cases addObject:enmlToHTML];
+    }
+
+    for (NSNumber * length in @[@(16 * 1024), @(1024 * 1024), @(16 * 1024 * 1024)]) {
+        __block NSData * data = nil;
+        ENBenchmarkCase * md5 = [ENBenchmarkCase caseWithName:@"resource_md5" size:[length stringValue] setUp:^(ENBenchmarkCase * benchmarkCase) {
+            data = ENBenchmarkRandomData([length unsignedIntegerValue]);
+            benchmarkCase.bytesPerIteration = data.length;
+        }];
+        md5.body = ^{
+            // The hash is cached per resource, so each iteration hashes a fresh one.
+            (void)[[ENResource alloc] initWithData:data mimeType:@"application/octet-stream"].dataHash;
+        };
+        [cases addObject:md5];
+    }
+
+    for (NSNumber * keyCount in @[@10, @100, @1000]) {
+        __block ENPreferencesStore * store = nil;
+        __block NSUInteger counter = 0;
+        ENBenchmarkCase * preferences = [ENBenchmarkCase caseWithName:@"preferences_store_write" size:[keyCount stringValue] setUp:^(ENBenchmarkCase * benchmarkCase) {
+            NSString * path = [temporaryDirectory stringByAppendingPathComponent:[NSString stringWithFormat:@"prefs-%@.plist", keyCount]];
+            [[NSFileManager defaultManager] removeItemAtPath:path error:NULL];
+            store = [[ENPreferencesStore alloc] initWithURL:[NSURL fileURLWithPath:path]];
+            for (NSUInteger i = 0; i < [keyCount unsignedIntegerValue]; i++) {
+                [store setObject:ENBenchmarkGuid(i) forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+            }
+        }];
+        preferences.body = ^{
+            [store setObject:@(counter++) forKey:@"key-0"];
+        };
+        [cases addObject:preferences];
+    }
+
+    // A search over a scope whose notes all have their text indexed, with a word and a tag.
+    for (NSNumber * noteCount in @[@1000, @10000]) {
+        __block ENNoteIndex * noteIndex = nil;
+        __block NSArray * noteMetadata = nil;
+        __block EDAMSyncChunk * chunk = nil;
+        __block ENNoteSearchQuery * query = nil;
+        ENBenchmarkCase * search = [ENBenchmarkCase caseWithName:@"local_search" size:[noteCount stringValue] setUp:^(ENBenchmarkCase * benchmarkCase) {
+            chunk = ENBenchmarkSyncChunk([noteCount unsignedIntegerValue]);
+            noteIndex = [[ENNoteIndex alloc] init];
+            [noteIndex applySyncChunk:chunk];
+            NSString * text = ENBenchmarkText(2048);
+            NSMutableArray * metadataList = [NSMutableArray array];
+            NSDictionary * signatures = [noteIndex textSignaturesForNotesNeedingText];
+            for (EDAMNote * note in chunk.notes) {
+                [noteIndex setText:text forNoteGuid:note.guid textSignature:signatures[note.guid]];
+                EDAMNoteMetadata * metadata = [[EDAMNoteMetadata alloc] init];
+                metadata.guid = note.guid;
+                metadata.title = note.title;
+                metadata.notebookGuid = note.notebookGuid;
+                metadata.tagGuids = note.tagGuids;
+                metadata.created = note.created;
+                metadata.updated = note.updated;
+                [metadataList addObject:metadata];
+            }
+            noteMetadata = metadataList;
+            query = [ENNoteSearchQuery queryWithSearchString:@"fox tag:tag-1"];
+        }];
+        search.body = ^{
+            if (![query matchingNoteMetadata:noteMetadata index:noteIndex notebooks:chunk.notebooks tags:chunk.tags]) {
+                @throw [NSException exceptionWithName:NSInternalInconsistencyException reason:@"Expected a local answer" userInfo:nil];
+            }
+        };
+        [cases addObject:search];
+    }
+
+    return cases;
+}
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool {
+        NSArray * arguments = [[NSProcessInfo processInfo] arguments];
+        BOOL list = [arguments containsObject:@"--list"];
+        NSString * caseFilter = nil;
+        double seconds = 1.0;
+        for (NSUInteger i = 1; i + 1 < arguments.count; i++) {
+            if ([arguments[i] isEqualToString:@"--case"]) {
+                caseFilter = arguments[i + 1];
+            } else if ([arguments[i] isEqualToString:@"--seconds"]) {
+                seconds = [arguments[i + 1] doubleValue];
+            }
+        }
+
+        NSString * temporaryDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+        [[NSFileManager defaultManager] createDirectoryAtPath:temporaryDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+
+        int status = 0;
+        for (ENBenchmarkCase * benchmarkCase in ENBenchmarkCases(temporaryDirectory)) {
+            NSString * identifier = [benchmarkCase identifier];
+            if (caseFilter && ![identifier isEqualToString:caseFilter] && ![benchmarkCase.name isEqualToString:caseFilter]) {
+                continue;
+            }
+            if (list) {
+                printf("%s\n", [identifier UTF8String]);
+                continue;
+            }
+            @try {
+                printf("%s\n", [[benchmarkCase runForSeconds:seconds] UTF8String]);
+            }
+            @catch (NSException * exception) {
+                fprintf(stderr, "%s failed: %s\n", [identifier UTF8String], [[exception description] UTF8String]);
+                status = 1;
+            }
+            fflush(stdout);
+        }
+
+        [[NSFileManager defaultManager] removeItemAtPath:temporaryDirectory error:NULL];
+        return status;
+    }
+}
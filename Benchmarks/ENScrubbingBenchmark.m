@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Scrubs a corpus of tag names with the production scrubber and with a copy of the original per-character
+// regex implementation, checks that both agree, and reports the time each takes.
+
+#import <Foundation/Foundation.h>
+#import "EDAMLimits.h"
+#import "NSString+ENScrubbing.h"
+#import "NSRegularExpression+ENAGRegex.h"
+
+static const NSUInteger ENBenchmarkTagCount = 100000;
+
+static NSString * ENLegacyScrub(NSString * string, NSString * regexPattern, uint16_t minLength, uint16_t maxLength)
+{
+    if ([string length] < minLength) {
+        return nil;
+    }
+    else if ([string length] > maxLength) {
+        string = [string substringToIndex:maxLength];
+    }
+    
+    NSRegularExpression * regex = [NSRegularExpression regularExpressionWithPattern:regexPattern options:0 error:NULL];
+    NSArray * matches = [regex matchesInString:string options:0 range:NSMakeRange(0, string.length)];
+    if (matches.count == 0) {
+        NSMutableString * newString = [NSMutableString stringWithCapacity:[string length]];
+        for (NSUInteger i = 0; i < [string length]; i++) {
+            NSString * oneCharSubString = [string substringWithRange:NSMakeRange(i, 1)];
+            matches = [regex matchesInString:oneCharSubString options:0 range:NSMakeRange(0, 1)];
+            if (matches.count > 0) {
+                [newString appendString:oneCharSubString];
+            }
+        }
+        string = newString;
+    }
+    
+    if ([string length] < minLength) {
+        return nil;
+    }
+    return string;
+}
+
+static NSArray * ENBenchmarkTagNames(NSUInteger count)
+{
+    // A mix of clean names and names that fail the whole-string match (commas, control characters,
+    // leading/trailing whitespace, non-BMP characters, overlong names), so both paths are exercised.
+    NSArray * templates = @[@"work", @"Project %lu", @"  padded %lu  ", @"a,b,c %lu", @"tab\t%lu",
+                            @"line\nbreak %lu", @"café %lu", @"\U0001F4DD notes %lu", @"　ideographic %lu",
+                            [@"" stringByPaddingToLength:140 withString:@"long%lu " startingAtIndex:0]];
+    NSMutableArray * names = [NSMutableArray arrayWithCapacity:count];
+    srandom(42);
+    for (NSUInteger i = 0; i < count; i++) {
+        NSString * format = templates[(NSUInteger)random() % templates.count];
+        [names addObject:[format stringByReplacingOccurrencesOfString:@"%lu" withString:[@(i) stringValue]]];
+    }
+    return names;
+}
+
+static double ENBenchmarkSeconds(void (^block)(void))
+{
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    block();
+    return CFAbsoluteTimeGetCurrent() - start;
+}
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool {
+        NSString * pattern = [EDAMLimitsConstants EDAM_TAG_NAME_REGEX];
+        uint16_t minLength = (uint16_t)[EDAMLimitsConstants EDAM_TAG_NAME_LEN_MIN];
+        uint16_t maxLength = (uint16_t)[EDAMLimitsConstants EDAM_TAG_NAME_LEN_MAX];
+        NSArray * names = ENBenchmarkTagNames(ENBenchmarkTagCount);
+        NSMutableArray * legacyResults = [NSMutableArray arrayWithCapacity:names.count];
+        NSMutableArray * results = [NSMutableArray arrayWithCapacity:names.count];
+        
+        double precompileSeconds = ENBenchmarkSeconds(^{
+            [NSRegularExpression enPrecompileEDAMLimitsPatterns];
+        });
+        double legacySeconds = ENBenchmarkSeconds(^{
+            for (NSString * name in names) {
+                @autoreleasepool {
+                    [legacyResults addObject:ENLegacyScrub(name, pattern, minLength, maxLength) ?: [NSNull null]];
+                }
+            }
+        });
+        double scrubSeconds = ENBenchmarkSeconds(^{
+            for (NSString * name in names) {
+                @autoreleasepool {
+                    [results addObject:[name en_scrubUsingRegex:pattern withMinLength:minLength maxLength:maxLength] ?: [NSNull null]];
+                }
+            }
+        });
+        
+        NSUInteger mismatches = 0;
+        for (NSUInteger i = 0; i < names.count; i++) {
+            if (![results[i] isEqual:legacyResults[i]]) {
+                if (mismatches++ < 10) {
+                    fprintf(stderr, "mismatch for %s: %s vs %s\n", [names[i] UTF8String],
+                            [[results[i] description] UTF8String], [[legacyResults[i] description] UTF8String]);
+                }
+            }
+        }
+        
+        printf("{\"benchmark\": \"scrub_tag_names\", \"count\": %lu, \"precompile_s\": %.6f, \"legacy_s\": %.6f, "
+               "\"scrub_s\": %.6f, \"speedup\": %.1f, \"mismatches\": %lu}\n",
+               (unsigned long)names.count, precompileSeconds, legacySeconds, scrubSeconds,
+               legacySeconds / scrubSeconds, (unsigned long)mismatches);
+        return (mismatches == 0) ? 0 : 1;
+    }
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Records the Thrift traffic of a scripted session (sync, notebook listing, search, note downloads) and
+// replays it without a network, to measure response decoding and ENSession orchestration on their own.
+//
+//   ENSessionReplayBenchmark --record <log> [--token <t> --note-store-url <url>]
+//   ENSessionReplayBenchmark --replay <log> [--iterations <n>] [--time-scale <x>]
+//
+// Without a token the session is recorded against a local ENEDAMStubServer. --time-scale 1 replays with
+// the recorded round trip times; the default of 0 replays as fast as possible. Replay prints one JSON line
+// per step and one for the whole scenario. The token and note store URL are saved next to the log as
+// <log>.session.plist, and both files contain the token: don't share recordings of real accounts.
+
+#import <Foundation/Foundation.h>
+#import "EDAM.h"
+#import "ENSDKPrivate.h"
+#import "ENTHTTPClient.h"
+#import "ENTTransportLog.h"
+#import "ENEDAMStubServer.h"
+
+@interface ENSession (Benchmark)
+- (ENNoteStoreClient *)primaryNoteStore;
+@end
+
+typedef void (^ENReplayStep)(void (^done)(NSError * error));
+
+static void ENReplayWait(BOOL (^finished)(void))
+{
+    while (!finished()) {
+        [[NSRunLoop mainRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+}
+
+static NSError * ENReplayRunStep(ENReplayStep step)
+{
+    __block BOOL finished = NO;
+    __block NSError * stepError = nil;
+    step(^(NSError * error) {
+        stepError = error;
+        finished = YES;
+    });
+    ENReplayWait(^BOOL{
+        return finished;
+    });
+    return stepError;
+}
+
+// The scenario, as named steps run one after another.
+static NSArray * ENReplayScenario(void)
+{
+    ENSession * session = [ENSession sharedSession];
+    NSMutableArray * steps = [NSMutableArray array];
+
+    [steps addObject:@[@"sync", ^(void (^done)(NSError *)) {
+        __block void (^fetch)(int32_t);
+        __block __weak void (^weakFetch)(int32_t);
+        fetch = ^(int32_t afterUSN) {
+            [session.primaryNoteStore fetchSyncChunkAfterUSN:afterUSN maxEntries:100 fullSyncOnly:NO completion:^(EDAMSyncChunk * chunk, NSError * error) {
+                if (error || !chunk.chunkHighUSN || chunk.chunkHighUSN.intValue >= chunk.updateCount.intValue) {
+                    done(error);
+                    return;
+                }
+                weakFetch(chunk.chunkHighUSN.intValue);
+            }];
+        };
+        weakFetch = fetch;
+        fetch(0);
+    }]];
+
+    [steps addObject:@[@"list_notebooks", ^(void (^done)(NSError *)) {
+        [session listNotebooks_cleanCache];
+        [session listNotebooksWithCompletion:^(NSArray * notebooks, NSError * error) {
+            done(error);
+        }];
+    }]];
+
+    __block NSArray * noteRefs = nil;
+    [steps addObject:@[@"find_notes", ^(void (^done)(NSError *)) {
+        [session findNotesWithSearch:nil inNotebook:nil orScope:ENSessionSearchScopeAll sortOrder:ENSessionSortOrderRecentlyUpdated maxResults:100 completion:^(NSArray * results, NSError * error) {
+            noteRefs = [results valueForKey:@"noteRef"];
+            done(error);
+        }];
+    }]];
+
+    [steps addObject:@[@"download_notes", ^(void (^done)(NSError *)) {
+        NSArray * toDownload = [noteRefs subarrayWithRange:NSMakeRange(0, MIN(noteRefs.count, (NSUInteger)10))];
+        __block NSUInteger remaining = toDownload.count;
+        __block NSError * firstError = nil;
+        if (remaining == 0) {
+            done(nil);
+            return;
+        }
+        for (ENNoteRef * noteRef in toDownload) {
+            [session downloadNote:noteRef progress:nil completion:^(ENNote * note, NSError * error) {
+                firstError = firstError ?: error;
+                if (--remaining == 0) {
+                    done(firstError);
+                }
+            }];
+        }
+    }]];
+
+    return steps;
+}
+
+static void ENReplayStartSession(NSString * token, NSString * noteStoreUrl)
+{
+    [ENSession setDisableRefreshingNotebooksCacheOnLaunch:YES];
+    [ENSession setSharedSessionDeveloperToken:token noteStoreUrl:noteStoreUrl];
+    ENSession * session = [ENSession sharedSession];
+    ENReplayWait(^BOOL{
+        return session.userDisplayName.length > 0;
+    });
+}
+
+static NSString * ENReplayJSON(NSDictionary * object)
+{
+    NSData * json = [NSJSONSerialization dataWithJSONObject:object options:NSJSONWritingSortedKeys error:NULL];
+    return [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+}
+
+static double ENReplayPercentile(NSArray<NSNumber *> * samples, double percentile)
+{
+    NSArray<NSNumber *> * sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+    if (sorted.count == 0) {
+        return 0;
+    }
+    return sorted[MIN(sorted.count - 1, (NSUInteger)(percentile / 100.0 * sorted.count))].doubleValue;
+}
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool {
+        NSArray * argumentList = [[NSProcessInfo processInfo] arguments];
+        NSMutableDictionary * options = [NSMutableDictionary dictionary];
+        for (NSUInteger i = 1; i + 1 < argumentList.count; i++) {
+            if ([argumentList[i] hasPrefix:@"--"]) {
+                options[[argumentList[i] substringFromIndex:2]] = argumentList[i + 1];
+            }
+        }
+        NSString * recordPath = options[@"record"];
+        NSString * replayPath = options[@"replay"];
+        if (!recordPath == !replayPath) {
+            fprintf(stderr, "usage: ENSessionReplayBenchmark --record <log> [--token <t> --note-store-url <url>]\n"
+                            "       ENSessionReplayBenchmark --replay <log> [--iterations <n>] [--time-scale <x>]\n");
+            return 2;
+        }
+
+        NSError * error = nil;
+        if (recordPath) {
+            NSString * token = options[@"token"];
+            NSString * noteStoreUrl = options[@"note-store-url"];
+            ENEDAMStubServer * server = nil;
+            if (!token) {
+                server = [[ENEDAMStubServer alloc] initWithDataset:[ENEDAMStubDataset datasetWithNotebookCount:10 noteCount:500]];
+                if (![server startOnPort:0 error:&error]) {
+                    fprintf(stderr, "Could not start the stub server: %s\n", [[error description] UTF8String]);
+                    return 1;
+                }
+                token = server.authenticationToken;
+                noteStoreUrl = server.noteStoreUrl;
+            }
+
+            ENTTransportLog * log = [[ENTTransportLog alloc] init];
+            [ENStoreClient setTransportFactory:^id<ENTTransport>(NSURL * url) {
+                return [[ENTRecordingTransport alloc] initWithTransport:[[ENTHTTPClient alloc] initWithURL:url] log:log url:url];
+            }];
+            ENReplayStartSession(token, noteStoreUrl);
+            for (NSArray * step in ENReplayScenario()) {
+                NSError * stepError = ENReplayRunStep(step[1]);
+                if (stepError) {
+                    fprintf(stderr, "%s failed: %s\n", [step[0] UTF8String], [[stepError description] UTF8String]);
+                }
+            }
+            NSDictionary * sessionInfo = @{@"token": token, @"noteStoreUrl": noteStoreUrl ?: @""};
+            if (![log writeToFile:recordPath error:&error] ||
+                ![sessionInfo writeToURL:[NSURL fileURLWithPath:[recordPath stringByAppendingString:@".session.plist"]] error:&error]) {
+                fprintf(stderr, "Could not write %s: %s\n", [recordPath UTF8String], [[error description] UTF8String]);
+                return 1;
+            }
+            printf("Recorded %lu exchanges to %s.\n", (unsigned long)log.exchangeCount, [recordPath UTF8String]);
+            [server stop];
+            return 0;
+        }
+
+        ENTTransportLog * log = [[ENTTransportLog alloc] initWithContentsOfFile:replayPath error:&error];
+        NSDictionary * sessionInfo = [NSDictionary dictionaryWithContentsOfFile:[replayPath stringByAppendingString:@".session.plist"]];
+        if (!log || !sessionInfo) {
+            fprintf(stderr, "Could not read %s: %s\n", [replayPath UTF8String], [[error description] UTF8String]);
+            return 1;
+        }
+        double timeScale = [options[@"time-scale"] doubleValue];
+        NSUInteger iterations = options[@"iterations"] ? (NSUInteger)[options[@"iterations"] integerValue] : 20;
+        [ENStoreClient setTransportFactory:^id<ENTTransport>(NSURL * url) {
+            ENTReplayTransport * transport = [[ENTReplayTransport alloc] initWithLog:log url:url];
+            transport.timeScale = timeScale;
+            return transport;
+        }];
+        // Authentication is replayed once, outside the measurements; the session keeps its state
+        // across iterations, as an app's would.
+        ENReplayStartSession(sessionInfo[@"token"], sessionInfo[@"noteStoreUrl"]);
+
+        NSArray * scenario = ENReplayScenario();
+        NSMutableDictionary * stepSamples = [NSMutableDictionary dictionary];
+        NSMutableArray * totalSamples = [NSMutableArray array];
+        NSUInteger errors = 0;
+        for (NSUInteger i = 0; i < iterations; i++) {
+            @autoreleasepool {
+                [log rewind];
+                CFAbsoluteTime scenarioStart = CFAbsoluteTimeGetCurrent();
+                for (NSArray * step in scenario) {
+                    CFAbsoluteTime stepStart = CFAbsoluteTimeGetCurrent();
+                    if (ENReplayRunStep(step[1])) {
+                        errors++;
+                    }
+                    NSMutableArray * samples = stepSamples[step[0]] ?: (stepSamples[step[0]] = [NSMutableArray array]);
+                    [samples addObject:@((CFAbsoluteTimeGetCurrent() - stepStart) * 1000.0)];
+                }
+                [totalSamples addObject:@((CFAbsoluteTimeGetCurrent() - scenarioStart) * 1000.0)];
+            }
+        }
+
+        NSString * commit = [[NSProcessInfo processInfo] environment][@"EN_BENCHMARK_COMMIT"] ?: @"unknown";
+        NSMutableArray * names = [NSMutableArray array];
+        for (NSArray * step in scenario) {
+            [names addObject:step[0]];
+        }
+        [names addObject:@"scenario"];
+        stepSamples[@"scenario"] = totalSamples;
+        for (NSString * name in names) {
+            NSArray * samples = stepSamples[name];
+            printf("%s\n", [ENReplayJSON(@{@"benchmark": [@"replay_" stringByAppendingString:name],
+                                           @"iterations": @(samples.count),
+                                           @"time_scale": @(timeScale),
+                                           @"mean_ms": @([[samples valueForKeyPath:@"@avg.doubleValue"] doubleValue]),
+                                           @"p50_ms": @(ENReplayPercentile(samples, 50)),
+                                           @"p90_ms": @(ENReplayPercentile(samples, 90)),
+                                           @"errors": @(errors),
+                                           @"request_mismatches": @(log.mismatchCount),
+                                           @"commit": commit}) UTF8String]);
+        }
+    }
+    return 0;
+}
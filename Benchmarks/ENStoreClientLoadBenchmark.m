@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// End-to-end throughput and latency of the store clients and ENSession against ENEDAMStubServer, a local
+// stand-in for the service. Each case keeps a fixed number of calls in flight for a fixed time and prints
+// one JSON line with throughput, latency percentiles, error count and the server's view of the traffic.
+//
+//   ENStoreClientLoadBenchmark [--list] [--case <name>] [--seconds <n>] [--concurrency <n>]
+//                              [--notebooks <n>] [--notes <n>] [--linked-notebooks <n>] [--business-notebooks <n>]
+//                              [--content-length <bytes>] [--resources-per-note <n>] [--resource-length <bytes>]
+//                              [--latency-ms <ms>] [--jitter-ms <ms>] [--bandwidth <bytes/s>]
+//                              [--system-error-rate <0-1>] [--transport-error-rate <0-1>]
+//                              [--rate-limit-rate <0-1>] [--max-calls-per-second <n>]
+//   ENStoreClientLoadBenchmark --serve [--port <n>] [dataset and fault options]
+//
+// --serve only runs the server, and prints the URLs and token to point an app at it.
+
+#import <Foundation/Foundation.h>
+#import "EDAM.h"
+#import "ENSDKPrivate.h"
+#import "ENEDAMStubServer.h"
+
+typedef void (^ENLoadCompletion)(NSError * error);
+
+@interface ENLoadCase : NSObject
+@property (nonatomic, copy) NSString * name;
+@property (nonatomic, copy) void (^setUp)(ENLoadCase * loadCase);
+// Starts one operation, calling the completion on the main queue when it finishes.
+@property (nonatomic, copy) void (^issue)(ENLoadCompletion completion);
+@end
+
+@implementation ENLoadCase
++ (instancetype)caseWithName:(NSString *)name setUp:(void (^)(ENLoadCase *))setUp
+{
+    ENLoadCase * loadCase = [[ENLoadCase alloc] init];
+    loadCase.name = name;
+    loadCase.setUp = setUp;
+    return loadCase;
+}
+@end
+
+static void ENLoadWait(BOOL (^finished)(void))
+{
+    while (!finished()) {
+        [[NSRunLoop mainRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+}
+
+static double ENLoadPercentile(NSArray<NSNumber *> * sorted, double percentile)
+{
+    if (sorted.count == 0) {
+        return 0;
+    }
+    NSUInteger index = MIN(sorted.count - 1, (NSUInteger)(percentile / 100.0 * sorted.count));
+    return sorted[index].doubleValue;
+}
+
+static NSString * ENLoadRun(ENLoadCase * loadCase, ENEDAMStubServer * server, NSUInteger concurrency, double seconds)
+{
+    loadCase.setUp(loadCase);
+    [server resetStatistics];
+
+    NSMutableArray<NSNumber *> * latencies = [NSMutableArray array];
+    __block NSUInteger inFlight = 0;
+    __block NSUInteger errors = 0;
+    __block void (^issueNext)(void);
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    CFAbsoluteTime end = start + seconds;
+    __block __weak void (^weakIssueNext)(void);
+    issueNext = ^{
+        inFlight++;
+        CFAbsoluteTime issued = CFAbsoluteTimeGetCurrent();
+        loadCase.issue(^(NSError * error) {
+            CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+            inFlight--;
+            [latencies addObject:@((now - issued) * 1000.0)];
+            if (error) {
+                errors++;
+            }
+            if (now < end) {
+                weakIssueNext();
+            }
+        });
+    };
+    weakIssueNext = issueNext;
+    for (NSUInteger i = 0; i < concurrency; i++) {
+        issueNext();
+    }
+    ENLoadWait(^BOOL{
+        return inFlight == 0;
+    });
+    double elapsed = CFAbsoluteTimeGetCurrent() - start;
+
+    NSArray * sorted = [latencies sortedArrayUsingSelector:@selector(compare:)];
+    uint64_t calls = 0;
+    for (NSNumber * count in server.callCounts.allValues) {
+        calls += count.unsignedLongLongValue;
+    }
+    NSDictionary * result = @{@"benchmark": loadCase.name,
+                              @"concurrency": @(concurrency),
+                              @"operations": @(latencies.count),
+                              @"errors": @(errors),
+                              @"seconds": @(elapsed),
+                              @"ops_per_s": @(latencies.count / elapsed),
+                              @"latency_ms_p50": @(ENLoadPercentile(sorted, 50)),
+                              @"latency_ms_p90": @(ENLoadPercentile(sorted, 90)),
+                              @"latency_ms_p99": @(ENLoadPercentile(sorted, 99)),
+                              @"latency_ms_max": @([[sorted lastObject] doubleValue]),
+                              @"server_calls": @(calls),
+                              @"server_calls_per_op": @(latencies.count ? (double)calls / latencies.count : 0),
+                              @"request_bytes": @(server.bytesReceived),
+                              @"response_bytes": @(server.bytesSent),
+                              @"commit": [[NSProcessInfo processInfo] environment][@"EN_BENCHMARK_COMMIT"] ?: @"unknown"};
+    NSData * json = [NSJSONSerialization dataWithJSONObject:result options:NSJSONWritingSortedKeys error:NULL];
+    return [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+}
+
+#pragma mark - Cases
+
+static NSArray<ENLoadCase *> * ENLoadCases(ENEDAMStubServer * server, NSUInteger concurrency)
+{
+    NSMutableArray * cases = [NSMutableArray array];
+    ENNoteStoreClient * noteStore = [ENNoteStoreClient noteStoreClientWithUrl:server.noteStoreUrl authenticationToken:server.authenticationToken];
+    __block NSArray<NSString *> * noteGuids = nil;
+
+    void (^fetchNoteGuids)(void) = ^{
+        if (noteGuids) {
+            return;
+        }
+        EDAMNotesMetadataResultSpec * resultSpec = [[EDAMNotesMetadataResultSpec alloc] init];
+        __block BOOL finished = NO;
+        [noteStore findNotesMetadataWithFilter:[[EDAMNoteFilter alloc] init] offset:0 maxNotes:250 resultSpec:resultSpec completion:^(EDAMNotesMetadataList * metadata, NSError * error) {
+            noteGuids = [metadata.notes valueForKey:@"guid"] ?: @[];
+            finished = YES;
+        }];
+        ENLoadWait(^BOOL{
+            return finished;
+        });
+    };
+
+    // Raw store client calls, all on one client that allows as many calls at once as the run keeps in flight.
+    noteStore.maximumConcurrentCalls = concurrency;
+    ENNoteStoreClient * (^client)(void) = ^ENNoteStoreClient * {
+        return noteStore;
+    };
+
+    [cases addObject:[ENLoadCase caseWithName:@"store_get_sync_chunk" setUp:^(ENLoadCase * loadCase) {
+        __block int32_t afterUSN = 0;
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            [client() fetchSyncChunkAfterUSN:afterUSN maxEntries:100 fullSyncOnly:NO completion:^(EDAMSyncChunk * chunk, NSError * error) {
+                afterUSN = (chunk.chunkHighUSN && chunk.chunkHighUSN.intValue < chunk.updateCount.intValue) ? chunk.chunkHighUSN.intValue : 0;
+                completion(error);
+            }];
+        };
+    }]];
+
+    [cases addObject:[ENLoadCase caseWithName:@"store_find_notes_metadata" setUp:^(ENLoadCase * loadCase) {
+        EDAMNotesMetadataResultSpec * resultSpec = [[EDAMNotesMetadataResultSpec alloc] init];
+        resultSpec.includeTitle = resultSpec.includeUpdated = resultSpec.includeNotebookGuid = @YES;
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            EDAMNoteFilter * filter = [[EDAMNoteFilter alloc] init];
+            filter.order = @(NoteSortOrder_UPDATED);
+            [client() findNotesMetadataWithFilter:filter offset:0 maxNotes:50 resultSpec:resultSpec completion:^(EDAMNotesMetadataList * metadata, NSError * error) {
+                completion(error);
+            }];
+        };
+    }]];
+
+    [cases addObject:[ENLoadCase caseWithName:@"store_get_note" setUp:^(ENLoadCase * loadCase) {
+        fetchNoteGuids();
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            NSString * guid = noteGuids.count ? noteGuids[arc4random_uniform((uint32_t)noteGuids.count)] : @"";
+            [client() fetchNoteWithGuid:guid includingContent:YES resourceOptions:ENResourceFetchOptionIncludeData completion:^(EDAMNote * note, NSError * error) {
+                completion(error);
+            }];
+        };
+    }]];
+
+    // The same work through ENSession, which adds its own round trips (linked and business notebooks, auth).
+    void (^setUpSession)(void) = ^{
+        ENSession * session = [ENSession sharedSession];
+        ENLoadWait(^BOOL{
+            return session.userDisplayName.length > 0;
+        });
+    };
+
+    [cases addObject:[ENLoadCase caseWithName:@"session_list_notebooks" setUp:^(ENLoadCase * loadCase) {
+        setUpSession();
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            ENSession * session = [ENSession sharedSession];
+            [session listNotebooks_cleanCache];
+            [session listNotebooksWithCompletion:^(NSArray * notebooks, NSError * error) {
+                completion(error);
+            }];
+        };
+    }]];
+
+    [cases addObject:[ENLoadCase caseWithName:@"session_find_notes" setUp:^(ENLoadCase * loadCase) {
+        setUpSession();
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            [[ENSession sharedSession] findNotesWithSearch:[ENNoteSearch noteSearchWithSearchString:@"river"]
+                                                inNotebook:nil
+                                                   orScope:ENSessionSearchScopeAll
+                                                 sortOrder:ENSessionSortOrderRecentlyUpdated
+                                                maxResults:50
+                                                completion:^(NSArray * results, NSError * error) {
+                                                    completion(error);
+                                                }];
+        };
+    }]];
+
+    [cases addObject:[ENLoadCase caseWithName:@"session_download_note" setUp:^(ENLoadCase * loadCase) {
+        setUpSession();
+        __block NSArray<ENNoteRef *> * noteRefs = nil;
+        [[ENSession sharedSession] findNotesWithSearch:nil inNotebook:nil orScope:ENSessionSearchScopePersonal sortOrder:ENSessionSortOrderRecentlyUpdated maxResults:250 completion:^(NSArray * results, NSError * error) {
+            noteRefs = [results valueForKey:@"noteRef"] ?: @[];
+        }];
+        ENLoadWait(^BOOL{
+            return noteRefs != nil;
+        });
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            if (noteRefs.count == 0) {
+                completion([NSError errorWithDomain:ENErrorDomain code:ENErrorCodeNotFound userInfo:nil]);
+                return;
+            }
+            [[ENSession sharedSession] downloadNote:noteRefs[arc4random_uniform((uint32_t)noteRefs.count)] progress:nil completion:^(ENNote * note, NSError * error) {
+                completion(error);
+            }];
+        };
+    }]];
+
+    [cases addObject:[ENLoadCase caseWithName:@"session_upload_note" setUp:^(ENLoadCase * loadCase) {
+        setUpSession();
+        NSString * text = [@"" stringByPaddingToLength:server.dataset.noteContentLength withString:@"Benchmark upload text. " startingAtIndex:0];
+        loadCase.issue = ^(ENLoadCompletion completion) {
+            ENNote * note = [[ENNote alloc] init];
+            note.title = @"Uploaded by the load benchmark";
+            note.content = [ENNoteContent noteContentWithString:text];
+            [[ENSession sharedSession] uploadNote:note notebook:nil completion:^(ENNoteRef * noteRef, NSError * error) {
+                completion(error);
+            }];
+        };
+    }]];
+
+    return cases;
+}
+
+#pragma mark - Main
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool {
+        NSArray * argumentList = [[NSProcessInfo processInfo] arguments];
+        NSMutableDictionary * options = [NSMutableDictionary dictionary];
+        for (NSUInteger i = 1; i + 1 < argumentList.count; i++) {
+            if ([argumentList[i] hasPrefix:@"--"] && ![argumentList[i + 1] hasPrefix:@"--"]) {
+                options[[argumentList[i] substringFromIndex:2]] = argumentList[i + 1];
+            }
+        }
+        double (^option)(NSString *, double) = ^double(NSString * name, double defaultValue) {
+            return options[name] ? [options[name] doubleValue] : defaultValue;
+        };
+
+        ENEDAMStubDataset * dataset = [ENEDAMStubDataset datasetWithNotebookCount:(NSUInteger)option(@"notebooks", 10)
+                                                                        noteCount:(NSUInteger)option(@"notes", 1000)];
+        dataset.linkedNotebookCount = (NSUInteger)option(@"linked-notebooks", 2);
+        dataset.businessNotebookCount = (NSUInteger)option(@"business-notebooks", 2);
+        dataset.noteContentLength = (NSUInteger)option(@"content-length", 2048);
+        dataset.resourcesPerNote = (NSUInteger)option(@"resources-per-note", 0);
+        dataset.resourceLength = (NSUInteger)option(@"resource-length", 64 * 1024);
+
+        ENEDAMStubFaults * faults = [[ENEDAMStubFaults alloc] init];
+        faults.latency = option(@"latency-ms", 0) / 1000.0;
+        faults.latencyJitter = option(@"jitter-ms", 0) / 1000.0;
+        faults.bandwidthBytesPerSecond = (NSUInteger)option(@"bandwidth", 0);
+        faults.systemErrorRate = option(@"system-error-rate", 0);
+        faults.transportErrorRate = option(@"transport-error-rate", 0);
+        faults.rateLimitRate = option(@"rate-limit-rate", 0);
+        faults.maximumCallsPerSecond = (NSUInteger)option(@"max-calls-per-second", 0);
+
+        ENEDAMStubServer * server = [[ENEDAMStubServer alloc] initWithDataset:dataset];
+        server.faults = faults;
+        NSError * error = nil;
+        if (![server startOnPort:(uint16_t)option(@"port", 0) error:&error]) {
+            fprintf(stderr, "Could not start the stub server: %s\n", [[error description] UTF8String]);
+            return 1;
+        }
+
+        if ([argumentList containsObject:@"--serve"]) {
+            printf("user store:  %s\nnote store:  %s\ntoken:       %s\n",
+                   [server.userStoreUrl UTF8String], [server.noteStoreUrl UTF8String], [server.authenticationToken UTF8String]);
+            fflush(stdout);
+            [[NSRunLoop mainRunLoop] run];
+            return 0;
+        }
+
+        [ENSession setDisableRefreshingNotebooksCacheOnLaunch:YES];
+        [ENSession setSharedSessionDeveloperToken:server.authenticationToken noteStoreUrl:server.noteStoreUrl];
+
+        NSString * caseFilter = options[@"case"];
+        BOOL list = [argumentList containsObject:@"--list"];
+        NSUInteger concurrency = (NSUInteger)MAX(option(@"concurrency", 4), 1);
+        double seconds = option(@"seconds", 5.0);
+        for (ENLoadCase * loadCase in ENLoadCases(server, concurrency)) {
+            if (caseFilter && ![loadCase.name isEqualToString:caseFilter]) {
+                continue;
+            }
+            if (list) {
+                printf("%s\n", [loadCase.name UTF8String]);
+                continue;
+            }
+            @autoreleasepool {
+                printf("%s\n", [ENLoadRun(loadCase, server, concurrency, seconds) UTF8String]);
+                fflush(stdout);
+            }
+        }
+        [server stop];
+    }
+    return 0;
+}
@@ -32,6 +32,10 @@
 @protocol ENBusinessNoteStoreClientDelegate <NSObject>
 - (NSString *)noteStoreUrlForBusinessStoreClient:(ENBusinessNoteStoreClient *)client;
 - (NSString *)authenticationTokenForBusinessStoreClient:(ENBusinessNoteStoreClient *)client;
+@optional
+// Returns YES if the business token is at hand. Otherwise starts getting it without blocking, returns
+// NO, and calls the completion once it has it or has failed to.
+- (BOOL)prepareAuthenticationForBusinessStoreClient:(ENBusinessNoteStoreClient *)client orNotifyWithCompletion:(void (^)(NSError * error))completion;
 @end
 
 @interface ENBusinessNoteStoreClient : ENNoteStoreClient
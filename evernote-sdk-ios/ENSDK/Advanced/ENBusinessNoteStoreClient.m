@@ -28,6 +28,7 @@
 
 #import "ENBusinessNoteStoreClient.h"
 #import "ENSDKPrivate.h"
+#import "ENStoreClientMetricsInternal.h"
 
 @implementation ENBusinessNoteStoreClient
 + (instancetype)noteStoreClientForBusiness
@@ -47,6 +48,27 @@
     return [self.delegate authenticationTokenForBusinessStoreClient:self];
 }
 
+// The token is looked up from inside each call's block, so it is got beforehand rather than there.
+- (BOOL)prepareCallOrNotifyWithCompletion:(void (^)(NSError *))completion
+{
+    id<ENBusinessNoteStoreClientDelegate> delegate = self.delegate;
+    if (![delegate respondsToSelector:@selector(prepareAuthenticationForBusinessStoreClient:orNotifyWithCompletion:)]) {
+        return YES;
+    }
+    return [delegate prepareAuthenticationForBusinessStoreClient:self orNotifyWithCompletion:completion];
+}
+
+- (ENStoreClientType)metricsStoreType
+{
+    return ENStoreClientTypeBusiness;
+}
+
+// The session has one business token at a time.
+- (NSString *)credentialKey
+{
+    return @"business";
+}
+
 - (void)createBusinessNotebook:(EDAMNotebook *)notebook
                     completion:(void(^)(EDAMLinkedNotebook *notebook, NSError *error))completion
 {
@@ -866,7 +866,9 @@ typedef void (^ENNoteStoreClientProgressHandler)(CGFloat progress);
                   completion:(void(^)(int32_t usn , NSError *_Nullable error))completion;
 
 /**
- *  Cancel the first operation on the note store queue
+ *  Cancel the operation that has been running longest on this note store. Its request is aborted
+ *  and its completion is called with an ENErrorCodeCancelled error. To cancel particular operations,
+ *  make them within -[ENCancellationToken performBlock:].
  */
 - (void) cancelFirstOperation;
 
@@ -30,13 +30,36 @@
 #import "ENSDKPrivate.h"
 #import "ENAuthCache.h"
 #import "EDAMNoteStoreClient+Utilities.h"
-#import "ENTHTTPClient.h"
 #import "ENTBinaryProtocol.h"
+#import "ENTAsyncInvocation.h"
 #import "ENSession.h"
 
 // This is the Evernote standard reasonable recommendation for a single findNotes call and won't break in future.
 #define FIND_NOTES_DEFAULT_MAX_NOTES 100
 
+// SyncChunk's updateCount field. It follows currentTime and chunkHighUSN, and all three precede the
+// chunk's objects on the wire.
+static const int ENNoteStoreClientSyncChunkUpdateCountField = 3;
+
+// Has the current call report its sync chunk's chunkHighUSN and updateCount as soon as they are decoded.
+static void ENNoteStoreClientObserveSyncChunkHead(ENNoteStoreClientSyncChunkHeadHandler headHandler)
+{
+    if (!headHandler) {
+        return;
+    }
+    ENTAsyncInvocation * invocation = [ENTAsyncInvocation currentInvocation];
+    __weak ENTAsyncInvocation * weakInvocation = invocation;
+    invocation.fieldReadHandler = ^(id object, int fieldIndex) {
+        if (fieldIndex != ENNoteStoreClientSyncChunkUpdateCountField || ![object isKindOfClass:[EDAMSyncChunk class]]) {
+            return;
+        }
+        // Nothing further in the response is of interest, so stop watching its fields.
+        weakInvocation.fieldReadHandler = nil;
+        EDAMSyncChunk * chunk = object;
+        headHandler(chunk.chunkHighUSN, [chunk.updateCount intValue]);
+    };
+}
+
 @interface ENNoteStoreClient ()
 @property (nonatomic, strong) EDAMNoteStoreClient * client;
 @property (nonatomic, copy) NSString * cachedNoteStoreUrl;
@@ -114,12 +137,13 @@
 
 - (EDAMNoteStoreClient *)client
 {
+    // Calls in flight each have their own client; this one serves the synchronous helpers.
+    EDAMNoteStoreClient * callClient = [self thriftClientForCurrentCall];
+    if (callClient) {
+        return callClient;
+    }
     if (!_client) {
-        NSString * noteStoreUrl = [self noteStoreUrl];
-        NSURL * url = [NSURL URLWithString:noteStoreUrl];
-        ENTHTTPClient * transport = [[ENTHTTPClient alloc] initWithURL:url];
-        ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
-        _client = [[EDAMNoteStoreClient alloc] initWithProtocol:protocol];
+        _client = [self newThriftClient];
         
         // Bind progress handlers if they are pending attachment.
         [self updateProgressHandlers];
@@ -127,20 +151,50 @@
     return _client;
 }
 
+- (id)newThriftClient
+{
+    NSString * noteStoreUrl = [self noteStoreUrl];
+    NSURL * url = [NSURL URLWithString:noteStoreUrl];
+    id<ENTTransport> transport = [ENStoreClient transportWithURL:url];
+    ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
+    return [[EDAMNoteStoreClient alloc] initWithProtocol:protocol];
+}
+
+// Clients made with a token are told apart by it and the store they call with it; subclasses that get
+// their token from the session say which of its tokens they use instead, since looking it up may mean
+// authenticating.
+- (NSString *)credentialKey
+{
+    NSString * token = self.cachedAuthenticationToken;
+    NSString * url = self.cachedNoteStoreUrl;
+    return (token && url) ? [NSString stringWithFormat:@"%@@%@", token, url] : nil;
+}
+
+// Every store client in the process calls under the session's account, and a note store URL names its
+// shard, so the URL is enough to tell which account and shard rate limits and load apply to.
+- (NSString *)storeKey
+{
+    return [self noteStoreUrl];
+}
+
 #pragma mark - Private Synchronous Helpers
 
+// For callers on threads of their own, such as thumbnail downloads. Linked store client calls warm the
+// auth cache asynchronously before their blocks run, so they reach this only if it expired in between.
 - (EDAMAuthenticationResult *)authenticateToSharedNotebookWithGlobalId:(NSString *)globalId
 {
-    return [self.client authenticateToSharedNotebook:globalId authenticationToken:self.authenticationToken];
+    return [ENTAsyncInvocation performSynchronously:^id {
+        return [self.client authenticateToSharedNotebook:globalId authenticationToken:self.authenticationToken];
+    }];
 }
 
 #pragma mark - NoteStore sync methods
 
 - (void)fetchSyncStateWithCompletion:(void(^)(EDAMSyncState *syncState, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getSyncState:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"getSyncState" arguments:@[] completion:completion];
 }
 
 - (void)fetchSyncChunkAfterUSN:(int32_t)afterUSN
@@ -148,7 +202,7 @@
                   fullSyncOnly:(BOOL)fullSyncOnly
                     completion:(void(^)(EDAMSyncChunk *_Nullable syncChunk, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getSyncChunk:self.authenticationToken afterUSN:afterUSN maxEntries:maxEntries fullSyncOnly:fullSyncOnly];
     } completion:completion];
 }
@@ -158,7 +212,17 @@
                                 filter:(EDAMSyncChunkFilter *)filter
                             completion:(void(^)(EDAMSyncChunk *_Nullable syncChunk, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self fetchFilteredSyncChunkAfterUSN:afterUSN maxEntries:maxEntries filter:filter headHandler:nil completion:completion];
+}
+
+- (void)fetchFilteredSyncChunkAfterUSN:(int32_t)afterUSN
+                            maxEntries:(int32_t)maxEntries
+                                filter:(EDAMSyncChunkFilter *)filter
+                           headHandler:(ENNoteStoreClientSyncChunkHeadHandler)headHandler
+                            completion:(void(^)(EDAMSyncChunk *_Nullable syncChunk, NSError *_Nullable error))completion
+{
+    [self invokeConcurrentAsyncObjectBlock:^id {
+        ENNoteStoreClientObserveSyncChunkHead(headHandler);
         return [self.client getFilteredSyncChunk:self.authenticationToken afterUSN:afterUSN maxEntries:maxEntries filter:filter];
     } completion:completion];
 }
@@ -166,7 +230,7 @@
 - (void)fetchSyncStateForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
                              completion:(void(^)(EDAMSyncState *_Nullable syncState, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getLinkedNotebookSyncState:self.authenticationToken linkedNotebook:linkedNotebook];
     } completion:completion];
 }
@@ -177,7 +241,18 @@
                            fullSyncOnly:(BOOL)fullSyncOnly
                              completion:(void(^)(EDAMSyncChunk *_Nullable syncChunk, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self fetchSyncChunkForLinkedNotebook:linkedNotebook afterUSN:afterUSN maxEntries:maxEntries fullSyncOnly:fullSyncOnly headHandler:nil completion:completion];
+}
+
+- (void)fetchSyncChunkForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+                               afterUSN:(int32_t)afterUSN
+                             maxEntries:(int32_t)maxEntries
+                           fullSyncOnly:(BOOL)fullSyncOnly
+                            headHandler:(ENNoteStoreClientSyncChunkHeadHandler)headHandler
+                             completion:(void(^)(EDAMSyncChunk *_Nullable syncChunk, NSError *_Nullable error))completion
+{
+    [self invokeConcurrentAsyncObjectBlock:^id {
+        ENNoteStoreClientObserveSyncChunkHead(headHandler);
         return [self.client getLinkedNotebookSyncChunk:self.authenticationToken linkedNotebook:linkedNotebook afterUSN:afterUSN maxEntries:maxEntries fullSyncOnly:fullSyncOnly];
     } completion:completion];
 }
@@ -186,26 +261,26 @@
 
 - (void)listNotebooksWithCompletion:(void(^)(NSArray<EDAMNotebook *> *_Nullable notebooks, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client listNotebooks:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"listNotebooks" arguments:@[] completion:completion];
 }
 
 - (void)fetchNotebookWithGuid:(EDAMGuid)guid
                    completion:(void(^)(EDAMNotebook *_Nullable notebook, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getNotebook:self.authenticationToken guid:guid];
-    } completion:completion];
+    } methodName:@"getNotebook" arguments:@[guid] completion:completion];
 }
 
 
 
 - (void)fetchDefaultNotebookWithCompletion:(void(^)(EDAMNotebook *_Nullable notebook, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getDefaultNotebook:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"getDefaultNotebook" arguments:@[] completion:completion];
 }
 
 - (void)createNotebook:(EDAMNotebook *)notebook
@@ -237,15 +312,15 @@
 
 - (void)listTagsWithCompletion:(void(^)(NSArray<EDAMTag *> *_Nullable tags, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client listTags:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"listTags" arguments:@[] completion:completion];
 }
 
 - (void)listTagsInNotebookWithGuid:(EDAMGuid)guid
                         completion:(void(^)(NSArray<EDAMTag *> * _Nullable tags, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client listTagsByNotebook:self.authenticationToken notebookGuid:guid];
     } completion:completion];
 };
@@ -253,9 +328,9 @@
 - (void)fetchTagWithGuid:(EDAMGuid)guid
               completion:(void(^)(EDAMTag *_Nullable tag, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getTag:self.authenticationToken guid:guid];
-    } completion:completion];
+    } methodName:@"getTag" arguments:@[guid] completion:completion];
 }
 
 - (void)createTag:(EDAMTag *)tag
@@ -294,7 +369,7 @@
 
 - (void)listSearchesWithCompletion:(void(^)(NSArray<EDAMSavedSearch *> *_Nullable searches, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client listSearches:self.authenticationToken];
     } completion:completion];
 }
@@ -303,7 +378,7 @@
                  completion:(void(^)(EDAMSavedSearch *_Nullable search, NSError *_Nullable error))completion
 
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getSearch:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -337,7 +412,7 @@
                   resultSpec:(EDAMRelatedResultSpec *)resultSpec
                   completion:(void(^)(EDAMRelatedResult *_Nullable result, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client findRelated:self.authenticationToken query:query resultSpec:resultSpec];
     } completion:completion];
 }
@@ -347,7 +422,7 @@
                    maxNotes:(int32_t)maxNotes
                  completion:(void(^)(EDAMNoteList *_Nullable list, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client findNotes:self.authenticationToken filter:filter offset:offset maxNotes:maxNotes];
     } completion:completion];
 }
@@ -367,7 +442,7 @@
                          resultSpec:(EDAMNotesMetadataResultSpec *)resultSpec
                          completion:(void(^)(EDAMNotesMetadataList *_Nullable metadata, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client findNotesMetadata:self.authenticationToken filter:filter offset:offset maxNotes:maxNotes resultSpec:resultSpec];
     } completion:completion];
 }
@@ -376,7 +451,7 @@
                   includingTrash:(BOOL)includingTrash
                       completion:(void(^)(EDAMNoteCollectionCounts *_Nullable counts, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client findNoteCounts:self.authenticationToken filter:filter withTrash:includingTrash];
     } completion:completion];
 }
@@ -386,20 +461,20 @@
           resourceOptions:(ENResourceFetchOption)resourceOptions
                completion:(void(^)(EDAMNote *_Nullable note, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getNote:self.authenticationToken
                                guid:guid
                         withContent:includingContent
                   withResourcesData:EN_FLAG_ISSET(resourceOptions, ENResourceFetchOptionIncludeData)
            withResourcesRecognition:EN_FLAG_ISSET(resourceOptions, ENResourceFetchOptionIncludeRecognitionData)
          withResourcesAlternateData:EN_FLAG_ISSET(resourceOptions, ENResourceFetchOptionIncludeAlternateData)];
-    } completion:completion];
+    } methodName:@"getNote" arguments:@[guid, @(includingContent), @(resourceOptions)] completion:completion];
 }
 
 - (void)fetchNoteApplicationDataWithGuid:(EDAMGuid)guid
                               completion:(void(^)(EDAMLazyMap *_Nullable map, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteApplicationData:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -408,7 +483,7 @@
                                           key:(NSString *)key
                                    completion:(void(^)(NSString *_Nullable entry, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteApplicationDataEntry:self.authenticationToken guid:guid key:key];
     } completion:completion];
 }
@@ -435,9 +510,9 @@
 - (void)fetchNoteContentWithGuid:(EDAMGuid)guid
                       completion:(void(^)(NSString *_Nullable content, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getNoteContent:self.authenticationToken guid:guid];
-    } completion:completion];
+    } methodName:@"getNoteContent" arguments:@[guid] completion:completion];
 }
 
 - (void)fetchSearchTextForNoteWithGuid:(EDAMGuid)guid
@@ -445,7 +520,7 @@
                    tokenizeForIndexing:(BOOL)tokenizeForIndexing
                             completion:(void(^)(NSString *_Nullable text, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteSearchText:self.authenticationToken guid:guid noteOnly:noteOnly tokenizeForIndexing:tokenizeForIndexing];
     } completion:completion];
 }
@@ -453,7 +528,7 @@
 - (void)fetchSearchTextForResourceWithGuid:(EDAMGuid)guid
                                 completion:(void(^)(NSString *_Nullable text, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceSearchText:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -461,7 +536,7 @@
 - (void)fetchTagNamesForNoteWithGuid:(EDAMGuid)guid
                           completion:(void(^)(NSArray<NSString *> *_Nullable names, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteTagNames:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -525,7 +600,7 @@
 - (void)listNoteVersionsWithGuid:(EDAMGuid)guid
                       completion:(void(^)(NSArray<EDAMNoteVersionId *> *_Nullable versions, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client listNoteVersions:self.authenticationToken noteGuid:guid];
     } completion:completion];
 }
@@ -535,7 +610,7 @@
                  resourceOptions:(ENResourceFetchOption)resourceOptions
                       completion:(void(^)(EDAMNote *_Nullable note, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteVersion:self.authenticationToken
                                   noteGuid:guid
                          updateSequenceNum:updateSequenceNum
@@ -551,20 +626,20 @@
                       options:(ENResourceFetchOption)options
                    completion:(void(^)(EDAMResource *_Nullable resource, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getResource:self.authenticationToken
                                    guid:guid
                                withData:EN_FLAG_ISSET(options, ENResourceFetchOptionIncludeData)
                         withRecognition:EN_FLAG_ISSET(options, ENResourceFetchOptionIncludeRecognitionData)
                          withAttributes:EN_FLAG_ISSET(options, ENResourceFetchOptionIncludeAttributes)
                       withAlternateData:EN_FLAG_ISSET(options, ENResourceFetchOptionIncludeAlternateData)];
-    } completion:completion];
+    } methodName:@"getResource" arguments:@[guid, @(options)] completion:completion];
 }
 
 - (void)fetchResourceApplicationDataWithGuid:(EDAMGuid)guid
                                   completion:(void(^)(EDAMLazyMap *_Nullable map, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceApplicationData:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -573,7 +648,7 @@
                                               key:(NSString *)key
                                        completion:(void(^)(NSString *_Nullable entry, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceApplicationDataEntry:self.authenticationToken guid:guid key:key];
     } completion:completion];
 }
@@ -608,9 +683,9 @@
 - (void)fetchResourceDataWithGuid:(EDAMGuid)guid
                        completion:(void(^)(NSData *_Nullable data, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getResourceData:self.authenticationToken guid:guid];
-    } completion:completion];
+    } methodName:@"getResourceData" arguments:@[guid] completion:completion];
 }
 
 - (void)fetchResourceByHashWithGuid:(EDAMGuid)guid
@@ -618,7 +693,7 @@
                             options:(ENResourceFetchOption)options
                          completion:(void(^)(EDAMResource *_Nullable resource, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceByHash:self.authenticationToken
                                      noteGuid:guid
                                   contentHash:contentHash
@@ -631,7 +706,7 @@
 - (void)fetchRecognitionDataForResourceWithGuid:(EDAMGuid)guid
                                      completion:(void(^)(NSData *_Nullable data, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceRecognition:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -639,7 +714,7 @@
 - (void)fetchAlternateDataForResourceWithGuid:(EDAMGuid)guid
                                    completion:(void(^)(NSData *_Nullable data, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceAlternateData:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -647,7 +722,7 @@
 - (void)fetchAttributesForResourceWithGuid:(EDAMGuid)guid
                                 completion:(void(^)(EDAMResourceAttributes *_Nullable attributes, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getResourceAttributes:self.authenticationToken guid:guid];
     } completion:completion];
 }
@@ -658,7 +733,7 @@
                             publicURI:(NSString *)publicURI
                            completion:(void(^)(EDAMNotebook *_Nullable notebook, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getPublicNotebook:userId publicUri:publicURI];
     } completion:completion];
 }
@@ -684,7 +759,7 @@
 
 - (void)listSharedNotebooksWithCompletion:(void(^)(NSArray<EDAMSharedNotebook *> *_Nullable sharedNotebooks, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client listSharedNotebooks:self.authenticationToken];
     } completion:completion];
 }
@@ -715,9 +790,9 @@
 
 - (void)listLinkedNotebooksWithCompletion:(void(^)(NSArray<EDAMLinkedNotebook *> *_Nullable linkedNotebooks, NSError *_Nullable error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client listLinkedNotebooks:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"listLinkedNotebooks" arguments:@[] completion:completion];
 }
 
 - (void)expungeLinkedNotebookWithGuid:(EDAMGuid)guid
@@ -738,9 +813,9 @@
 
 - (void)fetchSharedNotebookByAuthWithCompletion:(void(^)(EDAMSharedNotebook *_Nullable sharedNotebook, NSError *_Nullable error))completion;
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeCoalescedAsyncObjectBlock:^id {
         return [self.client getSharedNotebookByAuth:self.authenticationToken];
-    } completion:completion];
+    } methodName:@"getSharedNotebookByAuth" arguments:@[] completion:completion];
 }
 
 - (void)emailNoteWithParameters:(EDAMNoteEmailParameters *)parameters
@@ -794,7 +869,7 @@
 }
 
 - (void) cancelFirstOperation {
-    [[self client] cancel];
+    [self cancelFirstCall];
 }
 
 
@@ -34,6 +34,9 @@
 #import "ENMLWriter.h"
 #import "ENNoteStoreClient.h"
 #import "ENBusinessNoteStoreClient.h"
+#import "ENStoreClientMetrics.h"
+#import "ENSDKTracer.h"
+#import "ENSyncEngine.h"
 
 
 NS_ASSUME_NONNULL_BEGIN
@@ -147,6 +150,47 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (void) setKeychainGroup:(nullable NSString*)keychainGroup;
 
+/**
+ *  Set to YES to keep a local store of the account's metadata, kept up to date by -syncEngine. Listing
+ *  notebooks and searches are then answered from the store whenever the service reports no changes
+ *  since it was last synced. A search is answered there if it sticks to words and the notebook:, tag:,
+ *  intitle:, created:, updated: and sourceApplication: operators, and if none of its words could be in
+ *  the text of a note that is not indexed. Defaults to NO. Set it before the shared session is first used.
+ *
+ *  @param enable Whether the session should keep a local sync store.
+ */
++ (void)setEnableLocalSyncStore:(BOOL)enable;
+
+/**
+ *  Set to YES to also index the text of each note and of its recognized resources in the local store,
+ *  so that searches for words in notes can be answered there. The sync then makes a getNoteSearchText
+ *  call for every note whose content or resource recognition changed, which for the first sync is every
+ *  note. Has no effect unless the local sync store is enabled. Defaults to NO. Set it before the shared
+ *  session is first used.
+ *
+ *  @param enable Whether the local sync store should index note text.
+ */
++ (void)setEnableLocalSearchIndex:(BOOL)enable;
+
+/**
+ *  Set to a number of bytes to keep up to that much of downloaded notes, with their resources, on disk.
+ *  Downloading a note the cache holds at its current update sequence number is then answered from the
+ *  disk: at once for a note ref from -findNotesWithSearch:, otherwise after a call that fetches only
+ *  the note's metadata. A resource is kept once however many notes hold it, and downloading another
+ *  note that holds it fetches only that note's other resources. The notes used least recently are
+ *  evicted past the limit. Defaults to 0, which disables the cache. Set it before the shared session
+ *  is first used.
+ *
+ *  @param bytes The most disk space the cache may use.
+ */
++ (void)setNoteCacheSizeLimit:(NSUInteger)bytes;
+
+/**
+ *  The engine that syncs the local store, or nil unless enabled with +setEnableLocalSyncStore:.
+ *  The session starts a sync after authenticating, and whenever a search finds the store out of date.
+ */
+@property (nonatomic, readonly, nullable) ENSyncEngine * syncEngine;
+
 @end
 
 @interface ENSessionFindNotesResult (Advanced)
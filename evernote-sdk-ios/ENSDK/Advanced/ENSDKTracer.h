@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Records spans for ENSession operations while enabled: one span per top-level call
+ *  (listNotebooks, findNotes, uploadNote, downloadNote), a child span for each step of the call,
+ *  and a child span for each Thrift call the step makes. Auth cache lookups appear as instant
+ *  events. Spans can be exported as Chrome trace-event JSON, which loads in chrome://tracing
+ *  or Perfetto; each top-level call gets its own track.
+ */
+@interface ENSDKTracer : NSObject
++ (ENSDKTracer *)sharedTracer;
+
+/**
+ *  Defaults to NO. Operations that start while tracing is disabled are not recorded.
+ */
+@property (atomic, assign, getter=isEnabled) BOOL enabled;
+
+/**
+ *  The most events kept; the oldest are discarded beyond this. Defaults to 10000.
+ */
+@property (atomic, assign) NSUInteger maximumEventCount;
+
+/**
+ *  The recorded events as a Chrome trace-event JSON object.
+ */
+- (nullable NSData *)chromeTraceData;
+- (BOOL)writeChromeTraceToURL:(NSURL *)url error:(NSError **)error;
+
+- (void)removeAllEvents;
+@end
+
+NS_ASSUME_NONNULL_END
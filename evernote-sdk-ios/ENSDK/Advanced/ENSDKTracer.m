@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENSDKTracer.h"
+#import "ENSDKTracerInternal.h"
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+BOOL ENSDKTraceEnabled = NO;
+
+static char ENSDKTraceUnchanged;
+
+static uint64_t ENSDKTraceNextSpanID(void)
+{
+    static uint64_t lastSpanID = 0;
+    return __atomic_add_fetch(&lastSpanID, 1, __ATOMIC_RELAXED);
+}
+
+@interface ENSDKTracer ()
+@property (nonatomic, strong) NSMutableArray * events;
+@property (nonatomic, assign) uint64_t epoch;
+@property (nonatomic, assign) double microsecondsPerTick;
+- (uint64_t)timestampForTime:(uint64_t)time;
+- (void)addEvent:(NSDictionary *)event;
+@end
+
+#pragma mark - Spans
+
+@interface ENSDKSpan ()
+@property (nonatomic, copy) NSString * name;
+@property (nonatomic, copy) NSString * category;
+@property (nonatomic, assign) uint64_t spanID;
+@property (nonatomic, assign) uint64_t parentID;
+@property (nonatomic, assign) uint64_t trackID;
+@property (nonatomic, assign) uint64_t startTime;
+@property (nonatomic, assign) BOOL finished;
+@property (nonatomic, strong) NSMutableDictionary * arguments;
+@property (nonatomic, strong) ENSDKSpan * currentStep;
+@end
+
+@implementation ENSDKSpan
++ (ENSDKSpan *)spanWithName:(NSString *)name
+{
+    if (!ENSDKTraceEnabled) {
+        return nil;
+    }
+    ENSDKSpan * parent = ENSDKTraceCurrentSpan();
+    if (parent) {
+        return [parent childSpanWithName:name category:@"session"];
+    }
+    ENSDKSpan * span = [[ENSDKSpan alloc] initWithName:name category:@"session" parent:nil];
+    [span recordTrackName];
+    return span;
+}
+
+- (id)initWithName:(NSString *)name category:(NSString *)category parent:(ENSDKSpan *)parent
+{
+    self = [super init];
+    if (self) {
+        self.name = name;
+        self.category = category;
+        self.spanID = ENSDKTraceNextSpanID();
+        self.parentID = parent.spanID;
+        // Each top-level span gets its own track, and everything under it shares that track.
+        self.trackID = parent ? parent.trackID : self.spanID;
+        self.startTime = mach_absolute_time();
+    }
+    return self;
+}
+
+- (ENSDKSpan *)childSpanWithName:(NSString *)name category:(NSString *)category
+{
+    return [[ENSDKSpan alloc] initWithName:name category:category parent:self];
+}
+
+- (ENSDKSpan *)beginStepWithSelector:(SEL)selector
+{
+    ENSDKSpan * step = [self childSpanWithName:NSStringFromSelector(selector) category:@"step"];
+    ENSDKSpan * previousStep = nil;
+    @synchronized(self) {
+        previousStep = self.currentStep;
+        self.currentStep = step;
+    }
+    [previousStep finishWithError:nil];
+    return step;
+}
+
+- (void)setArgument:(id)value forKey:(NSString *)key
+{
+    @synchronized(self) {
+        if (!self.arguments) {
+            self.arguments = [[NSMutableDictionary alloc] init];
+        }
+        self.arguments[key] = [value description];
+    }
+}
+
+- (void)addInstantEventWithName:(NSString *)name category:(NSString *)category
+{
+    ENSDKTracer * tracer = [ENSDKTracer sharedTracer];
+    [tracer addEvent:@{@"name" : name,
+                       @"cat" : category,
+                       @"ph" : @"i",
+                       @"s" : @"t",
+                       @"ts" : @([tracer timestampForTime:mach_absolute_time()]),
+                       @"pid" : @([[NSProcessInfo processInfo] processIdentifier]),
+                       @"tid" : @(self.trackID),
+                       @"args" : @{@"parentId" : @(self.spanID)}}];
+}
+
+- (void)finishWithError:(NSError *)error
+{
+    uint64_t endTime = mach_absolute_time();
+    ENSDKSpan * step = nil;
+    NSMutableDictionary * args = nil;
+    @synchronized(self) {
+        if (self.finished) {
+            return;
+        }
+        self.finished = YES;
+        step = self.currentStep;
+        self.currentStep = nil;
+        args = self.arguments ? [self.arguments mutableCopy] : [[NSMutableDictionary alloc] init];
+    }
+    [step finishWithError:error];
+
+    args[@"spanId"] = @(self.spanID);
+    if (self.parentID) {
+        args[@"parentId"] = @(self.parentID);
+    }
+    if (error) {
+        args[@"error"] = [NSString stringWithFormat:@"%@ %ld", error.domain, (long)error.code];
+    }
+    ENSDKTracer * tracer = [ENSDKTracer sharedTracer];
+    uint64_t ts = [tracer timestampForTime:self.startTime];
+    [tracer addEvent:@{@"name" : self.name,
+                       @"cat" : self.category,
+                       @"ph" : @"X",
+                       @"ts" : @(ts),
+                       @"dur" : @([tracer timestampForTime:endTime] - ts),
+                       @"pid" : @([[NSProcessInfo processInfo] processIdentifier]),
+                       @"tid" : @(self.trackID),
+                       @"args" : args}];
+}
+
+- (void)recordTrackName
+{
+    [[ENSDKTracer sharedTracer] addEvent:@{@"name" : @"thread_name",
+                                           @"ph" : @"M",
+                                           @"pid" : @([[NSProcessInfo processInfo] processIdentifier]),
+                                           @"tid" : @(self.trackID),
+                                           @"args" : @{@"name" : [NSString stringWithFormat:@"%@ #%llu", self.name, self.spanID]}}];
+}
+@end
+
+#pragma mark - Current span
+
+static pthread_key_t ENSDKTraceCurrentSpanKey(void)
+{
+    static pthread_key_t key;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
+ENSDKSpan * ENSDKTraceCurrentSpan(void)
+{
+    if (!ENSDKTraceEnabled) {
+        return nil;
+    }
+    return (__bridge ENSDKSpan *)pthread_getspecific(ENSDKTraceCurrentSpanKey());
+}
+
+void * ENSDKTracePushCurrentSpan(ENSDKSpan * span)
+{
+    if (!span) {
+        return &ENSDKTraceUnchanged;
+    }
+    // The slot owns a reference to its span; the saved pointer takes over the previous one's.
+    pthread_key_t key = ENSDKTraceCurrentSpanKey();
+    void * previous = pthread_getspecific(key);
+    pthread_setspecific(key, (void *)CFBridgingRetain(span));
+    return previous;
+}
+
+void ENSDKTracePopCurrentSpan(void ** saved)
+{
+    if (*saved == &ENSDKTraceUnchanged) {
+        return;
+    }
+    pthread_key_t key = ENSDKTraceCurrentSpanKey();
+    void * current = pthread_getspecific(key);
+    pthread_setspecific(key, *saved);
+    if (current) {
+        CFRelease(current);
+    }
+}
+
+#pragma mark - Tracer
+
+@implementation ENSDKTracer
+{
+    BOOL _enabled;
+    NSUInteger _maximumEventCount;
+}
+
++ (ENSDKTracer *)sharedTracer
+{
+    static ENSDKTracer * sharedTracer = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedTracer = [[ENSDKTracer alloc] init];
+    });
+    return sharedTracer;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        self.microsecondsPerTick = (double)timebase.numer / (double)timebase.denom / 1e3;
+        self.epoch = mach_absolute_time();
+        self.events = [[NSMutableArray alloc] init];
+        _maximumEventCount = 10000;
+    }
+    return self;
+}
+
+- (BOOL)isEnabled
+{
+    @synchronized(self) {
+        return _enabled;
+    }
+}
+
+- (void)setEnabled:(BOOL)enabled
+{
+    @synchronized(self) {
+        _enabled = enabled;
+        ENSDKTraceEnabled = enabled;
+    }
+}
+
+- (NSUInteger)maximumEventCount
+{
+    @synchronized(self) {
+        return _maximumEventCount;
+    }
+}
+
+- (void)setMaximumEventCount:(NSUInteger)maximumEventCount
+{
+    @synchronized(self) {
+        _maximumEventCount = maximumEventCount;
+        [self trimEvents];
+    }
+}
+
+- (uint64_t)timestampForTime:(uint64_t)time
+{
+    return (time > self.epoch) ? (uint64_t)((time - self.epoch) * self.microsecondsPerTick) : 0;
+}
+
+- (void)addEvent:(NSDictionary *)event
+{
+    @synchronized(self) {
+        [self.events addObject:event];
+        [self trimEvents];
+    }
+}
+
+- (void)trimEvents
+{
+    // Trim an extra tenth at a time so a full buffer doesn't shift on every event.
+    if (self.events.count > _maximumEventCount) {
+        NSUInteger keep = _maximumEventCount - _maximumEventCount / 10;
+        [self.events removeObjectsInRange:NSMakeRange(0, self.events.count - keep)];
+    }
+}
+
+- (void)removeAllEvents
+{
+    @synchronized(self) {
+        [self.events removeAllObjects];
+    }
+}
+
+- (NSData *)chromeTraceData
+{
+    NSArray * events = nil;
+    @synchronized(self) {
+        events = [self.events copy];
+    }
+    return [NSJSONSerialization dataWithJSONObject:@{@"traceEvents" : events, @"displayTimeUnit" : @"ms"}
+                                           options:0
+                                             error:NULL];
+}
+
+- (BOOL)writeChromeTraceToURL:(NSURL *)url error:(NSError **)error
+{
+    NSData * data = [self chromeTraceData];
+    if (!data) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:nil];
+        }
+        return NO;
+    }
+    return [data writeToURL:url options:NSDataWritingAtomic error:error];
+}
+@end
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENRequestPriority.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  The kind of Evernote service a store client talks to.
+ */
+typedef NS_ENUM(NSInteger, ENStoreClientType) {
+    ENStoreClientTypePersonal = 0,
+    ENStoreClientTypeBusiness,
+    ENStoreClientTypeLinked,
+    ENStoreClientTypeUser,
+};
+
+/**
+ *  Timing and size of a single Thrift call made by a store client. The phases add up to the
+ *  total duration: waiting for the client's serial queue, writing the request, the HTTP round
+ *  trip, and reading the response.
+ */
+@interface ENStoreClientCallMetrics : NSObject
+@property (nonatomic, readonly) NSString * methodName;
+@property (nonatomic, readonly) ENStoreClientType storeType;
+@property (nonatomic, readonly) ENRequestPriority priority;
+@property (nonatomic, readonly) NSTimeInterval queueWait;
+@property (nonatomic, readonly) NSTimeInterval serializationDuration;
+@property (nonatomic, readonly) NSTimeInterval networkDuration;
+@property (nonatomic, readonly) NSTimeInterval deserializationDuration;
+@property (nonatomic, readonly) NSTimeInterval totalDuration;
+@property (nonatomic, readonly) uint64_t requestBytes;
+@property (nonatomic, readonly) uint64_t responseBytes;
+/**
+ *  nil if the call succeeded, otherwise the error it failed with.
+ */
+@property (nonatomic, readonly, nullable) NSError * error;
+@end
+
+/**
+ *  Observers are called synchronously on the store client's queue as each call completes, so
+ *  they must be thread safe and should return quickly.
+ */
+@protocol ENStoreClientMetricsObserver <NSObject>
+- (void)storeClientDidCompleteCall:(ENStoreClientCallMetrics *)metrics;
+@end
+
+/**
+ *  A latency histogram with power-of-two microsecond buckets.
+ */
+@interface ENStoreClientMetricsHistogram : NSObject
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSTimeInterval sum;
+@property (nonatomic, readonly) NSTimeInterval minimum;
+@property (nonatomic, readonly) NSTimeInterval maximum;
+@property (nonatomic, readonly) NSTimeInterval mean;
+/**
+ *  Upper bound of the bucket containing the given percentile (0-100), capped at the maximum.
+ */
+- (NSTimeInterval)valueAtPercentile:(double)percentile;
+@end
+
+/**
+ *  Aggregated metrics for one method on one type of store.
+ */
+@interface ENStoreClientMetricsSummary : NSObject
+@property (nonatomic, readonly) NSString * methodName;
+@property (nonatomic, readonly) ENStoreClientType storeType;
+@property (nonatomic, readonly) NSUInteger callCount;
+@property (nonatomic, readonly) NSUInteger errorCount;
+/**
+ *  Calls that made no request of their own, having joined an identical call already in flight. They
+ *  are not counted in callCount.
+ */
+@property (nonatomic, readonly) NSUInteger coalescedCallCount;
+@property (nonatomic, readonly) uint64_t requestBytes;
+@property (nonatomic, readonly) uint64_t responseBytes;
+@property (nonatomic, readonly) ENStoreClientMetricsHistogram * totalDuration;
+@property (nonatomic, readonly) ENStoreClientMetricsHistogram * queueWait;
+@property (nonatomic, readonly) ENStoreClientMetricsHistogram * serializationDuration;
+@property (nonatomic, readonly) ENStoreClientMetricsHistogram * networkDuration;
+@property (nonatomic, readonly) ENStoreClientMetricsHistogram * deserializationDuration;
+@end
+
+/**
+ *  Collects per-call metrics from every store client. Nothing is measured until an observer is
+ *  added or aggregation is enabled.
+ */
+@interface ENStoreClientMetrics : NSObject
++ (ENStoreClientMetrics *)sharedMetrics;
+
+/**
+ *  Observers are held weakly.
+ */
+- (void)addObserver:(id<ENStoreClientMetricsObserver>)observer;
+- (void)removeObserver:(id<ENStoreClientMetricsObserver>)observer;
+
+/**
+ *  When YES, every completed call is folded into the summaries. Defaults to NO.
+ */
+@property (atomic, assign) BOOL aggregationEnabled;
+
+/**
+ *  A snapshot of the aggregated metrics, one summary per method and store type.
+ */
+- (NSArray<ENStoreClientMetricsSummary *> *)summaries;
+
+/**
+ *  A snapshot of how long calls of the given priority waited in their store client's queue before
+ *  starting, across every method and store. Aggregated along with the summaries.
+ */
+- (ENStoreClientMetricsHistogram *)queueWaitForPriority:(ENRequestPriority)priority;
+
+- (void)resetSummaries;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,552 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENStoreClientMetrics.h"
+#import "ENStoreClientMetricsInternal.h"
+#import "ENError.h"
+#import <mach/mach_time.h>
+#import <pthread.h>
+
+// Bucket i counts durations in [2^(i-1), 2^i) microseconds; bucket 0 is anything under 1us.
+#define EN_HISTOGRAM_BUCKETS 40
+
+BOOL ENStoreClientMetricsActive = NO;
+
+static double ENStoreClientMetricsSecondsPerTick(void)
+{
+    static double secondsPerTick = 0;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        secondsPerTick = (double)timebase.numer / (double)timebase.denom / 1e9;
+    });
+    return secondsPerTick;
+}
+
+static NSTimeInterval ENStoreClientMetricsInterval(uint64_t start, uint64_t end)
+{
+    if (start == 0 || end <= start) {
+        return 0;
+    }
+    return (end - start) * ENStoreClientMetricsSecondsPerTick();
+}
+
+#pragma mark - Call metrics
+
+@interface ENStoreClientCallMetrics ()
+@property (nonatomic, copy) NSString * methodName;
+@property (nonatomic, assign) ENStoreClientType storeType;
+@property (nonatomic, assign) ENRequestPriority priority;
+@property (nonatomic, assign) NSTimeInterval queueWait;
+@property (nonatomic, assign) uint64_t requestBytes;
+@property (nonatomic, assign) uint64_t responseBytes;
+@property (nonatomic, strong) NSError * error;
+@property (nonatomic, assign) uint64_t startTime;
+@property (nonatomic, assign) uint64_t serializedTime;
+@property (nonatomic, assign) uint64_t receivedTime;
+@property (nonatomic, assign) uint64_t endTime;
+@property (nonatomic, strong) ENSDKSpan * span;
+// Only the first call an invocation makes waited in the queue.
+@property (nonatomic, assign) BOOL firstInInvocation;
+@end
+
+@implementation ENStoreClientCallMetrics
+- (NSTimeInterval)serializationDuration
+{
+    return ENStoreClientMetricsInterval(self.startTime, self.serializedTime);
+}
+
+- (NSTimeInterval)networkDuration
+{
+    return ENStoreClientMetricsInterval(self.serializedTime, self.receivedTime ?: self.endTime);
+}
+
+- (NSTimeInterval)deserializationDuration
+{
+    return ENStoreClientMetricsInterval(self.receivedTime, self.endTime);
+}
+
+- (NSTimeInterval)totalDuration
+{
+    return self.queueWait + ENStoreClientMetricsInterval(self.startTime, self.endTime);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p; method = %@; store = %ld; queue = %.1fms; serialize = %.1fms; network = %.1fms; deserialize = %.1fms; bytes = %llu/%llu; error = %@>",
+            [self class], self, self.methodName, (long)self.storeType,
+            self.queueWait * 1000.0, self.serializationDuration * 1000.0, self.networkDuration * 1000.0, self.deserializationDuration * 1000.0,
+            self.requestBytes, self.responseBytes, self.error];
+}
+@end
+
+#pragma mark - Histogram
+
+@interface ENStoreClientMetricsHistogram ()
+{
+    uint64_t _buckets[EN_HISTOGRAM_BUCKETS];
+}
+@property (nonatomic, assign) NSUInteger count;
+@property (nonatomic, assign) NSTimeInterval sum;
+@property (nonatomic, assign) NSTimeInterval minimum;
+@property (nonatomic, assign) NSTimeInterval maximum;
+@end
+
+@implementation ENStoreClientMetricsHistogram
+- (void)addValue:(NSTimeInterval)value
+{
+    uint64_t micros = (uint64_t)(value * 1e6);
+    NSUInteger bucket = 0;
+    while (micros > 0 && bucket < EN_HISTOGRAM_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    _buckets[bucket]++;
+    self.minimum = (self.count == 0) ? value : MIN(self.minimum, value);
+    self.maximum = MAX(self.maximum, value);
+    self.sum += value;
+    self.count++;
+}
+
+- (NSTimeInterval)mean
+{
+    return self.count ? self.sum / self.count : 0;
+}
+
+- (NSTimeInterval)valueAtPercentile:(double)percentile
+{
+    if (self.count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)ceil(self.count * MAX(0.0, MIN(percentile, 100.0)) / 100.0);
+    uint64_t seen = 0;
+    for (NSUInteger i = 0; i < EN_HISTOGRAM_BUCKETS; i++) {
+        seen += _buckets[i];
+        if (seen >= rank && seen > 0) {
+            NSTimeInterval upperBound = (double)(1ULL << i) / 1e6;
+            return MIN(upperBound, self.maximum);
+        }
+    }
+    return self.maximum;
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    ENStoreClientMetricsHistogram * copy = [[ENStoreClientMetricsHistogram alloc] init];
+    memcpy(copy->_buckets, _buckets, sizeof(_buckets));
+    copy.count = self.count;
+    copy.sum = self.sum;
+    copy.minimum = self.minimum;
+    copy.maximum = self.maximum;
+    return copy;
+}
+@end
+
+#pragma mark - Summary
+
+@interface ENStoreClientMetricsSummary ()
+@property (nonatomic, copy) NSString * methodName;
+@property (nonatomic, assign) ENStoreClientType storeType;
+@property (nonatomic, assign) NSUInteger callCount;
+@property (nonatomic, assign) NSUInteger errorCount;
+@property (nonatomic, assign) NSUInteger coalescedCallCount;
+@property (nonatomic, assign) uint64_t requestBytes;
+@property (nonatomic, assign) uint64_t responseBytes;
+@property (nonatomic, strong) ENStoreClientMetricsHistogram * totalDuration;
+@property (nonatomic, strong) ENStoreClientMetricsHistogram * queueWait;
+@property (nonatomic, strong) ENStoreClientMetricsHistogram * serializationDuration;
+@property (nonatomic, strong) ENStoreClientMetricsHistogram * networkDuration;
+@property (nonatomic, strong) ENStoreClientMetricsHistogram * deserializationDuration;
+@end
+
+@implementation ENStoreClientMetricsSummary
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.totalDuration = [[ENStoreClientMetricsHistogram alloc] init];
+        self.queueWait = [[ENStoreClientMetricsHistogram alloc] init];
+        self.serializationDuration = [[ENStoreClientMetricsHistogram alloc] init];
+        self.networkDuration = [[ENStoreClientMetricsHistogram alloc] init];
+        self.deserializationDuration = [[ENStoreClientMetricsHistogram alloc] init];
+    }
+    return self;
+}
+
+- (void)addCall:(ENStoreClientCallMetrics *)call
+{
+    self.callCount++;
+    if (call.error) {
+        self.errorCount++;
+    }
+    self.requestBytes += call.requestBytes;
+    self.responseBytes += call.responseBytes;
+    [self.totalDuration addValue:call.totalDuration];
+    [self.queueWait addValue:call.queueWait];
+    [self.serializationDuration addValue:call.serializationDuration];
+    [self.networkDuration addValue:call.networkDuration];
+    [self.deserializationDuration addValue:call.deserializationDuration];
+}
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    ENStoreClientMetricsSummary * copy = [[ENStoreClientMetricsSummary alloc] init];
+    copy.methodName = self.methodName;
+    copy.storeType = self.storeType;
+    copy.callCount = self.callCount;
+    copy.errorCount = self.errorCount;
+    copy.coalescedCallCount = self.coalescedCallCount;
+    copy.requestBytes = self.requestBytes;
+    copy.responseBytes = self.responseBytes;
+    copy.totalDuration = [self.totalDuration copy];
+    copy.queueWait = [self.queueWait copy];
+    copy.serializationDuration = [self.serializationDuration copy];
+    copy.networkDuration = [self.networkDuration copy];
+    copy.deserializationDuration = [self.deserializationDuration copy];
+    return copy;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: %p; method = %@; store = %ld; calls = %lu; errors = %lu; coalesced = %lu; p50 = %.1fms; p99 = %.1fms>",
+            [self class], self, self.methodName, (long)self.storeType,
+            (unsigned long)self.callCount, (unsigned long)self.errorCount, (unsigned long)self.coalescedCallCount,
+            [self.totalDuration valueAtPercentile:50] * 1000.0, [self.totalDuration valueAtPercentile:99] * 1000.0];
+}
+@end
+
+#pragma mark - Registry
+
+@interface ENStoreClientMetrics ()
+@property (nonatomic, strong) NSHashTable * observers;
+@property (nonatomic, strong) NSMutableDictionary * summariesByKey;
+@property (nonatomic, strong) NSArray * queueWaitByPriority;
+@end
+
+@implementation ENStoreClientMetrics
+{
+    BOOL _aggregationEnabled;
+}
+
++ (ENStoreClientMetrics *)sharedMetrics
+{
+    static ENStoreClientMetrics * sharedMetrics = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedMetrics = [[ENStoreClientMetrics alloc] init];
+    });
+    return sharedMetrics;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.observers = [NSHashTable weakObjectsHashTable];
+        self.summariesByKey = [[NSMutableDictionary alloc] init];
+        [self resetQueueWaitByPriority];
+    }
+    return self;
+}
+
+- (void)addObserver:(id<ENStoreClientMetricsObserver>)observer
+{
+    @synchronized(self) {
+        [self.observers addObject:observer];
+        [self updateActive];
+    }
+}
+
+- (void)removeObserver:(id<ENStoreClientMetricsObserver>)observer
+{
+    @synchronized(self) {
+        [self.observers removeObject:observer];
+        [self updateActive];
+    }
+}
+
+- (BOOL)aggregationEnabled
+{
+    @synchronized(self) {
+        return _aggregationEnabled;
+    }
+}
+
+- (void)setAggregationEnabled:(BOOL)aggregationEnabled
+{
+    @synchronized(self) {
+        _aggregationEnabled = aggregationEnabled;
+        [self updateActive];
+    }
+}
+
+- (NSArray *)summaries
+{
+    @synchronized(self) {
+        NSMutableArray * summaries = [NSMutableArray arrayWithCapacity:self.summariesByKey.count];
+        for (ENStoreClientMetricsSummary * summary in [self.summariesByKey allValues]) {
+            [summaries addObject:[summary copy]];
+        }
+        return summaries;
+    }
+}
+
+- (ENStoreClientMetricsHistogram *)queueWaitForPriority:(ENRequestPriority)priority
+{
+    @synchronized(self) {
+        return [self.queueWaitByPriority[MIN(MAX(priority, 0), ENRequestPriorityCount - 1)] copy];
+    }
+}
+
+- (void)resetSummaries
+{
+    @synchronized(self) {
+        [self.summariesByKey removeAllObjects];
+        [self resetQueueWaitByPriority];
+    }
+}
+
+- (void)resetQueueWaitByPriority
+{
+    NSMutableArray * histograms = [NSMutableArray arrayWithCapacity:ENRequestPriorityCount];
+    for (NSInteger priority = 0; priority < ENRequestPriorityCount; priority++) {
+        [histograms addObject:[[ENStoreClientMetricsHistogram alloc] init]];
+    }
+    self.queueWaitByPriority = histograms;
+}
+
+- (void)updateActive
+{
+    // Weakly held observers may have gone away without being removed; -allObjects skips those. -recordCall:
+    // calls this again when it finds none left, so collection stops with the first call after they go.
+    ENStoreClientMetricsActive = _aggregationEnabled || [self.observers allObjects].count > 0;
+}
+
+// Called with the lock held.
+- (ENStoreClientMetricsSummary *)summaryForMethod:(NSString *)methodName storeType:(ENStoreClientType)storeType
+{
+    NSString * key = [NSString stringWithFormat:@"%ld:%@", (long)storeType, methodName];
+    ENStoreClientMetricsSummary * summary = self.summariesByKey[key];
+    if (!summary) {
+        summary = [[ENStoreClientMetricsSummary alloc] init];
+        summary.methodName = methodName;
+        summary.storeType = storeType;
+        self.summariesByKey[key] = summary;
+    }
+    return summary;
+}
+
+- (void)recordCoalescedCallForMethod:(NSString *)methodName storeType:(ENStoreClientType)storeType
+{
+    @synchronized(self) {
+        if (_aggregationEnabled) {
+            [self summaryForMethod:methodName storeType:storeType].coalescedCallCount++;
+        }
+    }
+}
+
+- (void)recordCall:(ENStoreClientCallMetrics *)call
+{
+    NSArray * observers = nil;
+    @synchronized(self) {
+        observers = [self.observers allObjects];
+        if (observers.count == 0) {
+            // The last observer went away without being removed; stop collecting unless aggregating.
+            [self updateActive];
+        }
+        if (_aggregationEnabled) {
+            [[self summaryForMethod:call.methodName storeType:call.storeType] addCall:call];
+            if (call.firstInInvocation) {
+                [self.queueWaitByPriority[call.priority] addValue:call.queueWait];
+            }
+        }
+    }
+    for (id<ENStoreClientMetricsObserver> observer in observers) {
+        [observer storeClientDidCompleteCall:call];
+    }
+}
+@end
+
+#pragma mark - Invocation tracking
+
+@interface ENStoreClientInvocationMetrics : NSObject
+@property (nonatomic, assign) ENStoreClientType storeType;
+@property (nonatomic, assign) ENRequestPriority priority;
+@property (nonatomic, assign) BOOL madeCall;
+@property (nonatomic, assign) NSTimeInterval pendingQueueWait;
+@property (nonatomic, strong) ENStoreClientCallMetrics * currentCall;
+@property (nonatomic, strong) ENSDKSpan * parentSpan;
+@property (nonatomic, assign) void * previousInvocation;
+@property (nonatomic, assign) void * previousSpan;
+@end
+
+@implementation ENStoreClientInvocationMetrics
+@end
+
+static pthread_key_t ENStoreClientMetricsInvocationKey(void)
+{
+    static pthread_key_t key;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
+static ENStoreClientInvocationMetrics * ENStoreClientMetricsCurrentInvocation(void)
+{
+    if (!ENStoreClientMetricsActive && !ENSDKTraceEnabled) {
+        return nil;
+    }
+    return (__bridge ENStoreClientInvocationMetrics *)pthread_getspecific(ENStoreClientMetricsInvocationKey());
+}
+
+static void ENStoreClientMetricsFinishCall(ENStoreClientInvocationMetrics * invocation, NSError * error)
+{
+    ENStoreClientCallMetrics * call = invocation.currentCall;
+    if (!call) {
+        return;
+    }
+    invocation.currentCall = nil;
+    call.endTime = mach_absolute_time();
+    call.error = error;
+    [call.span finishWithError:error];
+    if (ENStoreClientMetricsActive) {
+        [[ENStoreClientMetrics sharedMetrics] recordCall:call];
+    }
+}
+
+uint64_t ENStoreClientMetricsEnqueueTime(void)
+{
+    return (ENStoreClientMetricsActive || ENSDKTraceEnabled) ? mach_absolute_time() : 0;
+}
+
+ENStoreClientInvocationMetrics * ENStoreClientMetricsBeginInvocation(ENStoreClientType storeType, ENRequestPriority priority, uint64_t enqueueTime, ENSDKSpan * parentSpan)
+{
+    if (enqueueTime == 0) {
+        return nil;
+    }
+    ENStoreClientInvocationMetrics * invocation = [[ENStoreClientInvocationMetrics alloc] init];
+    invocation.storeType = storeType;
+    invocation.priority = priority;
+    invocation.pendingQueueWait = ENStoreClientMetricsInterval(enqueueTime, mach_absolute_time());
+    invocation.parentSpan = parentSpan;
+    return invocation;
+}
+
+void ENStoreClientMetricsAttachInvocation(ENStoreClientInvocationMetrics * invocation)
+{
+    if (!invocation) {
+        return;
+    }
+    // The caller holds the invocation strongly until it ends, so the thread slot need not retain it.
+    pthread_key_t key = ENStoreClientMetricsInvocationKey();
+    invocation.previousInvocation = pthread_getspecific(key);
+    pthread_setspecific(key, (__bridge void *)invocation);
+    invocation.previousSpan = ENSDKTracePushCurrentSpan(invocation.parentSpan);
+}
+
+void ENStoreClientMetricsDetachInvocation(ENStoreClientInvocationMetrics * invocation)
+{
+    if (!invocation) {
+        return;
+    }
+    void * previousSpan = invocation.previousSpan;
+    ENSDKTracePopCurrentSpan(&previousSpan);
+    pthread_setspecific(ENStoreClientMetricsInvocationKey(), invocation.previousInvocation);
+}
+
+void ENStoreClientMetricsEndInvocation(ENStoreClientInvocationMetrics * invocation, NSError * error)
+{
+    if (!invocation) {
+        return;
+    }
+    // A call still open here never got a response, so the invocation's error is its outcome.
+    ENStoreClientMetricsFinishCall(invocation, error);
+}
+
+void ENStoreClientMetricsCallBegin(NSString * methodName)
+{
+    ENStoreClientInvocationMetrics * invocation = ENStoreClientMetricsCurrentInvocation();
+    if (!invocation) {
+        return;
+    }
+    ENStoreClientMetricsFinishCall(invocation, nil);
+    ENStoreClientCallMetrics * call = [[ENStoreClientCallMetrics alloc] init];
+    call.methodName = methodName;
+    call.storeType = invocation.storeType;
+    call.priority = invocation.priority;
+    // Queue wait belongs to the first call the invocation makes.
+    call.queueWait = invocation.pendingQueueWait;
+    call.firstInInvocation = !invocation.madeCall;
+    invocation.pendingQueueWait = 0;
+    invocation.madeCall = YES;
+    call.startTime = mach_absolute_time();
+    call.span = [invocation.parentSpan childSpanWithName:methodName category:@"thrift"];
+    invocation.currentCall = call;
+}
+
+void ENStoreClientMetricsCallMark(ENStoreClientMetricsPhase phase)
+{
+    ENStoreClientCallMetrics * call = ENStoreClientMetricsCurrentInvocation().currentCall;
+    if (!call) {
+        return;
+    }
+    switch (phase) {
+        case ENStoreClientMetricsPhaseSerialized:
+            call.serializedTime = mach_absolute_time();
+            break;
+        case ENStoreClientMetricsPhaseReceived:
+            call.receivedTime = mach_absolute_time();
+            break;
+    }
+}
+
+void ENStoreClientMetricsCallAddBytes(uint64_t requestBytes, uint64_t responseBytes)
+{
+    ENStoreClientCallMetrics * call = ENStoreClientMetricsCurrentInvocation().currentCall;
+    call.requestBytes += requestBytes;
+    call.responseBytes += responseBytes;
+}
+
+void ENStoreClientMetricsCallEnd(NSException * exception)
+{
+    ENStoreClientInvocationMetrics * invocation = ENStoreClientMetricsCurrentInvocation();
+    if (!invocation) {
+        return;
+    }
+    ENStoreClientMetricsFinishCall(invocation, exception ? [ENError errorFromException:exception] : nil);
+}
+
+void ENStoreClientMetricsCoalescedCall(ENStoreClientType storeType, NSString * methodName)
+{
+    if (ENStoreClientMetricsActive) {
+        [[ENStoreClientMetrics sharedMetrics] recordCoalescedCallForMethod:methodName storeType:storeType];
+    }
+}
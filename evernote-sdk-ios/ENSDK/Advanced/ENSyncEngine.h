@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class EDAMNotebook, EDAMTag, EDAMSavedSearch, EDAMLinkedNotebook, EDAMNoteMetadata;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  Keeps a local copy of the account's notebooks, tags, saved searches, linked notebooks and note
+ *  metadata, brought up to date with the service's incremental sync calls. The user's own account, their
+ *  business and each linked notebook are synced separately and side by side, each from the highest USN
+ *  it has applied, and the store is saved after every chunk, so a sync that is interrupted resumes where
+ *  it stopped.
+ *
+ *  Get the engine from -[ENSession syncEngine] after enabling it with +[ENSession setEnableLocalSyncStore:].
+ *  ENSession then answers -listNotebooksWithCompletion: and the searches the store can evaluate from the
+ *  store whenever a getSyncState call shows nothing has changed since.
+ */
+@interface ENSyncEngine : NSObject
+
+/**
+ *  YES once the user's own account has been synced to the end at least once.
+ */
+@property (nonatomic, readonly) BOOL hasCompletedFullSync;
+
+/**
+ *  YES while a sync is running.
+ */
+@property (nonatomic, readonly) BOOL isSynchronizing;
+
+/**
+ *  Brings the store up to date with the user's account, their business and each linked notebook, a few
+ *  at a time. Linked notebooks shared with the user since the last sync start once the account itself
+ *  is done. A call made
+ *  while a sync is running waits for that sync rather than starting another. Calls are made at the
+ *  current request priority, and the sync is not cancelled by the caller's cancellation token, since
+ *  other callers may be waiting on it.
+ *
+ *  @param completion Called on the main queue when the sync ends, with the first error met. A scope that fails to sync
+ *                    does not stop the others.
+ */
+- (void)synchronizeWithCompletion:(nullable void (^)(NSError *_Nullable error))completion;
+
+/**
+ *  Asks the service for the account's updateCount and compares it with the store's. This is a single
+ *  small call, and tells whether -synchronizeWithCompletion: has anything to fetch for the user's own
+ *  account. Changes in linked notebooks are not covered.
+ */
+- (void)checkForChangesWithCompletion:(void (^)(BOOL hasChanges, NSError *_Nullable error))completion;
+
+/**
+ *  The synced objects in the user's own account, in no particular order.
+ */
+- (NSArray<EDAMNotebook *> *)notebooks;
+- (NSArray<EDAMTag *> *)tags;
+- (NSArray<EDAMSavedSearch *> *)savedSearches;
+- (NSArray<EDAMLinkedNotebook *> *)linkedNotebooks;
+
+/**
+ *  Metadata for the notes not in the trash, in the user's own account or, given a linked notebook, in
+ *  that notebook. The metadata includes the title, dates, USN, notebook, tags, attributes and largest
+ *  resource, but not the content.
+ */
+- (NSArray<EDAMNoteMetadata *> *)noteMetadataForLinkedNotebook:(nullable EDAMLinkedNotebook *)linkedNotebook;
+
+/**
+ *  The synced notebooks and note metadata in the user's business, or empty arrays if the user is not in
+ *  a business.
+ */
+- (NSArray<EDAMNotebook *> *)businessNotebooks;
+- (NSArray<EDAMNoteMetadata *> *)businessNoteMetadata;
+
+/**
+ *  Deletes the store and cancels any sync that is running. ENSession does this when it unauthenticates.
+ */
+- (void)removeAllData;
+@end
+
+NS_ASSUME_NONNULL_END
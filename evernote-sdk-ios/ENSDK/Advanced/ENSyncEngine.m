@@ -0,0 +1,853 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENSyncEngine.h"
+#import "ENSyncStore.h"
+#import "ENNoteIndex.h"
+#import "ENNoteSearchQuery.h"
+#import "ENSDKPrivate.h"
+#import "ENSDKTracerInternal.h"
+#import "ENCancellationTokenInternal.h"
+#import "ENRequestPriorityInternal.h"
+
+// Entries asked for per chunk. The service asks clients not to go above 256.
+static int32_t ENSyncEngineChunkSize = 100;
+
+// Scopes synced at once. Each has its own USN space and usually its own shard, so they don't wait on each
+// other; the cap keeps a user with many linked notebooks from opening a connection to every one at once.
+static NSUInteger ENSyncEngineMaxConcurrentScopes = 4;
+
+// Seconds between saves of a note index while its text is being fetched. Each save rewrites the whole
+// index, so they go by time rather than by note; the index is saved again when the scope's text is done.
+static NSTimeInterval ENSyncEngineNoteIndexSaveInterval = 60;
+
+// getNoteSearchText calls in flight per scope.
+static NSUInteger ENSyncEngineMaxConcurrentTextFetches = 4;
+
+#define ENSyncEngineStepScope(context) \
+    ENSDKTraceScope([context.span beginStepWithSelector:_cmd]); \
+    ENCancellationTokenScope(context.cancellationToken); \
+    ENRequestPriorityScope(context.requestPriority)
+
+// One sync, shared by the scopes it syncs. Guarded by itself.
+@interface ENSyncEnginePass : NSObject
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
+// Scopes waiting for a slot, and the keys of every scope the pass has taken on.
+@property (nonatomic, strong) NSMutableArray * pendingContexts;
+@property (nonatomic, strong) NSMutableSet * scopeKeys;
+@property (nonatomic, assign) NSUInteger activeCount;
+@property (nonatomic, strong) NSError * error;
+@property (nonatomic, assign) BOOL completed;
+@end
+
+@implementation ENSyncEnginePass
+@end
+
+// The sync of one scope within a pass.
+@interface ENSyncEngineContext : NSObject
+@property (nonatomic, strong) ENSyncEnginePass * pass;
+@property (nonatomic, copy) NSString * scopeKey;
+// Loaded when the scope starts.
+@property (nonatomic, strong) ENSyncStoreScope * scope;
+@property (nonatomic, strong) ENNoteStoreClient * noteStore;
+@property (nonatomic, strong) EDAMLinkedNotebook * linkedNotebook;
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
+@end
+
+@implementation ENSyncEngineContext
+@end
+
+// One scope's chunks. Each chunk is asked for as soon as the one before it says where it ends, so chunks
+// can be in flight and arrive while earlier ones are still being decoded or applied.
+@interface ENSyncEngineScopeRun : NSObject
+@property (nonatomic, strong) ENSyncStoreScope * scope;
+@property (nonatomic, strong) ENNoteStoreClient * noteStore;
+@property (nonatomic, strong) EDAMLinkedNotebook * linkedNotebook;
+// Guarded by the run.
+@property (nonatomic, assign) int32_t requestedAfterUSN;
+@property (nonatomic, assign) BOOL ended;
+// Chunks received but not yet applied, by the USN they follow. Only touched on the store queue.
+@property (nonatomic, strong) NSMutableDictionary * receivedChunks;
+@end
+
+@implementation ENSyncEngineScopeRun
+@end
+
+// One scope's note text fetches. Only touched on the store queue.
+@interface ENSyncEngineIndexRun : NSObject
+// The notes still to fetch, taken from the end.
+@property (nonatomic, strong) NSMutableArray * guids;
+@property (nonatomic, strong) NSDictionary * signatures;
+@property (nonatomic, assign) NSUInteger pendingFetches;
+@property (nonatomic, assign) BOOL ended;
+@property (nonatomic, strong) NSDate * lastSaveDate;
+@end
+
+@implementation ENSyncEngineIndexRun
+@end
+
+@interface ENSyncEngine ()
+@property (nonatomic, weak) ENSession * session;
+@property (nonatomic, strong) ENSyncStore * store;
+// Chunks are applied and saved here rather than on the main queue, where store client completions run.
+@property (nonatomic, strong) dispatch_queue_t storeQueue;
+// Non-nil while a sync runs, holding the completions of everyone waiting for it.
+@property (nonatomic, strong) NSMutableArray * pendingCompletions;
+@property (nonatomic, strong) ENCancellationToken * syncToken;
+@property (nonatomic, assign) BOOL indexesNoteText;
+@end
+
+@implementation ENSyncEngine
+
+- (id)initWithSession:(ENSession *)session directoryURL:(NSURL *)directoryURL
+{
+    self = [super init];
+    if (self) {
+        self.session = session;
+        self.store = [[ENSyncStore alloc] initWithDirectoryURL:directoryURL];
+        self.storeQueue = dispatch_queue_create("com.evernote.sdk.ENSyncEngine", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (ENSyncStoreScope *)personalScope
+{
+    return [self.store scopeForKey:[ENSyncStore personalScopeKey]];
+}
+
+- (ENSyncStoreScope *)businessScope
+{
+    return [self.store scopeForKey:[ENSyncStore businessScopeKey]];
+}
+
+- (ENSyncStoreScope *)scopeForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+{
+    return [self.store scopeForKey:[ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid]];
+}
+
+- (BOOL)hasCompletedFullSync
+{
+    return [self personalScope].hasCompletedFullSync;
+}
+
+- (BOOL)isSynchronizing
+{
+    @synchronized(self) {
+        return (self.pendingCompletions != nil);
+    }
+}
+
+- (NSArray *)notebooks
+{
+    return [[self personalScope] notebooks];
+}
+
+- (NSArray *)tags
+{
+    return [[self personalScope] tags];
+}
+
+- (NSArray *)savedSearches
+{
+    return [[self personalScope] savedSearches];
+}
+
+- (NSArray *)linkedNotebooks
+{
+    return [[self personalScope] linkedNotebooks];
+}
+
+- (NSArray *)noteMetadataForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+{
+    ENSyncStoreScope * scope = linkedNotebook ? [self scopeForLinkedNotebook:linkedNotebook] : [self personalScope];
+    return [scope noteMetadataInNotebooksWithGuids:nil];
+}
+
+- (NSArray *)businessNotebooks
+{
+    return [[self businessScope] notebooks];
+}
+
+- (NSArray *)businessNoteMetadata
+{
+    return [[self businessScope] noteMetadataInNotebooksWithGuids:nil];
+}
+
+- (void)removeAllData
+{
+    ENCancellationToken * syncToken = nil;
+    @synchronized(self) {
+        syncToken = self.syncToken;
+    }
+    [syncToken cancel];
+    [self.store removeAllScopes];
+}
+
+#pragma mark - Checking for changes
+
+- (void)checkForChangesWithCompletion:(void (^)(BOOL hasChanges, NSError * error))completion
+{
+    ENSyncStoreScope * scope = [self personalScope];
+    [self fetchWhetherScope:scope isCurrentForLinkedNotebook:nil completion:^(BOOL isCurrent, int32_t updateCount, NSError * error) {
+        completion(error ? NO : !isCurrent, error);
+    }];
+}
+
+// A scope is current when it has been synced to the end and the service's updateCount has not moved since.
+- (void)fetchWhetherScope:(ENSyncStoreScope *)scope
+isCurrentForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+               completion:(void (^)(BOOL isCurrent, int32_t updateCount, NSError * error))completion
+{
+    void (^handler)(EDAMSyncState *, NSError *) = ^(EDAMSyncState * syncState, NSError * error) {
+        if (error) {
+            completion(NO, 0, error);
+            return;
+        }
+        int32_t updateCount = [syncState.updateCount intValue];
+        completion(scope.hasCompletedFullSync && scope.lastUSN >= updateCount, updateCount, nil);
+    };
+    ENSession * session = self.session;
+    if (linkedNotebook) {
+        [[session noteStoreForLinkedNotebook:linkedNotebook] fetchSyncStateForLinkedNotebook:linkedNotebook completion:handler];
+    } else {
+        ENNoteStoreClient * noteStore = [session primaryNoteStore];
+        if (!noteStore) {
+            completion(NO, 0, [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeAuthExpired userInfo:nil]);
+            return;
+        }
+        [noteStore fetchSyncStateWithCompletion:handler];
+    }
+}
+
+- (void)fetchListedNotebooksWithCompletion:(void (^)(NSArray * notebooks, NSDictionary * updateCounts, NSError * error))completion
+{
+    ENSyncStoreScope * scope = [self personalScope];
+    [self fetchWhetherScope:scope isCurrentForLinkedNotebook:nil completion:^(BOOL isCurrent, int32_t updateCount, NSError * error) {
+        if (error || !isCurrent) {
+            // Only a current scope knows every linked notebook whose changes would change the list.
+            completion(nil, nil, error);
+            return;
+        }
+        [self fetchListingUpdateCountsWithPersonalUpdateCount:updateCount linkedNotebooks:[scope linkedNotebooks] completion:^(NSDictionary * updateCounts, NSError * countsError) {
+            if (countsError) {
+                completion(nil, nil, countsError);
+                return;
+            }
+            NSArray * listedNotebooks = scope.listedNotebooks;
+            if (listedNotebooks && [scope.listedNotebooksUpdateCounts isEqualToDictionary:updateCounts]) {
+                completion(listedNotebooks, updateCounts, nil);
+            } else {
+                completion(nil, updateCounts, nil);
+            }
+        }];
+    }];
+}
+
+// The account's notebook list takes in its business's notebooks and the notebooks shared with it, which
+// change without the account's own updateCount moving. Their sync states are fetched all at once.
+- (void)fetchListingUpdateCountsWithPersonalUpdateCount:(int32_t)personalUpdateCount
+                                        linkedNotebooks:(NSArray *)linkedNotebooks
+                                             completion:(void (^)(NSDictionary * updateCounts, NSError * error))completion
+{
+    NSMutableDictionary * updateCounts = [[NSMutableDictionary alloc] init];
+    updateCounts[[ENSyncStore personalScopeKey]] = @(personalUpdateCount);
+    __block NSError * firstError = nil;
+    dispatch_group_t group = dispatch_group_create();
+    void (^handlerForKey)(NSString *, EDAMSyncState *, NSError *) = ^(NSString * key, EDAMSyncState * syncState, NSError * error) {
+        @synchronized(updateCounts) {
+            if (error) {
+                firstError = firstError ?: error;
+            } else {
+                updateCounts[key] = syncState.updateCount ?: @0;
+            }
+        }
+        dispatch_group_leave(group);
+    };
+    
+    ENSession * session = self.session;
+    if ([session isBusinessUser]) {
+        ENNoteStoreClient * businessNoteStore = [session businessNoteStore];
+        if (!businessNoteStore) {
+            completion(nil, [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeAuthExpired userInfo:nil]);
+            return;
+        }
+        dispatch_group_enter(group);
+        [businessNoteStore fetchSyncStateWithCompletion:^(EDAMSyncState * syncState, NSError * error) {
+            handlerForKey([ENSyncStore businessScopeKey], syncState, error);
+        }];
+    }
+    for (EDAMLinkedNotebook * linkedNotebook in linkedNotebooks) {
+        NSString * key = [ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid];
+        dispatch_group_enter(group);
+        [[session noteStoreForLinkedNotebook:linkedNotebook] fetchSyncStateForLinkedNotebook:linkedNotebook completion:^(EDAMSyncState * syncState, NSError * error) {
+            handlerForKey(key, syncState, error);
+        }];
+    }
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        completion(firstError ? nil : updateCounts, firstError);
+    });
+}
+
+- (void)setListedNotebooks:(NSArray *)notebooks updateCounts:(NSDictionary *)updateCounts
+{
+    [self.store setListedNotebooks:notebooks updateCounts:updateCounts forScope:[self personalScope]];
+}
+
+- (void)fetchCurrentNoteMetadataInPersonalScope:(BOOL)includePersonal
+                                linkedNotebooks:(NSArray *)linkedNotebooks
+                                  matchingQuery:(ENNoteSearchQuery *)query
+                                     completion:(void (^)(NSArray * metadata))completion
+{
+    NSMutableArray * scopes = [[NSMutableArray alloc] init];
+    NSMutableArray * scopeLinkedNotebooks = [[NSMutableArray alloc] init];
+    if (includePersonal) {
+        [scopes addObject:[self personalScope]];
+        [scopeLinkedNotebooks addObject:[NSNull null]];
+    }
+    for (EDAMLinkedNotebook * linkedNotebook in linkedNotebooks) {
+        [scopes addObject:[self scopeForLinkedNotebook:linkedNotebook]];
+        [scopeLinkedNotebooks addObject:linkedNotebook];
+    }
+    
+    // Check every scope at once; each check is a single getSyncState call.
+    dispatch_group_t group = dispatch_group_create();
+    __block BOOL allCurrent = YES;
+    for (NSUInteger i = 0; i < scopes.count; i++) {
+        EDAMLinkedNotebook * linkedNotebook = (scopeLinkedNotebooks[i] == [NSNull null]) ? nil : scopeLinkedNotebooks[i];
+        dispatch_group_enter(group);
+        [self fetchWhetherScope:scopes[i] isCurrentForLinkedNotebook:linkedNotebook completion:^(BOOL isCurrent, int32_t updateCount, NSError * error) {
+            if (!isCurrent) {
+                @synchronized(scopes) {
+                    allCurrent = NO;
+                }
+            }
+            dispatch_group_leave(group);
+        }];
+    }
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        if (!allCurrent) {
+            // Catch up in the background, so that the next search can be answered here.
+            [self synchronizeInBackground];
+            completion(nil);
+            return;
+        }
+        // Off the main queue: the first search of a scope loads its index from disk.
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+            NSMutableArray * metadata = [[NSMutableArray alloc] init];
+            for (ENSyncStoreScope * scope in scopes) {
+                NSArray * matches = [query matchingNoteMetadata:[scope noteMetadataInNotebooksWithGuids:nil]
+                                                          index:[self.store noteIndexForScope:scope]
+                                                      notebooks:[scope notebooks]
+                                                           tags:[scope tags]];
+                if (!matches) {
+                    metadata = nil;
+                    break;
+                }
+                [metadata addObjectsFromArray:matches];
+            }
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(metadata);
+            });
+        });
+    });
+}
+
+#pragma mark - Synchronizing
+
+- (void)synchronizeInBackground
+{
+    if (self.isSynchronizing) {
+        return;
+    }
+    // In a later turn of the main queue, so that the sync does not join the caller's span.
+    dispatch_async(dispatch_get_main_queue(), ^{
+        ENRequestPriorityScope(ENRequestPriorityBulk);
+        [self synchronizeWithCompletion:nil];
+    });
+}
+
+- (void)synchronizeWithCompletion:(void (^)(NSError * error))completion
+{
+    if (![NSThread isMainThread]) {
+        // The session makes its store clients on demand, and only on the main queue.
+        ENRequestPriority requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            ENRequestPriorityScope(requestPriority);
+            [self synchronizeWithCompletion:completion];
+        });
+        return;
+    }
+    
+    ENSyncEnginePass * pass = nil;
+    @synchronized(self) {
+        BOOL running = (self.pendingCompletions != nil);
+        if (!running) {
+            self.pendingCompletions = [[NSMutableArray alloc] init];
+        }
+        if (completion) {
+            [self.pendingCompletions addObject:[completion copy]];
+        }
+        if (running) {
+            return;
+        }
+        // The sync has its own token: it is shared by everyone waiting, so no single caller may cancel it.
+        pass = [[ENSyncEnginePass alloc] init];
+        pass.cancellationToken = [ENCancellationToken token];
+        self.syncToken = pass.cancellationToken;
+    }
+    pass.span = [ENSDKSpan spanWithName:@"sync"];
+    pass.requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
+    pass.pendingContexts = [[NSMutableArray alloc] init];
+    pass.scopeKeys = [[NSMutableSet alloc] init];
+    
+    ENSession * session = self.session;
+    ENNoteStoreClient * noteStore = [session primaryNoteStore];
+    if (!noteStore) {
+        pass.completed = YES;
+        pass.error = [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeAuthExpired userInfo:nil];
+        [self sync_completePass:pass];
+        return;
+    }
+    // Every scope starts at once, up to the cap. The linked notebooks are the ones the account listed
+    // when it was last synced; any that the account's own scope turns up this time join when it ends.
+    [self sync_queueScopeWithKey:[ENSyncStore personalScopeKey] noteStore:noteStore linkedNotebook:nil pass:pass];
+    if ([session isBusinessUser]) {
+        [self sync_queueScopeWithKey:[ENSyncStore businessScopeKey] noteStore:[session businessNoteStore] linkedNotebook:nil pass:pass];
+    }
+    for (EDAMLinkedNotebook * linkedNotebook in [[self personalScope] linkedNotebooks]) {
+        [self sync_queueScopeWithKey:[ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid]
+                           noteStore:[session noteStoreForLinkedNotebook:linkedNotebook]
+                      linkedNotebook:linkedNotebook
+                                pass:pass];
+    }
+    // Off the main queue from here, since starting a scope can load it from disk.
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self sync_startScopesInPass:pass];
+    });
+}
+
+// Called on the main queue, where the store client was made; the scope's steps run elsewhere.
+- (void)sync_queueScopeWithKey:(NSString *)scopeKey
+                     noteStore:(ENNoteStoreClient *)noteStore
+                linkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+                          pass:(ENSyncEnginePass *)pass
+{
+    if (!noteStore) {
+        return;
+    }
+    @synchronized(pass) {
+        if ([pass.scopeKeys containsObject:scopeKey]) {
+            return;
+        }
+        [pass.scopeKeys addObject:scopeKey];
+        ENSyncEngineContext * context = [[ENSyncEngineContext alloc] init];
+        context.pass = pass;
+        context.scopeKey = scopeKey;
+        context.noteStore = noteStore;
+        context.linkedNotebook = linkedNotebook;
+        context.cancellationToken = pass.cancellationToken;
+        context.requestPriority = pass.requestPriority;
+        [pass.pendingContexts addObject:context];
+    }
+}
+
+// Fills the free slots from the queue, and completes the pass once nothing is left running or queued.
+- (void)sync_startScopesInPass:(ENSyncEnginePass *)pass
+{
+    NSMutableArray * contexts = [[NSMutableArray alloc] init];
+    BOOL complete = NO;
+    @synchronized(pass) {
+        if (pass.cancellationToken.isCancelled) {
+            // Scopes not yet started stay as they are; the next sync picks them up.
+            [pass.pendingContexts removeAllObjects];
+            if (!pass.error) {
+                pass.error = [ENError cancelledError];
+            }
+        }
+        while (pass.activeCount < ENSyncEngineMaxConcurrentScopes && pass.pendingContexts.count > 0) {
+            [contexts addObject:pass.pendingContexts[0]];
+            [pass.pendingContexts removeObjectAtIndex:0];
+            pass.activeCount++;
+        }
+        if (pass.activeCount == 0 && !pass.completed) {
+            pass.completed = YES;
+            complete = YES;
+        }
+    }
+    for (ENSyncEngineContext * context in contexts) {
+        // Each scope gets a span of its own, since the scopes' steps overlap.
+        context.scope = [self.store scopeForKey:context.scopeKey];
+        context.span = [pass.span childSpanWithName:context.scopeKey category:@"sync"];
+        [self sync_fetchSyncStateWithContext:context];
+    }
+    if (complete) {
+        [self sync_completePass:pass];
+    }
+}
+
+- (void)sync_fetchSyncStateWithContext:(ENSyncEngineContext *)context
+{
+    ENSyncEngineStepScope(context);
+    void (^handler)(EDAMSyncState *, NSError *) = ^(EDAMSyncState * syncState, NSError * error) {
+        if (error) {
+            [self sync_failScopeWithContext:context error:error];
+            return;
+        }
+        // Resetting and marking the scope write it out, so they wait their turn on the store queue.
+        dispatch_async(self.storeQueue, ^{
+            ENSyncEngineStepScope(context);
+            ENSyncStoreScope * scope = context.scope;
+            if (scope.lastUSN > 0 && [syncState.fullSyncBefore longLongValue] > scope.lastSyncTime) {
+                ENSDKLog(Info, Sync, @"Service requires a full sync of %@.", scope.key);
+                [self.store resetScope:scope];
+            }
+            int32_t updateCount = [syncState.updateCount intValue];
+            if (scope.lastUSN >= updateCount) {
+                [self.store markScope:scope synchronizedWithUpdateCount:updateCount];
+                [self sync_finishScopeWithContext:context];
+                return;
+            }
+            [self sync_beginChunksWithContext:context];
+        });
+    };
+    if (context.linkedNotebook) {
+        [context.noteStore fetchSyncStateForLinkedNotebook:context.linkedNotebook completion:handler];
+    } else {
+        [context.noteStore fetchSyncStateWithCompletion:handler];
+    }
+}
+
+- (void)sync_beginChunksWithContext:(ENSyncEngineContext *)context
+{
+    if (context.cancellationToken.isCancelled) {
+        [self sync_failScopeWithContext:context error:[ENError cancelledError]];
+        return;
+    }
+    if (self.indexesNoteText) {
+        // Loaded before the chunks, so that it sees which notes' text they change.
+        [self.store noteIndexForScope:context.scope];
+    }
+    ENSyncEngineScopeRun * run = [[ENSyncEngineScopeRun alloc] init];
+    run.scope = context.scope;
+    run.noteStore = context.noteStore;
+    run.linkedNotebook = context.linkedNotebook;
+    run.requestedAfterUSN = -1;
+    run.receivedChunks = [[NSMutableDictionary alloc] init];
+    [self sync_fetchChunkAfterUSN:context.scope.lastUSN run:run context:context];
+}
+
+// The chunk before asks for this one twice, once when its head is decoded and again when it completes in
+// case it had no head to report; only the first of the two goes out.
+- (void)sync_fetchChunkAfterUSN:(int32_t)afterUSN run:(ENSyncEngineScopeRun *)run context:(ENSyncEngineContext *)context
+{
+    ENSyncEngineStepScope(context);
+    @synchronized(run) {
+        if (run.ended || afterUSN <= run.requestedAfterUSN) {
+            return;
+        }
+        run.requestedAfterUSN = afterUSN;
+    }
+    
+    ENNoteStoreClientSyncChunkHeadHandler headHandler = ^(NSNumber * chunkHighUSN, int32_t updateCount) {
+        if (chunkHighUSN && [chunkHighUSN intValue] < updateCount) {
+            // Off the decoding thread, which is still inside this chunk's call.
+            dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+                [self sync_fetchChunkAfterUSN:[chunkHighUSN intValue] run:run context:context];
+            });
+        }
+    };
+    void (^handler)(EDAMSyncChunk *, NSError *) = ^(EDAMSyncChunk * chunk, NSError * error) {
+        if (chunk.chunkHighUSN && [chunk.chunkHighUSN intValue] < [chunk.updateCount intValue]) {
+            [self sync_fetchChunkAfterUSN:[chunk.chunkHighUSN intValue] run:run context:context];
+        }
+        dispatch_async(self.storeQueue, ^{
+            [self sync_receiveChunk:chunk afterUSN:afterUSN error:error run:run context:context];
+        });
+    };
+    
+    if (run.linkedNotebook) {
+        [run.noteStore fetchSyncChunkForLinkedNotebook:run.linkedNotebook
+                                              afterUSN:afterUSN
+                                            maxEntries:ENSyncEngineChunkSize
+                                          fullSyncOnly:NO
+                                           headHandler:headHandler
+                                            completion:handler];
+    } else {
+        EDAMSyncChunkFilter * filter = [[EDAMSyncChunkFilter alloc] init];
+        filter.includeNotes = @YES;
+        filter.includeNoteResources = @YES;
+        filter.includeNoteAttributes = @YES;
+        filter.includeNotebooks = @YES;
+        filter.includeTags = @YES;
+        filter.includeSearches = @YES;
+        filter.includeLinkedNotebooks = @YES;
+        // Nothing can have been expunged from a store that starts empty.
+        filter.includeExpunged = @(afterUSN > 0);
+        [run.noteStore fetchFilteredSyncChunkAfterUSN:afterUSN
+                                           maxEntries:ENSyncEngineChunkSize
+                                               filter:filter
+                                          headHandler:headHandler
+                                           completion:handler];
+    }
+}
+
+// Runs on the store queue. The next chunk is usually on its way while this one is applied and saved, and
+// a small chunk can arrive before a large one asked for earlier, so chunks wait here until they follow on
+// from what the scope holds.
+- (void)sync_receiveChunk:(EDAMSyncChunk *)chunk
+                 afterUSN:(int32_t)afterUSN
+                    error:(NSError *)error
+                      run:(ENSyncEngineScopeRun *)run
+                  context:(ENSyncEngineContext *)context
+{
+    ENSyncEngineStepScope(context);
+    @synchronized(run) {
+        if (run.ended) {
+            return;
+        }
+        if (error) {
+            run.ended = YES;
+        }
+    }
+    if (error) {
+        // Chunks already applied stay saved, so the next sync resumes after them.
+        [self sync_failScopeWithContext:context error:error];
+        return;
+    }
+    
+    run.receivedChunks[@(afterUSN)] = chunk;
+    EDAMSyncChunk * nextChunk = nil;
+    while ((nextChunk = run.receivedChunks[@(run.scope.lastUSN)])) {
+        [run.receivedChunks removeObjectForKey:@(run.scope.lastUSN)];
+        [self.store applySyncChunk:nextChunk toScope:run.scope];
+        int32_t updateCount = [nextChunk.updateCount intValue];
+        if (!nextChunk.chunkHighUSN || [nextChunk.chunkHighUSN intValue] >= updateCount) {
+            @synchronized(run) {
+                run.ended = YES;
+            }
+            [self.store markScope:run.scope synchronizedWithUpdateCount:updateCount];
+            [self sync_finishScopeWithContext:context];
+            return;
+        }
+    }
+}
+
+// Runs on the store queue.
+- (void)sync_finishScopeWithContext:(ENSyncEngineContext *)context
+{
+    if ([context.scope.key isEqualToString:[ENSyncStore personalScopeKey]]) {
+        // The account's linked notebooks are now current. Drop the scopes of any that are gone, and queue
+        // any that are new; the rest were queued when the pass began. The new ones' store clients are made
+        // on the main queue, and the scope ends only once they are queued, so the pass waits for them.
+        NSArray * linkedNotebooks = [context.scope linkedNotebooks];
+        NSMutableSet * keys = [[NSMutableSet alloc] init];
+        for (EDAMLinkedNotebook * linkedNotebook in linkedNotebooks) {
+            [keys addObject:[ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid]];
+        }
+        [self.store removeLinkedScopesExceptKeys:keys];
+        NSMutableArray * newLinkedNotebooks = [[NSMutableArray alloc] init];
+        @synchronized(context.pass) {
+            for (EDAMLinkedNotebook * linkedNotebook in linkedNotebooks) {
+                if (![context.pass.scopeKeys containsObject:[ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid]]) {
+                    [newLinkedNotebooks addObject:linkedNotebook];
+                }
+            }
+        }
+        if (newLinkedNotebooks.count > 0) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                for (EDAMLinkedNotebook * linkedNotebook in newLinkedNotebooks) {
+                    [self sync_queueScopeWithKey:[ENSyncStore scopeKeyForLinkedNotebookGuid:linkedNotebook.guid]
+                                       noteStore:[self.session noteStoreForLinkedNotebook:linkedNotebook]
+                                  linkedNotebook:linkedNotebook
+                                            pass:context.pass];
+                }
+                dispatch_async(self.storeQueue, ^{
+                    [self sync_continueFinishedScopeWithContext:context];
+                });
+            });
+            return;
+        }
+    }
+    [self sync_continueFinishedScopeWithContext:context];
+}
+
+- (void)sync_continueFinishedScopeWithContext:(ENSyncEngineContext *)context
+{
+    if (context.cancellationToken.isCancelled) {
+        [self sync_failScopeWithContext:context error:[ENError cancelledError]];
+        return;
+    }
+    if (self.indexesNoteText) {
+        [self sync_indexNoteTextWithContext:context];
+        return;
+    }
+    [self sync_endScopeWithContext:context error:nil];
+}
+
+- (void)sync_indexNoteTextWithContext:(ENSyncEngineContext *)context
+{
+    ENSyncEngineStepScope(context);
+    NSDictionary * signatures = [[self.store noteIndexForScope:context.scope] textSignaturesForNotesNeedingText];
+    NSMutableArray * noteMetadata = [[NSMutableArray alloc] init];
+    for (EDAMNoteMetadata * metadata in [context.scope noteMetadataInNotebooksWithGuids:nil]) {
+        if (signatures[metadata.guid]) {
+            [noteMetadata addObject:metadata];
+        }
+    }
+    // Taken from the end, so the most recently updated notes are searchable first.
+    [noteMetadata sortUsingComparator:^NSComparisonResult(EDAMNoteMetadata * metadata1, EDAMNoteMetadata * metadata2) {
+        return [metadata1.updated compare:metadata2.updated];
+    }];
+    ENSyncEngineIndexRun * run = [[ENSyncEngineIndexRun alloc] init];
+    run.guids = [[noteMetadata valueForKey:@"guid"] mutableCopy];
+    run.signatures = signatures;
+    run.lastSaveDate = [NSDate date];
+    [self sync_fetchNoteTextWithRun:run context:context];
+}
+
+// Runs on the store queue. Each note is a getNoteSearchText call, which covers the content and the
+// recognized text of its resources; a few are in flight at once.
+- (void)sync_fetchNoteTextWithRun:(ENSyncEngineIndexRun *)run context:(ENSyncEngineContext *)context
+{
+    ENSyncEngineStepScope(context);
+    if (run.ended) {
+        return;
+    }
+    if (context.cancellationToken.isCancelled) {
+        // The text fetched so far is kept, unless a logout removed the scope, which leaves nothing to save.
+        run.ended = YES;
+        [self.store saveNoteIndexForScope:context.scope];
+        [self sync_failScopeWithContext:context error:[ENError cancelledError]];
+        return;
+    }
+    if (run.guids.count == 0 && run.pendingFetches == 0) {
+        run.ended = YES;
+        [self.store saveNoteIndexForScope:context.scope];
+        [self sync_endScopeWithContext:context error:nil];
+        return;
+    }
+    while (run.guids.count > 0 && run.pendingFetches < ENSyncEngineMaxConcurrentTextFetches) {
+        NSString * guid = [run.guids lastObject];
+        [run.guids removeLastObject];
+        run.pendingFetches++;
+        [context.noteStore fetchSearchTextForNoteWithGuid:guid noteOnly:NO tokenizeForIndexing:NO completion:^(NSString * text, NSError * error) {
+            dispatch_async(self.storeQueue, ^{
+                run.pendingFetches--;
+                [self sync_receiveNoteText:text guid:guid error:error run:run context:context];
+            });
+        }];
+    }
+}
+
+// Runs on the store queue.
+- (void)sync_receiveNoteText:(NSString *)text
+                        guid:(NSString *)guid
+                       error:(NSError *)error
+                         run:(ENSyncEngineIndexRun *)run
+                     context:(ENSyncEngineContext *)context
+{
+    if (run.ended) {
+        return;
+    }
+    if (error && [error.domain isEqualToString:ENErrorDomain] && error.code == ENErrorCodeNotFound) {
+        // Gone since the chunk that listed it; the next chunk takes it out of the index.
+    } else if (error) {
+        // The notes left keep needing their text, and the next sync carries on with them. The scope
+        // itself is synced, so only a cancellation counts as its failure.
+        run.ended = YES;
+        [self.store saveNoteIndexForScope:context.scope];
+        if (context.cancellationToken.isCancelled) {
+            [self sync_failScopeWithContext:context error:error];
+        } else {
+            ENSDKLog(Error, Sync, @"Stopped indexing note text in %@: %@", context.scope.key, error);
+            [self sync_endScopeWithContext:context error:nil];
+        }
+        return;
+    } else {
+        [[self.store noteIndexForScope:context.scope] setText:text forNoteGuid:guid textSignature:run.signatures[guid]];
+    }
+    if (-[run.lastSaveDate timeIntervalSinceNow] >= ENSyncEngineNoteIndexSaveInterval) {
+        [self.store saveNoteIndexForScope:context.scope];
+        run.lastSaveDate = [NSDate date];
+    }
+    [self sync_fetchNoteTextWithRun:run context:context];
+}
+
+// A scope that fails, say a linked notebook that is no longer shared, is left as it was and does not stop
+// the others. The pass reports the first error.
+- (void)sync_failScopeWithContext:(ENSyncEngineContext *)context error:(NSError *)error
+{
+    if (!context.cancellationToken.isCancelled) {
+        ENSDKLog(Error, Sync, @"Failed to sync %@: %@", context.scope.key, error);
+    }
+    ENSyncEnginePass * pass = context.pass;
+    @synchronized(pass) {
+        if (!pass.error) {
+            pass.error = error;
+        }
+    }
+    [self sync_endScopeWithContext:context error:error];
+}
+
+- (void)sync_endScopeWithContext:(ENSyncEngineContext *)context error:(NSError *)error
+{
+    [context.span finishWithError:error];
+    ENSyncEnginePass * pass = context.pass;
+    @synchronized(pass) {
+        pass.activeCount--;
+    }
+    [self sync_startScopesInPass:pass];
+}
+
+- (void)sync_completePass:(ENSyncEnginePass *)pass
+{
+    NSError * error = nil;
+    @synchronized(pass) {
+        error = pass.error;
+    }
+    [pass.span finishWithError:error];
+    NSArray * completions = nil;
+    @synchronized(self) {
+        completions = self.pendingCompletions;
+        self.pendingCompletions = nil;
+        if (self.syncToken == pass.cancellationToken) {
+            self.syncToken = nil;
+        }
+    }
+    for (void (^completion)(NSError *) in completions) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(error);
+        });
+    }
+}
+
+@end
@@ -29,10 +29,12 @@
 #import "ENUserStoreClient.h"
 #import "ENSDKPrivate.h"
 #import "ENTBinaryProtocol.h"
-#import "ENTHTTPClient.h"
+#import "ENTAsyncInvocation.h"
+#import "ENStoreClientMetricsInternal.h"
 
 @interface ENUserStoreClient ()
 @property (nonatomic, strong) EDAMUserStoreClient * client;
+@property (nonatomic, copy) NSString * userStoreUrl;
 @property (nonatomic, strong) NSString * authenticationToken;
 @end
 
@@ -46,20 +48,52 @@
 {
     self = [super init];
     if (self) {
-        NSURL * url = [NSURL URLWithString:userStoreUrl];
-        ENTHTTPClient * transport = [[ENTHTTPClient alloc] initWithURL:url];
-        ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
-        self.client = [[EDAMUserStoreClient alloc] initWithProtocol:protocol];
+        self.userStoreUrl = userStoreUrl;
         self.authenticationToken = authenticationToken;
     }
     return self;
 }
 
+- (EDAMUserStoreClient *)client
+{
+    // Calls in flight each have their own client; this one serves the synchronous helpers.
+    EDAMUserStoreClient * callClient = [self thriftClientForCurrentCall];
+    if (callClient) {
+        return callClient;
+    }
+    if (!_client) {
+        _client = [self newThriftClient];
+    }
+    return _client;
+}
+
+- (id)newThriftClient
+{
+    NSURL * url = [NSURL URLWithString:self.userStoreUrl];
+    id<ENTTransport> transport = [ENStoreClient transportWithURL:url];
+    ENTBinaryProtocol * protocol = [[ENTBinaryProtocol alloc] initWithTransport:transport];
+    return [[EDAMUserStoreClient alloc] initWithProtocol:protocol];
+}
+
+- (NSString *)storeKey
+{
+    return self.userStoreUrl;
+}
+
+- (ENStoreClientType)metricsStoreType
+{
+    return ENStoreClientTypeUser;
+}
+
 #pragma mark - Private Synchronous Helpers
 
+// For callers on threads of their own, such as thumbnail downloads. Business store client calls warm the
+// auth cache asynchronously before their blocks run, so they reach this only if it expired in between.
 - (EDAMAuthenticationResult *)authenticateToBusiness
 {
-    return [self.client authenticateToBusiness:self.authenticationToken];
+    return [ENTAsyncInvocation performSynchronously:^id {
+        return [self.client authenticateToBusiness:self.authenticationToken];
+    }];
 }
 
 #pragma mark - UserStore methods
@@ -78,14 +112,14 @@
 - (void)fetchBootstrapInfoWithLocale:(NSString *)locale
                           completion:(void(^)(EDAMBootstrapInfo *info, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getBootstrapInfo:locale];
     } completion:completion];
 }
 
 - (void)fetchUserWithCompletion:(void(^)(EDAMUser *user, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getUser:self.authenticationToken];
     } completion:completion];
 }
@@ -93,21 +127,21 @@
 - (void)fetchPublicUserInfoWithUsername:(NSString *)username
                              completion:(void(^)(EDAMPublicUserInfo *info, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getPublicUserInfo:username];
     } completion:completion];
 }
 
 - (void)fetchPremiumInfoWithCompletion:(void(^)(EDAMPremiumInfo *info, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getPremiumInfo:self.authenticationToken];
     } completion:completion];
 }
 
 - (void)fetchNoteStoreURLWithCompletion:(void(^)(NSString *noteStoreUrl, NSError *error))completion
 {
-    [self invokeAsyncObjectBlock:^id {
+    [self invokeConcurrentAsyncObjectBlock:^id {
         return [self.client getNoteStoreUrl:self.authenticationToken];
     } completion:completion];
 }
@@ -32,105 +32,15 @@
 #import "ENMIMEUtils.h"
 #import "ENMLConstants.h"
 #import "ENMIMEUtils.h"
+#import "ENURLUtils.h"
 
 #import "NSData+EvernoteSDK.h"
-#import "NSRegularExpression+ENAGRegex.h"
-#import "NSString+EDAMNilAdditions.h"
 #import "ENSDKAdvanced.h"
 
 @implementation ENMLWriter
 
 + (BOOL) validateURLComponents: (NSURL *) url {
-  if (url == nil) {
-    return NO;
-  }
-  
-  NSString *scheme = [url scheme];
-  if ([scheme rangeOfString: @"script"].location != NSNotFound) {
-    // disallow *script* schemes!
-    return NO;
-  }
-  else if ([scheme isEqualToString: @"file"]) {
-    return YES;
-  }
-  else if ([scheme isEqualToString:@"x-apple-data-detectors"]) {
-    return NO;
-  }
-  else if ([scheme isEqualToString:@"tel"]) {
-    return YES;
-  }
-  
-  BOOL result = YES;
-  
-  // compare regex parsed components to what NSURL thinks it has since NSURL is stinky
-  // See RFC 3986 Appendix B
-  NSRegularExpression * r = [NSRegularExpression enRegexWithPattern: @"^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\\?([^#]*))?(#(.*))?"];
-  NSArray * components = [r enCapturedSubstringsOfString: [url absoluteString]];
-  if (!components || [components count] != 10) {
-    return NO;
-  }
-  
-  scheme = [components objectAtIndex: 2];
-  if (![scheme enIsEqualToStringOrNil: [url scheme]]) {
-    NSLog(@"Scheme '%@' does not match scheme '%@'", scheme, [url scheme]);
-    result = NO;
-  }
-  NSString * authority = [components objectAtIndex: 4];
-  NSMutableString * hrefAuthority = [NSMutableString string];
-  if ([url user] || [url password]) {
-    if ([url user]) {
-      [hrefAuthority appendString: [url user]];
-    }
-    if ([url password]) {
-      [hrefAuthority appendString: @":"];
-      [hrefAuthority appendString: [url password]];
-    }
-    [hrefAuthority appendString: @"@"];
-  }
-  if ([url host]) {
-    [hrefAuthority appendString: [url host]];
-  }
-  if ([url port]) {
-    [hrefAuthority appendString: @":"];
-    [hrefAuthority appendFormat: @"%@", [url port]];
-  }
-  
-  if (![authority enIsEqualToStringOrNil: hrefAuthority]) {
-    NSLog(@"Authority '%@' does not match authority '%@'", authority, hrefAuthority);
-    result = NO;
-  }
-  NSString * path = [components objectAtIndex: 5];
-  path = [path stringByReplacingPercentEscapesUsingEncoding: NSUTF8StringEncoding];
-  NSString * urlPath = [url path];
-  if (![path enIsEqualToStringOrNil: urlPath]) {
-    if ([scheme caseInsensitiveCompare: @"mailto"] == 0) {
-      if (! [path enIsEqualToStringOrNil: [url resourceSpecifier]]) {
-        NSLog(@"Path '%@' does not match resource specifier '%@'", path, [url resourceSpecifier]);
-        result = NO;
-      }
-    } else if ([path hasSuffix: @"/"]) {
-      path = [path substringToIndex: [path length] - 1];
-      if (![path enIsEqualToStringOrNil: urlPath]) {
-        NSLog(@"Path '%@' does not match path '%@'", path, urlPath);
-        result = NO;
-      }
-    } else {
-      NSLog(@"Path '%@' does not match path '%@'", path, urlPath);
-      result = NO;
-    }
-  }
-  NSString * query = [components objectAtIndex: 7];
-  if (![query enIsEqualToStringOrNil: [url query]]) {
-    NSLog(@"Query '%@' does not match query '%@'", query, [url query]);
-    result = NO;
-  }
-  NSString * fragment = [components objectAtIndex: 9];
-  if (![fragment enIsEqualToStringOrNil: [url fragment]]) {
-    NSLog(@"Fragment '%@' does not match fragment '%@'", fragment, [url fragment]);
-    result = NO;
-  }
-  
-  return result;
+  return [ENURLUtils validateURLComponents:url];
 }
 
 + (NSString *) emptyNote {
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2012-2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENURLUtils.h"
+#import "ENSDKLogger.h"
+
+typedef struct {
+  NSRange scheme;
+  NSRange authority;
+  NSRange path;
+  NSRange query;
+  NSRange fragment;
+} ENURLComponentRanges;
+
+typedef enum {
+  ENURLDecodeEnd = 0,
+  ENURLDecodeUnit,
+  ENURLDecodeFailed
+} ENURLDecodeStatus;
+
+// Walks a range of a string, replacing percent escapes the way
+// -stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding does, one UTF-16 unit at a time.
+typedef struct {
+  CFStringInlineBuffer *buffer;
+  CFIndex index;
+  CFIndex end;
+  UniChar pending;
+  BOOL hasPending;
+} ENURLPercentDecoder;
+
+static inline UniChar ENURLCharAt(CFStringInlineBuffer *buffer, CFIndex index) {
+  return CFStringGetCharacterFromInlineBuffer(buffer, index);
+}
+
+static inline BOOL ENURLIsLineTerminator(UniChar c) {
+  // What ICU's '.' refuses to match.
+  return (c >= 0x0A && c <= 0x0D) || c == 0x85 || c == 0x2028 || c == 0x2029;
+}
+
+static void ENURLScanComponents(CFStringInlineBuffer *buffer, CFIndex length, ENURLComponentRanges *ranges) {
+  // Mirrors ^(([^:/?#]+):)?(//([^/?#]*))?([^?#]*)(\?([^#]*))?(#(.*))? with unmatched groups left empty.
+  CFIndex i = 0, j = 0;
+  memset(ranges, 0, sizeof(*ranges));
+
+  while (j < length) {
+    UniChar c = ENURLCharAt(buffer, j);
+    if (c == ':' || c == '/' || c == '?' || c == '#') {
+      break;
+    }
+    j++;
+  }
+  if (j > 0 && j < length && ENURLCharAt(buffer, j) == ':') {
+    ranges->scheme = NSMakeRange(0, (NSUInteger)j);
+    i = j + 1;
+  }
+
+  if (i + 1 < length && ENURLCharAt(buffer, i) == '/' && ENURLCharAt(buffer, i + 1) == '/') {
+    CFIndex start = i + 2;
+    for (i = start; i < length; i++) {
+      UniChar c = ENURLCharAt(buffer, i);
+      if (c == '/' || c == '?' || c == '#') {
+        break;
+      }
+    }
+    ranges->authority = NSMakeRange((NSUInteger)start, (NSUInteger)(i - start));
+  }
+
+  CFIndex start = i;
+  for (; i < length; i++) {
+    UniChar c = ENURLCharAt(buffer, i);
+    if (c == '?' || c == '#') {
+      break;
+    }
+  }
+  ranges->path = NSMakeRange((NSUInteger)start, (NSUInteger)(i - start));
+
+  if (i < length && ENURLCharAt(buffer, i) == '?') {
+    start = ++i;
+    while (i < length && ENURLCharAt(buffer, i) != '#') {
+      i++;
+    }
+    ranges->query = NSMakeRange((NSUInteger)start, (NSUInteger)(i - start));
+  }
+
+  if (i < length && ENURLCharAt(buffer, i) == '#') {
+    start = ++i;
+    while (i < length && !ENURLIsLineTerminator(ENURLCharAt(buffer, i))) {
+      i++;
+    }
+    ranges->fragment = NSMakeRange((NSUInteger)start, (NSUInteger)(i - start));
+  }
+}
+
+#pragma mark - Comparison
+
+// Compares the string's characters at *index against piece, advancing *index past them on a match.
+static BOOL ENURLConsumeString(CFStringInlineBuffer *buffer, CFIndex *index, CFIndex end, NSString *piece) {
+  CFIndex pieceLength = (CFIndex)[piece length];
+  if (end - *index < pieceLength) {
+    return NO;
+  }
+  CFStringInlineBuffer pieceBuffer;
+  CFStringInitInlineBuffer((__bridge CFStringRef)piece, &pieceBuffer, CFRangeMake(0, pieceLength));
+  for (CFIndex k = 0; k < pieceLength; k++) {
+    if (ENURLCharAt(buffer, *index + k) != ENURLCharAt(&pieceBuffer, k)) {
+      return NO;
+    }
+  }
+  *index += pieceLength;
+  return YES;
+}
+
+// Equivalent to [[absoluteString substringWithRange:range] enIsEqualToStringOrNil:string].
+static BOOL ENURLRangeIsEqualToStringOrNil(CFStringInlineBuffer *buffer, NSRange range, NSString *string) {
+  if (string == nil) {
+    return (range.length == 0);
+  }
+  CFIndex index = (CFIndex)range.location;
+  return ((NSUInteger)[string length] == range.length &&
+          ENURLConsumeString(buffer, &index, (CFIndex)NSMaxRange(range), string));
+}
+
+static BOOL ENURLRangeHasCaseInsensitivePrefix(CFStringInlineBuffer *buffer, NSRange range, const char *ascii) {
+  size_t asciiLength = strlen(ascii);
+  if (range.length != asciiLength) {
+    return NO;
+  }
+  for (size_t k = 0; k < asciiLength; k++) {
+    UniChar c = ENURLCharAt(buffer, (CFIndex)(range.location + k));
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+    if (c != (UniChar)ascii[k]) {
+      return NO;
+    }
+  }
+  return YES;
+}
+
+#pragma mark - Percent decoding
+
+static inline BOOL ENURLHexValue(UniChar c, uint8_t *value) {
+  if (c >= '0' && c <= '9') {
+    *value = (uint8_t)(c - '0');
+  } else if (c >= 'a' && c <= 'f') {
+    *value = (uint8_t)(c - 'a' + 10);
+  } else if (c >= 'A' && c <= 'F') {
+    *value = (uint8_t)(c - 'A' + 10);
+  } else {
+    return NO;
+  }
+  return YES;
+}
+
+static BOOL ENURLReadEscapedByte(ENURLPercentDecoder *decoder, CFIndex index, uint8_t *byte) {
+  uint8_t high = 0, low = 0;
+  if (decoder->end - index < 3 || ENURLCharAt(decoder->buffer, index) != '%' ||
+      !ENURLHexValue(ENURLCharAt(decoder->buffer, index + 1), &high) ||
+      !ENURLHexValue(ENURLCharAt(decoder->buffer, index + 2), &low)) {
+    return NO;
+  }
+  *byte = (uint8_t)((high << 4) | low);
+  return YES;
+}
+
+// Same rules CFString applies when creating a string from UTF-8 bytes.
+static BOOL ENURLIsLegalUTF8(const uint8_t *bytes, NSUInteger length) {
+  uint8_t lead = bytes[0];
+  if (lead > 0xF4 || (lead >= 0x80 && lead < 0xC2)) {
+    return NO;
+  }
+  for (NSUInteger k = 1; k < length; k++) {
+    uint8_t b = bytes[k];
+    if (b < 0x80 || b > 0xBF) {
+      return NO;
+    }
+  }
+  if (length > 1) {
+    uint8_t second = bytes[1];
+    if ((lead == 0xE0 && second < 0xA0) || (lead == 0xED && second > 0x9F) ||
+        (lead == 0xF0 && second < 0x90) || (lead == 0xF4 && second > 0x8F)) {
+      return NO;
+    }
+  }
+  return YES;
+}
+
+static ENURLDecodeStatus ENURLPercentDecoderNext(ENURLPercentDecoder *decoder, UniChar *unit) {
+  while (YES) {
+    if (decoder->hasPending) {
+      decoder->hasPending = NO;
+      *unit = decoder->pending;
+      return ENURLDecodeUnit;
+    }
+    if (decoder->index >= decoder->end) {
+      return ENURLDecodeEnd;
+    }
+    UniChar c = ENURLCharAt(decoder->buffer, decoder->index);
+    if (c != '%') {
+      decoder->index++;
+      *unit = c;
+      return ENURLDecodeUnit;
+    }
+
+    // The lead byte decides how many escapes make up the character, as in CFURL.
+    uint8_t bytes[4];
+    if (!ENURLReadEscapedByte(decoder, decoder->index, &bytes[0])) {
+      return ENURLDecodeFailed;
+    }
+    NSUInteger count = !(bytes[0] & 0x80) ? 1 : !(bytes[0] & 0x20) ? 2 : !(bytes[0] & 0x10) ? 3 : 4;
+    for (NSUInteger k = 1; k < count; k++) {
+      if (!ENURLReadEscapedByte(decoder, decoder->index + (CFIndex)(3 * k), &bytes[k])) {
+        return ENURLDecodeFailed;
+      }
+    }
+    decoder->index += (CFIndex)(3 * count);
+    if (count == 1) {
+      *unit = bytes[0];
+      return ENURLDecodeUnit;
+    }
+    if (!ENURLIsLegalUTF8(bytes, count)) {
+      return ENURLDecodeFailed;
+    }
+
+    uint32_t scalar = bytes[0] & (0xFF >> (count + 1));
+    for (NSUInteger k = 1; k < count; k++) {
+      scalar = (scalar << 6) | (bytes[k] & 0x3F);
+    }
+    if (scalar == 0xFEFF) {
+      // CFString drops a UTF-8 byte order mark, so an escaped one decodes to nothing.
+      continue;
+    }
+    if (scalar >= 0x10000) {
+      scalar -= 0x10000;
+      decoder->pending = (UniChar)(0xDC00 | (scalar & 0x3FF));
+      decoder->hasPending = YES;
+      *unit = (UniChar)(0xD800 | (scalar >> 10));
+    } else {
+      *unit = (UniChar)scalar;
+    }
+    return ENURLDecodeUnit;
+  }
+}
+
+static void ENURLPercentDecoderInit(ENURLPercentDecoder *decoder, CFStringInlineBuffer *buffer, NSRange range) {
+  decoder->buffer = buffer;
+  decoder->index = (CFIndex)range.location;
+  decoder->end = (CFIndex)NSMaxRange(range);
+  decoder->pending = 0;
+  decoder->hasPending = NO;
+}
+
+// Equivalent to comparing the first decodedLength units of the decoded path with -enIsEqualToStringOrNil:.
+static BOOL ENURLDecodedPathIsEqualToStringOrNil(CFStringInlineBuffer *buffer, NSRange path,
+                                                 NSUInteger decodedLength, NSString *string) {
+  if (string == nil) {
+    return (decodedLength == 0);
+  }
+  if ((NSUInteger)[string length] != decodedLength) {
+    return NO;
+  }
+  CFStringInlineBuffer stringBuffer;
+  CFStringInitInlineBuffer((__bridge CFStringRef)string, &stringBuffer, CFRangeMake(0, (CFIndex)decodedLength));
+  ENURLPercentDecoder decoder;
+  ENURLPercentDecoderInit(&decoder, buffer, path);
+  UniChar unit = 0;
+  for (NSUInteger k = 0; k < decodedLength; k++) {
+    if (ENURLPercentDecoderNext(&decoder, &unit) != ENURLDecodeUnit ||
+        unit != ENURLCharAt(&stringBuffer, (CFIndex)k)) {
+      return NO;
+    }
+  }
+  return YES;
+}
+
+@implementation ENURLUtils
+
++ (NSString *) decodedPathForLogging:(NSString *)absoluteString range:(NSRange)range {
+  return [[absoluteString substringWithRange:range] stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+}
+
++ (BOOL) validateURLComponents: (NSURL *) url {
+  if (url == nil) {
+    return NO;
+  }
+  
+  NSString *urlScheme = [url scheme];
+  if ([urlScheme rangeOfString: @"script"].location != NSNotFound) {
+    // disallow *script* schemes!
+    return NO;
+  }
+  else if ([urlScheme isEqualToString: @"file"]) {
+    return YES;
+  }
+  else if ([urlScheme isEqualToString:@"x-apple-data-detectors"]) {
+    return NO;
+  }
+  else if ([urlScheme isEqualToString:@"tel"]) {
+    return YES;
+  }
+  
+  BOOL result = YES;
+  NSString *absoluteString = [url absoluteString];
+  if (absoluteString == nil) {
+    return NO;
+  }
+  CFIndex length = (CFIndex)[absoluteString length];
+  CFStringInlineBuffer buffer;
+  CFStringInitInlineBuffer((__bridge CFStringRef)absoluteString, &buffer, CFRangeMake(0, length));
+  ENURLComponentRanges ranges;
+  ENURLScanComponents(&buffer, length, &ranges);
+  
+  if (!ENURLRangeIsEqualToStringOrNil(&buffer, ranges.scheme, urlScheme)) {
+    ENSDKLog(Info, ENML, @"Scheme '%@' does not match scheme '%@'", [absoluteString substringWithRange:ranges.scheme], urlScheme);
+    result = NO;
+  }
+  
+  // The authority has to read as [user][:password]@ host [:port], using NSURL's values for each.
+  CFIndex index = (CFIndex)ranges.authority.location;
+  CFIndex end = (CFIndex)NSMaxRange(ranges.authority);
+  NSString *user = [url user];
+  NSString *password = [url password];
+  NSString *host = [url host];
+  NSNumber *port = [url port];
+  BOOL authorityMatches = YES;
+  if (user || password) {
+    if (user) {
+      authorityMatches = ENURLConsumeString(&buffer, &index, end, user);
+    }
+    if (password) {
+      authorityMatches = authorityMatches && ENURLConsumeString(&buffer, &index, end, @":") && ENURLConsumeString(&buffer, &index, end, password);
+    }
+    authorityMatches = authorityMatches && ENURLConsumeString(&buffer, &index, end, @"@");
+  }
+  if (host) {
+    authorityMatches = authorityMatches && ENURLConsumeString(&buffer, &index, end, host);
+  }
+  if (port) {
+    authorityMatches = authorityMatches && ENURLConsumeString(&buffer, &index, end, @":") && ENURLConsumeString(&buffer, &index, end, [port description]);
+  }
+  if (!authorityMatches || index != end) {
+    ENSDKLog(Info, ENML, @"Authority '%@' does not match URL %@", [absoluteString substringWithRange:ranges.authority], url);
+    result = NO;
+  }
+  
+  // One pass to find out whether the path decodes at all, how long it is, and how it ends.
+  ENURLPercentDecoder decoder;
+  ENURLPercentDecoderInit(&decoder, &buffer, ranges.path);
+  ENURLDecodeStatus status;
+  NSUInteger decodedLength = 0;
+  UniChar unit = 0, lastUnit = 0;
+  while ((status = ENURLPercentDecoderNext(&decoder, &unit)) == ENURLDecodeUnit) {
+    decodedLength++;
+    lastUnit = unit;
+  }
+  
+  NSString *urlPath = [url path];
+  if (status == ENURLDecodeFailed) {
+    ENSDKLog(Info, ENML, @"Path '%@' could not be decoded", [absoluteString substringWithRange:ranges.path]);
+    result = NO;
+  }
+  else if (!ENURLDecodedPathIsEqualToStringOrNil(&buffer, ranges.path, decodedLength, urlPath)) {
+    if (ENURLRangeHasCaseInsensitivePrefix(&buffer, ranges.scheme, "mailto")) {
+      if (!ENURLDecodedPathIsEqualToStringOrNil(&buffer, ranges.path, decodedLength, [url resourceSpecifier])) {
+        ENSDKLog(Info, ENML, @"Path '%@' does not match resource specifier '%@'",
+                 [self decodedPathForLogging:absoluteString range:ranges.path], [url resourceSpecifier]);
+        result = NO;
+      }
+    } else if (decodedLength > 0 && lastUnit == '/') {
+      if (!ENURLDecodedPathIsEqualToStringOrNil(&buffer, ranges.path, decodedLength - 1, urlPath)) {
+        ENSDKLog(Info, ENML, @"Path '%@' does not match path '%@'", [self decodedPathForLogging:absoluteString range:ranges.path], urlPath);
+        result = NO;
+      }
+    } else {
+      ENSDKLog(Info, ENML, @"Path '%@' does not match path '%@'", [self decodedPathForLogging:absoluteString range:ranges.path], urlPath);
+      result = NO;
+    }
+  }
+  
+  NSString *query = [url query];
+  if (!ENURLRangeIsEqualToStringOrNil(&buffer, ranges.query, query)) {
+    ENSDKLog(Info, ENML, @"Query '%@' does not match query '%@'", [absoluteString substringWithRange:ranges.query], query);
+    result = NO;
+  }
+  NSString *fragment = [url fragment];
+  if (!ENURLRangeIsEqualToStringOrNil(&buffer, ranges.fragment, fragment)) {
+    ENSDKLog(Info, ENML, @"Fragment '%@' does not match fragment '%@'", [absoluteString substringWithRange:ranges.fragment], fragment);
+    result = NO;
+  }
+  
+  return result;
+}
+
+@end
@@ -28,6 +28,7 @@
 
 #import "ENXMLWriter.h"
 #import "ENXMLUtils.h"
+#import "ENTUTF8String.h"
 #import <libxml/xmlwriter.h>
 
 static void CheckXMLResult(int result, NSString *blah) {
@@ -51,7 +52,8 @@ static void CheckXMLResult(int result, NSString *blah) {
 
 @implementation ENXMLWriter {
   id<ENXMLWriterDelegate> __weak _delegate;
-  NSMutableString *_contents;
+  NSMutableData *_contentsData;
+  NSString *_contents;
   
   xmlTextWriterPtr _xmlWriter;
   xmlOutputBufferPtr _xmlOutputBuffer;
@@ -75,8 +77,10 @@ static int ENXMLWriter_delegateWriteCallback(void * context,  const char * buffe
 }
 
 static int ENXMLWriter_contentsWriteCallback(void * context,  const char * buffer, int len) {
-  NSMutableString *contents = (__bridge NSMutableString *)context;
-  [contents appendString:[NSString stringWithUTF8String:buffer]];
+  // Kept as the UTF-8 libxml writes, which is also what goes on the wire. A chunk may end partway
+  // through a character, so it can't be decoded on its own anyway.
+  NSMutableData *contentsData = (__bridge NSMutableData *)context;
+  [contentsData appendBytes:buffer length:len];
   return len;
 }
 
@@ -90,10 +94,23 @@ static int ENXMLWriter_delegateCloseCallback(void * context) {
 #pragma mark Properties
 
 @synthesize delegate = _delegate;
-@synthesize contents = _contents;
 @synthesize dtd = _dtd;
 @synthesize openElementCount = _openElementCount;
 
+- (NSString *) contents {
+  if (!_contentsData) {
+    return nil;
+  }
+  // Flush what libxml still buffers, for contents asked for before the document ends.
+  if (_xmlWriter) {
+    xmlTextWriterFlush(_xmlWriter);
+  }
+  if (!_contents || [_contents lengthOfBytesUsingEncoding:NSUTF8StringEncoding] != [_contentsData length]) {
+    _contents = [[ENTUTF8String alloc] initWithUTF8Data:_contentsData];
+  }
+  return _contents;
+}
+
 #pragma mark -
 #pragma mark NSObject Methods
 - (id)init {
@@ -125,10 +142,11 @@ static int ENXMLWriter_delegateCloseCallback(void * context) {
                                                NULL);
   }
   else {
-    _contents = [[NSMutableString alloc] init];
+    _contentsData = [[NSMutableData alloc] init];
+    _contents = nil;
     _xmlOutputBuffer = xmlOutputBufferCreateIO(ENXMLWriter_contentsWriteCallback,
                                                NULL,
-                                               (__bridge void *)_contents, 
+                                               (__bridge void *)_contentsData, 
                                                NULL);
   }
   CheckXMLResult(_xmlOutputBuffer == nil ? -1 : 0, @"xmlOutputBufferCreateIO");
@@ -33,6 +33,14 @@ NS_ASSUME_NONNULL_BEGIN
 @interface NSRegularExpression (ENAGRegex)
 
 + (nullable NSRegularExpression *) enRegexWithPattern:(NSString *)pattern;
+
+// Returns a compiled regex from a process-wide registry, compiling and registering it on first use.
+// NSRegularExpression is immutable, so the result can be shared freely across threads.
++ (nullable NSRegularExpression *) enCachedRegexWithPattern:(NSString *)pattern;
+
+// Compiles every *_REGEX constant published by EDAMLimitsConstants into the registry up front.
++ (void) enPrecompileEDAMLimitsPatterns;
+
 - (BOOL) enFindInString:(NSString *)string;
 - (BOOL) enMatchesString:(NSString *)string;
 - (NSArray<NSString *> *) enCapturedSubstringsOfString:(NSString *)string;
@@ -26,7 +26,19 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <objc/runtime.h>
 #import "NSRegularExpression+ENAGRegex.h"
+#import "EDAMLimits.h"
+
+static NSMutableDictionary * ENAGRegexRegistry(void)
+{
+    static NSMutableDictionary * registry = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        registry = [[NSMutableDictionary alloc] init];
+    });
+    return registry;
+}
 
 @implementation NSRegularExpression (ENAGRegex)
 + (NSRegularExpression *) enRegexWithPattern:(NSString *)pattern {
@@ -40,6 +52,50 @@
     return result;
 }
 
++ (NSRegularExpression *) enCachedRegexWithPattern:(NSString *)pattern {
+    if (!pattern) {
+        return nil;
+    }
+    NSMutableDictionary *registry = ENAGRegexRegistry();
+    @synchronized(registry) {
+        NSRegularExpression *result = registry[pattern];
+        if (result) {
+            return result;
+        }
+    }
+
+    // Compile outside the lock; if two threads race on the same pattern, the first one registered wins.
+    NSRegularExpression *compiled = [self enRegexWithPattern:pattern];
+    if (compiled == nil) {
+        return nil;
+    }
+    @synchronized(registry) {
+        NSRegularExpression *existing = registry[pattern];
+        if (existing) {
+            return existing;
+        }
+        registry[pattern] = compiled;
+    }
+    return compiled;
+}
+
++ (void) enPrecompileEDAMLimitsPatterns {
+    // EDAMLimits is generated, so discover its patterns from the class rather than listing them by hand.
+    Class limitsClass = [EDAMLimitsConstants class];
+    unsigned int methodCount = 0;
+    Method *methods = class_copyMethodList(object_getClass(limitsClass), &methodCount);
+    for (unsigned int i = 0; i < methodCount; i++) {
+        SEL selector = method_getName(methods[i]);
+        NSString *name = NSStringFromSelector(selector);
+        if (method_getNumberOfArguments(methods[i]) != 2 || [name rangeOfString:@"_REGEX"].location == NSNotFound) {
+            continue;
+        }
+        NSString *(*getter)(id, SEL) = (NSString *(*)(id, SEL))method_getImplementation(methods[i]);
+        [self enCachedRegexWithPattern:getter(limitsClass, selector)];
+    }
+    free(methods);
+}
+
 - (BOOL) enFindInString:(NSString *)string {
     NSTextCheckingResult *result = [self firstMatchInString:string
                                                     options:0
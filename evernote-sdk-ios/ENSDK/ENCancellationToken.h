@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ *  A cancellation token cancels the ENSession and store client calls started while it is current,
+ *  and everything those calls start in turn. Calls that are still queued complete at once; calls on the
+ *  network have their HTTP transfer aborted. Either way the completion is called with an
+ *  ENErrorCodeCancelled error, or ENErrorCodeTimedOut if the token's deadline passed.
+ *
+ *  Any completion-based API can be cancelled this way:
+ *
+ *      ENCancellationToken * token = [ENCancellationToken tokenWithTimeout:10];
+ *      [token performBlock:^{
+ *          [[ENSession sharedSession] findNotesWithSearch:search ... completion:completion];
+ *      }];
+ *      ...
+ *      [token cancel];
+ */
+@interface ENCancellationToken : NSObject
+
+/**
+ *  A token without a deadline, cancelled only by -cancel.
+ */
++ (instancetype)token;
+
+/**
+ *  A token that cancels itself the given number of seconds from now.
+ */
++ (instancetype)tokenWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ *  A token that cancels itself at the given date.
+ */
++ (instancetype)tokenWithDeadline:(nullable NSDate *)deadline;
+
+/**
+ *  The token current on the calling thread, if any.
+ */
++ (nullable ENCancellationToken *)currentToken;
+
+/**
+ *  Runs the block on the calling thread with this token current.
+ */
+- (void)performBlock:(void (^)(void))block;
+
+/**
+ *  Cancels every call started under the token. Calls started under it afterwards fail at once.
+ *  Later calls are ignored.
+ */
+- (void)cancel;
+
+@property (nonatomic, readonly, nullable) NSDate * deadline;
+
+/**
+ *  YES once the token has been cancelled or its deadline has passed.
+ */
+@property (nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ *  The error calls under the token complete with once it is cancelled, or nil before then.
+ */
+@property (nonatomic, readonly, nullable) NSError * error;
+
+@end
+
+NS_ASSUME_NONNULL_END
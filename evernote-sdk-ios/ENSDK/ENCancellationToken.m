@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENCancellationTokenInternal.h"
+#import "ENError.h"
+#import <pthread.h>
+
+static char ENCancellationTokenUnchanged;
+
+@implementation ENCancellationToken
+{
+    NSError * _error;
+    NSMutableArray * _handlers;
+}
+
++ (instancetype)token
+{
+    return [[self alloc] initWithDeadline:nil];
+}
+
++ (instancetype)tokenWithTimeout:(NSTimeInterval)timeout
+{
+    return [[self alloc] initWithDeadline:[NSDate dateWithTimeIntervalSinceNow:timeout]];
+}
+
++ (instancetype)tokenWithDeadline:(NSDate *)deadline
+{
+    return [[self alloc] initWithDeadline:deadline];
+}
+
+- (id)init
+{
+    return [self initWithDeadline:nil];
+}
+
+- (id)initWithDeadline:(NSDate *)deadline
+{
+    self = [super init];
+    if (self) {
+        _deadline = deadline;
+        _handlers = [[NSMutableArray alloc] init];
+        if (deadline) {
+            // Calls under the token keep it alive until they finish, so a token nothing uses any more
+            // has nothing left to time out.
+            __weak ENCancellationToken * weakSelf = self;
+            NSTimeInterval delay = MAX([deadline timeIntervalSinceNow], 0);
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [weakSelf cancelWithError:[ENError timedOutError]];
+            });
+        }
+    }
+    return self;
+}
+
+- (void)cancel
+{
+    [self cancelWithError:[ENError cancelledError]];
+}
+
+- (void)cancelWithError:(NSError *)error
+{
+    NSArray * handlers = nil;
+    @synchronized(self) {
+        if (_error) {
+            return;
+        }
+        _error = error;
+        handlers = [_handlers copy];
+        [_handlers removeAllObjects];
+    }
+    for (void (^handler)(void) in handlers) {
+        handler();
+    }
+}
+
+- (NSError *)error
+{
+    NSError * error = nil;
+    @synchronized(self) {
+        error = _error;
+    }
+    if (!error && self.deadline && [self.deadline timeIntervalSinceNow] <= 0) {
+        // The deadline has passed but the timer has not fired yet.
+        [self cancelWithError:[ENError timedOutError]];
+        @synchronized(self) {
+            error = _error;
+        }
+    }
+    return error;
+}
+
+- (BOOL)isCancelled
+{
+    return self.error != nil;
+}
+
+- (id)addCancellationHandler:(void (^)(void))handler
+{
+    void (^registration)(void) = [handler copy];
+    if (!self.isCancelled) {
+        @synchronized(self) {
+            if (!_error) {
+                [_handlers addObject:registration];
+                return registration;
+            }
+        }
+    }
+    registration();
+    return registration;
+}
+
+- (void)removeCancellationHandler:(id)registration
+{
+    if (!registration) {
+        return;
+    }
+    @synchronized(self) {
+        [_handlers removeObjectIdenticalTo:registration];
+    }
+}
+
+- (void)performBlock:(void (^)(void))block
+{
+    ENCancellationTokenScope(self);
+    block();
+}
+
+#pragma mark - Current token
+
+static pthread_key_t ENCancellationTokenCurrentKey(void)
+{
+    static pthread_key_t key;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
++ (ENCancellationToken *)currentToken
+{
+    return (__bridge ENCancellationToken *)pthread_getspecific(ENCancellationTokenCurrentKey());
+}
+
+@end
+
+void * ENCancellationTokenPushCurrent(ENCancellationToken * token)
+{
+    if (!token) {
+        return &ENCancellationTokenUnchanged;
+    }
+    // The slot owns a reference to its token; the saved pointer takes over the previous one's.
+    pthread_key_t key = ENCancellationTokenCurrentKey();
+    void * previous = pthread_getspecific(key);
+    pthread_setspecific(key, (void *)CFBridgingRetain(token));
+    return previous;
+}
+
+void ENCancellationTokenPopCurrent(void ** saved)
+{
+    if (*saved == &ENCancellationTokenUnchanged) {
+        return;
+    }
+    pthread_key_t key = ENCancellationTokenCurrentKey();
+    void * current = pthread_getspecific(key);
+    pthread_setspecific(key, *saved);
+    if (current) {
+        CFRelease(current);
+    }
+}
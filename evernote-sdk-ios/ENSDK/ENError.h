@@ -44,13 +44,17 @@ typedef NS_ENUM(NSInteger, ENErrorCode) {
     ENErrorCodeDataConflict,
     ENErrorCodeENMLInvalid,
     ENErrorCodeRateLimitReached,
-    ENErrorCodeCancelled
+    ENErrorCodeCancelled,
+    ENErrorCodeTimedOut
 };
 
 @interface ENError : NSObject
 
 + (NSError *)connectionFailedError;
 + (NSError *)noteSizeLimitReachedError;
++ (NSError *)cancelledError;
++ (NSError *)timedOutError;
++ (NSError *)rateLimitReachedErrorWithDuration:(NSTimeInterval)duration;
 + (nullable NSError *)errorFromException:(nullable NSException *)exception;
 + (ENErrorCode)sanitizedErrorCodeFromEDAMErrorCode:(int)code;
 
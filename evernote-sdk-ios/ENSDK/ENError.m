@@ -52,6 +52,28 @@ NSString * ENErrorDomain = @"ENErrorDomain";
                            userInfo:@{NSLocalizedDescriptionKey: @"Note exceeded size limit to upload."}];
 }
 
++ (NSError *)cancelledError
+{
+    return [NSError errorWithDomain:ENErrorDomain
+                               code:ENErrorCodeCancelled
+                           userInfo:@{NSLocalizedDescriptionKey: [self localizedDescriptionForENErrorCode:ENErrorCodeCancelled]}];
+}
+
++ (NSError *)timedOutError
+{
+    return [NSError errorWithDomain:ENErrorDomain
+                               code:ENErrorCodeTimedOut
+                           userInfo:@{NSLocalizedDescriptionKey: [self localizedDescriptionForENErrorCode:ENErrorCodeTimedOut]}];
+}
+
++ (NSError *)rateLimitReachedErrorWithDuration:(NSTimeInterval)duration
+{
+    return [NSError errorWithDomain:ENErrorDomain
+                               code:ENErrorCodeRateLimitReached
+                           userInfo:@{NSLocalizedDescriptionKey: [self localizedDescriptionForENErrorCode:ENErrorCodeRateLimitReached],
+                                      @"rateLimitDuration": @((int32_t)ceil(duration))}];
+}
+
 + (NSError *)errorFromException:(NSException *)exception
 {
     if (exception) {
@@ -165,6 +187,12 @@ NSString * ENErrorDomain = @"ENErrorDomain";
         case ENErrorCodeRateLimitReached:
             return @"Application reached hourly API call limit to Evernote.";
             
+        case ENErrorCodeCancelled:
+            return @"Operation was cancelled.";
+            
+        case ENErrorCodeTimedOut:
+            return @"Operation did not finish before its deadline.";
+            
         default:
             return @"Unknown error";
     }
@@ -59,6 +59,11 @@
 }
 
 - (id)initWithServiceNote:(EDAMNote *)note
+{
+    return [self initWithServiceNote:note resourceDataLoader:nil];
+}
+
+- (id)initWithServiceNote:(EDAMNote *)note resourceDataLoader:(ENResourceDataLoader)resourceDataLoader
 {
     self = [super init];
     if (self) {
@@ -72,7 +77,7 @@
         // Resources to ENResources
         _resources = [[NSMutableArray alloc] init];
         for (EDAMResource * serviceResource in note.resources) {
-            ENResource * resource = [ENResource resourceWithServiceResource:serviceResource];
+            ENResource * resource = [ENResource resourceWithServiceResource:serviceResource dataLoader:resourceDataLoader];
             if (resource) {
                 [_resources addObject:resource];
             }
@@ -146,6 +151,61 @@
         return;
     }
     
+    // The archive carries the resources, so load any still on the service first. One that fails to load
+    // is left out of the archive.
+    if (![self hasUnloadedResources]) {
+        [self generateWebArchiveDataWithLoadedResources:completion];
+        return;
+    }
+    [self loadResourceDataWithCompletion:^(NSError * error) {
+        [self generateWebArchiveDataWithLoadedResources:completion];
+    }];
+}
+
+- (BOOL)hasUnloadedResources
+{
+    for (ENResource * resource in self.resources) {
+        if (!resource.isDataLoaded) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (BOOL)replacesServiceNoteGUID:(NSString *)guid
+{
+    return self.serviceNote && [self.serviceNote.guid isEqualToString:guid];
+}
+
+- (BOOL)needsResourceDataToReplaceServiceNoteGUID:(NSString *)guid
+{
+    return ![self replacesServiceNoteGUID:guid] && [self hasUnloadedResources];
+}
+
+- (void)loadResourceDataWithCompletion:(void (^)(NSError * error))completion
+{
+    dispatch_group_t resourcesGroup = dispatch_group_create();
+    __block NSError * firstError = nil;
+    for (ENResource * resource in self.resources) {
+        if (!resource.isDataLoaded) {
+            dispatch_group_enter(resourcesGroup);
+            [resource loadDataWithCompletion:^(NSData * data, NSError * error) {
+                @synchronized(resourcesGroup) {
+                    if (error && !firstError) {
+                        firstError = error;
+                    }
+                }
+                dispatch_group_leave(resourcesGroup);
+            }];
+        }
+    }
+    dispatch_group_notify(resourcesGroup, dispatch_get_main_queue(), ^{
+        completion(firstError);
+    });
+}
+
+- (void)generateWebArchiveDataWithLoadedResources:(ENNoteGenerateWebArchiveDataCompletionHandler)completion
+{
     // Turn the content of the note into sanitized HTML.
     NSString * enml = [self enmlContent];
     if (!enml) {
@@ -193,6 +253,9 @@
         // Prepare the array of any subresources present for the main archive.
         NSMutableArray * subresources = [[NSMutableArray alloc] init];
         for (EDAMResource * resource in edamResources) {
+            if (!resource.data.body) {
+                continue;
+            }
             ENWebResource * webResource = [[ENWebResource alloc] initWithData:resource.data.body
                                                                           URL:[NSURL URLWithString:resource.attributes.sourceURL]
                                                                      MIMEType:resource.mime
@@ -207,7 +270,24 @@
         ENWebArchive * archive = [[ENWebArchive alloc] initWithMainResource:mainResource
                                                                subresources:subresources
                                                            subframeArchives:nil];
-        completion([archive data]);
+        
+        // Stream the archive out to a scratch file and hand back a mapping of it, so that a note with large
+        // resources doesn't need a second, fully resident copy of all of them. Fall back to building the data
+        // in memory if we can't go through the file system.
+        NSString * filename = [NSString stringWithFormat:@"ENNote-%@.webarchive", [[NSUUID UUID] UUIDString]];
+        NSURL * fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:filename]];
+        NSData * archiveData = nil;
+        NSError * error = nil;
+        if ([archive writeToURL:fileURL error:&error]) {
+            archiveData = [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedIfSafe error:&error];
+            // The mapping stays valid after the file is unlinked.
+            [[NSFileManager defaultManager] removeItemAtURL:fileURL error:NULL];
+        }
+        if (!archiveData) {
+            ENSDKLogInfo(@"+webArchiveData couldn't stream archive to disk: %@", error);
+            archiveData = [archive data];
+        }
+        completion(archiveData);
     }];
 }
 
@@ -260,7 +340,8 @@
     // of the "original" note we might be replacing, but not propagate those properties to a
     // a completely fresh note.
     EDAMNote * note = nil;
-    if (self.serviceNote && [self.serviceNote.guid isEqualToString:guid]) {
+    BOOL replacesServiceNote = [self replacesServiceNoteGUID:guid];
+    if (replacesServiceNote) {
         note = [self.serviceNote copy];
         // Don't preserve these. Our caller will either rewrite them or leave them blank.
         note.guid = nil;
@@ -315,10 +396,14 @@
         note.tagNames = [self.tagNames mutableCopy];
     }
     
-    // Turn any ENResources on the note into EDAMResources.
+    // Turn any ENResources on the note into EDAMResources. Data still on the service can be referenced by
+    // hash only from the note it belongs to; callers writing anywhere else load it first.
     NSMutableArray * resources = [NSMutableArray array];
     for (ENResource * localResource in self.resources) {
-        EDAMResource * resource = [localResource EDAMResource];
+        EDAMResource * resource = replacesServiceNote ? [localResource EDAMResourceReferencingServiceData] : [localResource EDAMResource];
+        if (!resource && !localResource.isDataLoaded) {
+            ENSDKLogError(@"Resource %@ is left out of the note: its data has not loaded.", localResource);
+        }
         if (resource) {
             [resources addObject:resource];
         }
@@ -347,8 +432,10 @@
 
 - (BOOL)validateForLimits
 {
-    if (self.enmlContent.length < (NSUInteger)[EDAMLimitsConstants EDAM_NOTE_CONTENT_LEN_MIN] ||
-        self.enmlContent.length > (NSUInteger)[EDAMLimitsConstants EDAM_NOTE_CONTENT_LEN_MAX]) {
+    // The service counts content in UTF-8 bytes, which ENML from the writer or the wire also has at hand.
+    NSUInteger contentLength = [self.enmlContent lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    if (contentLength < (NSUInteger)[EDAMLimitsConstants EDAM_NOTE_CONTENT_LEN_MIN] ||
+        contentLength > (NSUInteger)[EDAMLimitsConstants EDAM_NOTE_CONTENT_LEN_MAX]) {
         ENSDKLogInfo(@"Note fails validation for content length: %@", self);
         return NO;
     }
@@ -359,7 +446,7 @@
     }
     
     for (ENResource * resource in self.resources) {
-        if (resource.data.length > maxResourceSize) {
+        if (resource.dataSize > maxResourceSize) {
             ENSDKLogInfo(@"Note fails validation for resource length: %@", self);
             return NO;
         }
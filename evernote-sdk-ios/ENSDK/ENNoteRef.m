@@ -72,6 +72,7 @@
     copy.type = self.type;
     copy.guid = self.guid;
     copy.linkedNotebook = self.linkedNotebook;
+    copy.updateSequenceNum = self.updateSequenceNum;
     return copy;
 }
 
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENRequestPriorityInternal.h"
+#import <pthread.h>
+
+// The thread slot holds the priority plus one, so that an empty slot means no priority is set.
+static pthread_key_t ENRequestPriorityCurrentKey(void)
+{
+    static pthread_key_t key;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        pthread_key_create(&key, NULL);
+    });
+    return key;
+}
+
+ENRequestPriority ENRequestPriorityCurrent(ENRequestPriority fallback)
+{
+    intptr_t value = (intptr_t)pthread_getspecific(ENRequestPriorityCurrentKey());
+    return (value > 0) ? (ENRequestPriority)(value - 1) : fallback;
+}
+
+void * ENRequestPriorityPushCurrent(ENRequestPriority priority)
+{
+    pthread_key_t key = ENRequestPriorityCurrentKey();
+    void * previous = pthread_getspecific(key);
+    pthread_setspecific(key, (void *)(intptr_t)(priority + 1));
+    return previous;
+}
+
+void ENRequestPriorityPopCurrent(void ** saved)
+{
+    pthread_setspecific(ENRequestPriorityCurrentKey(), *saved);
+}
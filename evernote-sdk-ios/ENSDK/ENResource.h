@@ -39,10 +39,21 @@ NS_ASSUME_NONNULL_BEGIN
 @interface ENResource : NSObject
 
 /**
- *  The data body of the resource.
+ *  The data body of the resource. Nil for a resource of a note downloaded with
+ *  -[ENSession downloadNote:resourcePrefetchPolicy:progress:completion:] until its data is loaded.
  */
 @property (nonatomic, strong, nullable) NSData * data;
 
+/**
+ *  NO while the data of a resource downloaded without it has not been loaded yet. YES otherwise.
+ */
+@property (nonatomic, readonly, getter=isDataLoaded) BOOL dataLoaded;
+
+/**
+ *  The size in bytes of the data body, known before the data is loaded.
+ */
+@property (nonatomic, readonly) NSUInteger dataSize;
+
 /**
  *  The MIME type of the resource.
  */
@@ -93,6 +104,16 @@ NS_ASSUME_NONNULL_BEGIN
  */
 @property (readonly, nonatomic) NSString *mediaTag;
 
+/**
+ *  Loads the data body of a resource downloaded without it. Loads of the same resource made while one
+ *  is under way share it. A note whose resources are not all loaded can still replace itself on the
+ *  service, which keeps the bodies it already has, but load them all before uploading it as a new note.
+ *
+ *  @param completion A block called on the main queue with the data or an error, or at once if the
+ *                    data is already loaded.
+ */
+- (void)loadDataWithCompletion:(void (^)(NSData *_Nullable data, NSError *_Nullable error))completion;
+
 @end
 
 NS_ASSUME_NONNULL_END
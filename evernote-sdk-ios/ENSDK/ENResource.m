@@ -36,17 +36,41 @@
 @property (nonatomic, strong) NSData * dataHash;
 @property (nonatomic, strong) NSDictionary * edamAttributes;
 @property (nonatomic, copy) NSString * guid;
+// Set while the data body is still on the service, with the size it should have.
+@property (nonatomic, copy) ENResourceDataLoader dataLoader;
+@property (nonatomic, assign) NSUInteger expectedDataSize;
+@property (nonatomic, strong) NSMutableArray * pendingDataCompletions;
 @end
 
 @implementation ENResource
 + (instancetype)resourceWithServiceResource:(EDAMResource *)serviceResource
 {
+    return [self resourceWithServiceResource:serviceResource dataLoader:nil];
+}
+
++ (instancetype)resourceWithServiceResource:(EDAMResource *)serviceResource dataLoader:(ENResourceDataLoader)dataLoader
+{
+    if (!serviceResource.data.body && dataLoader && serviceResource.guid && serviceResource.data.bodyHash.length == 16) {
+        ENResource * resource = [[ENResource alloc] init];
+        resource.dataHash = serviceResource.data.bodyHash;
+        resource.expectedDataSize = [serviceResource.data.size unsignedIntegerValue];
+        resource.dataLoader = dataLoader;
+        resource.mimeType = serviceResource.mime;
+        resource.filename = serviceResource.attributes.fileName;
+        resource.sourceUrl = serviceResource.attributes.sourceURL;
+        resource.guid = serviceResource.guid;
+        return resource;
+    }
     if (!serviceResource.data.body) {
         ENSDKLogError(@"Can't create an ENResource from an EDAMResource with no body");
         return nil;
     }
     ENResource * resource = [[ENResource alloc] init];
     resource.data = serviceResource.data.body;
+    // Take the hash the service sent, rather than hashing the body again, when it goes with this body.
+    if (serviceResource.data.bodyHash.length == 16 && [serviceResource.data.size unsignedIntegerValue] == resource.data.length) {
+        resource.dataHash = serviceResource.data.bodyHash;
+    }
     resource.mimeType = serviceResource.mime;
     resource.filename = serviceResource.attributes.fileName;
     resource.sourceUrl = serviceResource.attributes.sourceURL;
@@ -97,9 +121,58 @@
     }
 
     self.dataHash = nil;
+    self.dataLoader = nil;
     _data = data;
 }
 
+- (BOOL)isDataLoaded
+{
+    return (self.dataLoader == nil);
+}
+
+- (NSUInteger)dataSize
+{
+    return self.dataLoader ? self.expectedDataSize : self.data.length;
+}
+
+- (void)loadDataWithCompletion:(void (^)(NSData * data, NSError * error))completion
+{
+    ENResourceDataLoader dataLoader = nil;
+    @synchronized(self) {
+        if (self.pendingDataCompletions) {
+            [self.pendingDataCompletions addObject:[completion copy]];
+            return;
+        }
+        if (self.dataLoader) {
+            self.pendingDataCompletions = [NSMutableArray arrayWithObject:[completion copy]];
+            dataLoader = self.dataLoader;
+        }
+    }
+    if (!dataLoader) {
+        completion(self.data, nil);
+        return;
+    }
+    dataLoader(self.guid, ^(NSData * data, NSError * error) {
+        NSArray * completions = nil;
+        @synchronized(self) {
+            if (!error && data.length != self.expectedDataSize) {
+                ENSDKLogError(@"Resource %@ data is %lu bytes, expected %lu.", self.guid, (unsigned long)data.length, (unsigned long)self.expectedDataSize);
+                error = [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeInvalidData userInfo:nil];
+            }
+            // Keep the hash the service sent. Data set meanwhile by the caller wins over the loaded data.
+            if (!error && self.dataLoader) {
+                self->_data = data;
+                self.dataLoader = nil;
+            }
+            completions = self.pendingDataCompletions;
+            self.pendingDataCompletions = nil;
+        }
+        for (void (^pendingCompletion)(NSData *, NSError *) in completions) {
+            pendingCompletion(error ? nil : self.data, error);
+        }
+    });
+}
+
 - (NSData *)dataHash
 {
     // Compute and cache the hash value.
@@ -109,6 +182,25 @@
     return _dataHash;
 }
 
+- (EDAMResource *)EDAMResourceReferencingServiceData
+{
+    if (self.dataLoader) {
+        // Only the hash: the service keeps the body it has for a resource of the note being replaced.
+        // Any other note, a new one included, needs the body itself.
+        EDAMResource * resource = [[EDAMResource alloc] init];
+        resource.guid = self.guid;
+        resource.data = [[EDAMData alloc] init];
+        resource.data.bodyHash = self.dataHash;
+        resource.data.size = @(self.expectedDataSize);
+        resource.mime = self.mimeType;
+        resource.attributes = [[EDAMResourceAttributes alloc] init];
+        resource.attributes.fileName = self.filename;
+        resource.attributes.sourceURL = self.sourceUrl;
+        return resource;
+    }
+    return [self EDAMResource];
+}
+
 - (EDAMResource *)EDAMResource
 {
     if (!self.data) {
@@ -26,6 +26,31 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#import <Foundation/Foundation.h>
+
+/**
+ *  Severity of an SDK log message. Messages above the session's logLevel are discarded before their
+ *  arguments are formatted.
+ */
+typedef NS_ENUM(NSInteger, ENSDKLogLevel) {
+    ENSDKLogLevelNone = 0,
+    ENSDKLogLevelError,
+    ENSDKLogLevelInfo,
+    ENSDKLogLevelDebug,
+};
+
+/**
+ *  Subsystem that produced an SDK log message. Combine values to select which subsystems are logged.
+ */
+typedef NS_OPTIONS(NSUInteger, ENSDKLogCategory) {
+    ENSDKLogCategoryGeneral   = 1 << 0,
+    ENSDKLogCategoryTransport = 1 << 1,
+    ENSDKLogCategorySync      = 1 << 2,
+    ENSDKLogCategoryENML      = 1 << 3,
+    ENSDKLogCategoryAuth      = 1 << 4,
+    ENSDKLogCategoryAll       = ~(NSUInteger)0,
+};
+
 //
 // The SDK sends some info and error messages to a log output. By default, these will just go to NSLog.
 // You can plug into your app's own logging infrastructure if you wish by setting the shared ENSession's
@@ -54,3 +79,23 @@
  */
 - (void)evernoteLogErrorString:(NSString *)str;
 @end
+
+/**
+ *  A structured log sink receives the message's static format string and its unformatted arguments,
+ *  so it can aggregate by format, defer formatting, or drop messages without paying for them. Set it
+ *  as the shared ENSession's structuredLogger.
+ */
+@protocol ENSDKStructuredLogging <NSObject>
+/**
+ *  This method is called for each message that passes the session's level and category filters.
+ *
+ *  @param level     Severity of the message.
+ *  @param category  Subsystem that produced the message.
+ *  @param format    Static format string of the message.
+ *  @param arguments Arguments for the format string. Copy with va_copy if they must outlive the call.
+ */
+- (void)evernoteLogWithLevel:(ENSDKLogLevel)level
+                    category:(ENSDKLogCategory)category
+                      format:(NSString *)format
+                   arguments:(va_list)arguments;
+@end
@@ -28,12 +28,13 @@
 
 #import <Foundation/Foundation.h>
 #import <UIKit/UIKit.h>
+#import "ENSDKLogging.h"
+#import "ENRequestPriority.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 @class ENSessionFindNotesResult;
 @class ENNotebook, ENNote, ENNoteRef, ENNoteSearch;
-@protocol ENSDKLogging;
 
 extern NSString * const ENSessionHostSandbox;
 
@@ -151,9 +152,31 @@ typedef NS_OPTIONS(NSUInteger, ENSessionSortOrder) {
 @property (nonatomic) BOOL hasResources;
 @end
 
+/**
+ *  Which resources of a note -downloadNote:resourcePrefetchPolicy:progress:completion: starts loading
+ *  the data of as soon as it has the note. A resource is prefetched if it is among the first resources
+ *  of the note, or if its MIME type starts with one of the given prefixes.
+ */
+@interface ENSessionResourcePrefetchPolicy : NSObject
++ (instancetype)policyWithFirstResourceCount:(NSUInteger)count mimeTypePrefixes:(nullable NSArray<NSString *> *)mimeTypePrefixes;
+
+/**
+ *  How many of the note's resources, in order, to prefetch.
+ */
+@property (nonatomic, assign) NSUInteger firstResourceCount;
+
+/**
+ *  MIME type prefixes, such as @"image/", of resources to prefetch.
+ */
+@property (nonatomic, copy, nullable) NSArray<NSString *> * mimeTypePrefixes;
+@end
+
 /**
  *  This is the class that represents a "session" with Evernote. It is designed as a singleton; get the
  *  instance with -sharedSession. It is the primary interface for all interactions with Evernote.
+ *
+ *  Any method that takes a completion handler can be cancelled, or given a deadline, by calling it
+ *  within -[ENCancellationToken performBlock:].
  */
 @interface ENSession : NSObject
 
@@ -164,6 +187,24 @@ typedef NS_OPTIONS(NSUInteger, ENSessionSortOrder) {
  */
 @property (nonatomic, strong, nullable) id<ENSDKLogging> logger;
 
+/**
+ *  The optional structured logger receives each message's static format string and unformatted
+ *  arguments, along with its level and category. It is nil by default, and is called in addition
+ *  to the logger above.
+ */
+@property (nonatomic, strong, nullable) id<ENSDKStructuredLogging> structuredLogger;
+
+/**
+ *  The most verbose level that is logged. Messages above it are discarded before they are formatted.
+ *  Defaults to ENSDKLogLevelInfo; set ENSDKLogLevelDebug to include verbose diagnostics.
+ */
+@property (nonatomic, assign) ENSDKLogLevel logLevel;
+
+/**
+ *  The subsystems that are logged. Defaults to ENSDKLogCategoryAll.
+ */
+@property (nonatomic, assign) ENSDKLogCategory logCategories;
+
 /**
  *  This is a string that is used when creating notes to uniquely identify your application. 
  *  By default, it will be equal to the bundle identifier of the app.
@@ -406,6 +447,22 @@ typedef NS_OPTIONS(NSUInteger, ENSessionSortOrder) {
             progress:(nullable ENSessionProgressHandler)progress
           completion:(ENSessionDownloadNoteCompletionHandler)completion NS_SWIFT_NAME(download(_:progress:completion:));
 
+/**
+ *  Download the content of a specified note, leaving the data of its resources on the service. The note
+ *  comes back after one call for its content, with each resource carrying its hash, MIME type and size,
+ *  and its data nil. The data of the resources the policy picks starts loading at once; that of the others
+ *  loads when asked for, through -[ENResource loadDataWithCompletion:].
+ *
+ *  @param noteRef        A reference to the note to download.
+ *  @param prefetchPolicy (optional) Which resources to start loading at once. None if nil.
+ *  @param progress       (optional) A block that will receive updates from 0.0 to 1.0 indicating download progress.
+ *  @param completion     A block to receive the result of the operation (an ENNote object) or error.
+ */
+- (void)downloadNote:(ENNoteRef *)noteRef
+resourcePrefetchPolicy:(nullable ENSessionResourcePrefetchPolicy *)prefetchPolicy
+            progress:(nullable ENSessionProgressHandler)progress
+          completion:(ENSessionDownloadNoteCompletionHandler)completion NS_SWIFT_NAME(download(_:resourcePrefetchPolicy:progress:completion:));
+
 /**
  *  Download the service-generated thumbnail image for a note.
  *
@@ -417,6 +474,17 @@ typedef NS_OPTIONS(NSUInteger, ENSessionSortOrder) {
                     maxDimension:(NSUInteger)maxDimension
                       completion:(ENSessionDownloadNoteThumbnailCompletionHandler)completion;
 
+#pragma mark - Request priority
+
+/**
+ *  Runs the block with the calls it makes at the given priority. That includes every store call those
+ *  calls go on to make, such as each step of a findNotes.
+ *
+ *  @param priority The priority for calls made within the block.
+ *  @param block    The block, run on the calling thread.
+ */
+- (void)performWithRequestPriority:(ENRequestPriority)priority block:(void (^)(void))block;
+
 #pragma mark - Interaction with Evernote app
 
 /**
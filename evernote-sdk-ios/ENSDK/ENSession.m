@@ -28,6 +28,9 @@
 
 #import "ENSDKPrivate.h"
 #import "ENSDKLogging.h"
+#import "ENSDKTracerInternal.h"
+#import "ENCancellationTokenInternal.h"
+#import "ENRequestPriorityInternal.h"
 #import "ENSDKAdvanced.h"
 #import "ENAuthCache.h"
 #import "ENNoteStoreClient.h"
@@ -40,7 +43,10 @@
 #import "NSDate+EDAMAdditions.h"
 #import "NSString+URLEncoding.h"
 #import "ENShareURLHelper.h"
+#import "ENNoteSearchQuery.h"
+#import "ENNoteCache.h"
 #import "ENCommonUtils.h"
+#import "NSRegularExpression+ENAGRegex.h"
 
 // Strings visible publicly.
 NSString * const ENSessionHostSandbox = @"sandbox.evernote.com";
@@ -60,6 +66,10 @@ static NSString * ENSessionPreferencesLinkedAppNotebook = @"LinkedAppNotebook";
 static NSString * ENSessionPreferencesSharedAppNotebook = @"SharedAppNotebook";
 
 static NSUInteger ENSessionNotebooksCacheValidity = (5 * 60);   // 5 minutes
+static NSUInteger ENSessionMaxConcurrentResourceFetches = 4;
+
+static NSString * ENSessionSyncStoreDirectoryName = @"com.evernote.evernote-sdk-ios.sync";
+static NSString * ENSessionNoteCacheDirectoryName = @"com.evernote.evernote-sdk-ios.notes";
 
 @interface ENSessionDefaultLogger : NSObject <ENSDKLogging>
 @end
@@ -73,10 +83,15 @@ static NSUInteger ENSessionNotebooksCacheValidity = (5 * 60);   // 5 minutes
 @property (nonatomic, strong) NSMutableDictionary * sharedNotebooks;
 @property (nonatomic, assign) NSInteger pendingSharedNotebooks;
 @property (nonatomic, strong) NSError * error;
+@property (nonatomic, strong) NSDictionary * localStoreUpdateCounts;
 @property (nonatomic, copy) ENSessionListNotebooksCompletionHandler completion;
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
 @end
 
 @interface ENSessionUploadNoteContext : NSObject
+@property (nonatomic, strong) ENNote * sourceNote;
 @property (nonatomic, strong) EDAMNote * note;
 @property (nonatomic, strong) ENNoteRef * refToReplace;
 @property (nonatomic, strong) ENNotebook * notebook;
@@ -85,6 +100,9 @@ static NSUInteger ENSessionNotebooksCacheValidity = (5 * 60);   // 5 minutes
 @property (nonatomic, copy) ENSessionProgressHandler progress;
 @property (nonatomic, strong) ENNoteStoreClient * noteStore;
 @property (nonatomic, strong) ENNoteRef * noteRef;
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
 @end
 
 @interface ENSessionFindNotesContext : NSObject
@@ -102,6 +120,37 @@ static NSUInteger ENSessionNotebooksCacheValidity = (5 * 60);   // 5 minutes
 @property (nonatomic, strong) NSSet * resultGuidsFromBusiness;
 @property (nonatomic, strong) NSArray * results;
 @property (nonatomic, copy) ENSessionFindNotesCompletionHandler completion;
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
+@end
+
+@interface ENSessionDownloadNoteContext : NSObject
+@property (nonatomic, strong) ENNoteRef * noteRef;
+@property (nonatomic, strong) ENNoteStoreClient * noteStore;
+@property (nonatomic, strong) ENNoteCache * noteCache;
+@property (nonatomic, assign) int32_t cachedUpdateSequenceNum;
+@property (nonatomic, strong) EDAMNote * note;
+@property (nonatomic, strong) NSMutableArray * resourcesToFetch;
+@property (nonatomic, assign) NSUInteger pendingResourceFetches;
+@property (nonatomic, assign) BOOL resourceFetchFailed;
+@property (nonatomic, assign) BOOL leavesResourceData;
+@property (nonatomic, strong) ENSessionResourcePrefetchPolicy * prefetchPolicy;
+@property (nonatomic, copy) ENSessionDownloadNoteCompletionHandler completion;
+@property (nonatomic, strong) ENSDKSpan * span;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority requestPriority;
+@end
+
+// Steps after the first are called from store client completions on the main queue, so each step
+// enters its flow's span, cancellation token and priority again.
+#define ENSessionStepScope(context) \
+    ENSDKTraceScope([context.span beginStepWithSelector:_cmd]); \
+    ENCancellationTokenScope(context.cancellationToken); \
+    ENRequestPriorityScope(context.requestPriority)
+
+@interface ENSessionResourcePrefetchPolicy ()
+- (BOOL)shouldPrefetchResource:(ENResource *)resource atIndex:(NSUInteger)index;
 @end
 
 @interface ENSessionFindNotesResult ()
@@ -125,7 +174,14 @@ static NSUInteger ENSessionNotebooksCacheValidity = (5 * 60);   // 5 minutes
 @property (nonatomic, strong) ENAuthCache * authCache;
 @property (nonatomic, strong) NSArray * notebooksCache;
 @property (nonatomic, strong) NSDate * notebooksCacheDate;
+@property (nonatomic, strong) ENSyncEngine * syncEngine;
+@property (nonatomic, strong) ENNoteCache * noteCache;
 @property (nonatomic, strong) dispatch_queue_t thumbnailQueue;
+// Note cache writes, in order, so that a resource body loaded later lands after its note.
+@property (nonatomic, strong) dispatch_queue_t noteCacheQueue;
+// Completions waiting on a business or shared notebook authentication, keyed by what it is for, so that
+// calls made together authenticate once.
+@property (nonatomic, strong) NSMutableDictionary * pendingAuthenticationCompletions;
 
 @property (nonatomic, strong) ENUserStoreClient * userStorePendingRevocation;
 
@@ -144,6 +200,9 @@ static NSString * DeveloperToken, * NoteStoreUrl;
 static NSString * SecurityApplicationGroupIdentifier;
 static NSString * _keychainGroup, * _keychainAccessGroup;
 static BOOL disableRefreshingNotebooksCacheOnLaunch;
+static BOOL enableLocalSyncStore;
+static BOOL enableLocalSearchIndex;
+static NSUInteger noteCacheSizeLimit;
 
 + (void)setSharedSessionConsumerKey:(NSString *)key
                      consumerSecret:(NSString *)secret
@@ -182,6 +241,21 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     disableRefreshingNotebooksCacheOnLaunch = disable;
 }
 
++ (void)setEnableLocalSyncStore:(BOOL)enable
+{
+    enableLocalSyncStore = enable;
+}
+
++ (void)setEnableLocalSearchIndex:(BOOL)enable
+{
+    enableLocalSearchIndex = enable;
+}
+
++ (void)setNoteCacheSizeLimit:(NSUInteger)bytes
+{
+    noteCacheSizeLimit = bytes;
+}
+
 + (void) setSecurityApplicationGroupIdentifier:(NSString*)securityApplicationGroupIdentifier
 {
     SecurityApplicationGroupIdentifier = securityApplicationGroupIdentifier;
@@ -242,7 +316,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)startup
 {
-    self.logger = [[ENSessionDefaultLogger alloc] init];
+    [ENSDKLogger sharedLogger].logger = [[ENSessionDefaultLogger alloc] init];
     self.preferences = SecurityApplicationGroupIdentifier ? [ENPreferencesStore preferenceStoreWithSecurityApplicationGroupIdentifier:SecurityApplicationGroupIdentifier] : [ENPreferencesStore defaultPreferenceStore];
 
     [[NSNotificationCenter defaultCenter] addObserver:self
@@ -251,6 +325,13 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
                                                object:nil];
     
     self.thumbnailQueue = dispatch_queue_create("evernote-sdk-ios-thumbnail", DISPATCH_QUEUE_CONCURRENT);
+    self.pendingAuthenticationCompletions = [[NSMutableDictionary alloc] init];
+    self.noteCacheQueue = dispatch_queue_create("evernote-sdk-ios-note-cache", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0));
+    
+    // Warm the regex registry off the main thread so title and tag scrubbing never pays for compilation.
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        [NSRegularExpression enPrecompileEDAMLimitsPatterns];
+    });
     
     // Determine the host to use for this session.
     [self selectInitialSessionHost];
@@ -269,6 +350,8 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     if (!credentials || ![credentials areValid]) {
         self.isAuthenticated = NO;
         [self.preferences removeAllItems];
+        [self.syncEngine removeAllData];
+        [self.noteCache removeAllNotes];
         return;
     }
     
@@ -289,9 +372,10 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
         // generally used for the sandbox.
         self.sessionHost = SessionHostOverride;
     } else if (NoteStoreUrl) {
-        // If we have a developer key, just get the host from the note store url.
+        // If we have a developer key, just get the host from the note store url. Keep an explicit port, so
+        // that a local server (e.g. 127.0.0.1:8080) also serves the user store, over http.
         NSURL * noteStoreUrl = [NSURL URLWithString:NoteStoreUrl];
-        self.sessionHost = noteStoreUrl.host;
+        self.sessionHost = noteStoreUrl.port ? [NSString stringWithFormat:@"%@:%@", noteStoreUrl.host, noteStoreUrl.port] : noteStoreUrl.host;
     } else if ([[self currentProfileName] isEqualToString:ENBootstrapProfileNameInternational]) {
         self.sessionHost = ENSessionBootstrapServerBaseURLStringUS;
     } else if ([[self currentProfileName] isEqualToString:ENBootstrapProfileNameChina]) {
@@ -325,7 +409,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     // What if we're already mid-authenticating? If we have an authenticator object already, then
     // don't stomp on it.
     if (self.authenticator) {
-        ENSDKLogInfo(@"Cannot restart authentication while it is still in progress.");
+        ENSDKLog(Info, Auth, @"Cannot restart authentication while it is still in progress.");
         completion([NSError errorWithDomain:ENErrorDomain code:ENErrorCodeUnknown userInfo:nil]);
         return;
     }
@@ -369,7 +453,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     
     [[self userStore] fetchUserWithCompletion:^(EDAMUser *user, NSError *error) {
         if (error) {
-            ENSDKLogError(@"Failed to get user info for user: %@", error);
+            ENSDKLog(Error, Auth, @"Failed to get user info for user: %@", error);
             [self completeAuthenticationWithError:(failuresAreFatal ? error : nil)];
             return;
         }
@@ -381,12 +465,14 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
             // refresh the notebook cache
             [self listNotebooksWithCompletion:^(NSArray *notebooks, NSError *listNotebooksError) {
                 if (listNotebooksError) {
-                    ENSDKLogError(@"Error when listing notebooks: %@", listNotebooksError);
+                    ENSDKLog(Error, Sync, @"Error when listing notebooks: %@", listNotebooksError);
                 }
-                ENSDKLogInfo(@"Notebooks: %@", notebooks);
+                ENSDKLog(Debug, Sync, @"Notebooks: %@", notebooks);
             }];
         }
         
+        [self.syncEngine synchronizeInBackground];
+        
         [self refreshUploadUsage];
     }];
 }
@@ -394,7 +480,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 - (void)refreshUploadUsage {
     [self.primaryNoteStore fetchSyncStateWithCompletion:^(EDAMSyncState *syncState, NSError *error) {
         if (error) {
-            ENSDKLogError(@"Failed to get personal sync state");
+            ENSDKLog(Error, Sync, @"Failed to get personal sync state");
             return;
         }
         self.personalUploadUsage = syncState.uploaded.longLongValue;
@@ -403,7 +489,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     if (self.isBusinessUser) {
         [self.businessNoteStore fetchSyncStateWithCompletion:^(EDAMSyncState *syncState, NSError *error) {
             if (error) {
-                ENSDKLogError(@"Failed to get business sync state");
+                ENSDKLog(Error, Sync, @"Failed to get business sync state");
                 return;
             }
             self.businessUploadUsage = syncState.uploaded.longLongValue;
@@ -461,6 +547,47 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     return _sourceApplication;
 }
 
+// Logging configuration lives in ENSDKLogger so that log sites never need to reach the session.
+- (id<ENSDKLogging>)logger
+{
+    return [ENSDKLogger sharedLogger].logger;
+}
+
+- (void)setLogger:(id<ENSDKLogging>)logger
+{
+    [ENSDKLogger sharedLogger].logger = logger;
+}
+
+- (id<ENSDKStructuredLogging>)structuredLogger
+{
+    return [ENSDKLogger sharedLogger].structuredLogger;
+}
+
+- (void)setStructuredLogger:(id<ENSDKStructuredLogging>)structuredLogger
+{
+    [ENSDKLogger sharedLogger].structuredLogger = structuredLogger;
+}
+
+- (ENSDKLogLevel)logLevel
+{
+    return [ENSDKLogger sharedLogger].level;
+}
+
+- (void)setLogLevel:(ENSDKLogLevel)logLevel
+{
+    [ENSDKLogger sharedLogger].level = logLevel;
+}
+
+- (ENSDKLogCategory)logCategories
+{
+    return [ENSDKLogger sharedLogger].categories;
+}
+
+- (void)setLogCategories:(ENSDKLogCategory)logCategories
+{
+    [ENSDKLogger sharedLogger].categories = logCategories;
+}
+
 - (EDAMUserID)userID
 {
     return [self.user.id intValue];
@@ -483,7 +610,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 }
 
 - (void)unauthenticateAndRevokeAccessToken:(BOOL)shouldRevokeAccessToken {
-    ENSDKLogInfo(@"ENSession is unauthenticating.");
+    ENSDKLog(Info, Auth, @"ENSession is unauthenticating.");
     
     // Revoke the primary auth token, so the app session will not appear any longer on the user's
     // security page. This is purely opportunistic, of course, hence ignoring the result.
@@ -506,6 +633,8 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     self.authCache = [[ENAuthCache alloc] init];
     self.notebooksCache = nil;
     self.notebooksCacheDate = nil;
+    [self.syncEngine removeAllData];
+    [self.noteCache removeAllNotes];
     
     // Manually clear credentials. This ensures they're removed from the keychain also.
     ENCredentialStore * credentialStore = [self credentialStore];
@@ -540,6 +669,9 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 //
 // For personal users, therefore, this will make 2 + n roundtrips, where n is the number of shared notebooks.
 // For business users, this will make 2 + 2 + n roundtrips, where n is the number of nonbusiness shared notebooks.
+//
+// With a local sync store, a getSyncState call comes first. If the account's updateCount is the one the stored
+// list was built at, the stored list is the result and none of the above is needed.
 
 - (void)listNotebooksWithCompletion:(ENSessionListNotebooksCompletionHandler)completion
 {
@@ -554,6 +686,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     
     // Do we have a cached result that is unexpired?
     if ([self.notebooksCache count] > 0 && ([self.notebooksCacheDate timeIntervalSinceNow] * -1.0) < ENSessionNotebooksCacheValidity) {
+        [ENSDKTraceCurrentSpan() addInstantEventWithName:@"notebooksCache hit" category:@"cache"];
         completion(self.notebooksCache, nil);
         return;
     }
@@ -563,7 +696,10 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     ENSessionListNotebooksContext * context = [[ENSessionListNotebooksContext alloc] init];
     context.completion = completion;
     context.resultNotebooks = [[NSMutableArray alloc] init];
-    [self listNotebooks_listNotebooksWithContext:context];
+    context.span = [ENSDKSpan spanWithName:@"listNotebooks"];
+    context.cancellationToken = [ENCancellationToken currentToken];
+    context.requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
+    [self listNotebooks_checkLocalStoreWithContext:context];
 }
 
 - (void)listWritableNotebooksWithCompletion:(ENSessionListNotebooksCompletionHandler)completion
@@ -579,8 +715,33 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     }];
 }
 
+- (void)listNotebooks_checkLocalStoreWithContext:(ENSessionListNotebooksContext *)context
+{
+    ENSessionStepScope(context);
+    if (!self.syncEngine) {
+        [self listNotebooks_listNotebooksWithContext:context];
+        return;
+    }
+    [self.syncEngine fetchListedNotebooksWithCompletion:^(NSArray *notebooks, NSDictionary *updateCounts, NSError *error) {
+        if (notebooks) {
+            [context.span addInstantEventWithName:@"localStore hit" category:@"cache"];
+            [context.resultNotebooks addObjectsFromArray:notebooks];
+            [self listNotebooks_completeWithContext:context error:nil];
+            return;
+        }
+        if (error) {
+            // Not worth failing over; the full listing will report the same problem if it's real.
+            ENSDKLog(Info, Sync, @"Could not check the local store for notebooks: %@", error);
+        } else {
+            context.localStoreUpdateCounts = updateCounts;
+        }
+        [self listNotebooks_listNotebooksWithContext:context];
+    }];
+}
+
 - (void)listNotebooks_listNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     [self.primaryNoteStore listNotebooksWithCompletion:^(NSArray * notebooks, NSError *error) {
         if (error) {
             if ([self isErrorDueToRestrictedAuth:error]) {
@@ -605,6 +766,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_listSharedNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     [self.primaryNoteStore listSharedNotebooksWithCompletion:^(NSArray * sharedNotebooks, NSError *error) {
         if (error) {
             ENSDKLogError(@"Error from listSharedNotebooks in user's store: %@", error);
@@ -617,6 +779,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_listLinkedNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     [self.primaryNoteStore listLinkedNotebooksWithCompletion:^(NSArray *linkedNotebooks, NSError *error) {
         if (error) {
             if ([self isErrorDueToRestrictedAuth:error]) {
@@ -645,6 +808,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_fetchSharedBusinessNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     [self.businessNoteStore listSharedNotebooksWithCompletion:^(NSArray *sharedNotebooks, NSError *error) {
         if (error) {
             ENSDKLogError(@"Error from listSharedNotebooks in business store: %@", error);
@@ -668,6 +832,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_fetchBusinessNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     [self.businessNoteStore listNotebooksWithCompletion:^(NSArray *notebooks, NSError *error) {
         if (error) {
             ENSDKLogError(@"Error from listNotebooks in business store: %@", error);
@@ -686,6 +851,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_processBusinessNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     // Postprocess our notebook sets for business notebooks. For every linked notebook in the personal
     // account, check for a corresponding business shared notebook (by shareKey). If we find it, also
     // grab its corresponding notebook object from the business notebook list.
@@ -712,6 +878,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_fetchSharedNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     // Fetch shared notebooks for any non-business linked notebooks remaining in the
     // array in the context. We will have already pulled out the linked notebooks that
     // were processed for business.
@@ -729,6 +896,9 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
                     [self listNotebooks_completePendingSharedNotebookWithContext:context];
                     return;
                 }
+                ENSDKTraceScope(context.span.currentStep);
+                ENCancellationTokenScope(context.cancellationToken);
+                ENRequestPriorityScope(context.requestPriority);
                 [noteStore fetchPublicNotebookWithUserID:[[info userId] intValue]
                                                publicURI:linkedNotebook.uri
                                                completion:^(EDAMNotebook *sharedNotebook, NSError *fetchError) {
@@ -770,6 +940,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_processSharedNotebooksWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     // Process the results
     for (EDAMLinkedNotebook * linkedNotebook in context.linkedPersonalNotebooks) {
         id sharedNotebook = [context.sharedNotebooks objectForKey:linkedNotebook.guid];
@@ -789,6 +960,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)listNotebooks_prepareResultsWithContext:(ENSessionListNotebooksContext *)context
 {
+    ENSessionStepScope(context);
     // If there's only one notebook, and it's not flagged as the default notebook for the account, then
     // we must be in a single-notebook auth scenario. In this case, simply override the flag so to a caller it
     // will appear to be the default anyway. Note that we only do this if it's not already the default. If a single
@@ -812,9 +984,21 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 - (void)listNotebooks_completeWithContext:(ENSessionListNotebooksContext *)context
                                     error:(NSError *)error
 {
-    self.notebooksCache = context.resultNotebooks;
-    self.notebooksCacheDate = [NSDate date];
+    if (!error && context.cancellationToken.isCancelled) {
+        // Steps that carry on past a failed call may have left out what a cancelled call would have found.
+        error = context.cancellationToken.error;
+    }
+    // A list cut short by an error, cancellation included, is not kept for the next caller.
+    if (!error) {
+        self.notebooksCache = context.resultNotebooks;
+        self.notebooksCacheDate = [NSDate date];
+    }
+    // A list that left out notebooks that failed to load is not stored.
+    if (!error && !context.error && context.localStoreUpdateCounts) {
+        [self.syncEngine setListedNotebooks:context.resultNotebooks updateCounts:context.localStoreUpdateCounts];
+    }
     
+    [context.span finishWithError:error];
     context.completion(context.resultNotebooks, error);
 }
 
@@ -886,22 +1070,52 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     }
     
     ENSessionUploadNoteContext * context = [[ENSessionUploadNoteContext alloc] init];
-    if (noteToReplace) {
-        context.note = [note EDAMNoteToReplaceServiceNoteGUID:noteToReplace.guid];
-    } else {
-        context.note = [note EDAMNote];
-    }
+    context.sourceNote = note;
     context.refToReplace = noteToReplace;
     context.notebook = notebook;
     context.policy = policy;
     context.completion = completion;
     context.progress = progress;
+    context.span = [ENSDKSpan spanWithName:@"uploadNote"];
+    context.cancellationToken = [ENCancellationToken currentToken];
+    context.requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
     
+    [self uploadNote_prepareNoteWithContext:context];
+}
+
+- (void)uploadNote_prepareNoteWithContext:(ENSessionUploadNoteContext *)context
+{
+    ENSessionStepScope(context);
+    // A downloaded note's resources may still be on the service. They go up as their hash alone only
+    // when replacing that same note; a new note, or another one, needs their data.
+    if (![context.sourceNote needsResourceDataToReplaceServiceNoteGUID:context.refToReplace.guid]) {
+        [self uploadNote_convertNoteWithContext:context];
+        return;
+    }
+    [context.sourceNote loadResourceDataWithCompletion:^(NSError * error) {
+        if (error) {
+            ENSDKLogError(@"Failed to load resource data for uploadNote: %@", error);
+            [self uploadNote_completeWithContext:context error:error];
+            return;
+        }
+        [self uploadNote_convertNoteWithContext:context];
+    }];
+}
+
+- (void)uploadNote_convertNoteWithContext:(ENSessionUploadNoteContext *)context
+{
+    ENSessionStepScope(context);
+    if (context.refToReplace) {
+        context.note = [context.sourceNote EDAMNoteToReplaceServiceNoteGUID:context.refToReplace.guid];
+    } else {
+        context.note = [context.sourceNote EDAMNote];
+    }
     [self uploadNote_determineDestinationWithContext:context];
 }
 
 - (void)uploadNote_determineDestinationWithContext:(ENSessionUploadNoteContext *)context
 {
+    ENSessionStepScope(context);
     // Begin prepping a resulting note ref.
     context.noteRef = [[ENNoteRef alloc] init];
     
@@ -955,6 +1169,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)uploadNote_updateWithContext:(ENSessionUploadNoteContext *)context
 {
+    ENSessionStepScope(context);
     // If we're replacing a note, fixup the update date.
     context.note.updated = @([[NSDate date] edamTimestamp]);
     
@@ -974,6 +1189,12 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
                     context.note.guid = nil;
                     context.policy = ENSessionUploadPolicyCreate;
                     context.refToReplace = nil;
+                    if ([context.sourceNote needsResourceDataToReplaceServiceNoteGUID:nil]) {
+                        // The note was written to replace the one it came from, with resources as their
+                        // hash alone. A new note needs their data.
+                        [self uploadNote_prepareNoteWithContext:context];
+                        return;
+                    }
 
                     // Go back to determining the destination before creating. We'll take into account a supplied
                     // notebook at this point, which may actually be in a different place than the note we were
@@ -998,6 +1219,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)uploadNote_findLinkedAppNotebookWithContext:(ENSessionUploadNoteContext *)context
 {
+    ENSessionStepScope(context);
     // We know the app notebook is linked. List linked notebooks; we expect to find a single result.
     [self.primaryNoteStore listLinkedNotebooksWithCompletion:^(NSArray * linkedNotebooks, NSError *listError) {
         if (listError) {
@@ -1035,6 +1257,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)uploadNote_findSharedAppNotebookWithContext:(ENSessionUploadNoteContext *)context
 {
+    ENSessionStepScope(context);
     EDAMLinkedNotebook * linkedNotebook = [self.preferences decodedObjectForKey:ENSessionPreferencesLinkedAppNotebook];
     ENNoteStoreClient * linkedNoteStore = [self noteStoreForLinkedNotebook:linkedNotebook];
     [linkedNoteStore fetchSharedNotebookByAuthWithCompletion:^(EDAMSharedNotebook *sharedNotebook, NSError *fetchError) {
@@ -1063,6 +1286,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)uploadNote_createWithContext:(ENSessionUploadNoteContext *)context
 {
+    ENSessionStepScope(context);
     // Clear create and update dates. The service will set these to sensible defaults for a new note.
     context.note.created = context.note.updated = nil;
     
@@ -1093,6 +1317,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 #if EN_PROGRESS_HANDLERS_ENABLED
     context.noteStore.uploadProgressHandler = nil;
 #endif
+    [context.span finishWithError:error];
     if (context.completion) {
         context.completion(error ? nil : context.noteRef, error);
     }
@@ -1255,6 +1480,9 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     context.findMetadataResults = [[NSMutableArray alloc] init];
     context.requiresLocalMerge = requiresLocalMerge;
     context.sortAscending = sortAscending;
+    context.span = [ENSDKSpan spanWithName:@"findNotes"];
+    context.cancellationToken = [ENCancellationToken currentToken];
+    context.requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
     
     // If we have a scope notebook, we already know what notebook the results will appear in.
     // If we don't have a scope notebook, then we need to query for all the notebooks to determine
@@ -1265,11 +1493,12 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     }
     
     // Go directly to the next step.
-    [self findNotes_findInPersonalScopeWithContext:context];
+    [self findNotes_findInLocalStoreWithContext:context];
 }
 
 - (void)findNotes_listNotebooksWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     // XXX: We do the full listNotebooks operation here, which is overkill in all situations,
     // and could wind us up doing a bunch of extra work. Optimization is to only look at -listNotebooks
     // if we're personal scope, and -listLinkedNotebooks for linked and business, without ever
@@ -1280,7 +1509,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     [self listNotebooksWithCompletion:^(NSArray *notebooks, NSError *listNotebooksError) {
         if (notebooks) {
             context.allNotebooks = notebooks;
-            [self findNotes_findInPersonalScopeWithContext:context];
+            [self findNotes_findInLocalStoreWithContext:context];
         } else {
             ENSDKLogError(@"findNotes: Failed to list notebooks. %@", listNotebooksError);
             [self findNotes_completeWithContext:context error:listNotebooksError];
@@ -1288,8 +1517,65 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     }];
 }
 
+- (void)findNotes_findInLocalStoreWithContext:(ENSessionFindNotesContext *)context
+{
+    ENSessionStepScope(context);
+    // The local store evaluates only part of the search grammar; other searches go to the service. Nor
+    // does it hold the business notebooks the user hasn't joined, which a business scope search covers.
+    BOOL searchesBusiness = (!context.scopeNotebook && EN_FLAG_ISSET(context.scope, ENSessionSearchScopeBusiness) && [self isBusinessUser]);
+    ENNoteSearchQuery * query = [ENNoteSearchQuery queryWithSearchString:context.noteFilter.words ?: @""];
+    // Without the notes' text, words are left unknown for nearly every note, so don't pay to find that out.
+    BOOL lacksNoteText = (query.matchesNoteText && !self.syncEngine.indexesNoteText);
+    if (!self.syncEngine || !query || searchesBusiness || lacksNoteText) {
+        [self findNotes_findInPersonalScopeWithContext:context];
+        return;
+    }
+    
+    // The same scopes the service searches would be: see the steps below.
+    BOOL includePersonal = NO;
+    NSMutableArray * linkedNotebooks = [[NSMutableArray alloc] init];
+    if (context.scopeNotebook) {
+        if (context.scopeNotebook.isLinked) {
+            [linkedNotebooks addObject:context.scopeNotebook.linkedNotebook];
+        } else {
+            includePersonal = YES;
+        }
+    } else {
+        includePersonal = EN_FLAG_ISSET(context.scope, ENSessionSearchScopePersonal) && ![self appNotebookIsLinked];
+        if (EN_FLAG_ISSET(context.scope, ENSessionSearchScopePersonalLinked)) {
+            for (ENNotebook * notebook in context.allNotebooks) {
+                if (notebook.isLinked && !notebook.isBusinessNotebook) {
+                    [linkedNotebooks addObject:notebook.linkedNotebook];
+                }
+            }
+        }
+    }
+    
+    [self.syncEngine fetchCurrentNoteMetadataInPersonalScope:includePersonal linkedNotebooks:linkedNotebooks matchingQuery:query completion:^(NSArray *metadata) {
+        if (!metadata) {
+            [self findNotes_findInPersonalScopeWithContext:context];
+            return;
+        }
+        [context.span addInstantEventWithName:@"localStore hit" category:@"cache"];
+        for (EDAMNoteMetadata * noteMetadata in metadata) {
+            if (!context.scopeNotebook || [noteMetadata.notebookGuid isEqualToString:context.scopeNotebook.guid]) {
+                [context.findMetadataResults addObject:noteMetadata];
+            }
+        }
+        // The store's notes come in no order, so they always need the sort the service would have done.
+        // There is no relevance to sort by locally; update date stands in, as it does across scopes.
+        if (EN_FLAG_ISSET(context.sortOrder, ENSessionSortOrderRelevance)) {
+            EN_FLAG_CLEAR(context.sortOrder, ENSessionSortOrderRelevance);
+            EN_FLAG_SET(context.sortOrder, ENSessionSortOrderRecentlyUpdated);
+        }
+        context.requiresLocalMerge = YES;
+        [self findNotes_processResultsWithContext:context];
+    }];
+}
+
 - (void)findNotes_findInPersonalScopeWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     BOOL skipPersonalScope = NO;
     // Skip the personal scope if the scope notebook isn't personal, or if the scope
     // flag doesn't include personal.
@@ -1326,6 +1612,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)findNotes_findInBusinessScopeWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     // Skip the business scope if the user is not a business user, or the scope notebook
     // is not a business notebook, or the business scope is not included.
     if (![self isBusinessUser] ||
@@ -1360,6 +1647,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)findNotes_findInLinkedScopeWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     // Skip linked scope if scope notebook is not a personal linked notebook, or if the
     // linked scope is not included.
     if (context.scopeNotebook) {
@@ -1389,6 +1677,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)findNotes_nextFindInLinkedScopeWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     if (context.linkedNotebooksToSearch.count == 0) {
         [self findNotes_processResultsWithContext:context];
         return;
@@ -1420,6 +1709,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)findNotes_processResultsWithContext:(ENSessionFindNotesContext *)context
 {
+    ENSessionStepScope(context);
     // OK, now we have a complete list of note refs objects. If we need to do a local sort, then do so.
     if (context.requiresLocalMerge) {
         [context.findMetadataResults sortUsingComparator:^NSComparisonResult(id obj1, id obj2) {
@@ -1456,6 +1746,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     for (EDAMNoteMetadata * metadata in context.findMetadataResults) {
         ENNoteRef * ref = [[ENNoteRef alloc] init];
         ref.guid = metadata.guid;
+        ref.updateSequenceNum = [metadata.updateSequenceNum intValue];
         
         // Figure out which notebook this note belongs to. (If there's a scope notebook, it always belongs to that one.)
         ENNotebook * notebook = context.scopeNotebook ?: notebooksByGuid[metadata.notebookGuid];
@@ -1502,6 +1793,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 - (void)findNotes_completeWithContext:(ENSessionFindNotesContext *)context error:(NSError *)error
 {
+    [context.span finishWithError:error];
     if (error) {
         context.completion(nil, error);
     } else {
@@ -1514,6 +1806,23 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 - (void)downloadNote:(ENNoteRef *)noteRef
             progress:(ENSessionProgressHandler)progress
           completion:(ENSessionDownloadNoteCompletionHandler)completion
+{
+    [self downloadNote:noteRef leavingResourceData:NO prefetchPolicy:nil progress:progress completion:completion];
+}
+
+- (void)downloadNote:(ENNoteRef *)noteRef
+resourcePrefetchPolicy:(ENSessionResourcePrefetchPolicy *)prefetchPolicy
+            progress:(ENSessionProgressHandler)progress
+          completion:(ENSessionDownloadNoteCompletionHandler)completion
+{
+    [self downloadNote:noteRef leavingResourceData:YES prefetchPolicy:prefetchPolicy progress:progress completion:completion];
+}
+
+- (void)downloadNote:(ENNoteRef *)noteRef
+ leavingResourceData:(BOOL)leavesResourceData
+      prefetchPolicy:(ENSessionResourcePrefetchPolicy *)prefetchPolicy
+            progress:(ENSessionProgressHandler)progress
+          completion:(ENSessionDownloadNoteCompletionHandler)completion
 {
     if (!completion) {
         [NSException raise:NSInvalidArgumentException format:@"handler required"];
@@ -1531,29 +1840,260 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
         return;
     }
 
+    ENSessionDownloadNoteContext * context = [[ENSessionDownloadNoteContext alloc] init];
+    context.noteRef = noteRef;
+    context.leavesResourceData = leavesResourceData;
+    context.prefetchPolicy = prefetchPolicy;
+    context.completion = completion;
+    context.span = [ENSDKSpan spanWithName:@"downloadNote"];
+    context.cancellationToken = [ENCancellationToken currentToken];
+    context.requestPriority = ENRequestPriorityCurrent(ENRequestPriorityDefault);
+    ENSDKTraceScope(context.span);
+
     // Find the note store client that works with this note.
-    ENNoteStoreClient * noteStore = [self noteStoreForNoteRef:noteRef];
+    context.noteStore = [self noteStoreForNoteRef:noteRef];
 #if EN_PROGRESS_HANDLERS_ENABLED
     if (progress) {
-        noteStore.downloadProgressHandler = progress;
+        context.noteStore.downloadProgressHandler = progress;
     }
 #endif
     
-    // Fetch by guid. Always get the content and resources.
-    [noteStore fetchNoteWithGuid:noteRef.guid includingContent:YES resourceOptions:ENResourceFetchOptionIncludeData completion:^(EDAMNote * note, NSError *error) {
+    context.noteCache = self.noteCache;
+    if (context.noteCache) {
+        [self downloadNote_checkNoteCacheWithContext:context];
+    } else if (context.leavesResourceData) {
+        [self downloadNote_fetchNoteWithoutResourceDataWithContext:context];
+    } else {
+        [self downloadNote_fetchNoteWithContext:context];
+    }
+}
+
+- (void)downloadNote_checkNoteCacheWithContext:(ENSessionDownloadNoteContext *)context
+{
+    // The cache reads the disk, so look there off the main thread. A ref from a search carries the note's
+    // current USN, so a copy at that USN is good as it is. Otherwise any cached copy has to be checked
+    // against the service first.
+    NSString * guid = context.noteRef.guid;
+    int32_t updateSequenceNum = context.noteRef.updateSequenceNum;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        EDAMNote * note = nil;
+        if (updateSequenceNum > 0) {
+            note = [context.noteCache noteWithGuid:guid updateSequenceNum:updateSequenceNum];
+        } else {
+            context.cachedUpdateSequenceNum = [context.noteCache updateSequenceNumForNoteGuid:guid];
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            ENSessionStepScope(context);
+            if (context.cancellationToken.isCancelled) {
+                [self downloadNote_completeWithContext:context note:nil error:context.cancellationToken.error];
+            } else if (note) {
+                [self downloadNote_completeWithContext:context note:note error:nil];
+            } else if (context.cachedUpdateSequenceNum > 0) {
+                [self downloadNote_checkUpdateSequenceNumWithContext:context];
+            } else {
+                [self downloadNote_fetchNoteWithoutResourceDataWithContext:context];
+            }
+        });
+    });
+}
+
+- (void)downloadNote_checkUpdateSequenceNumWithContext:(ENSessionDownloadNoteContext *)context
+{
+    // Fetching the note without its content or resources costs little next to fetching it whole.
+    ENSessionStepScope(context);
+    [context.noteStore fetchNoteWithGuid:context.noteRef.guid includingContent:NO resourceOptions:0 completion:^(EDAMNote * note, NSError * error) {
+        if (error || [note.updateSequenceNum intValue] != context.cachedUpdateSequenceNum) {
+            // Any error surfaces again from the next fetch, unless it was a passing one.
+            [self downloadNote_fetchNoteWithoutResourceDataWithContext:context];
+            return;
+        }
+        NSString * guid = context.noteRef.guid;
+        int32_t updateSequenceNum = context.cachedUpdateSequenceNum;
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            EDAMNote * cachedNote = [context.noteCache noteWithGuid:guid updateSequenceNum:updateSequenceNum];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (cachedNote) {
+                    [self downloadNote_completeWithContext:context note:cachedNote error:nil];
+                } else {
+                    [self downloadNote_fetchNoteWithoutResourceDataWithContext:context];
+                }
+            });
+        });
+    }];
+}
+
+- (void)downloadNote_fetchNoteWithoutResourceDataWithContext:(ENSessionDownloadNoteContext *)context
+{
+    // The same attachment often turns up in many notes, and the cache keeps each body once by its hash.
+    // Fetch the note without resource bodies, and take whichever of them the cache already holds.
+    ENSessionStepScope(context);
+    [context.noteStore fetchNoteWithGuid:context.noteRef.guid includingContent:YES resourceOptions:0 completion:^(EDAMNote * note, NSError * error) {
         if (error) {
-#if EN_PROGRESS_HANDLERS_ENABLED
-            noteStore.downloadProgressHandler = nil;
-#endif
-            completion(nil, error);
+            [self downloadNote_completeWithContext:context note:nil error:error];
             return;
         }
-        // Create an ENNote from the EDAMNote.
-        ENNote * resultNote = [[ENNote alloc] initWithServiceNote:note];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            NSMutableArray * resourcesToFetch = [[NSMutableArray alloc] init];
+            for (EDAMResource * resource in note.resources) {
+                NSData * body = resource.data.bodyHash ? [context.noteCache resourceDataWithHash:resource.data.bodyHash] : nil;
+                if (body.length == [resource.data.size unsignedIntegerValue]) {
+                    resource.data.body = body;
+                } else {
+                    [resourcesToFetch addObject:resource];
+                }
+            }
+            dispatch_async(dispatch_get_main_queue(), ^{
+                context.note = note;
+                context.resourcesToFetch = resourcesToFetch;
+                if (context.leavesResourceData) {
+                    // The resources not cached load on demand, and join the cached note as they do.
+                    [self downloadNote_storeNoteWithContext:context note:note];
+                    [self downloadNote_completeWithContext:context note:note error:nil];
+                } else if (resourcesToFetch.count > ENSessionMaxConcurrentResourceFetches && resourcesToFetch.count == note.resources.count) {
+                    // Nothing was cached; one call for all the bodies beats one for each resource.
+                    [self downloadNote_fetchResourceDataWithContext:context];
+                } else {
+                    [self downloadNote_fetchResourcesWithContext:context];
+                }
+            });
+        });
+    }];
+}
+
+- (void)downloadNote_fetchResourceDataWithContext:(ENSessionDownloadNoteContext *)context
+{
+    // The note in hand already has its content, so fetch it again with only the resource bodies.
+    ENSessionStepScope(context);
+    [context.noteStore fetchNoteWithGuid:context.noteRef.guid includingContent:NO resourceOptions:ENResourceFetchOptionIncludeData completion:^(EDAMNote * note, NSError * error) {
+        if (error) {
+            [self downloadNote_completeWithContext:context note:nil error:error];
+            return;
+        }
+        NSMutableDictionary * bodies = [[NSMutableDictionary alloc] init];
+        for (EDAMResource * resource in note.resources) {
+            if (resource.guid && resource.data.body) {
+                bodies[resource.guid] = resource.data;
+            }
+        }
+        // A resource that changed in between is fetched by the hash the note in hand has for it.
+        NSMutableArray * resourcesToFetch = [[NSMutableArray alloc] init];
+        for (EDAMResource * resource in context.resourcesToFetch) {
+            EDAMData * data = bodies[resource.guid];
+            if (data && [data.bodyHash isEqualToData:resource.data.bodyHash]) {
+                resource.data.body = data.body;
+            } else {
+                [resourcesToFetch addObject:resource];
+            }
+        }
+        context.resourcesToFetch = resourcesToFetch;
+        [self downloadNote_fetchResourcesWithContext:context];
+    }];
+}
+
+// A few at a time, each a getResourceByHash call.
+- (void)downloadNote_fetchResourcesWithContext:(ENSessionDownloadNoteContext *)context
+{
+    ENSessionStepScope(context);
+    if (context.resourceFetchFailed) {
+        return;
+    }
+    if (context.resourcesToFetch.count == 0 && context.pendingResourceFetches == 0) {
+        [self downloadNote_storeNoteWithContext:context note:context.note];
+        [self downloadNote_completeWithContext:context note:context.note error:nil];
+        return;
+    }
+    while (context.resourcesToFetch.count > 0 && context.pendingResourceFetches < ENSessionMaxConcurrentResourceFetches) {
+        EDAMResource * resource = context.resourcesToFetch.firstObject;
+        [context.resourcesToFetch removeObjectAtIndex:0];
+        context.pendingResourceFetches++;
+        [context.noteStore fetchResourceByHashWithGuid:context.noteRef.guid contentHash:resource.data.bodyHash options:ENResourceFetchOptionIncludeData completion:^(EDAMResource * fetchedResource, NSError * error) {
+            context.pendingResourceFetches--;
+            if (context.resourceFetchFailed) {
+                return;
+            }
+            if (error) {
+                // The first failure ends the download; the fetches still in flight are left to finish.
+                context.resourceFetchFailed = YES;
+                [self downloadNote_completeWithContext:context note:nil error:error];
+                return;
+            }
+            resource.data.body = fetchedResource.data.body;
+            [self downloadNote_fetchResourcesWithContext:context];
+        }];
+    }
+}
+
+- (void)downloadNote_fetchNoteWithContext:(ENSessionDownloadNoteContext *)context
+{
+    // Fetch by guid. Always get the content and resources.
+    ENSessionStepScope(context);
+    [context.noteStore fetchNoteWithGuid:context.noteRef.guid includingContent:YES resourceOptions:ENResourceFetchOptionIncludeData completion:^(EDAMNote * note, NSError *error) {
+        if (!error) {
+            [self downloadNote_storeNoteWithContext:context note:note];
+        }
+        [self downloadNote_completeWithContext:context note:note error:error];
+    }];
+}
+
+- (void)downloadNote_storeNoteWithContext:(ENSessionDownloadNoteContext *)context note:(EDAMNote *)note
+{
+    if (context.noteCache) {
+        dispatch_async(self.noteCacheQueue, ^{
+            [context.noteCache storeNote:note];
+        });
+    }
+}
+
+- (void)downloadNote_completeWithContext:(ENSessionDownloadNoteContext *)context note:(EDAMNote *)note error:(NSError *)error
+{
 #if EN_PROGRESS_HANDLERS_ENABLED
-        noteStore.downloadProgressHandler = nil;
+    context.noteStore.downloadProgressHandler = nil;
 #endif
-        completion(resultNote, nil);
+    [context.span finishWithError:error];
+    if (error) {
+        context.completion(nil, error);
+        return;
+    }
+    if (!context.leavesResourceData) {
+        // Create an ENNote from the EDAMNote.
+        context.completion([[ENNote alloc] initWithServiceNote:note], nil);
+        return;
+    }
+    
+    // Resources without their bodies load them from the note's store when asked, and each body loaded goes
+    // to the note's cached copy.
+    ENNoteStoreClient * noteStore = context.noteStore;
+    ENNoteCache * noteCache = context.noteCache;
+    dispatch_queue_t noteCacheQueue = self.noteCacheQueue;
+    NSString * noteGuid = note.guid;
+    int32_t updateSequenceNum = [note.updateSequenceNum intValue];
+    NSMutableDictionary * hashesByResourceGuid = [[NSMutableDictionary alloc] init];
+    for (EDAMResource * resource in note.resources) {
+        if (resource.guid && resource.data.bodyHash && !resource.data.body) {
+            hashesByResourceGuid[resource.guid] = resource.data.bodyHash;
+        }
+    }
+    ENNote * resultNote = [[ENNote alloc] initWithServiceNote:note resourceDataLoader:^(NSString * resourceGuid, void (^loadCompletion)(NSData *, NSError *)) {
+        [noteStore fetchResourceDataWithGuid:resourceGuid completion:^(NSData * data, NSError * error) {
+            NSData * hash = hashesByResourceGuid[resourceGuid];
+            if (data && hash && noteCache) {
+                dispatch_async(noteCacheQueue, ^{
+                    [noteCache storeResourceData:data withHash:hash forNoteGuid:noteGuid updateSequenceNum:updateSequenceNum];
+                });
+            }
+            loadCompletion(data, error);
+        }];
+    }];
+    context.completion(resultNote, nil);
+    
+    // Start the prefetch after handing back the note, so that it does not hold up showing the content.
+    ENSessionResourcePrefetchPolicy * policy = context.prefetchPolicy;
+    [resultNote.resources enumerateObjectsUsingBlock:^(ENResource * resource, NSUInteger index, BOOL * stop) {
+        if (!resource.isDataLoaded && [policy shouldPrefetchResource:resource atIndex:index]) {
+            ENCancellationTokenScope(context.cancellationToken);
+            ENRequestPriorityScope(context.requestPriority);
+            [resource loadDataWithCompletion:^(NSData * data, NSError * error) {}];
+        }
     }];
 }
 
@@ -1586,7 +2126,15 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     }
     
     // Get over to a concurrent background queue.
+    ENCancellationToken * cancellationToken = [ENCancellationToken currentToken];
     dispatch_async(self.thumbnailQueue, ^{
+        if (cancellationToken.isCancelled) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(nil, cancellationToken.error);
+            });
+            return;
+        }
+        
         // Get the info we need for this note ref, then construct a standard request for the thumbnail.
         NSString * authToken = [self authenticationTokenForNoteRef:noteRef];
         NSString * shardId = [self shardIdForNoteRef:noteRef];
@@ -1611,30 +2159,52 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
         [request addValue:@"application/x-www-form-urlencoded;charset=UTF-8" forHTTPHeaderField:@"Content-Type"];
         [request addValue:[NSString stringWithFormat:@"%lu", (unsigned long)request.HTTPBody.length] forHTTPHeaderField:@"Content-Length"];
         [request addValue:self.sessionHost forHTTPHeaderField:@"Host"];
-        
-        NSURLResponse * response = nil;
-        NSError * error = nil;
-        NSData * thumbnailData = [NSURLConnection sendSynchronousRequest:request returningResponse:&response error:&error];
-        UIImage * thumbnail = nil;
-        if (!thumbnailData) {
-            ENSDKLogError(@"Failed to get thumb data at url %@", urlString);
-        } else {
-            thumbnail = [UIImage imageWithData:thumbnailData];
+        if (cancellationToken.deadline) {
+            request.timeoutInterval = MAX([cancellationToken.deadline timeIntervalSinceNow], 1);
         }
-        dispatch_async(dispatch_get_main_queue(), ^{
-            if (thumbnail) {
-                completion(thumbnail, nil);
+        
+        // A data task rather than a blocking request, so that cancelling stops the transfer itself and no
+        // thumbnail queue thread waits on it.
+        __block id cancellationHandler = nil;
+        NSURLSessionDataTask * task = [[NSURLSession sharedSession] dataTaskWithRequest:request completionHandler:^(NSData * thumbnailData, NSURLResponse * response, NSError * error) {
+            [cancellationToken removeCancellationHandler:cancellationHandler];
+            if (cancellationToken.isCancelled) {
+                thumbnailData = nil;
+                error = cancellationToken.error;
+            }
+            UIImage * thumbnail = nil;
+            if (!thumbnailData) {
+                ENSDKLogError(@"Failed to get thumb data at url %@", urlString);
             } else {
-                if (!error) {
-                    completion(nil, [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeUnknown userInfo:nil]);
+                thumbnail = [UIImage imageWithData:thumbnailData];
+            }
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (thumbnail) {
+                    completion(thumbnail, nil);
                 } else {
-                    completion(nil, error);                    
+                    if (!error) {
+                        completion(nil, [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeUnknown userInfo:nil]);
+                    } else {
+                        completion(nil, error);
+                    }
                 }
-            }
-        });
+            });
+        }];
+        cancellationHandler = [cancellationToken addCancellationHandler:^{
+            [task cancel];
+        }];
+        [task resume];
     });
 }
 
+#pragma mark - Request priority
+
+- (void)performWithRequestPriority:(ENRequestPriority)priority block:(void (^)(void))block
+{
+    ENRequestPriorityScope(priority);
+    block();
+}
+
 #pragma mark - Interaction with Evernote app
 
 - (BOOL)viewNoteInEvernote:(ENNoteRef *)noteRef {
@@ -1717,15 +2287,47 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 {
     NSAssert(![NSThread isMainThread], @"Cannot authenticate to business on main thread");
     EDAMAuthenticationResult * auth = [self.authCache authenticationResultForBusiness];
+    [ENSDKTraceCurrentSpan() addInstantEventWithName:(auth ? @"authCache business hit" : @"authCache business miss") category:@"auth"];
     if (!auth) {
         auth = [self.userStore authenticateToBusiness];
-        [self.authCache setAuthenticationResultForBusiness:auth];
-        self.businessUser = auth.user;
-        [self.preferences encodeObject:self.businessUser forKey:ENSessionPreferencesBusinessUser];
+        [self cacheBusinessAuthenticationResult:auth];
     }
     return auth;
 }
 
+- (void)cacheBusinessAuthenticationResult:(EDAMAuthenticationResult *)auth
+{
+    [self.authCache setAuthenticationResultForBusiness:auth];
+    self.businessUser = auth.user;
+    [self.preferences encodeObject:self.businessUser forKey:ENSessionPreferencesBusinessUser];
+}
+
+// Returns YES if the caller is the first to wait on the key's authentication, and so should start it.
+- (BOOL)addPendingAuthenticationCompletion:(void (^)(NSError *))completion forKey:(NSString *)key
+{
+    @synchronized (self.pendingAuthenticationCompletions) {
+        NSMutableArray * completions = self.pendingAuthenticationCompletions[key];
+        if (completions) {
+            [completions addObject:[completion copy]];
+            return NO;
+        }
+        self.pendingAuthenticationCompletions[key] = [NSMutableArray arrayWithObject:[completion copy]];
+        return YES;
+    }
+}
+
+- (void)completePendingAuthenticationForKey:(NSString *)key error:(NSError *)error
+{
+    NSArray * completions = nil;
+    @synchronized (self.pendingAuthenticationCompletions) {
+        completions = self.pendingAuthenticationCompletions[key];
+        [self.pendingAuthenticationCompletions removeObjectForKey:key];
+    }
+    for (void (^completion)(NSError *) in completions) {
+        completion(error);
+    }
+}
+
 - (ENAuthCache *)authCache
 {
     if (!_authCache) {
@@ -1734,6 +2336,38 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     return _authCache;
 }
 
+- (ENSyncEngine *)syncEngine
+{
+    if (!_syncEngine && enableLocalSyncStore) {
+        // The store is a cache of what the service holds, so it lives in Caches, or beside the preferences
+        // in the shared container when there is one.
+        NSURL * baseURL = nil;
+        if (SecurityApplicationGroupIdentifier) {
+            baseURL = [[NSFileManager defaultManager] containerURLForSecurityApplicationGroupIdentifier:SecurityApplicationGroupIdentifier];
+        } else {
+            baseURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] firstObject];
+        }
+        _syncEngine = [[ENSyncEngine alloc] initWithSession:self directoryURL:[baseURL URLByAppendingPathComponent:ENSessionSyncStoreDirectoryName]];
+        _syncEngine.indexesNoteText = enableLocalSearchIndex;
+    }
+    return _syncEngine;
+}
+
+- (ENNoteCache *)noteCache
+{
+    if (!_noteCache && noteCacheSizeLimit > 0) {
+        // Like the sync store, a cache of what the service holds.
+        NSURL * baseURL = nil;
+        if (SecurityApplicationGroupIdentifier) {
+            baseURL = [[NSFileManager defaultManager] containerURLForSecurityApplicationGroupIdentifier:SecurityApplicationGroupIdentifier];
+        } else {
+            baseURL = [[[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask] firstObject];
+        }
+        _noteCache = [[ENNoteCache alloc] initWithDirectoryURL:[baseURL URLByAppendingPathComponent:ENSessionNoteCacheDirectoryName] sizeLimit:noteCacheSizeLimit];
+    }
+    return _noteCache;
+}
+
 - (void)notifyAuthenticationChanged
 {
     if (self.isAuthenticated) {
@@ -1843,7 +2477,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
             token = [self authenticationTokenForLinkedNotebookRef:noteRef.linkedNotebook];
         }
     } @catch (NSException * e) {
-        ENSDKLogError(@"Caught exception getting auth token for note ref %@: %@", noteRef, e);
+        ENSDKLog(Error, Auth, @"Caught exception getting auth token for note ref %@: %@", noteRef, e);
         token = nil;
     }
     
@@ -1872,9 +2506,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 {
     // If the host string includes an explict port (e.g., foo.bar.com:8080), use http. Otherwise https.
     // Use a simple regex to check for a colon and port number suffix.
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:@".*:[0-9]+"
-                                                                           options:NSRegularExpressionCaseInsensitive
-                                                                             error:nil];
+    NSRegularExpression *regex = [NSRegularExpression enCachedRegexWithPattern:@".*:[0-9]+"];
     NSUInteger numberOfMatches = [regex numberOfMatchesInString:self.sessionHost
                                                         options:0
                                                           range:NSMakeRange(0, [self.sessionHost length])];
@@ -1897,6 +2529,26 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     return auth.noteStoreUrl;
 }
 
+// Warms the auth cache with an asynchronous call, so that the getters above find the result there
+// instead of blocking a work queue thread on the round trip.
+- (BOOL)prepareAuthenticationForBusinessStoreClient:(ENBusinessNoteStoreClient *)client orNotifyWithCompletion:(void (^)(NSError *))completion
+{
+    ENUserStoreClient * userStore = self.userStore;
+    if (!userStore || [self.authCache authenticationResultForBusiness]) {
+        return YES;
+    }
+    NSString * key = @"business";
+    if ([self addPendingAuthenticationCompletion:completion forKey:key]) {
+        [userStore authenticateToBusinessWithCompletion:^(EDAMAuthenticationResult * authenticationResult, NSError * error) {
+            if (authenticationResult) {
+                [self cacheBusinessAuthenticationResult:authenticationResult];
+            }
+            [self completePendingAuthenticationForKey:key error:error];
+        }];
+    }
+    return NO;
+}
+
 #pragma mark - ENLinkedNoteStoreClientDelegate
 
 - (NSString *)authenticationTokenForLinkedNotebookRef:(ENLinkedNotebookRef *)linkedNotebookRef
@@ -1910,6 +2562,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     
     // See if we have auth data already for this notebook.
     EDAMAuthenticationResult * auth = [self.authCache authenticationResultForLinkedNotebookGuid:linkedNotebookRef.guid];
+    [ENSDKTraceCurrentSpan() addInstantEventWithName:(auth ? @"authCache linked hit" : @"authCache linked miss") category:@"auth"];
     if (!auth) {
         // Create a temporary note store client for the linked note store, with our primary auth token,
         // in order to authenticate to the shared notebook.
@@ -1920,6 +2573,26 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
     return auth.authenticationToken;
 }
 
+// Like the business one, warms the auth cache without blocking.
+- (BOOL)prepareAuthenticationForLinkedNotebookRef:(ENLinkedNotebookRef *)linkedNotebookRef orNotifyWithCompletion:(void (^)(NSError *))completion
+{
+    if (linkedNotebookRef.sharedNotebookGlobalId == nil ||
+        [self.authCache authenticationResultForLinkedNotebookGuid:linkedNotebookRef.guid]) {
+        return YES;
+    }
+    NSString * key = [@"linked:" stringByAppendingString:linkedNotebookRef.guid];
+    if ([self addPendingAuthenticationCompletion:completion forKey:key]) {
+        ENNoteStoreClient * linkedNoteStore = [ENNoteStoreClient noteStoreClientWithUrl:linkedNotebookRef.noteStoreUrl authenticationToken:self.primaryAuthenticationToken];
+        [linkedNoteStore authenticateToSharedNotebook:linkedNotebookRef.sharedNotebookGlobalId completion:^(EDAMAuthenticationResult * result, NSError * error) {
+            if (result) {
+                [self.authCache setAuthenticationResult:result forLinkedNotebookGuid:linkedNotebookRef.guid];
+            }
+            [self completePendingAuthenticationForKey:key error:error];
+        }];
+    }
+    return NO;
+}
+
 #pragma mark - ENAuthenticatorDelegate
 
 - (ENUserStoreClient *)userStoreClientForBootstrapping
@@ -1952,7 +2625,7 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 - (void)storeClientFailedAuthentication:(NSNotification *)notification
 {
     if (notification.object == [self primaryNoteStore]) {
-        ENSDKLogError(@"Primary note store operation failed authentication. Unauthenticating.");
+        ENSDKLog(Error, Auth, @"Primary note store operation failed authentication. Unauthenticating.");
         [self unauthenticate];
     }
 }
@@ -1998,6 +2671,29 @@ static BOOL disableRefreshingNotebooksCacheOnLaunch;
 
 #pragma mark - Local class definitions
 
+@implementation ENSessionResourcePrefetchPolicy
++ (instancetype)policyWithFirstResourceCount:(NSUInteger)count mimeTypePrefixes:(NSArray *)mimeTypePrefixes
+{
+    ENSessionResourcePrefetchPolicy * policy = [[ENSessionResourcePrefetchPolicy alloc] init];
+    policy.firstResourceCount = count;
+    policy.mimeTypePrefixes = mimeTypePrefixes;
+    return policy;
+}
+
+- (BOOL)shouldPrefetchResource:(ENResource *)resource atIndex:(NSUInteger)index
+{
+    if (index < self.firstResourceCount) {
+        return YES;
+    }
+    for (NSString * prefix in self.mimeTypePrefixes) {
+        if ([resource.mimeType.lowercaseString hasPrefix:prefix.lowercaseString]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+@end
+
 @implementation ENSessionFindNotesResult
 - (NSString *)description
 {
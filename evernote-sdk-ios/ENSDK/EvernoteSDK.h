@@ -34,6 +34,8 @@
 #import "ENResource.h"
 #import "ENError.h"
 #import "ENSession.h"
+#import "ENCancellationToken.h"
+#import "ENRequestPriority.h"
 #import "ENCommonUtils.h"
 #import "ENSDKLogging.h"
 
@@ -54,6 +56,7 @@
 #import "NSDate+EDAMAdditions.h"
 #import "ENEncryptedContentInfo.h"
 #import "ENMIMEUtils.h"
+#import "ENURLUtils.h"
 #import "ENMLWriter.h"
 #import "ENXMLDTD.h"
 #import "ENXMLUtils.h"
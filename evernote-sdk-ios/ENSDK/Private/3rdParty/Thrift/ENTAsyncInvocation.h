@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENTTransport.h"
+
+// Runs a block of Thrift calls without keeping a thread waiting on the network.
+//
+// When a call sends its request through an ENTAsyncTransport, the rest of the block runs on with every
+// call returning nil at once and nothing more sent. Once the response arrives the block is run again from
+// the start: calls that already completed return their earlier results (or throw their earlier
+// exceptions) without being sent again, and the call that was waiting reads its response. A block that
+// makes N network calls therefore runs N + 1 times, so it must only make calls and return what they give
+// it, without other side effects. Calls through transports that are not asynchronous block as usual.
+@interface ENTAsyncInvocation : NSObject
+
+- (id) initWithBlock: (void (^)(void)) block;
+
+// Anything the caller wants reachable from inside the block through +currentInvocation.
+@property (strong, nonatomic) id context;
+
+// Runs the block on the calling thread. Returns YES if it ran to completion, or NO if it is waiting
+// for a response, in which case resumeHandler is called on an arbitrary thread once the response has
+// arrived (never before this method returns) and the invocation should be run again. Exceptions from
+// the block propagate.
+//
+// Every run starts the block again from the top, and the calls it makes are matched to earlier
+// responses by their order. So whatever the block does before the call it waits on is done again on
+// each run, and must come out the same: state it reads or changes along the way (a cache lookup, a
+// counter) must not change which calls it makes, or they stop lining up with the recorded responses.
+- (BOOL) runWithResumeHandler: (void (^)(void)) resumeHandler;
+
+// Aborts the request the invocation is waiting on or blocked in, if any, and makes every call it makes
+// afterwards throw instead of being sent. Calls that already completed keep their results, so a block
+// that had finished its last call still completes. May be called from any thread.
+- (void) cancel;
+
+@property (assign, readonly, getter=isCancelled) BOOL cancelled;
+
+// When YES, a call the service answers with an exception (one the method declares, or an application
+// exception) returns nil instead of throwing it, and the exception becomes the invocation's
+// serviceException: every call after it returns nil without being sent, as while waiting, and the block
+// runs on to its end. Nothing is unwound for an expected error such as a note not being found.
+// Transport failures and cancellation still throw. Defaults to NO.
+@property (assign, nonatomic) BOOL returnsServiceExceptions;
+
+// The exception the failed call was answered with, when returnsServiceExceptions is on.
+@property (strong, readonly, nonatomic) NSException *serviceException;
+
+// The name of the first call the block made, such as "getNote", or nil if it made none.
+@property (readonly, nonatomic) NSString *firstMessageName;
+
+// Called on the decoding thread after each field of a struct in a response is read onto its object, with
+// the object and the field's index. Lets the caller act on a leading field of a large response before
+// the rest of it is decoded. Set it from inside the block; it must be cheap and must not throw.
+@property (copy, nonatomic) void (^fieldReadHandler)(id object, int fieldIndex);
+
+// The invocation being run on the calling thread, if any.
++ (ENTAsyncInvocation *) currentInvocation;
+
+// Runs the block outside the current invocation, so calls it makes block as they would anywhere else.
+// For synchronous helpers that are called from inside a store client block.
++ (id) performSynchronously: (id (^)(void)) block;
+
+// ENTProtocolUtil calls these around each call made while the invocation runs.
+
+// Returns YES if the request should not be written: the invocation is waiting, or this call has already
+// been sent. In the latter case the transport is ready to read the response.
+- (BOOL) beginCall: (NSString *) messageName onTransport: (id <ENTTransport>) transport;
+
+// Flushes the request just written. Returns YES if the response is ready to read, and NO if the
+// invocation is now waiting for it.
+- (BOOL) flushTransport: (id <ENTTransport>) transport;
+
+// Returns YES if the response should not be read, with the result (or the service exception) to
+// return instead.
+- (BOOL) takeResult: (id *) result exception: (NSException **) exception;
+
+- (void) finishCallWithResult: (id) result
+                    exception: (NSException *) exception;
+
+@end
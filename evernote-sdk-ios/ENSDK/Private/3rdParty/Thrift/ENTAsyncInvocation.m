@@ -0,0 +1,265 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import <pthread.h>
+#import "ENTAsyncInvocation.h"
+#import "ENStoreClientMetricsInternal.h"
+
+@interface ENTAsyncCall : NSObject
+
+@property (copy, nonatomic) NSString *messageName;
+@property (assign, nonatomic) BOOL finished;
+@property (strong, nonatomic) id result;
+@property (strong, nonatomic) NSException *resultException;
+
+// Set when an asynchronous send completes.
+@property (strong, nonatomic) NSData *response;
+@property (assign, nonatomic) NSUInteger requestLength;
+@property (strong, nonatomic) NSException *transportException;
+
+@end
+
+@implementation ENTAsyncCall
+@end
+
+static pthread_key_t ENTAsyncInvocationKey(void) {
+  static pthread_key_t key;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    pthread_key_create(&key, NULL);
+  });
+  return key;
+}
+
+@interface ENTAsyncInvocation()
+
+@property (copy, nonatomic) void (^block)(void);
+@property (copy, nonatomic) void (^resumeHandler)(void);
+@property (strong, nonatomic) NSMutableArray *calls;
+@property (strong, nonatomic) ENTAsyncCall *currentCall;
+@property (assign, nonatomic) NSUInteger callIndex;
+@property (assign, nonatomic) BOOL waiting;
+@property (assign, nonatomic) BOOL running;
+@property (assign, nonatomic) BOOL responded;
+@property (assign, readwrite) BOOL cancelled;
+@property (strong, readwrite, nonatomic) NSException *serviceException;
+// The transport whose request is on the network, for -cancel.
+@property (strong, nonatomic) id <ENTTransport> transportInFlight;
+
+@end
+
+@implementation ENTAsyncInvocation
+
+- (id) initWithBlock: (void (^)(void)) block {
+  self = [super init];
+  if (self != nil) {
+    self.block = block;
+    self.calls = [[NSMutableArray alloc] init];
+  }
+  return self;
+}
+
++ (ENTAsyncInvocation *) currentInvocation {
+  return (__bridge ENTAsyncInvocation *) pthread_getspecific(ENTAsyncInvocationKey());
+}
+
++ (id) performSynchronously: (id (^)(void)) block {
+  pthread_key_t key = ENTAsyncInvocationKey();
+  void * previous = pthread_getspecific(key);
+  pthread_setspecific(key, NULL);
+  @try {
+    return block();
+  }
+  @finally {
+    pthread_setspecific(key, previous);
+  }
+}
+
+- (BOOL) runWithResumeHandler: (void (^)(void)) resumeHandler {
+  @synchronized(self) {
+    self.resumeHandler = resumeHandler;
+    self.running = YES;
+    self.responded = NO;
+  }
+  self.callIndex = 0;
+  self.currentCall = nil;
+  self.waiting = NO;
+
+  // The caller holds the invocation while it runs, so the thread slot need not retain it.
+  pthread_key_t key = ENTAsyncInvocationKey();
+  void * previous = pthread_getspecific(key);
+  pthread_setspecific(key, (__bridge void *) self);
+  @try {
+    self.block();
+  }
+  @finally {
+    pthread_setspecific(key, previous);
+    self.currentCall = nil;
+    [self finishRun];
+  }
+  return !self.waiting;
+}
+
+- (void) finishRun {
+  void (^resumeHandler)(void) = nil;
+  @synchronized(self) {
+    self.running = NO;
+    if (!self.waiting) {
+      self.resumeHandler = nil;
+    }
+    else if (self.responded) {
+      // The response came back before the run ended.
+      resumeHandler = self.resumeHandler;
+      self.resumeHandler = nil;
+    }
+  }
+  if (resumeHandler != nil) {
+    resumeHandler();
+  }
+}
+
+- (void) cancel {
+  id <ENTTransport> transport = nil;
+  @synchronized(self) {
+    self.cancelled = YES;
+    transport = self.transportInFlight;
+  }
+  [transport cancel];
+}
+
+- (void) throwIfCancelled {
+  if (self.cancelled) {
+    @throw [ENTTransportException exceptionWithReason: @"Call was cancelled"];
+  }
+}
+
+- (void) callDidRespond {
+  void (^resumeHandler)(void) = nil;
+  @synchronized(self) {
+    self.transportInFlight = nil;
+    self.responded = YES;
+    if (!self.running) {
+      resumeHandler = self.resumeHandler;
+      self.resumeHandler = nil;
+    }
+  }
+  if (resumeHandler != nil) {
+    resumeHandler();
+  }
+}
+
+- (NSString *) firstMessageName {
+  ENTAsyncCall *call = self.calls.firstObject;
+  return call.messageName;
+}
+
+- (BOOL) beginCall: (NSString *) messageName onTransport: (id <ENTTransport>) transport {
+  if (self.waiting || self.serviceException != nil) {
+    return YES;
+  }
+
+  NSUInteger index = self.callIndex++;
+  if (index == self.calls.count) {
+    [self throwIfCancelled];
+    self.currentCall = [[ENTAsyncCall alloc] init];
+    self.currentCall.messageName = messageName;
+    [self.calls addObject: self.currentCall];
+    return NO;
+  }
+
+  ENTAsyncCall * call = self.calls[index];
+  self.currentCall = call;
+  if (call.finished) {
+    return YES;
+  }
+
+  // This is the call the last run waited for.
+  ENStoreClientMetricsCallMark(ENStoreClientMetricsPhaseReceived);
+  ENStoreClientMetricsCallAddBytes(call.requestLength, call.response.length);
+  NSException * exception = call.transportException;
+  NSData * response = call.response;
+  call.transportException = nil;
+  call.response = nil;
+  if (exception != nil) {
+    @throw exception;
+  }
+  [(id <ENTAsyncTransport>) transport resetWithResponse: response];
+  return YES;
+}
+
+- (BOOL) flushTransport: (id <ENTTransport>) transport {
+  if (![transport conformsToProtocol: @protocol(ENTAsyncTransport)]) {
+    @synchronized(self) {
+      [self throwIfCancelled];
+      self.transportInFlight = transport;
+    }
+    @try {
+      [transport flush];
+    }
+    @finally {
+      @synchronized(self) {
+        self.transportInFlight = nil;
+      }
+    }
+    return YES;
+  }
+
+  ENTAsyncCall * call = self.currentCall;
+  // Sent under the lock so that a -cancel racing with the send still finds the request to abort.
+  @synchronized(self) {
+    [self throwIfCancelled];
+    self.waiting = YES;
+    self.transportInFlight = transport;
+    [(id <ENTAsyncTransport>) transport sendRequestWithCompletion: ^(NSData * response, NSUInteger requestLength, NSException * exception) {
+      call.response = response;
+      call.requestLength = requestLength;
+      call.transportException = exception;
+      [self callDidRespond];
+    }];
+  }
+  return NO;
+}
+
+- (BOOL) takeResult: (id *) result exception: (NSException **) exception {
+  if (self.waiting || self.serviceException != nil) {
+    *result = nil;
+    return YES;
+  }
+  ENTAsyncCall * call = self.currentCall;
+  if (call == nil || !call.finished) {
+    return NO;
+  }
+  *result = call.result;
+  *exception = call.resultException;
+  return YES;
+}
+
+- (void) finishCallWithResult: (id) result
+                    exception: (NSException *) exception
+{
+  ENTAsyncCall * call = self.currentCall;
+  call.finished = YES;
+  call.result = result;
+  call.resultException = exception;
+  if (exception != nil && self.returnsServiceExceptions) {
+    self.serviceException = exception;
+  }
+}
+
+@end
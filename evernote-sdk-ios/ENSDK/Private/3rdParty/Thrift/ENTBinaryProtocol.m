@@ -18,10 +18,15 @@
  */
 
 #import "ENTBinaryProtocol.h"
+#import "ENTUTF8String.h"
 
 int32_t VERSION_1 = 0x80010000;
 int32_t VERSION_MASK = 0xffff0000;
 
+// Strings at least this long, in practice note content, are read as ENTUTF8Strings and left as UTF-8
+// until something asks for their characters. Shorter ones are decoded at once, as most are used that way.
+static int ENTBinaryProtocolUTF8StringMinimumSize = 16 * 1024;
+
 @interface ENTBinaryProtocol()
 
 @property (strong, nonatomic) id <ENTTransport> transport;
@@ -61,6 +66,10 @@ int32_t VERSION_MASK = 0xffff0000;
   
   [self.transport readAll: (uint8_t *) buffer offset: 0 length: size];
   buffer[size] = 0;
+  if (size >= ENTBinaryProtocolUTF8StringMinimumSize) {
+    NSData * data = [[NSData alloc] initWithBytesNoCopy: buffer length: size freeWhenDone: YES];
+    return [[ENTUTF8String alloc] initWithUTF8Data: data];
+  }
   NSString * result = [[NSString alloc] initWithBytesNoCopy:buffer length:size encoding:NSUTF8StringEncoding freeWhenDone:YES];
   return result;
 }
@@ -343,7 +352,10 @@ int32_t VERSION_MASK = 0xffff0000;
 }
 
 - (void) writeString: (NSString *) value {
-  if (value != nil) {
+  if ([value isKindOfClass: [ENTUTF8String class]]) {
+    [self writeBinary: [(ENTUTF8String *) value UTF8Data]];
+  }
+  else if (value != nil) {
     const char * utf8Bytes = [value UTF8String];
     int length = (int)strlen(utf8Bytes);
     [self writeI32: length];
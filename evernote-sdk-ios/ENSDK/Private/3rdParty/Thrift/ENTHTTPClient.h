@@ -20,7 +20,10 @@
 #import <Foundation/Foundation.h>
 #import "ENTTransport.h"
 
-@interface ENTHTTPClient : NSObject <ENTTransport>
+// Requests go through a shared NSURLSession. Flushes block until the response arrives; sends through
+// ENTAsyncTransport complete on the session's delegate queue without holding a thread. -cancel aborts
+// the request in flight, which then fails with a transport exception.
+@interface ENTHTTPClient : NSObject <ENTAsyncTransport>
 
 - (id) initWithURL:(NSURL *)aURL;
 
@@ -18,6 +18,7 @@
  */
 
 #import "ENTHTTPClient.h"
+#import "ENStoreClientMetricsInternal.h"
 
 @interface ENTHTTPClient()
 
@@ -26,7 +27,8 @@
 @property (assign, nonatomic) int responseDataOffset;
 @property (strong, nonatomic) NSString *userAgent;
 @property (assign, nonatomic) int timeout;
-
+// The request on the network, if any, for -cancel to abort.
+@property (strong, nonatomic) NSURLSessionDataTask *task;
 
 @end
 
@@ -89,43 +91,112 @@
   return request;
 }
 
-- (void) flush {
-  // make the HTTP request
-  NSMutableURLRequest *request = [self newRequest];
-  [request setHTTPBody: self.requestData]; // not sure if it copies the data
-
-  NSURLResponse * response;
-  NSError * error;
-  NSData * responseData = [NSURLConnection sendSynchronousRequest: request
-                                                returningResponse: &response
-                                                            error: &error];
-
-  [self.requestData setLength: 0];
++ (NSURLSession *) sharedSession {
+  static NSURLSession * sharedSession = nil;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    NSURLSessionConfiguration * configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+    configuration.URLCache = nil;
+    // Completions only hand the response on, so one delegate thread serves every client.
+    NSOperationQueue * delegateQueue = [[NSOperationQueue alloc] init];
+    delegateQueue.name = @"com.evernote.sdk.ENTHTTPClient";
+    delegateQueue.maxConcurrentOperationCount = 1;
+    sharedSession = [NSURLSession sessionWithConfiguration: configuration
+                                                  delegate: nil
+                                             delegateQueue: delegateQueue];
+  });
+  return sharedSession;
+}
 
+- (NSException *) exceptionForResponse: (NSURLResponse *) response
+                                  data: (NSData *) responseData
+                                 error: (NSError *) error
+{
   if (responseData == nil) {
-    @throw [ENTTransportException exceptionWithName: @"TTransportException"
-                                reason: @"Could not make HTTP request"
-                                error: error];
+    return [ENTTransportException exceptionWithName: @"TTransportException"
+                                             reason: @"Could not make HTTP request"
+                                              error: error];
   }
   if (![response isKindOfClass: [NSHTTPURLResponse class]]) {
-    @throw [ENTTransportException exceptionWithName: @"TTransportException"
-                                           reason: [NSString stringWithFormat: @"Unexpected NSURLResponse type: %@",
-                                                    NSStringFromClass([response class])]];
+    return [ENTTransportException exceptionWithName: @"TTransportException"
+                                             reason: [NSString stringWithFormat: @"Unexpected NSURLResponse type: %@",
+                                                      NSStringFromClass([response class])]];
   }
 
   NSHTTPURLResponse * httpResponse = (NSHTTPURLResponse *) response;
   if ([httpResponse statusCode] != 200) {
-    @throw [ENTTransportException exceptionWithName: @"TTransportException"
-                                           reason: [NSString stringWithFormat: @"Bad response from HTTP server: %ld",
-                                                    (long)[httpResponse statusCode]]];
+    return [ENTTransportException exceptionWithName: @"TTransportException"
+                                             reason: [NSString stringWithFormat: @"Bad response from HTTP server: %ld",
+                                                      (long)[httpResponse statusCode]]
+                                           userInfo: @{ @"HTTPStatusCode" : @([httpResponse statusCode]) }];
+  }
+  return nil;
+}
+
+- (void) flush {
+  // Sent through the shared session and waited for here, so that -cancel can abort it.
+  __block NSData * responseData = nil;
+  __block NSUInteger requestLength = 0;
+  __block NSException * exception = nil;
+  dispatch_semaphore_t done = dispatch_semaphore_create(0);
+  [self sendRequestWithCompletion: ^(NSData * response, NSUInteger length, NSException * sendException) {
+    responseData = response;
+    requestLength = length;
+    exception = sendException;
+    dispatch_semaphore_signal(done);
+  }];
+  dispatch_semaphore_wait(done, DISPATCH_TIME_FOREVER);
+  ENStoreClientMetricsCallAddBytes(requestLength, responseData.length);
+
+  if (exception != nil) {
+    @throw exception;
   }
 
   self.responseData = responseData;
   self.responseDataOffset = 0;
 }
 
-- (void)cancel {
-    // noop
+- (void) sendRequestWithCompletion: (void (^)(NSData * response, NSUInteger requestLength, NSException * exception)) completion {
+  NSMutableURLRequest *request = [self newRequest];
+  NSData * body = [self.requestData copy];
+  [request setHTTPBody: body];
+  [self.requestData setLength: 0];
+  // The last response has been read by now.
+  self.responseData = nil;
+
+  __block NSURLSessionDataTask * task = nil;
+  task = [[ENTHTTPClient sharedSession] dataTaskWithRequest: request
+                                          completionHandler: ^(NSData * data, NSURLResponse * response, NSError * error) {
+    @synchronized(self) {
+      if (self.task == task) {
+        self.task = nil;
+      }
+    }
+    task = nil;
+    NSException * exception = [self exceptionForResponse: response data: data error: error];
+    completion(exception ? nil : data, body.length, exception);
+  }];
+  @synchronized(self) {
+    self.task = task;
+  }
+  [task resume];
+}
+
+- (void) resetWithResponse: (NSData *) response {
+  [self.requestData setLength: 0];
+  self.responseData = response;
+  self.responseDataOffset = 0;
+}
+
+- (void) cancel {
+  // The task's completion reports the cancellation to whoever is waiting, and dropping the task
+  // releases the request body and whatever had arrived of the response.
+  NSURLSessionDataTask * task = nil;
+  @synchronized(self) {
+    task = self.task;
+    self.task = nil;
+  }
+  [task cancel];
 }
 
 @end
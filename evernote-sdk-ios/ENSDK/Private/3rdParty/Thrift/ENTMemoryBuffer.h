@@ -0,0 +1,34 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENTTransport.h"
+
+// A transport over an in-memory buffer. Writes append to the buffer and reads consume it from the front,
+// so a buffer can carry one side of a Thrift exchange without a connection.
+@interface ENTMemoryBuffer : NSObject <ENTTransport>
+
+- (id) init;
+
+- (id) initWithData: (NSData *) data;
+
+// Everything written and not yet read.
+- (NSData *) getBuffer;
+
+@end
@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import "ENTMemoryBuffer.h"
+
+@interface ENTMemoryBuffer()
+
+@property (strong, nonatomic) NSMutableData *buffer;
+@property (assign, nonatomic) NSUInteger offset;
+
+@end
+
+@implementation ENTMemoryBuffer
+
+- (id) init {
+  return [self initWithData: nil];
+}
+
+- (id) initWithData: (NSData *) data {
+  self = [super init];
+  if (self != nil) {
+    self.buffer = data ? [data mutableCopy] : [[NSMutableData alloc] initWithCapacity: 1024];
+  }
+  return self;
+}
+
+- (int) readAll: (uint8_t *) buf offset: (int) off length: (int) len {
+  if (self.buffer.length - self.offset < (NSUInteger)len) {
+    @throw [ENTTransportException exceptionWithReason: @"Not enough bytes remain in buffer"];
+  }
+  [self.buffer getBytes: buf + off range: NSMakeRange(self.offset, len)];
+  self.offset += len;
+  return len;
+}
+
+- (void) write: (const uint8_t *) data offset: (unsigned int) offset length: (unsigned int) length {
+  [self.buffer appendBytes: data + offset length: length];
+}
+
+- (NSData *) getBuffer {
+  return [self.buffer subdataWithRange: NSMakeRange(self.offset, self.buffer.length - self.offset)];
+}
+
+- (void) flush {
+  // noop
+}
+
+- (void) cancel {
+  // noop
+}
+
+@end
@@ -21,6 +21,7 @@
 #import "ENTException.h"
 
 @protocol ENTTransport;
+@class FATArgument;
 
 enum {
   TMessageType_CALL = 1,
@@ -156,6 +157,15 @@ enum {
       fromProtocol:(id<ENTProtocol>)inProtocol
  withResponseTypes:(NSArray *)responseTypes;
 
+// Like the above, but a reply carrying an exception (one of the response types, or an application
+// exception) returns nil and hands the exception back without raising it. Transport and protocol
+// failures still throw. The method above throws the exception unless the current ENTAsyncInvocation
+// returns service exceptions.
++ (id) readMessage:(NSString *)message
+      fromProtocol:(id<ENTProtocol>)inProtocol
+ withResponseTypes:(NSArray *)responseTypes
+  serviceException:(NSException **)serviceException;
+
 + (void) writeObject:(id)object
         ontoProtocol:(id<ENTProtocol>)outProtocol;
 
@@ -163,4 +173,20 @@ enum {
           toProtocol:(id<ENTProtocol>)outProtocol
        withArguments:(NSArray *)arguments;
 
+// Server side of the two calls above. The message header must already have been read; the arguments come
+// back keyed by field name. A reply carries one result field: index 0 for success, or the index the method
+// declares for the exception being returned.
++ (NSDictionary *) readArgumentsFromProtocol:(id<ENTProtocol>)inProtocol
+                                  withFields:(NSArray *)argumentFields;
+
++ (void) sendReply:(NSString *)messageName
+        sequenceID:(int)sequenceID
+        toProtocol:(id<ENTProtocol>)outProtocol
+        withResult:(FATArgument *)result;
+
++ (void) sendException:(ENTApplicationException *)exception
+            forMessage:(NSString *)messageName
+            sequenceID:(int)sequenceID
+            toProtocol:(id<ENTProtocol>)outProtocol;
+
 @end
@@ -22,6 +22,9 @@
 #import "FATField.h"
 #import "FATObject.h"
 #import "ENTTransport.h"
+#import "ENSDKLogger.h"
+#import "ENStoreClientMetricsInternal.h"
+#import "ENTAsyncInvocation.h"
 
 @implementation ENTProtocolException
 @end
@@ -209,6 +212,7 @@
   [inProtocol readStructBeginReturningName: NULL];
   
   NSArray *structFields = [[object class] structFields];
+  void (^fieldReadHandler)(id, int) = [ENTAsyncInvocation currentInvocation].fieldReadHandler;
   while (true) {
     int fieldType = 0;
     int fieldID = 0;
@@ -230,7 +234,7 @@
     
     if (field == nil || (field.type != fieldType && field.type != TType_BINARY && fieldType != TType_STRING)) {
       if (field != nil) {
-        NSLog(@"Skipping field:%@ due to type mismatch (received:%i)", field, fieldType);
+        ENSDKLog(Info, Transport, @"Skipping field:%@ due to type mismatch (received:%i)", field, fieldType);
       }
       
       [self skipType: fieldType onProtocol: inProtocol];
@@ -242,7 +246,9 @@
       
       [object setValue:fieldValue
                 forKey:field.name];
-      
+      if (fieldReadHandler != nil) {
+        fieldReadHandler(object, fieldID);
+      }
     }
     
     [inProtocol readFieldEnd];
@@ -329,13 +335,53 @@
 + (id) readMessage:(NSString *)message
       fromProtocol:(id<ENTProtocol>)inProtocol
  withResponseTypes:(NSArray *)responseTypes
+{
+  NSException *serviceException = nil;
+  id result = [self readMessage:message fromProtocol:inProtocol withResponseTypes:responseTypes serviceException:&serviceException];
+  if (serviceException != nil && ![ENTAsyncInvocation currentInvocation].returnsServiceExceptions) {
+    @throw serviceException;
+  }
+  return result;
+}
+
++ (id) readMessage:(NSString *)message
+      fromProtocol:(id<ENTProtocol>)inProtocol
+ withResponseTypes:(NSArray *)responseTypes
+  serviceException:(NSException **)serviceException
+{
+  ENTAsyncInvocation *invocation = [ENTAsyncInvocation currentInvocation];
+  id result = nil;
+  NSException *exception = nil;
+  if ([invocation takeResult: &result exception: &exception]) {
+    *serviceException = exception;
+    return result;
+  }
+  @try {
+    result = [self _readMessage:message fromProtocol:inProtocol withResponseTypes:responseTypes serviceException:&exception];
+  }
+  @catch (NSException *transportException) {
+    ENStoreClientMetricsCallEnd(transportException);
+    [invocation finishCallWithResult: nil exception: transportException];
+    @throw;
+  }
+  ENStoreClientMetricsCallEnd(exception);
+  [invocation finishCallWithResult: result exception: exception];
+  *serviceException = exception;
+  return result;
+}
+
++ (id) _readMessage:(NSString *)message
+       fromProtocol:(id<ENTProtocol>)inProtocol
+  withResponseTypes:(NSArray *)responseTypes
+   serviceException:(NSException **)serviceException
 {
   int msgType = 0;
   [inProtocol readMessageBeginReturningName: nil type: &msgType sequenceID: NULL];
   if (msgType == TMessageType_EXCEPTION) {
     ENTApplicationException * x = [ENTApplicationException read: inProtocol];
     [inProtocol readMessageEnd];
-    @throw x;
+    *serviceException = x;
+    return nil;
   }
   
   NSMutableArray *responseObjects = [NSMutableArray array];
@@ -355,7 +401,7 @@
     for (FATField *aResponseType in responseTypes) {
       if (aResponseType.index == fieldID) {
         if (aResponseType.type != (uint32_t)fieldType && aResponseType.type != TType_BINARY && fieldType != TType_STRING) {
-          NSLog(@"Skipping field:%@ due to type mismatch (received:%i)", aResponseType, fieldType);
+          ENSDKLog(Info, Transport, @"Skipping field:%@ due to type mismatch (received:%i)", aResponseType, fieldType);
         }
         else {
           id fieldValue = [self _readValueForField:aResponseType
@@ -384,7 +430,8 @@
   
   for (id anObject in responseObjects) {
     if ([anObject isKindOfClass:[NSException class]] == YES) {
-      @throw anObject;
+      *serviceException = anObject;
+      return nil;
     }
   }
   
@@ -397,8 +444,8 @@
   }
   
   if (nonExceptionTypesPresent) {
-    @throw [ENTApplicationException exceptionWithType: ENTApplicationException_MISSING_RESULT
-                                             reason: [message stringByAppendingString:@" failed: unknown result"]];
+    *serviceException = [ENTApplicationException exceptionWithType: ENTApplicationException_MISSING_RESULT
+                                                           reason: [message stringByAppendingString:@" failed: unknown result"]];
   }
   
   return nil;
@@ -438,6 +485,11 @@
           toProtocol:(id<ENTProtocol>)outProtocol
        withArguments:(NSArray *)arguments
 {
+  ENTAsyncInvocation *invocation = [ENTAsyncInvocation currentInvocation];
+  if ([invocation beginCall: messageName onTransport: [outProtocol transport]]) {
+    return;
+  }
+  ENStoreClientMetricsCallBegin(messageName);
   [outProtocol writeMessageBeginWithName: messageName type: TMessageType_CALL sequenceID: 0];
   [outProtocol writeStructBeginWithName: [messageName stringByAppendingString:@"_args"]];
   
@@ -455,6 +507,92 @@
   [outProtocol writeFieldStop];
   [outProtocol writeStructEnd];
   [outProtocol writeMessageEnd];
+  ENStoreClientMetricsCallMark(ENStoreClientMetricsPhaseSerialized);
+  if (invocation == nil) {
+    [[outProtocol transport] flush];
+  }
+  else if (![invocation flushTransport: [outProtocol transport]]) {
+    return;
+  }
+  ENStoreClientMetricsCallMark(ENStoreClientMetricsPhaseReceived);
+}
+
++ (NSDictionary *) readArgumentsFromProtocol:(id<ENTProtocol>)inProtocol
+                                  withFields:(NSArray *)argumentFields
+{
+  NSMutableDictionary *arguments = [NSMutableDictionary dictionary];
+  [inProtocol readStructBeginReturningName: NULL];
+  
+  while (true) {
+    int fieldType = 0;
+    int fieldID = 0;
+    
+    [inProtocol readFieldBeginReturningName: NULL type: &fieldType fieldID: &fieldID];
+    if (fieldType == TType_STOP) {
+      break;
+    }
+    
+    FATField *field = nil;
+    for (FATField *aField in argumentFields) {
+      if (aField.index == fieldID) {
+        field = aField;
+        break;
+      }
+    }
+    
+    if (field == nil || (field.type != fieldType && field.type != TType_BINARY && fieldType != TType_STRING)) {
+      [self skipType: fieldType onProtocol: inProtocol];
+    }
+    else {
+      id fieldValue = [self _readValueForField:field
+                                  fromProtocol:inProtocol];
+      if (fieldValue != nil) {
+        [arguments setObject:fieldValue forKey:field.name];
+      }
+    }
+    [inProtocol readFieldEnd];
+  }
+  
+  [inProtocol readStructEnd];
+  [inProtocol readMessageEnd];
+  return arguments;
+}
+
++ (void) sendReply:(NSString *)messageName
+        sequenceID:(int)sequenceID
+        toProtocol:(id<ENTProtocol>)outProtocol
+        withResult:(FATArgument *)result
+{
+  [outProtocol writeMessageBeginWithName: messageName type: TMessageType_REPLY sequenceID: sequenceID];
+  [outProtocol writeStructBeginWithName: [messageName stringByAppendingString:@"_result"]];
+  
+  if (result.value != nil) {
+    FATField *field = result.field;
+    int fieldType = field.type;
+    if (fieldType == TType_BINARY) {
+      fieldType = TType_STRING;
+    }
+    [outProtocol writeFieldBeginWithName:field.name type:fieldType fieldID:field.index];
+    [self _writeValue:result.value
+             forField:field
+           toProtocol:outProtocol];
+    [outProtocol writeFieldEnd];
+  }
+  
+  [outProtocol writeFieldStop];
+  [outProtocol writeStructEnd];
+  [outProtocol writeMessageEnd];
+  [[outProtocol transport] flush];
+}
+
++ (void) sendException:(ENTApplicationException *)exception
+            forMessage:(NSString *)messageName
+            sequenceID:(int)sequenceID
+            toProtocol:(id<ENTProtocol>)outProtocol
+{
+  [outProtocol writeMessageBeginWithName: messageName type: TMessageType_EXCEPTION sequenceID: sequenceID];
+  [exception write: outProtocol];
+  [outProtocol writeMessageEnd];
   [[outProtocol transport] flush];
 }
 
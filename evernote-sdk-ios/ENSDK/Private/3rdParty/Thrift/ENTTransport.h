@@ -40,6 +40,23 @@
 
 @end
 
+@protocol ENTAsyncTransport <ENTTransport>
+
+  /**
+   * Sends the request written since the last flush without waiting for the response.
+   *
+   * @param completion Called on an arbitrary thread with the response body and the
+   *                   request size, or with the exception flush would have thrown
+   */
+- (void) sendRequestWithCompletion: (void (^)(NSData * response, NSUInteger requestLength, NSException * exception)) completion;
+
+  /**
+   * Discards anything written since the last flush and makes response the data read next.
+   */
+- (void) resetWithResponse: (NSData *) response;
+
+@end
+
 @interface ENTTransportException : ENTException
 
 + (id) exceptionWithReason: (NSString *) reason
@@ -0,0 +1,68 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENTTransport.h"
+
+// A recording of Thrift exchanges: for each flush, the URL, the request bytes, the response bytes
+// (or the reason the call failed) and how long the round trip took. Logs are written to disk in a
+// compact binary form so a real session can be captured once and replayed without a network.
+@interface ENTTransportLog : NSObject
+
+- (id) init;
+
+- (id) initWithContentsOfFile: (NSString *) path
+                        error: (NSError **) error;
+
+- (BOOL) writeToFile: (NSString *) path
+               error: (NSError **) error;
+
+- (NSUInteger) exchangeCount;
+
+// Replay cursors go back to the first exchange, and the mismatch count is cleared.
+- (void) rewind;
+
+// Replayed requests whose bytes differed from the recorded request for the same URL and method.
+// A growing count means the code under test no longer makes the calls that were recorded.
+- (NSUInteger) mismatchCount;
+
+@end
+
+// Passes everything through to another transport and appends each exchange to a log. Several
+// recording transports can share one log.
+@interface ENTRecordingTransport : NSObject <ENTTransport>
+
+- (id) initWithTransport: (id <ENTTransport>) transport
+                     log: (ENTTransportLog *) log
+                     url: (NSURL *) url;
+
+@end
+
+// Answers requests from a log instead of the network. Exchanges are matched by URL and Thrift
+// method name and served in recorded order; a method's exchanges start over once they have all
+// been served, so a recording can be replayed repeatedly. Each flush waits for the recorded round
+// trip time multiplied by timeScale: 1 reproduces the original timing, 0 (the default) none.
+@interface ENTReplayTransport : NSObject <ENTTransport>
+
+- (id) initWithLog: (ENTTransportLog *) log
+               url: (NSURL *) url;
+
+@property (assign, nonatomic) double timeScale;
+
+@end
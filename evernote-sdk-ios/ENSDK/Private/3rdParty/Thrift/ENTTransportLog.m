@@ -0,0 +1,429 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import "ENTTransportLog.h"
+#import "ENStoreClientMetricsInternal.h"
+
+// File layout, all integers big-endian:
+//   "ENTL" magic, uint32 version
+//   uint32 URL count, then per URL: uint32 length, UTF-8 bytes
+//   then per exchange until the end of the file:
+//     uint32 URL index, uint8 flags, uint32 duration in microseconds,
+//     uint32 request length, request bytes, uint32 response length, response bytes
+// A failed exchange has the failed flag set and the failure reason, UTF-8, as its response.
+static const uint32_t ENTTransportLogVersion = 1;
+static const uint8_t ENTTransportLogFlagFailed = 1 << 0;
+
+static NSString * ENTTransportLogMethodName(NSData * request) {
+  // Strict messages start with the version word, which has the high bit set; non-strict ones start
+  // with the name.
+  const uint8_t * bytes = request.bytes;
+  NSUInteger length = request.length;
+  NSUInteger offset = 0;
+  if (length < 4) {
+    return @"";
+  }
+  if (bytes[0] & 0x80) {
+    offset = 4;
+  }
+  if (length < offset + 4) {
+    return @"";
+  }
+  uint32_t nameLength = ((uint32_t)bytes[offset] << 24) | ((uint32_t)bytes[offset + 1] << 16) |
+                        ((uint32_t)bytes[offset + 2] << 8) | (uint32_t)bytes[offset + 3];
+  offset += 4;
+  if (nameLength > length - offset) {
+    return @"";
+  }
+  return [[NSString alloc] initWithBytes: bytes + offset length: nameLength encoding: NSUTF8StringEncoding] ?: @"";
+}
+
+@interface ENTTransportExchange : NSObject
+
+@property (strong, nonatomic) NSString *url;
+@property (strong, nonatomic) NSString *methodName;
+@property (strong, nonatomic) NSData *request;
+@property (strong, nonatomic) NSMutableData *response;
+@property (strong, nonatomic) NSString *failureReason;
+@property (assign, nonatomic) NSTimeInterval duration;
+
+@end
+
+@implementation ENTTransportExchange
+@end
+
+@interface ENTTransportLog()
+
+@property (strong, nonatomic) NSMutableArray *exchanges;
+@property (strong, nonatomic) NSMutableDictionary *exchangesByKey;
+@property (strong, nonatomic) NSMutableDictionary *cursors;
+@property (assign, nonatomic) NSUInteger mismatches;
+
+@end
+
+@implementation ENTTransportLog
+
+- (id) init {
+  self = [super init];
+  if (self != nil) {
+    self.exchanges = [[NSMutableArray alloc] init];
+    self.cursors = [[NSMutableDictionary alloc] init];
+  }
+  return self;
+}
+
+- (id) initWithContentsOfFile: (NSString *) path
+                        error: (NSError **) error
+{
+  NSData * data = [NSData dataWithContentsOfFile: path options: NSDataReadingMappedIfSafe error: error];
+  if (data == nil) {
+    return nil;
+  }
+  self = [self init];
+  if (self == nil) {
+    return nil;
+  }
+
+  const uint8_t * bytes = data.bytes;
+  NSUInteger length = data.length;
+  __block NSUInteger offset = 0;
+  __block BOOL truncated = NO;
+  uint32_t (^readU32)(void) = ^uint32_t {
+    if (length - offset < 4) {
+      truncated = YES;
+      return 0;
+    }
+    uint32_t value = ((uint32_t)bytes[offset] << 24) | ((uint32_t)bytes[offset + 1] << 16) |
+                     ((uint32_t)bytes[offset + 2] << 8) | (uint32_t)bytes[offset + 3];
+    offset += 4;
+    return value;
+  };
+  NSData * (^readBytes)(uint32_t) = ^NSData * (uint32_t count) {
+    if (length - offset < count) {
+      truncated = YES;
+      return nil;
+    }
+    NSData * result = [data subdataWithRange: NSMakeRange(offset, count)];
+    offset += count;
+    return result;
+  };
+
+  NSData * magic = readBytes(4);
+  uint32_t version = readU32();
+  if (truncated || memcmp(magic.bytes, "ENTL", 4) != 0 || version != ENTTransportLogVersion) {
+    if (error) {
+      *error = [NSError errorWithDomain: NSCocoaErrorDomain
+                                   code: NSFileReadCorruptFileError
+                               userInfo: @{NSFilePathErrorKey: path}];
+    }
+    return nil;
+  }
+
+  uint32_t urlCount = readU32();
+  NSMutableArray * urls = [[NSMutableArray alloc] init];
+  for (uint32_t i = 0; i < urlCount && !truncated; i++) {
+    NSData * urlData = readBytes(readU32());
+    [urls addObject: [[NSString alloc] initWithData: urlData ?: [NSData data] encoding: NSUTF8StringEncoding] ?: @""];
+  }
+
+  while (offset < length && !truncated) {
+    uint32_t urlIndex = readU32();
+    uint8_t flags = 0;
+    NSData * flagData = readBytes(1);
+    if (flagData) {
+      flags = ((const uint8_t *)flagData.bytes)[0];
+    }
+    uint32_t duration = readU32();
+    NSData * request = readBytes(readU32());
+    NSData * response = readBytes(readU32());
+    if (truncated || urlIndex >= urls.count) {
+      truncated = YES;
+      break;
+    }
+
+    ENTTransportExchange * exchange = [[ENTTransportExchange alloc] init];
+    exchange.url = urls[urlIndex];
+    exchange.methodName = ENTTransportLogMethodName(request);
+    exchange.request = request;
+    exchange.duration = duration / 1000000.0;
+    if (flags & ENTTransportLogFlagFailed) {
+      exchange.failureReason = [[NSString alloc] initWithData: response encoding: NSUTF8StringEncoding] ?: @"";
+      exchange.response = [[NSMutableData alloc] init];
+    } else {
+      exchange.response = [response mutableCopy];
+    }
+    [self.exchanges addObject: exchange];
+  }
+
+  if (truncated) {
+    if (error) {
+      *error = [NSError errorWithDomain: NSCocoaErrorDomain
+                                   code: NSFileReadCorruptFileError
+                               userInfo: @{NSFilePathErrorKey: path}];
+    }
+    return nil;
+  }
+  return self;
+}
+
+- (BOOL) writeToFile: (NSString *) path
+               error: (NSError **) error
+{
+  NSMutableData * data = [[NSMutableData alloc] init];
+  void (^writeU32)(uint32_t) = ^(uint32_t value) {
+    uint32_t bigEndian = CFSwapInt32HostToBig(value);
+    [data appendBytes: &bigEndian length: 4];
+  };
+  void (^writeData)(NSData *) = ^(NSData * bytes) {
+    writeU32((uint32_t)bytes.length);
+    [data appendData: bytes];
+  };
+
+  @synchronized(self) {
+    [data appendBytes: "ENTL" length: 4];
+    writeU32(ENTTransportLogVersion);
+
+    NSMutableArray * urls = [[NSMutableArray alloc] init];
+    NSMutableDictionary * urlIndexes = [[NSMutableDictionary alloc] init];
+    for (ENTTransportExchange * exchange in self.exchanges) {
+      if (urlIndexes[exchange.url] == nil) {
+        urlIndexes[exchange.url] = @(urls.count);
+        [urls addObject: exchange.url];
+      }
+    }
+    writeU32((uint32_t)urls.count);
+    for (NSString * url in urls) {
+      writeData([url dataUsingEncoding: NSUTF8StringEncoding]);
+    }
+
+    for (ENTTransportExchange * exchange in self.exchanges) {
+      writeU32([urlIndexes[exchange.url] unsignedIntValue]);
+      uint8_t flags = exchange.failureReason ? ENTTransportLogFlagFailed : 0;
+      [data appendBytes: &flags length: 1];
+      writeU32((uint32_t)MIN(exchange.duration * 1000000.0, (double)UINT32_MAX));
+      writeData(exchange.request);
+      writeData(exchange.failureReason ? [exchange.failureReason dataUsingEncoding: NSUTF8StringEncoding] : exchange.response);
+    }
+  }
+  return [data writeToFile: path options: NSDataWritingAtomic error: error];
+}
+
+- (NSUInteger) exchangeCount {
+  @synchronized(self) {
+    return self.exchanges.count;
+  }
+}
+
+- (void) rewind {
+  @synchronized(self) {
+    [self.cursors removeAllObjects];
+    self.mismatches = 0;
+  }
+}
+
+- (NSUInteger) mismatchCount {
+  @synchronized(self) {
+    return self.mismatches;
+  }
+}
+
+- (void) addExchange: (ENTTransportExchange *) exchange {
+  @synchronized(self) {
+    [self.exchanges addObject: exchange];
+    self.exchangesByKey = nil;
+  }
+}
+
+- (void) appendResponseBytes: (const uint8_t *) bytes
+                      length: (int) length
+                  toExchange: (ENTTransportExchange *) exchange
+{
+  @synchronized(self) {
+    [exchange.response appendBytes: bytes length: length];
+  }
+}
+
+- (ENTTransportExchange *) nextExchangeForURL: (NSString *) url
+                                      request: (NSData *) request
+{
+  NSString * key = [NSString stringWithFormat: @"%@ %@", url, ENTTransportLogMethodName(request)];
+  @synchronized(self) {
+    if (self.exchangesByKey == nil) {
+      self.exchangesByKey = [[NSMutableDictionary alloc] init];
+      for (ENTTransportExchange * exchange in self.exchanges) {
+        NSString * exchangeKey = [NSString stringWithFormat: @"%@ %@", exchange.url, exchange.methodName];
+        NSMutableArray * list = self.exchangesByKey[exchangeKey];
+        if (list == nil) {
+          list = [[NSMutableArray alloc] init];
+          self.exchangesByKey[exchangeKey] = list;
+        }
+        [list addObject: exchange];
+      }
+    }
+
+    NSArray * list = self.exchangesByKey[key];
+    if (list.count == 0) {
+      return nil;
+    }
+    NSUInteger cursor = [self.cursors[key] unsignedIntegerValue];
+    ENTTransportExchange * exchange = list[cursor % list.count];
+    self.cursors[key] = @(cursor + 1);
+    if (![exchange.request isEqualToData: request]) {
+      self.mismatches++;
+    }
+    return exchange;
+  }
+}
+
+@end
+
+@interface ENTRecordingTransport()
+
+@property (strong, nonatomic) id <ENTTransport> transport;
+@property (strong, nonatomic) ENTTransportLog *log;
+@property (strong, nonatomic) NSString *url;
+@property (strong, nonatomic) NSMutableData *requestData;
+@property (strong, nonatomic) ENTTransportExchange *exchange;
+
+@end
+
+@implementation ENTRecordingTransport
+
+- (id) initWithTransport: (id <ENTTransport>) transport
+                     log: (ENTTransportLog *) log
+                     url: (NSURL *) url
+{
+  self = [super init];
+  if (self != nil) {
+    self.transport = transport;
+    self.log = log;
+    self.url = url.absoluteString ?: @"";
+    self.requestData = [[NSMutableData alloc] initWithCapacity: 1024];
+  }
+  return self;
+}
+
+- (int) readAll: (uint8_t *) buf offset: (int) off length: (int) len {
+  int read = [self.transport readAll: buf offset: off length: len];
+  if (self.exchange != nil) {
+    [self.log appendResponseBytes: buf + off length: read toExchange: self.exchange];
+  }
+  return read;
+}
+
+- (void) write: (const uint8_t *) data offset: (unsigned int) offset length: (unsigned int) length {
+  [self.requestData appendBytes: data + offset length: length];
+  [self.transport write: data offset: offset length: length];
+}
+
+- (void) flush {
+  ENTTransportExchange * exchange = [[ENTTransportExchange alloc] init];
+  exchange.url = self.url;
+  exchange.request = [self.requestData copy];
+  exchange.methodName = ENTTransportLogMethodName(exchange.request);
+  exchange.response = [[NSMutableData alloc] init];
+  [self.requestData setLength: 0];
+  self.exchange = nil;
+
+  CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+  @try {
+    [self.transport flush];
+  }
+  @catch (NSException * exception) {
+    exchange.duration = CFAbsoluteTimeGetCurrent() - start;
+    exchange.failureReason = exception.reason ?: exception.name;
+    [self.log addExchange: exchange];
+    @throw;
+  }
+  exchange.duration = CFAbsoluteTimeGetCurrent() - start;
+  [self.log addExchange: exchange];
+  // The response is captured as the protocol reads it.
+  self.exchange = exchange;
+}
+
+- (void) cancel {
+  [self.transport cancel];
+}
+
+@end
+
+@interface ENTReplayTransport()
+
+@property (strong, nonatomic) ENTTransportLog *log;
+@property (strong, nonatomic) NSString *url;
+@property (strong, nonatomic) NSMutableData *requestData;
+@property (strong, nonatomic) NSData *responseData;
+@property (assign, nonatomic) NSUInteger responseDataOffset;
+
+@end
+
+@implementation ENTReplayTransport
+
+- (id) initWithLog: (ENTTransportLog *) log
+               url: (NSURL *) url
+{
+  self = [super init];
+  if (self != nil) {
+    self.log = log;
+    self.url = url.absoluteString ?: @"";
+    self.requestData = [[NSMutableData alloc] initWithCapacity: 1024];
+  }
+  return self;
+}
+
+- (int) readAll: (uint8_t *) buf offset: (int) off length: (int) len {
+  if (self.responseData.length - self.responseDataOffset < (NSUInteger)len) {
+    @throw [ENTTransportException exceptionWithReason: @"Read past the end of the recorded response"];
+  }
+  [self.responseData getBytes: buf + off range: NSMakeRange(self.responseDataOffset, len)];
+  self.responseDataOffset += len;
+  return len;
+}
+
+- (void) write: (const uint8_t *) data offset: (unsigned int) offset length: (unsigned int) length {
+  [self.requestData appendBytes: data + offset length: length];
+}
+
+- (void) flush {
+  ENTTransportExchange * exchange = [self.log nextExchangeForURL: self.url request: self.requestData];
+  NSString * methodName = ENTTransportLogMethodName(self.requestData);
+  NSUInteger requestLength = self.requestData.length;
+  [self.requestData setLength: 0];
+  self.responseData = nil;
+  self.responseDataOffset = 0;
+
+  if (exchange == nil) {
+    @throw [ENTTransportException exceptionWithReason: [NSString stringWithFormat: @"No recorded exchange for %@ at %@",
+                                                        methodName, self.url]];
+  }
+  if (self.timeScale > 0 && exchange.duration > 0) {
+    [NSThread sleepForTimeInterval: exchange.duration * self.timeScale];
+  }
+  ENStoreClientMetricsCallAddBytes(requestLength, exchange.response.length);
+  if (exchange.failureReason != nil) {
+    @throw [ENTTransportException exceptionWithReason: exchange.failureReason];
+  }
+  self.responseData = exchange.response;
+}
+
+- (void) cancel {
+  // noop
+}
+
+@end
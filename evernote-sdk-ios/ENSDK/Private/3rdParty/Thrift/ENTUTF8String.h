@@ -0,0 +1,32 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+// An immutable string held as its UTF-8 bytes, the way Thrift carries strings on the wire. Large note
+// content is read into one of these and written back out without being transcoded; the UTF-16 form the
+// rest of NSString works on is only made the first time something asks for characters.
+@interface ENTUTF8String : NSString
+
+// Nil if the data is not well-formed UTF-8.
+- (id) initWithUTF8Data: (NSData *) data;
+
+@property (nonatomic, readonly) NSData * UTF8Data;
+
+@end
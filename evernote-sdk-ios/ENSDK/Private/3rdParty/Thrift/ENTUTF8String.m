@@ -0,0 +1,138 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#import "ENTUTF8String.h"
+
+// Checks the bytes are well-formed UTF-8: no stray continuation bytes, overlong forms, surrogates or code
+// points past U+10FFFF.
+static BOOL ENTIsValidUTF8(const uint8_t * bytes, NSUInteger length) {
+  NSUInteger i = 0;
+  while (i < length) {
+    uint8_t byte = bytes[i];
+    if (byte < 0x80) {
+      i++;
+      continue;
+    }
+    NSUInteger count;
+    uint32_t min;
+    uint32_t codePoint;
+    if ((byte & 0xE0) == 0xC0) {
+      count = 1; min = 0x80; codePoint = byte & 0x1F;
+    } else if ((byte & 0xF0) == 0xE0) {
+      count = 2; min = 0x800; codePoint = byte & 0x0F;
+    } else if ((byte & 0xF8) == 0xF0) {
+      count = 3; min = 0x10000; codePoint = byte & 0x07;
+    } else {
+      return NO;
+    }
+    if (length - i <= count) {
+      return NO;
+    }
+    for (NSUInteger j = 1; j <= count; j++) {
+      uint8_t continuation = bytes[i + j];
+      if ((continuation & 0xC0) != 0x80) {
+        return NO;
+      }
+      codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+    if (codePoint < min || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+      return NO;
+    }
+    i += count + 1;
+  }
+  return YES;
+}
+
+@interface ENTUTF8String ()
+@property (atomic, strong) NSString * decodedString;
+@end
+
+@implementation ENTUTF8String {
+  NSData * _UTF8Data;
+}
+
+@synthesize UTF8Data = _UTF8Data;
+
+- (id) initWithUTF8Data: (NSData *) data {
+  if (!ENTIsValidUTF8([data bytes], [data length])) {
+    return nil;
+  }
+  self = [super init];
+  if (self != nil) {
+    _UTF8Data = [data copy];
+  }
+  return self;
+}
+
+- (NSString *) string {
+  NSString * string = self.decodedString;
+  if (string == nil) {
+    string = [[NSString alloc] initWithData: _UTF8Data encoding: NSUTF8StringEncoding] ?: @"";
+    self.decodedString = string;
+  }
+  return string;
+}
+
+#pragma mark - NSString primitives
+
+- (NSUInteger) length {
+  return [[self string] length];
+}
+
+- (unichar) characterAtIndex: (NSUInteger) index {
+  return [[self string] characterAtIndex: index];
+}
+
+- (void) getCharacters: (unichar *) buffer range: (NSRange) range {
+  [[self string] getCharacters: buffer range: range];
+}
+
+#pragma mark - Answered from the bytes
+
+- (NSUInteger) lengthOfBytesUsingEncoding: (NSStringEncoding) encoding {
+  if (encoding == NSUTF8StringEncoding) {
+    return [_UTF8Data length];
+  }
+  return [super lengthOfBytesUsingEncoding: encoding];
+}
+
+- (NSData *) dataUsingEncoding: (NSStringEncoding) encoding {
+  if (encoding == NSUTF8StringEncoding) {
+    return _UTF8Data;
+  }
+  return [super dataUsingEncoding: encoding];
+}
+
+- (NSData *) dataUsingEncoding: (NSStringEncoding) encoding allowLossyConversion: (BOOL) lossy {
+  if (encoding == NSUTF8StringEncoding) {
+    return _UTF8Data;
+  }
+  return [super dataUsingEncoding: encoding allowLossyConversion: lossy];
+}
+
+- (id) copyWithZone: (NSZone *) zone {
+  return self;
+}
+
+// Archives hold a plain string.
+- (Class) classForCoder {
+  return [NSString class];
+}
+
+@end
@@ -11,5 +11,9 @@
 #import "ENTBinaryProtocol.h"
 #import "ENTException.h"
 #import "ENTHTTPClient.h"
+#import "ENTAsyncInvocation.h"
+#import "ENTMemoryBuffer.h"
+#import "ENTUTF8String.h"
+#import "ENTTransportLog.h"
 #import "ENTProtocol.h"
 #import "ENTTransport.h"
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+/**
+ *  Object types that can appear in a binary property list.
+ */
+typedef NS_ENUM(NSInteger, ENBinaryPlistObjectType) {
+    ENBinaryPlistObjectTypeInvalid = 0,
+    ENBinaryPlistObjectTypeNull,
+    ENBinaryPlistObjectTypeBoolean,
+    ENBinaryPlistObjectTypeInteger,
+    ENBinaryPlistObjectTypeReal,
+    ENBinaryPlistObjectTypeDate,
+    ENBinaryPlistObjectTypeData,
+    ENBinaryPlistObjectTypeString,
+    ENBinaryPlistObjectTypeArray,
+    ENBinaryPlistObjectTypeDictionary,
+    ENBinaryPlistObjectTypeOther
+};
+
+/**
+ *  Index of an object in a binary property list's object table.
+ */
+typedef uint64_t ENBinaryPlistObjectRef;
+
+/**
+ *  A random-access reader for "bplist00" binary property lists. Unlike NSPropertyListSerialization,
+ *  nothing is decoded until it is asked for, and data objects are returned as no-copy slices of the
+ *  underlying buffer. Pair it with a memory-mapped NSData to keep large archives out of resident memory.
+ *  Slices retain the underlying buffer, so they stay valid after the reader is gone.
+ */
+@interface ENBinaryPlistReader : NSObject
++ (BOOL)isBinaryPlistData:(NSData *)data;
+
+// Returns nil if the data is not a well-formed binary property list.
+- (id)initWithData:(NSData *)data;
+
+@property (nonatomic, readonly) NSData * data;
+@property (nonatomic, readonly) ENBinaryPlistObjectRef topObject;
+
+- (ENBinaryPlistObjectType)typeOfObject:(ENBinaryPlistObjectRef)object;
+
+// Number of elements in an array, or of key/value pairs in a dictionary. 0 for any other type.
+- (NSUInteger)countOfObject:(ENBinaryPlistObjectRef)object;
+- (BOOL)getObject:(ENBinaryPlistObjectRef *)outObject atIndex:(NSUInteger)index inArray:(ENBinaryPlistObjectRef)array;
+- (BOOL)getObject:(ENBinaryPlistObjectRef *)outObject forKey:(NSString *)key inDictionary:(ENBinaryPlistObjectRef)dictionary;
+
+- (NSString *)stringForObject:(ENBinaryPlistObjectRef)object;
+- (NSData *)dataForObject:(ENBinaryPlistObjectRef)object;
+
+// Fully materializes an object (and everything below it) into Foundation property list objects.
+- (id)propertyListForObject:(ENBinaryPlistObjectRef)object;
+@end
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENBinaryPlistReader.h"
+
+static const char ENBinaryPlistMagic[] = "bplist00";
+static const NSUInteger ENBinaryPlistMagicLength = 8;
+static const NSUInteger ENBinaryPlistTrailerLength = 32;
+static const NSUInteger ENBinaryPlistMaxDepth = 512;
+
+static uint64_t ENBinaryPlistReadInt(const uint8_t * p, NSUInteger size)
+{
+    uint64_t value = 0;
+    for (NSUInteger i = 0; i < size; i++) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+@interface ENBinaryPlistReader ()
+{
+    const uint8_t * _bytes;
+    uint64_t _offsetTableOffset;
+    uint64_t _numObjects;
+    uint8_t _offsetIntSize;
+    uint8_t _objectRefSize;
+}
+@property (nonatomic, strong) NSData * data;
+@property (nonatomic, assign) ENBinaryPlistObjectRef topObject;
+@end
+
+@implementation ENBinaryPlistReader
++ (BOOL)isBinaryPlistData:(NSData *)data
+{
+    return (data.length >= ENBinaryPlistMagicLength + ENBinaryPlistTrailerLength &&
+            memcmp(data.bytes, ENBinaryPlistMagic, ENBinaryPlistMagicLength) == 0);
+}
+
+- (id)initWithData:(NSData *)data
+{
+    self = [super init];
+    if (self) {
+        if (![[self class] isBinaryPlistData:data]) {
+            return nil;
+        }
+        self.data = data;
+        _bytes = data.bytes;
+
+        const uint8_t * trailer = _bytes + data.length - ENBinaryPlistTrailerLength;
+        _offsetIntSize = trailer[6];
+        _objectRefSize = trailer[7];
+        _numObjects = ENBinaryPlistReadInt(trailer + 8, 8);
+        _topObject = ENBinaryPlistReadInt(trailer + 16, 8);
+        _offsetTableOffset = ENBinaryPlistReadInt(trailer + 24, 8);
+
+        uint64_t tableLimit = data.length - ENBinaryPlistTrailerLength;
+        if (_offsetIntSize < 1 || _offsetIntSize > 8 ||
+            _objectRefSize < 1 || _objectRefSize > 8 ||
+            _numObjects == 0 || _topObject >= _numObjects ||
+            _offsetTableOffset < ENBinaryPlistMagicLength || _offsetTableOffset > tableLimit ||
+            _numObjects > (tableLimit - _offsetTableOffset) / _offsetIntSize) {
+            return nil;
+        }
+    }
+    return self;
+}
+
+#pragma mark - Object table
+
+- (BOOL)getOffset:(uint64_t *)outOffset ofObject:(ENBinaryPlistObjectRef)object
+{
+    if (object >= _numObjects) {
+        return NO;
+    }
+    uint64_t offset = ENBinaryPlistReadInt(_bytes + _offsetTableOffset + object * _offsetIntSize, _offsetIntSize);
+    if (offset < ENBinaryPlistMagicLength || offset >= _offsetTableOffset) {
+        return NO;
+    }
+    *outOffset = offset;
+    return YES;
+}
+
+// Decodes an object's marker byte. For variable-length types, the count is resolved (including the
+// extended integer form used when the count does not fit in the marker nibble) and the offset of the
+// payload is returned.
+- (BOOL)getMarker:(uint8_t *)outMarker
+            count:(uint64_t *)outCount
+    payloadOffset:(uint64_t *)outPayloadOffset
+         ofObject:(ENBinaryPlistObjectRef)object
+{
+    uint64_t offset = 0;
+    if (![self getOffset:&offset ofObject:object]) {
+        return NO;
+    }
+    uint8_t marker = _bytes[offset];
+    uint64_t count = marker & 0x0F;
+    uint64_t payload = offset + 1;
+    uint8_t kind = marker >> 4;
+    BOOL hasCount = (kind == 0x4 || kind == 0x5 || kind == 0x6 || kind == 0xA || kind == 0xC || kind == 0xD);
+    if (hasCount && count == 0x0F) {
+        if (payload >= _offsetTableOffset || (_bytes[payload] >> 4) != 0x1) {
+            return NO;
+        }
+        NSUInteger size = (NSUInteger)1 << (_bytes[payload] & 0x0F);
+        if (size > 8 || payload + 1 + size > _offsetTableOffset) {
+            return NO;
+        }
+        count = ENBinaryPlistReadInt(_bytes + payload + 1, size);
+        payload += 1 + size;
+    }
+    *outMarker = marker;
+    *outCount = count;
+    *outPayloadOffset = payload;
+    return YES;
+}
+
+- (BOOL)payloadOffset:(uint64_t)payload hasCount:(uint64_t)count ofSize:(uint64_t)size
+{
+    return (payload <= _offsetTableOffset && count <= (_offsetTableOffset - payload) / size);
+}
+
+- (ENBinaryPlistObjectRef)objectRefAtOffset:(uint64_t)offset
+{
+    return ENBinaryPlistReadInt(_bytes + offset, _objectRefSize);
+}
+
+#pragma mark - Typed access
+
+- (ENBinaryPlistObjectType)typeOfObject:(ENBinaryPlistObjectRef)object
+{
+    uint64_t offset = 0;
+    if (![self getOffset:&offset ofObject:object]) {
+        return ENBinaryPlistObjectTypeInvalid;
+    }
+    uint8_t marker = _bytes[offset];
+    switch (marker >> 4) {
+        case 0x0:
+            return (marker == 0x08 || marker == 0x09) ? ENBinaryPlistObjectTypeBoolean : ENBinaryPlistObjectTypeNull;
+        case 0x1:
+            return ENBinaryPlistObjectTypeInteger;
+        case 0x2:
+            return ENBinaryPlistObjectTypeReal;
+        case 0x3:
+            return ENBinaryPlistObjectTypeDate;
+        case 0x4:
+            return ENBinaryPlistObjectTypeData;
+        case 0x5:
+        case 0x6:
+            return ENBinaryPlistObjectTypeString;
+        case 0xA:
+            return ENBinaryPlistObjectTypeArray;
+        case 0xD:
+            return ENBinaryPlistObjectTypeDictionary;
+        default:
+            return ENBinaryPlistObjectTypeOther;
+    }
+}
+
+- (NSUInteger)countOfObject:(ENBinaryPlistObjectRef)object
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (![self getMarker:&marker count:&count payloadOffset:&payload ofObject:object]) {
+        return 0;
+    }
+    uint8_t kind = marker >> 4;
+    if (kind == 0xA) {
+        return [self payloadOffset:payload hasCount:count ofSize:_objectRefSize] ? (NSUInteger)count : 0;
+    }
+    if (kind == 0xD) {
+        return [self payloadOffset:payload hasCount:count ofSize:2 * _objectRefSize] ? (NSUInteger)count : 0;
+    }
+    return 0;
+}
+
+- (BOOL)getObject:(ENBinaryPlistObjectRef *)outObject atIndex:(NSUInteger)index inArray:(ENBinaryPlistObjectRef)array
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (![self getMarker:&marker count:&count payloadOffset:&payload ofObject:array] ||
+        (marker >> 4) != 0xA || index >= count ||
+        ![self payloadOffset:payload hasCount:count ofSize:_objectRefSize]) {
+        return NO;
+    }
+    *outObject = [self objectRefAtOffset:payload + index * _objectRefSize];
+    return YES;
+}
+
+- (BOOL)getObject:(ENBinaryPlistObjectRef *)outObject forKey:(NSString *)key inDictionary:(ENBinaryPlistObjectRef)dictionary
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (![self getMarker:&marker count:&count payloadOffset:&payload ofObject:dictionary] ||
+        (marker >> 4) != 0xD ||
+        ![self payloadOffset:payload hasCount:count ofSize:2 * _objectRefSize]) {
+        return NO;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        ENBinaryPlistObjectRef keyObject = [self objectRefAtOffset:payload + i * _objectRefSize];
+        if ([[self stringForObject:keyObject] isEqualToString:key]) {
+            *outObject = [self objectRefAtOffset:payload + (count + i) * _objectRefSize];
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSString *)stringForObject:(ENBinaryPlistObjectRef)object
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (![self getMarker:&marker count:&count payloadOffset:&payload ofObject:object]) {
+        return nil;
+    }
+    if ((marker >> 4) == 0x5 && [self payloadOffset:payload hasCount:count ofSize:1]) {
+        return [[NSString alloc] initWithBytes:_bytes + payload length:(NSUInteger)count encoding:NSASCIIStringEncoding];
+    }
+    if ((marker >> 4) == 0x6 && [self payloadOffset:payload hasCount:count ofSize:2]) {
+        return [[NSString alloc] initWithBytes:_bytes + payload length:(NSUInteger)(count * 2) encoding:NSUTF16BigEndianStringEncoding];
+    }
+    return nil;
+}
+
+- (NSData *)dataForObject:(ENBinaryPlistObjectRef)object
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (![self getMarker:&marker count:&count payloadOffset:&payload ofObject:object] ||
+        (marker >> 4) != 0x4 || ![self payloadOffset:payload hasCount:count ofSize:1]) {
+        return nil;
+    }
+    if (count == 0) {
+        return [NSData data];
+    }
+
+    // Hand out a window onto our buffer rather than a copy. The deallocator keeps the backing data
+    // (and its mapping, if any) alive for as long as the slice is.
+    NSData * backingData = self.data;
+    return [[NSData alloc] initWithBytesNoCopy:(void *)(_bytes + payload)
+                                        length:(NSUInteger)count
+                                   deallocator:^(void * bytes, NSUInteger length) {
+                                       (void)backingData;
+                                   }];
+}
+
+#pragma mark - Materialization
+
+- (id)propertyListForObject:(ENBinaryPlistObjectRef)object
+{
+    return [self propertyListForObject:object depth:0];
+}
+
+- (id)propertyListForObject:(ENBinaryPlistObjectRef)object depth:(NSUInteger)depth
+{
+    uint8_t marker = 0;
+    uint64_t count = 0, payload = 0;
+    if (depth > ENBinaryPlistMaxDepth ||
+        ![self getMarker:&marker count:&count payloadOffset:&payload ofObject:object]) {
+        return nil;
+    }
+
+    switch ([self typeOfObject:object]) {
+        case ENBinaryPlistObjectTypeNull:
+            return [NSNull null];
+        case ENBinaryPlistObjectTypeBoolean:
+            return @(marker == 0x09);
+        case ENBinaryPlistObjectTypeInteger: {
+            NSUInteger size = (NSUInteger)1 << (marker & 0x0F);
+            if (size > 8 || ![self payloadOffset:payload hasCount:size ofSize:1]) {
+                return nil;
+            }
+            uint64_t value = ENBinaryPlistReadInt(_bytes + payload, size);
+            return (size == 8) ? @((int64_t)value) : @(value);
+        }
+        case ENBinaryPlistObjectTypeReal:
+        case ENBinaryPlistObjectTypeDate: {
+            NSUInteger size = (NSUInteger)1 << (marker & 0x0F);
+            if ((size != 4 && size != 8) || ![self payloadOffset:payload hasCount:size ofSize:1]) {
+                return nil;
+            }
+            uint64_t bits = ENBinaryPlistReadInt(_bytes + payload, size);
+            double value = 0;
+            if (size == 4) {
+                uint32_t bits32 = (uint32_t)bits;
+                float value32 = 0;
+                memcpy(&value32, &bits32, sizeof(value32));
+                value = value32;
+            } else {
+                memcpy(&value, &bits, sizeof(value));
+            }
+            if ([self typeOfObject:object] == ENBinaryPlistObjectTypeDate) {
+                return [NSDate dateWithTimeIntervalSinceReferenceDate:value];
+            }
+            return @(value);
+        }
+        case ENBinaryPlistObjectTypeData:
+            return [self dataForObject:object];
+        case ENBinaryPlistObjectTypeString:
+            return [self stringForObject:object];
+        case ENBinaryPlistObjectTypeArray: {
+            NSUInteger elementCount = [self countOfObject:object];
+            NSMutableArray * array = [[NSMutableArray alloc] initWithCapacity:elementCount];
+            for (NSUInteger i = 0; i < elementCount; i++) {
+                ENBinaryPlistObjectRef element = 0;
+                id value = nil;
+                if ([self getObject:&element atIndex:i inArray:object]) {
+                    value = [self propertyListForObject:element depth:depth + 1];
+                }
+                if (!value) {
+                    return nil;
+                }
+                [array addObject:value];
+            }
+            return array;
+        }
+        case ENBinaryPlistObjectTypeDictionary: {
+            NSUInteger pairCount = [self countOfObject:object];
+            NSMutableDictionary * dictionary = [[NSMutableDictionary alloc] initWithCapacity:pairCount];
+            for (NSUInteger i = 0; i < pairCount; i++) {
+                NSString * key = [self stringForObject:[self objectRefAtOffset:payload + i * _objectRefSize]];
+                id value = [self propertyListForObject:[self objectRefAtOffset:payload + (pairCount + i) * _objectRefSize]
+                                                 depth:depth + 1];
+                if (!key || !value) {
+                    return nil;
+                }
+                dictionary[key] = value;
+            }
+            return dictionary;
+        }
+        default:
+            return nil;
+    }
+}
+@end
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENCancellationToken.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface ENCancellationToken (Internal)
+// Calls the handler once, on an arbitrary thread, when the token is cancelled; at once if it already is.
+// Returns the registration to pass to -removeCancellationHandler: when the work it cancels is done.
+- (id)addCancellationHandler:(void (^)(void))handler;
+- (void)removeCancellationHandler:(nullable id)registration;
+@end
+
+// Makes a token current until the end of the enclosing scope. ENSession flows enter their token in
+// each step, since steps run from store client completions on the main queue.
+extern void * _Nullable ENCancellationTokenPushCurrent(ENCancellationToken * _Nullable token);
+extern void ENCancellationTokenPopCurrent(void * _Nullable * _Nonnull saved);
+#define ENCancellationTokenScope(token) \
+    __attribute__((cleanup(ENCancellationTokenPopCurrent), unused)) void * ENCancellationTokenSaved = ENCancellationTokenPushCurrent(token)
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, ENConcurrencyLimiterOutcome) {
+    // The store answered, even if with an EDAM error; the call's latency counts.
+    ENConcurrencyLimiterOutcomeSuccess,
+    // The store was overloaded: a 5xx response, a timeout or a rate-limit error.
+    ENConcurrencyLimiterOutcomeOverload,
+    // The call says nothing about the store's load, as with a cancelled call or a network failure.
+    ENConcurrencyLimiterOutcomeIgnored,
+};
+
+// An adaptive limit on the calls in flight to one store (a shard's note store, say), shared by every
+// store client calling it. The limit grows additively, by about one call per round trip, while the
+// store's latency stays near its baseline and the limit is in use, and is cut multiplicatively when
+// latency climbs or the store reports overload.
+@interface ENConcurrencyLimiter : NSObject
+
+// The shared limiter for a store, or nil for a nil key.
++ (nullable ENConcurrencyLimiter *)limiterForKey:(nullable NSString *)key;
+
+@property (nonatomic, readonly) NSUInteger limit;
+@property (nonatomic, readonly) NSUInteger inFlight;
+
+// Takes a slot for a call and returns YES, or returns NO if the store is at its limit. In that case the
+// block is dispatched to the queue once a slot may be free; each caller should wait with one block at a
+// time.
+- (BOOL)acquireOrNotifyOnQueue:(dispatch_queue_t)queue block:(dispatch_block_t)block;
+
+// Gives back a slot taken by -acquireOrNotifyOnQueue:block:. A getNote with its resources takes far
+// longer than a getSyncState whatever the load, so latency is judged against the method's own baseline.
+- (void)releaseWithLatency:(NSTimeInterval)latency forMethod:(nullable NSString *)methodName outcome:(ENConcurrencyLimiterOutcome)outcome;
+
+@end
+
+NS_ASSUME_NONNULL_END
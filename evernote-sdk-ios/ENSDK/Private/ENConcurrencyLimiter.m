@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENConcurrencyLimiter.h"
+#import "ENSDKPrivate.h"
+
+static double ENConcurrencyLimiterInitialLimit = 4.0;
+static double ENConcurrencyLimiterMinimumLimit = 1.0;
+static double ENConcurrencyLimiterMaximumLimit = 32.0;
+
+// The limit is cut to this fraction on overload.
+static double ENConcurrencyLimiterBackoff = 0.75;
+
+// Latency counts as a spike once the smoothed ratio of latency to its method's baseline reaches this.
+static double ENConcurrencyLimiterLatencyTolerance = 2.0;
+
+// Weight of each sample in the smoothed values, and how quickly a baseline follows latency up.
+static double ENConcurrencyLimiterSmoothing = 0.2;
+static double ENConcurrencyLimiterBaselineDrift = 0.01;
+
+@interface ENConcurrencyLimiter ()
+@property (nonatomic, copy) NSString * key;
+@property (nonatomic, assign) double limitValue;
+@property (nonatomic, assign) NSUInteger inFlightCount;
+// The store's latency without load for each method: the lowest seen, following any lasting rise slowly.
+@property (nonatomic, strong) NSMutableDictionary * baselineLatencies;
+// Each call's latency over its method's baseline, smoothed, so that calls of every method can be weighed
+// together.
+@property (nonatomic, assign) double smoothedLatencyRatio;
+// Smoothed raw latency, as a round trip's length.
+@property (nonatomic, assign) NSTimeInterval smoothedLatency;
+@property (nonatomic, assign) NSTimeInterval lastBackoffTime;
+@property (nonatomic, strong) NSMutableArray * waiters;
+@end
+
+@implementation ENConcurrencyLimiter
+
++ (ENConcurrencyLimiter *)limiterForKey:(NSString *)key
+{
+    static NSMutableDictionary * limiters;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        limiters = [[NSMutableDictionary alloc] init];
+    });
+    if (!key) {
+        return nil;
+    }
+    @synchronized(limiters) {
+        ENConcurrencyLimiter * limiter = limiters[key];
+        if (!limiter) {
+            limiter = [[ENConcurrencyLimiter alloc] init];
+            limiter.key = key;
+            limiters[key] = limiter;
+        }
+        return limiter;
+    }
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.limitValue = ENConcurrencyLimiterInitialLimit;
+        self.baselineLatencies = [[NSMutableDictionary alloc] init];
+        self.waiters = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (NSUInteger)limit
+{
+    @synchronized(self) {
+        return (NSUInteger)self.limitValue;
+    }
+}
+
+- (NSUInteger)inFlight
+{
+    @synchronized(self) {
+        return self.inFlightCount;
+    }
+}
+
+- (BOOL)acquireOrNotifyOnQueue:(dispatch_queue_t)queue block:(dispatch_block_t)block
+{
+    @synchronized(self) {
+        if (self.inFlightCount < (NSUInteger)self.limitValue) {
+            self.inFlightCount++;
+            return YES;
+        }
+        [self.waiters addObject:@[queue, [block copy]]];
+        return NO;
+    }
+}
+
+- (void)releaseWithLatency:(NSTimeInterval)latency forMethod:(NSString *)methodName outcome:(ENConcurrencyLimiterOutcome)outcome
+{
+    NSArray * waiters = nil;
+    @synchronized(self) {
+        NSUInteger inFlight = self.inFlightCount;
+        self.inFlightCount = inFlight - 1;
+        if (outcome == ENConcurrencyLimiterOutcomeSuccess) {
+            [self addLatency:latency forMethod:methodName ?: @"" inFlight:inFlight];
+        } else if (outcome == ENConcurrencyLimiterOutcomeOverload) {
+            [self backOff];
+        }
+        if (self.inFlightCount < (NSUInteger)self.limitValue && self.waiters.count > 0) {
+            waiters = [self.waiters copy];
+            [self.waiters removeAllObjects];
+        }
+    }
+    // Every waiter tries again; those that miss out wait again.
+    for (NSArray * waiter in waiters) {
+        dispatch_async(waiter[0], waiter[1]);
+    }
+}
+
+// Called with the lock held.
+- (void)addLatency:(NSTimeInterval)latency forMethod:(NSString *)methodName inFlight:(NSUInteger)inFlight
+{
+    NSTimeInterval baselineLatency = [self.baselineLatencies[methodName] doubleValue];
+    if (baselineLatency == 0 || latency < baselineLatency) {
+        baselineLatency = latency;
+    } else {
+        baselineLatency += (latency - baselineLatency) * ENConcurrencyLimiterBaselineDrift;
+    }
+    self.baselineLatencies[methodName] = @(baselineLatency);
+    double ratio = (baselineLatency > 0) ? latency / baselineLatency : 1.0;
+    // Smoothed so that one large response does not read as the store slowing down.
+    if (self.smoothedLatency == 0) {
+        self.smoothedLatency = latency;
+        self.smoothedLatencyRatio = ratio;
+    } else {
+        self.smoothedLatency += (latency - self.smoothedLatency) * ENConcurrencyLimiterSmoothing;
+        self.smoothedLatencyRatio += (ratio - self.smoothedLatencyRatio) * ENConcurrencyLimiterSmoothing;
+    }
+
+    if (self.smoothedLatencyRatio > ENConcurrencyLimiterLatencyTolerance) {
+        [self backOff];
+    } else if (inFlight * 2 >= (NSUInteger)self.limitValue) {
+        // Only a limit that is being used has shown it can grow.
+        self.limitValue = MIN(self.limitValue + 1.0 / self.limitValue, ENConcurrencyLimiterMaximumLimit);
+    }
+}
+
+// Called with the lock held. Calls that were already in flight when the limit was cut report the same
+// overload, so the limit is cut at most once per round trip.
+- (void)backOff
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    if (now - self.lastBackoffTime < MAX(self.smoothedLatency, 0.05)) {
+        return;
+    }
+    self.lastBackoffTime = now;
+    self.limitValue = MAX(self.limitValue * ENConcurrencyLimiterBackoff, ENConcurrencyLimiterMinimumLimit);
+    ENSDKLog(Debug, Transport, @"ENConcurrencyLimiter %@ limit now %.1f", self.key, self.limitValue);
+    if (self.smoothedLatencyRatio > ENConcurrencyLimiterLatencyTolerance) {
+        // Start measuring afresh at the lower limit, or the same spike would keep cutting it.
+        self.smoothedLatencyRatio = ENConcurrencyLimiterLatencyTolerance;
+    }
+}
+
+@end
@@ -119,7 +119,7 @@
     BOOL success = [_enmlWriter startElement:tag
                                   attributes:attrDict];
     if (success == NO) {
-      ENSDKLogInfo(@"startElement:%@ returned NO, skipping element and children", tag);
+      ENSDKLog(Info, ENML, @"startElement:%@ returned NO, skipping element and children", tag);
       _skipCount++;
     }
   }
@@ -31,6 +31,9 @@
 
 @protocol ENLinkedNoteStoreClientDelegate <NSObject>
 - (NSString *)authenticationTokenForLinkedNotebookRef:(ENLinkedNotebookRef *)linkedNotebookRef;
+// Returns YES if the shared notebook's token is at hand. Otherwise starts getting it without blocking,
+// returns NO, and calls the completion once it has it or has failed to.
+- (BOOL)prepareAuthenticationForLinkedNotebookRef:(ENLinkedNotebookRef *)linkedNotebookRef orNotifyWithCompletion:(void (^)(NSError * error))completion;
 @end
 
 @interface ENLinkedNoteStoreClient : ENNoteStoreClient
@@ -28,6 +28,7 @@
 
 #import "ENLinkedNoteStoreClient.h"
 #import "ENSDKPrivate.h"
+#import "ENStoreClientMetricsInternal.h"
 
 @interface ENLinkedNoteStoreClient ()
 @property (nonatomic, strong) ENLinkedNotebookRef * linkedNotebookRef;
@@ -47,8 +48,27 @@
     return [self.delegate authenticationTokenForLinkedNotebookRef:self.linkedNotebookRef];
 }
 
+// The token is looked up from inside each call's block, so it is got beforehand rather than there.
+- (BOOL)prepareCallOrNotifyWithCompletion:(void (^)(NSError *))completion
+{
+    NSAssert(self.delegate, @"ENLinkedNoteStoreClient delegate not set");
+    return [self.delegate prepareAuthenticationForLinkedNotebookRef:self.linkedNotebookRef orNotifyWithCompletion:completion];
+}
+
 - (NSString *)noteStoreUrl
 {
     return self.linkedNotebookRef.noteStoreUrl;
 }
+
+- (ENStoreClientType)metricsStoreType
+{
+    return ENStoreClientTypeLinked;
+}
+
+// The session authenticates to each shared notebook once, so its global id stands for the token.
+- (NSString *)credentialKey
+{
+    NSString * sharedNotebookGlobalId = self.linkedNotebookRef.sharedNotebookGlobalId;
+    return sharedNotebookGlobalId ? [@"linked:" stringByAppendingString:sharedNotebookGlobalId] : nil;
+}
 @end
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class EDAMNote;
+
+// An on-disk cache of downloaded notes, with their content and resource data, keyed by note GUID and
+// tagged with the note's USN. A note is only handed back at the USN asked for, and only if its content
+// still matches the hash and length the service gave for it. Past the size limit, the notes used least
+// recently are evicted. Resource bodies are stored by their hash, once however many notes hold them.
+@interface ENNoteCache : NSObject
+- (id)initWithDirectoryURL:(NSURL *)directoryURL sizeLimit:(unsigned long long)sizeLimit;
+
+// The USN of the cached copy of the note, or 0 if there is none.
+- (int32_t)updateSequenceNumForNoteGuid:(NSString *)guid;
+
+// A resource body any cached note holds, by the MD5 hash of the body, or nil. The same buffer goes to
+// every caller while any of them holds it. Reads the disk.
+- (nullable NSData *)resourceDataWithHash:(NSData *)hash;
+
+// The cached note if it is at the given USN, holds all its resource data and checks out, else nil. Reads
+// the disk.
+- (nullable EDAMNote *)noteWithGuid:(NSString *)guid updateSequenceNum:(int32_t)updateSequenceNum;
+
+// Caches a note fetched with its content and whichever of its resource bodies it has, replacing any older
+// copy. Writes the disk.
+- (void)storeNote:(EDAMNote *)note;
+
+// Adds a resource body loaded later to the cached copy of the note, if that copy is at the given USN.
+// The copy is handed back once it holds every body. Writes the disk.
+- (void)storeResourceData:(NSData *)data withHash:(NSData *)hash forNoteGuid:(NSString *)guid updateSequenceNum:(int32_t)updateSequenceNum;
+
+- (void)removeNoteWithGuid:(NSString *)guid;
+- (void)removeAllNotes;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENNoteCache.h"
+#import "ENResourceBlobStore.h"
+#import "EDAM.h"
+#import "ENTBinaryProtocol.h"
+#import "ENTMemoryBuffer.h"
+#import "NSData+EvernoteSDK.h"
+#import "ENSDKPrivate.h"
+
+static NSString * ENNoteCacheIndexFilename = @"index.plist";
+static NSString * ENNoteCacheNoteFileExtension = @"note";
+static NSString * ENNoteCacheResourcesDirectoryName = @"resources";
+
+@interface ENNoteCache ()
+@property (nonatomic, strong) NSURL * directoryURL;
+@property (nonatomic, assign) unsigned long long sizeLimit;
+// Resource bodies, kept apart from the notes so that one attachment in many notes is stored once.
+@property (nonatomic, strong) ENResourceBlobStore * resourceStore;
+// Note GUID to a mutable dictionary of its cached USN, size and last access time. Loaded from disk on
+// first use. Access times are written out with the next change. A note's size counts its file and its
+// resource bodies, so bodies shared between notes count once for each; the cache then stays under its
+// limit, if at times further under it than it needs to.
+@property (nonatomic, strong) NSMutableDictionary * entriesByGuid;
+@property (nonatomic, assign) unsigned long long totalSize;
+@end
+
+@implementation ENNoteCache
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL sizeLimit:(unsigned long long)sizeLimit
+{
+    self = [super init];
+    if (self) {
+        self.directoryURL = directoryURL;
+        self.sizeLimit = sizeLimit;
+        self.resourceStore = [[ENResourceBlobStore alloc] initWithDirectoryURL:[directoryURL URLByAppendingPathComponent:ENNoteCacheResourcesDirectoryName]];
+    }
+    return self;
+}
+
+- (NSURL *)fileURLForNoteGuid:(NSString *)guid
+{
+    return [[self.directoryURL URLByAppendingPathComponent:guid] URLByAppendingPathExtension:ENNoteCacheNoteFileExtension];
+}
+
+#pragma mark - Index
+
+- (void)loadEntriesIfNeeded
+{
+    if (self.entriesByGuid) {
+        return;
+    }
+    self.entriesByGuid = [[NSMutableDictionary alloc] init];
+    self.totalSize = 0;
+    NSDictionary * entries = [NSDictionary dictionaryWithContentsOfURL:[self.directoryURL URLByAppendingPathComponent:ENNoteCacheIndexFilename]];
+    [entries enumerateKeysAndObjectsUsingBlock:^(NSString * guid, NSDictionary * entry, BOOL * stop) {
+        if ([entry isKindOfClass:[NSDictionary class]]) {
+            self.entriesByGuid[guid] = [entry mutableCopy];
+            self.totalSize += [entry[@"size"] unsignedLongLongValue];
+        }
+    }];
+}
+
+- (void)saveEntries
+{
+    NSError * error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+        ![self.entriesByGuid writeToURL:[self.directoryURL URLByAppendingPathComponent:ENNoteCacheIndexFilename] atomically:YES]) {
+        ENSDKLog(Error, General, @"Failed to write note cache index: %@", error);
+    }
+}
+
+- (void)removeEntryForNoteGuid:(NSString *)guid
+{
+    NSDictionary * entry = self.entriesByGuid[guid];
+    if (entry) {
+        self.totalSize -= MIN(self.totalSize, [entry[@"size"] unsignedLongLongValue]);
+        [self.entriesByGuid removeObjectForKey:guid];
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForNoteGuid:guid] error:NULL];
+    [self.resourceStore removeBodiesForOwner:guid];
+}
+
+// Drops the least recently used notes, other than the one just stored, until the cache fits.
+- (void)evictExceptNoteGuid:(NSString *)keptGuid
+{
+    if (self.totalSize <= self.sizeLimit) {
+        return;
+    }
+    NSArray * guids = [self.entriesByGuid keysSortedByValueUsingComparator:^NSComparisonResult(NSDictionary * entry1, NSDictionary * entry2) {
+        return [entry1[@"accessed"] compare:entry2[@"accessed"]];
+    }];
+    for (NSString * guid in guids) {
+        if (self.totalSize <= self.sizeLimit) {
+            break;
+        }
+        if (![guid isEqualToString:keptGuid]) {
+            [self removeEntryForNoteGuid:guid];
+        }
+    }
+}
+
+#pragma mark - Notes
+
++ (NSData *)dataFromNote:(EDAMNote *)note
+{
+    ENTMemoryBuffer * buffer = [[ENTMemoryBuffer alloc] init];
+    @try {
+        [ENTProtocolUtil writeObject:note ontoProtocol:[[ENTBinaryProtocol alloc] initWithTransport:buffer]];
+    } @catch (id e) {
+        ENSDKLog(Error, General, @"Failed to encode note %@ for the cache: %@", note.guid, e);
+        return nil;
+    }
+    return [buffer getBuffer];
+}
+
++ (EDAMNote *)noteFromData:(NSData *)data
+{
+    EDAMNote * note = [[EDAMNote alloc] init];
+    @try {
+        [ENTProtocolUtil readFromProtocol:[[ENTBinaryProtocol alloc] initWithTransport:[[ENTMemoryBuffer alloc] initWithData:data]] ontoObject:note];
+    } @catch (id e) {
+        return nil;
+    }
+    return note;
+}
+
+// A copy of the note without resource bodies, which go to the resource store instead. The note itself is
+// left as it is.
++ (EDAMNote *)noteWithoutResourceBodies:(EDAMNote *)note bodiesByHash:(NSMutableDictionary *)bodiesByHash
+{
+    if (note.resources.count == 0) {
+        return note;
+    }
+    EDAMNote * strippedNote = [note copy];
+    NSMutableArray * resources = [[NSMutableArray alloc] init];
+    for (EDAMResource * resource in note.resources) {
+        EDAMResource * strippedResource = [resource copy];
+        if (resource.data.body && resource.data.bodyHash) {
+            bodiesByHash[resource.data.bodyHash] = resource.data.body;
+            strippedResource.data = [resource.data copy];
+            strippedResource.data.body = nil;
+        }
+        [resources addObject:strippedResource];
+    }
+    strippedNote.resources = resources;
+    return strippedNote;
+}
+
+// The content against the hash the service sent with it, and each resource body against its size.
+// contentLength is documented in Unicode characters rather than bytes, so the MD5 of the UTF-8 bytes, the
+// documented integrity check, is the only one made on the content. Resource bodies are not hashed again
+// here; the resource store checked each against its hash when storing it.
++ (BOOL)isIntactNote:(EDAMNote *)note
+{
+    NSData * content = [note.content dataUsingEncoding:NSUTF8StringEncoding];
+    if (!content || ![[content enmd5] isEqualToData:note.contentHash]) {
+        return NO;
+    }
+    for (EDAMResource * resource in note.resources) {
+        if (resource.data.body.length != [resource.data.size unsignedIntegerValue]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (NSData *)resourceDataWithHash:(NSData *)hash
+{
+    return [self.resourceStore dataWithHash:hash];
+}
+
+- (int32_t)updateSequenceNumForNoteGuid:(NSString *)guid
+{
+    @synchronized(self) {
+        [self loadEntriesIfNeeded];
+        return [self.entriesByGuid[guid][@"usn"] intValue];
+    }
+}
+
+- (EDAMNote *)noteWithGuid:(NSString *)guid updateSequenceNum:(int32_t)updateSequenceNum
+{
+    @synchronized(self) {
+        [self loadEntriesIfNeeded];
+        NSMutableDictionary * entry = self.entriesByGuid[guid];
+        if (!entry || [entry[@"usn"] intValue] != updateSequenceNum) {
+            return nil;
+        }
+        entry[@"accessed"] = [NSDate date];
+    }
+    // Read outside the lock, so that a large note does not hold up other lookups. A copy replaced
+    // meanwhile fails the USN check below.
+    NSData * data = [NSData dataWithContentsOfURL:[self fileURLForNoteGuid:guid] options:NSDataReadingMappedIfSafe error:NULL];
+    EDAMNote * note = data ? [[self class] noteFromData:data] : nil;
+    if (!note || ![note.guid isEqualToString:guid] || [note.updateSequenceNum intValue] != updateSequenceNum) {
+        return nil;
+    }
+    for (EDAMResource * resource in note.resources) {
+        if (resource.data.bodyHash) {
+            resource.data.body = [self.resourceStore dataWithHash:resource.data.bodyHash];
+        }
+        if (!resource.data.body) {
+            // Stored before all its resources had loaded. Callers fill in the rest by hash.
+            return nil;
+        }
+    }
+    if (![[self class] isIntactNote:note]) {
+        ENSDKLog(Error, General, @"Cached note %@ does not match its content hash; dropping it.", guid);
+        [self removeNoteWithGuid:guid];
+        return nil;
+    }
+    return note;
+}
+
+- (void)storeNote:(EDAMNote *)note
+{
+    if (!note.guid || !note.updateSequenceNum) {
+        return;
+    }
+    NSMutableDictionary * bodiesByHash = [[NSMutableDictionary alloc] init];
+    NSData * data = [[self class] dataFromNote:[[self class] noteWithoutResourceBodies:note bodiesByHash:bodiesByHash]];
+    unsigned long long size = data.length;
+    for (NSData * body in bodiesByHash.allValues) {
+        size += body.length;
+    }
+    if (!data || size > self.sizeLimit) {
+        return;
+    }
+    @synchronized(self) {
+        [self loadEntriesIfNeeded];
+        NSDictionary * oldEntry = self.entriesByGuid[note.guid];
+        if (oldEntry) {
+            self.totalSize -= MIN(self.totalSize, [oldEntry[@"size"] unsignedLongLongValue]);
+            [self.entriesByGuid removeObjectForKey:note.guid];
+        }
+        // The bodies first: those the older copy shares with this one stay where they are.
+        NSError * error = nil;
+        if (![self.resourceStore setBodies:bodiesByHash forOwner:note.guid] ||
+            ![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+            ![data writeToURL:[self fileURLForNoteGuid:note.guid] options:NSDataWritingAtomic error:&error]) {
+            ENSDKLog(Error, General, @"Failed to write cached note %@: %@", note.guid, error);
+            [self removeEntryForNoteGuid:note.guid];
+            [self saveEntries];
+            return;
+        }
+        self.entriesByGuid[note.guid] = [@{@"usn": note.updateSequenceNum,
+                                           @"size": @(size),
+                                           @"accessed": [NSDate date]} mutableCopy];
+        self.totalSize += size;
+        [self evictExceptNoteGuid:note.guid];
+        [self saveEntries];
+    }
+}
+
+- (void)storeResourceData:(NSData *)data withHash:(NSData *)hash forNoteGuid:(NSString *)guid updateSequenceNum:(int32_t)updateSequenceNum
+{
+    @synchronized(self) {
+        [self loadEntriesIfNeeded];
+        NSMutableDictionary * entry = self.entriesByGuid[guid];
+        if (!entry || [entry[@"usn"] intValue] != updateSequenceNum) {
+            return;
+        }
+        if (![self.resourceStore addBody:data withHash:hash forOwner:guid]) {
+            return;
+        }
+        entry[@"size"] = @([entry[@"size"] unsignedLongLongValue] + data.length);
+        entry[@"accessed"] = [NSDate date];
+        self.totalSize += data.length;
+        [self evictExceptNoteGuid:guid];
+        [self saveEntries];
+    }
+}
+
+- (void)removeNoteWithGuid:(NSString *)guid
+{
+    @synchronized(self) {
+        [self loadEntriesIfNeeded];
+        [self removeEntryForNoteGuid:guid];
+        [self saveEntries];
+    }
+}
+
+- (void)removeAllNotes
+{
+    @synchronized(self) {
+        self.entriesByGuid = [[NSMutableDictionary alloc] init];
+        self.totalSize = 0;
+        [self.resourceStore removeAllBodies];
+        [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:NULL];
+    }
+}
+
+@end
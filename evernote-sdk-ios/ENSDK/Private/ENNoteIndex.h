@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class EDAMSyncChunk, EDAMNoteMetadata;
+
+// A word index of the notes in one sync scope. Titles come from the sync chunks themselves. The text of
+// each note's content and of its recognized resources comes from a getNoteSearchText call, made again
+// only when the note's content hash or a resource's recognition hash changes, so keeping the index up
+// to date costs a call per changed note rather than per note.
+//
+// Words are folded for case and diacritics, as the service's search is.
+@interface ENNoteIndex : NSObject <NSCoding>
+// The scope's lastUSN when the index last took a chunk.
+@property (nonatomic, readonly) int32_t lastUSN;
+
+// Set by the store once it has dropped the index, so that a sync still holding it does not write it back.
+@property (nonatomic, assign) BOOL discarded;
+
+// Splits text into folded words, as indexed.
++ (NSArray<NSString *> *)wordsInString:(NSString *)string;
+
+// Brings titles up to date and marks notes whose text changed as needing it again.
+- (void)applySyncChunk:(EDAMSyncChunk *)chunk;
+
+// Catches the index up with a scope it has not seen every chunk of: any note updated after the index's
+// lastUSN needs its text again, and notes the scope no longer holds are dropped.
+- (void)reconcileWithNoteMetadata:(NSArray<EDAMNoteMetadata *> *)noteMetadata lastUSN:(int32_t)lastUSN;
+
+- (void)removeAllNotes;
+
+// The notes whose text is missing or out of date, along with the signature to hand back with the text.
+- (NSDictionary<NSString *, NSData *> *)textSignaturesForNotesNeedingText;
+
+// Indexes a note's text. Ignored if the note has changed again since the signature was taken.
+- (void)setText:(NSString *)text forNoteGuid:(NSString *)guid textSignature:(NSData *)signature;
+
+// YES if the note's text is indexed and current.
+- (BOOL)hasTextForNoteGuid:(NSString *)guid;
+
+// The notes with the word, or a word starting with it, in their title or text. Notes whose text is not
+// indexed match on their title only.
+- (NSSet<NSString *> *)noteGuidsWithWord:(NSString *)word prefix:(BOOL)prefix;
+- (NSSet<NSString *> *)noteGuidsWithTitleWord:(NSString *)word prefix:(BOOL)prefix;
+@end
+
+NS_ASSUME_NONNULL_END
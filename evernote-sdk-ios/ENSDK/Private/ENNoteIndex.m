@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENNoteIndex.h"
+#import "EDAM.h"
+
+@interface ENNoteIndexEntry : NSObject <NSCoding>
+@property (nonatomic, copy) NSString * notebookGuid;
+@property (nonatomic, strong) NSArray * titleWords;
+// The words of the note's text, or nil while it is not indexed.
+@property (nonatomic, strong) NSArray * textWords;
+// The signature of the note's text as last synced, and of the text the words came from. An empty
+// signature stands for a note whose text changed in a way the index did not see.
+@property (nonatomic, strong) NSData * textSignature;
+@property (nonatomic, strong) NSData * indexedTextSignature;
+@end
+
+@implementation ENNoteIndexEntry
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.titleWords = @[];
+        self.textSignature = [NSData data];
+    }
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+    [encoder encodeObject:self.notebookGuid forKey:@"notebookGuid"];
+    [encoder encodeObject:self.titleWords forKey:@"titleWords"];
+    [encoder encodeObject:self.textWords forKey:@"textWords"];
+    [encoder encodeObject:self.textSignature forKey:@"textSignature"];
+    [encoder encodeObject:self.indexedTextSignature forKey:@"indexedTextSignature"];
+}
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+    self = [super init];
+    if (self) {
+        self.notebookGuid = [decoder decodeObjectForKey:@"notebookGuid"];
+        self.titleWords = [decoder decodeObjectForKey:@"titleWords"] ?: @[];
+        self.textWords = [decoder decodeObjectForKey:@"textWords"];
+        self.textSignature = [decoder decodeObjectForKey:@"textSignature"] ?: [NSData data];
+        self.indexedTextSignature = [decoder decodeObjectForKey:@"indexedTextSignature"];
+    }
+    return self;
+}
+
+@end
+
+@interface ENNoteIndex ()
+@property (nonatomic, assign) int32_t lastUSN;
+@property (nonatomic, strong) NSMutableDictionary * entriesByGuid;
+// Word to the set of note GUIDs, rebuilt from the entries when the index is loaded.
+@property (nonatomic, strong) NSMutableDictionary * titlePostings;
+@property (nonatomic, strong) NSMutableDictionary * textPostings;
+@end
+
+@implementation ENNoteIndex
+
++ (NSArray *)wordsInString:(NSString *)string
+{
+    NSMutableArray * words = [[NSMutableArray alloc] init];
+    if (string.length == 0) {
+        return words;
+    }
+    [string enumerateSubstringsInRange:NSMakeRange(0, string.length)
+                               options:NSStringEnumerationByWords
+                            usingBlock:^(NSString * substring, NSRange substringRange, NSRange enclosingRange, BOOL * stop) {
+        [words addObject:[substring stringByFoldingWithOptions:(NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch) locale:nil]];
+    }];
+    return words;
+}
+
++ (NSArray *)uniqueWordsInString:(NSString *)string
+{
+    return [[NSSet setWithArray:[self wordsInString:string]] allObjects];
+}
+
+// The note's content hash followed by the recognition hash of each resource, in resource order.
++ (NSData *)textSignatureOfNote:(EDAMNote *)note
+{
+    NSMutableData * signature = [NSMutableData dataWithData:note.contentHash ?: [NSData data]];
+    NSArray * resources = [note.resources sortedArrayUsingComparator:^NSComparisonResult(EDAMResource * resource1, EDAMResource * resource2) {
+        return [resource1.guid ?: @"" compare:resource2.guid ?: @""];
+    }];
+    for (EDAMResource * resource in resources) {
+        if (resource.recognition.bodyHash) {
+            [signature appendData:resource.recognition.bodyHash];
+        }
+    }
+    return signature;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.entriesByGuid = [[NSMutableDictionary alloc] init];
+        self.titlePostings = [[NSMutableDictionary alloc] init];
+        self.textPostings = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+#pragma mark - Postings
+
+- (void)addWords:(NSArray *)words forNoteGuid:(NSString *)guid toPostings:(NSMutableDictionary *)postings
+{
+    for (NSString * word in words) {
+        NSMutableSet * guids = postings[word];
+        if (!guids) {
+            guids = [[NSMutableSet alloc] init];
+            postings[word] = guids;
+        }
+        [guids addObject:guid];
+    }
+}
+
+- (void)removeWords:(NSArray *)words forNoteGuid:(NSString *)guid fromPostings:(NSMutableDictionary *)postings
+{
+    for (NSString * word in words) {
+        NSMutableSet * guids = postings[word];
+        [guids removeObject:guid];
+        if (guids.count == 0) {
+            [postings removeObjectForKey:word];
+        }
+    }
+}
+
+- (void)setTitle:(NSString *)title ofEntry:(ENNoteIndexEntry *)entry guid:(NSString *)guid
+{
+    NSArray * titleWords = [[self class] uniqueWordsInString:title];
+    [self removeWords:entry.titleWords forNoteGuid:guid fromPostings:self.titlePostings];
+    entry.titleWords = titleWords;
+    [self addWords:titleWords forNoteGuid:guid toPostings:self.titlePostings];
+}
+
+- (void)removeTextOfEntry:(ENNoteIndexEntry *)entry guid:(NSString *)guid
+{
+    [self removeWords:entry.textWords forNoteGuid:guid fromPostings:self.textPostings];
+    entry.textWords = nil;
+    entry.indexedTextSignature = nil;
+}
+
+- (void)removeNoteWithGuid:(NSString *)guid
+{
+    ENNoteIndexEntry * entry = self.entriesByGuid[guid];
+    if (entry) {
+        [self removeWords:entry.titleWords forNoteGuid:guid fromPostings:self.titlePostings];
+        [self removeTextOfEntry:entry guid:guid];
+        [self.entriesByGuid removeObjectForKey:guid];
+    }
+}
+
+- (ENNoteIndexEntry *)entryForNoteGuid:(NSString *)guid
+{
+    ENNoteIndexEntry * entry = self.entriesByGuid[guid];
+    if (!entry) {
+        entry = [[ENNoteIndexEntry alloc] init];
+        self.entriesByGuid[guid] = entry;
+    }
+    return entry;
+}
+
+#pragma mark - Updating
+
+- (void)applySyncChunk:(EDAMSyncChunk *)chunk
+{
+    @synchronized(self) {
+        for (EDAMNote * note in chunk.notes) {
+            if (note.active && ![note.active boolValue]) {
+                [self removeNoteWithGuid:note.guid];
+                continue;
+            }
+            ENNoteIndexEntry * entry = [self entryForNoteGuid:note.guid];
+            entry.notebookGuid = note.notebookGuid;
+            [self setTitle:note.title ofEntry:entry guid:note.guid];
+            NSData * signature = [[self class] textSignatureOfNote:note];
+            if (![entry.textSignature isEqualToData:signature]) {
+                entry.textSignature = signature;
+                [self removeTextOfEntry:entry guid:note.guid];
+            }
+        }
+        for (NSString * guid in chunk.expungedNotes) {
+            [self removeNoteWithGuid:guid];
+        }
+        if (chunk.expungedNotebooks.count > 0) {
+            NSSet * expungedNotebookGuids = [NSSet setWithArray:chunk.expungedNotebooks];
+            for (NSString * guid in [self.entriesByGuid allKeys]) {
+                if ([expungedNotebookGuids containsObject:[self.entriesByGuid[guid] notebookGuid]]) {
+                    [self removeNoteWithGuid:guid];
+                }
+            }
+        }
+        if (chunk.chunkHighUSN) {
+            self.lastUSN = MAX(self.lastUSN, [chunk.chunkHighUSN intValue]);
+        }
+    }
+}
+
+- (void)reconcileWithNoteMetadata:(NSArray *)noteMetadata lastUSN:(int32_t)lastUSN
+{
+    @synchronized(self) {
+        NSMutableSet * guids = [[NSMutableSet alloc] init];
+        for (EDAMNoteMetadata * metadata in noteMetadata) {
+            [guids addObject:metadata.guid];
+            ENNoteIndexEntry * entry = [self entryForNoteGuid:metadata.guid];
+            entry.notebookGuid = metadata.notebookGuid;
+            [self setTitle:metadata.title ofEntry:entry guid:metadata.guid];
+            if ([metadata.updateSequenceNum intValue] > self.lastUSN) {
+                // Metadata carries no hashes, so whether the text changed can't be told.
+                entry.textSignature = [NSData data];
+                [self removeTextOfEntry:entry guid:metadata.guid];
+            }
+        }
+        for (NSString * guid in [self.entriesByGuid allKeys]) {
+            if (![guids containsObject:guid]) {
+                [self removeNoteWithGuid:guid];
+            }
+        }
+        self.lastUSN = lastUSN;
+    }
+}
+
+- (void)removeAllNotes
+{
+    @synchronized(self) {
+        [self.entriesByGuid removeAllObjects];
+        [self.titlePostings removeAllObjects];
+        [self.textPostings removeAllObjects];
+        self.lastUSN = 0;
+    }
+}
+
+- (NSDictionary *)textSignaturesForNotesNeedingText
+{
+    @synchronized(self) {
+        NSMutableDictionary * signatures = [[NSMutableDictionary alloc] init];
+        [self.entriesByGuid enumerateKeysAndObjectsUsingBlock:^(NSString * guid, ENNoteIndexEntry * entry, BOOL * stop) {
+            if (!entry.textWords) {
+                signatures[guid] = entry.textSignature;
+            }
+        }];
+        return signatures;
+    }
+}
+
+- (void)setText:(NSString *)text forNoteGuid:(NSString *)guid textSignature:(NSData *)signature
+{
+    NSArray * textWords = [[self class] uniqueWordsInString:text];
+    @synchronized(self) {
+        ENNoteIndexEntry * entry = self.entriesByGuid[guid];
+        if (!entry || ![entry.textSignature isEqualToData:signature]) {
+            return;
+        }
+        [self removeTextOfEntry:entry guid:guid];
+        entry.textWords = textWords;
+        entry.indexedTextSignature = signature;
+        [self addWords:textWords forNoteGuid:guid toPostings:self.textPostings];
+    }
+}
+
+#pragma mark - Looking up
+
+- (BOOL)hasTextForNoteGuid:(NSString *)guid
+{
+    @synchronized(self) {
+        return ([self.entriesByGuid[guid] textWords] != nil);
+    }
+}
+
+- (void)addGuidsWithWord:(NSString *)word prefix:(BOOL)prefix inPostings:(NSDictionary *)postings toSet:(NSMutableSet *)guids
+{
+    if (!prefix) {
+        [guids unionSet:postings[word] ?: [NSSet set]];
+        return;
+    }
+    [postings enumerateKeysAndObjectsUsingBlock:^(NSString * postedWord, NSSet * postedGuids, BOOL * stop) {
+        if ([postedWord hasPrefix:word]) {
+            [guids unionSet:postedGuids];
+        }
+    }];
+}
+
+- (NSSet *)noteGuidsWithWord:(NSString *)word prefix:(BOOL)prefix
+{
+    NSMutableSet * guids = [[NSMutableSet alloc] init];
+    @synchronized(self) {
+        [self addGuidsWithWord:word prefix:prefix inPostings:self.titlePostings toSet:guids];
+        [self addGuidsWithWord:word prefix:prefix inPostings:self.textPostings toSet:guids];
+    }
+    return guids;
+}
+
+- (NSSet *)noteGuidsWithTitleWord:(NSString *)word prefix:(BOOL)prefix
+{
+    NSMutableSet * guids = [[NSMutableSet alloc] init];
+    @synchronized(self) {
+        [self addGuidsWithWord:word prefix:prefix inPostings:self.titlePostings toSet:guids];
+    }
+    return guids;
+}
+
+#pragma mark - NSCoding
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+    @synchronized(self) {
+        [encoder encodeInt32:self.lastUSN forKey:@"lastUSN"];
+        [encoder encodeObject:self.entriesByGuid forKey:@"entries"];
+    }
+}
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+    self = [self init];
+    if (self) {
+        self.lastUSN = [decoder decodeInt32ForKey:@"lastUSN"];
+        NSDictionary * entriesByGuid = [decoder decodeObjectForKey:@"entries"];
+        [entriesByGuid enumerateKeysAndObjectsUsingBlock:^(NSString * guid, ENNoteIndexEntry * entry, BOOL * stop) {
+            self.entriesByGuid[guid] = entry;
+            [self addWords:entry.titleWords forNoteGuid:guid toPostings:self.titlePostings];
+            [self addWords:entry.textWords forNoteGuid:guid toPostings:self.textPostings];
+        }];
+    }
+    return self;
+}
+
+@end
@@ -39,6 +39,9 @@ typedef NS_ENUM(NSInteger, ENNoteRefType) {
 @property (nonatomic, assign) ENNoteRefType type;
 @property (nonatomic, copy) NSString * guid;
 @property (nonatomic, strong) ENLinkedNotebookRef * linkedNotebook;
+// The note's USN when the ref was made from a search result, else 0. Lets a download be answered from
+// the note cache without asking the service. Not archived, and not part of equality.
+@property (nonatomic, assign) int32_t updateSequenceNum;
 @end
 
 #endif
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class ENNoteIndex, EDAMNoteMetadata, EDAMNotebook, EDAMTag;
+
+// A search in the part of the Evernote search grammar that can be answered from the local store: words,
+// with a trailing * for a prefix, and the notebook:, tag:, intitle:, created:, updated: and
+// sourceApplication: operators. Any term can be negated with a leading -, and a leading any: matches
+// notes with any of the terms rather than all of them.
+@interface ENNoteSearchQuery : NSObject
+// nil if the search uses anything outside that part, such as a phrase or another operator.
++ (nullable ENNoteSearchQuery *)queryWithSearchString:(NSString *)searchString;
+
+// YES if the search has plain words, which only an index holding the notes' text can answer.
+@property (nonatomic, readonly) BOOL matchesNoteText;
+
+// The notes among the given ones that match, or nil if the answer depends on the text of a note that is
+// not indexed yet. The notebooks and tags are the scope's, to look names up in.
+- (nullable NSArray<EDAMNoteMetadata *> *)matchingNoteMetadata:(NSArray<EDAMNoteMetadata *> *)noteMetadata
+                                                         index:(ENNoteIndex *)index
+                                                     notebooks:(NSArray<EDAMNotebook *> *)notebooks
+                                                          tags:(NSArray<EDAMTag *> *)tags;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENNoteSearchQuery.h"
+#import "ENNoteIndex.h"
+#import "EDAM.h"
+#import "NSRegularExpression+ENAGRegex.h"
+
+typedef NS_ENUM(NSInteger, ENNoteSearchTermType) {
+    ENNoteSearchTermTypeWord,
+    ENNoteSearchTermTypeInTitle,
+    ENNoteSearchTermTypeNotebook,
+    ENNoteSearchTermTypeTag,
+    ENNoteSearchTermTypeCreated,
+    ENNoteSearchTermTypeUpdated,
+    ENNoteSearchTermTypeSourceApplication
+};
+
+// Whether a note matches a term. A word can't be ruled out in a note whose text is not indexed.
+typedef NS_ENUM(NSInteger, ENNoteSearchMatch) {
+    ENNoteSearchMatchNo,
+    ENNoteSearchMatchYes,
+    ENNoteSearchMatchUnknown
+};
+
+@interface ENNoteSearchTerm : NSObject <NSCopying>
+@property (nonatomic, assign) ENNoteSearchTermType type;
+@property (nonatomic, assign) BOOL negated;
+// Folded, for words and names.
+@property (nonatomic, copy) NSString * value;
+@property (nonatomic, assign) BOOL prefix;
+@property (nonatomic, assign) EDAMTimestamp timestamp;
+// Looked up once per scope before the notes are checked, on a copy of the term.
+@property (nonatomic, strong) NSSet * noteGuids;
+@property (nonatomic, strong) NSSet * objectGuids;
+@end
+
+@implementation ENNoteSearchTerm
+
+- (id)copyWithZone:(NSZone *)zone
+{
+    ENNoteSearchTerm * term = [[ENNoteSearchTerm alloc] init];
+    term.type = self.type;
+    term.negated = self.negated;
+    term.value = self.value;
+    term.prefix = self.prefix;
+    term.timestamp = self.timestamp;
+    return term;
+}
+
+@end
+
+@interface ENNoteSearchQuery ()
+@property (nonatomic, strong) NSArray * terms;
+@property (nonatomic, assign) BOOL matchesAny;
+@end
+
+@implementation ENNoteSearchQuery
+
++ (ENNoteSearchQuery *)queryWithSearchString:(NSString *)searchString
+{
+    NSArray * tokens = [self tokensInSearchString:searchString];
+    if (!tokens) {
+        return nil;
+    }
+    ENNoteSearchQuery * query = [[ENNoteSearchQuery alloc] init];
+    NSMutableArray * terms = [[NSMutableArray alloc] init];
+    for (NSUInteger i = 0; i < tokens.count; i++) {
+        NSString * token = tokens[i];
+        if (i == 0 && [token caseInsensitiveCompare:@"any:"] == NSOrderedSame) {
+            query.matchesAny = YES;
+            continue;
+        }
+        ENNoteSearchTerm * term = [[ENNoteSearchTerm alloc] init];
+        if ([token hasPrefix:@"-"]) {
+            term.negated = YES;
+            token = [token substringFromIndex:1];
+        }
+        NSString * value = token;
+        term.type = ENNoteSearchTermTypeWord;
+        NSRange colon = [token rangeOfString:@":"];
+        if (colon.location != NSNotFound && ![token hasPrefix:@"\""]) {
+            NSNumber * type = [self termTypesByOperator][[[token substringToIndex:colon.location] lowercaseString]];
+            if (!type) {
+                return nil;
+            }
+            term.type = [type integerValue];
+            value = [token substringFromIndex:NSMaxRange(colon)];
+        }
+        if (![self parseValue:value intoTerm:term]) {
+            return nil;
+        }
+        if (term.value || term.type == ENNoteSearchTermTypeCreated || term.type == ENNoteSearchTermTypeUpdated) {
+            [terms addObject:term];
+        }
+    }
+    query.terms = terms;
+    return query;
+}
+
+- (BOOL)matchesNoteText
+{
+    for (ENNoteSearchTerm * term in self.terms) {
+        if (term.type == ENNoteSearchTermTypeWord) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
++ (NSDictionary *)termTypesByOperator
+{
+    static NSDictionary * termTypesByOperator = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        termTypesByOperator = @{@"intitle": @(ENNoteSearchTermTypeInTitle),
+                                @"notebook": @(ENNoteSearchTermTypeNotebook),
+                                @"tag": @(ENNoteSearchTermTypeTag),
+                                @"created": @(ENNoteSearchTermTypeCreated),
+                                @"updated": @(ENNoteSearchTermTypeUpdated),
+                                @"sourceapplication": @(ENNoteSearchTermTypeSourceApplication)};
+    });
+    return termTypesByOperator;
+}
+
+// Splits on whitespace outside double quotes. nil if a quote is left open.
++ (NSArray *)tokensInSearchString:(NSString *)searchString
+{
+    NSMutableArray * tokens = [[NSMutableArray alloc] init];
+    NSMutableString * token = [[NSMutableString alloc] init];
+    NSCharacterSet * whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+    BOOL quoted = NO;
+    for (NSUInteger i = 0; i < searchString.length; i++) {
+        unichar c = [searchString characterAtIndex:i];
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (!quoted && [whitespace characterIsMember:c]) {
+            if (token.length > 0) {
+                [tokens addObject:[token copy]];
+                [token setString:@""];
+            }
+            continue;
+        }
+        [token appendFormat:@"%C", c];
+    }
+    if (quoted) {
+        return nil;
+    }
+    if (token.length > 0) {
+        [tokens addObject:[token copy]];
+    }
+    return tokens;
+}
+
++ (BOOL)parseValue:(NSString *)value intoTerm:(ENNoteSearchTerm *)term
+{
+    BOOL quoted = NO;
+    if (value.length >= 2 && [value hasPrefix:@"\""] && [value hasSuffix:@"\""]) {
+        value = [value substringWithRange:NSMakeRange(1, value.length - 2)];
+        quoted = YES;
+    }
+    if ([value rangeOfString:@"\""].location != NSNotFound) {
+        return NO;
+    }
+    if (!quoted && [value hasSuffix:@"*"]) {
+        term.prefix = YES;
+        value = [value substringToIndex:value.length - 1];
+    }
+    
+    switch (term.type) {
+        case ENNoteSearchTermTypeWord:
+        case ENNoteSearchTermTypeInTitle: {
+            // Words are matched one at a time; a phrase or a hyphenated word would need their order.
+            NSArray * words = [ENNoteIndex wordsInString:value];
+            if (words.count > 1) {
+                return NO;
+            }
+            term.value = [words firstObject];
+            return YES;
+        }
+        case ENNoteSearchTermTypeNotebook:
+        case ENNoteSearchTermTypeTag:
+            if (term.prefix && term.type == ENNoteSearchTermTypeNotebook) {
+                return NO;
+            }
+            term.value = value.length > 0 ? [self foldedName:value] : nil;
+            return YES;
+        case ENNoteSearchTermTypeCreated:
+        case ENNoteSearchTermTypeUpdated: {
+            NSDate * date = term.prefix ? nil : [self dateFromSearchValue:value];
+            term.timestamp = (EDAMTimestamp)([date timeIntervalSince1970] * 1000.0);
+            return (date != nil);
+        }
+        case ENNoteSearchTermTypeSourceApplication:
+            term.value = value.length > 0 ? value : nil;
+            return !term.prefix;
+    }
+    return NO;
+}
+
++ (NSString *)foldedName:(NSString *)name
+{
+    return [name stringByFoldingWithOptions:(NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch) locale:nil];
+}
+
+// An absolute date, yyyyMMdd with an optional 'T'HHmmss and a trailing Z for UTC, or the start of the
+// current day, week, month or year, optionally moved by a number of them, as in week-1.
++ (NSDate *)dateFromSearchValue:(NSString *)value
+{
+    NSCalendar * calendar = [NSCalendar currentCalendar];
+    NSDictionary * unitsByName = @{@"day": @(NSCalendarUnitDay),
+                                   @"week": @(NSCalendarUnitWeekOfYear),
+                                   @"month": @(NSCalendarUnitMonth),
+                                   @"year": @(NSCalendarUnitYear)};
+    NSRegularExpression * relative = [NSRegularExpression enCachedRegexWithPattern:@"(?i)^(day|week|month|year)([-+][0-9]+)?$"];
+    NSTextCheckingResult * match = [relative firstMatchInString:value options:0 range:NSMakeRange(0, value.length)];
+    if (match) {
+        NSCalendarUnit unit = [unitsByName[[[value substringWithRange:[match rangeAtIndex:1]] lowercaseString]] unsignedIntegerValue];
+        NSDate * start = nil;
+        if (![calendar rangeOfUnit:unit startDate:&start interval:NULL forDate:[NSDate date]]) {
+            return nil;
+        }
+        NSInteger offset = 0;
+        if ([match rangeAtIndex:2].location != NSNotFound) {
+            offset = [[value substringWithRange:[match rangeAtIndex:2]] integerValue];
+        }
+        return [calendar dateByAddingUnit:unit value:offset toDate:start options:0];
+    }
+    
+    NSRegularExpression * absolute = [NSRegularExpression enCachedRegexWithPattern:@"(?i)^[0-9]{8}(T[0-9]{6})?(Z)?$"];
+    match = [absolute firstMatchInString:value options:0 range:NSMakeRange(0, value.length)];
+    if (!match) {
+        return nil;
+    }
+    BOOL hasTime = ([match rangeAtIndex:1].location != NSNotFound);
+    BOOL isUTC = ([match rangeAtIndex:2].location != NSNotFound);
+    NSString * dateString = [value uppercaseString];
+    if (isUTC) {
+        dateString = [dateString substringToIndex:dateString.length - 1];
+    }
+    return [[self searchDateFormatterWithTime:hasTime UTC:isUTC] dateFromString:dateString];
+}
+
+// One formatter for each format and time zone. Formatters are thread-safe, so searches share them.
++ (NSDateFormatter *)searchDateFormatterWithTime:(BOOL)hasTime UTC:(BOOL)isUTC
+{
+    static NSArray * formatters = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        NSLocale * locale = [[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"];
+        NSCalendar * calendar = [[NSCalendar alloc] initWithCalendarIdentifier:NSCalendarIdentifierGregorian];
+        NSMutableArray * allFormatters = [[NSMutableArray alloc] init];
+        for (NSString * dateFormat in @[@"yyyyMMdd", @"yyyyMMdd'T'HHmmss"]) {
+            for (NSTimeZone * timeZone in @[[NSTimeZone localTimeZone], [NSTimeZone timeZoneForSecondsFromGMT:0]]) {
+                NSDateFormatter * formatter = [[NSDateFormatter alloc] init];
+                formatter.locale = locale;
+                formatter.calendar = calendar;
+                formatter.timeZone = timeZone;
+                formatter.dateFormat = dateFormat;
+                [allFormatters addObject:formatter];
+            }
+        }
+        formatters = allFormatters;
+    });
+    return formatters[(hasTime ? 2 : 0) + (isUTC ? 1 : 0)];
+}
+
+#pragma mark - Matching
+
+- (NSArray *)matchingNoteMetadata:(NSArray *)noteMetadata index:(ENNoteIndex *)index notebooks:(NSArray *)notebooks tags:(NSArray *)tags
+{
+    // Each term's notes, notebooks or tags are found once, so that checking a note is a few set lookups.
+    NSMutableArray * terms = [[NSMutableArray alloc] init];
+    for (ENNoteSearchTerm * queryTerm in self.terms) {
+        ENNoteSearchTerm * term = [queryTerm copy];
+        [terms addObject:term];
+        switch (term.type) {
+            case ENNoteSearchTermTypeWord: {
+                term.noteGuids = [index noteGuidsWithWord:term.value prefix:term.prefix];
+                // A note's tags count as its words, by their current names.
+                NSMutableSet * tagGuids = [[NSMutableSet alloc] init];
+                for (EDAMTag * tag in tags) {
+                    for (NSString * word in [ENNoteIndex wordsInString:tag.name]) {
+                        if (term.prefix ? [word hasPrefix:term.value] : [word isEqualToString:term.value]) {
+                            [tagGuids addObject:tag.guid];
+                            break;
+                        }
+                    }
+                }
+                term.objectGuids = tagGuids;
+                break;
+            }
+            case ENNoteSearchTermTypeInTitle:
+                term.noteGuids = [index noteGuidsWithTitleWord:term.value prefix:term.prefix];
+                break;
+            case ENNoteSearchTermTypeNotebook: {
+                NSMutableSet * notebookGuids = [[NSMutableSet alloc] init];
+                for (EDAMNotebook * notebook in notebooks) {
+                    if ([[[self class] foldedName:notebook.name ?: @""] isEqualToString:term.value]) {
+                        [notebookGuids addObject:notebook.guid];
+                    }
+                }
+                term.objectGuids = notebookGuids;
+                break;
+            }
+            case ENNoteSearchTermTypeTag: {
+                NSMutableSet * tagGuids = [[NSMutableSet alloc] init];
+                for (EDAMTag * tag in tags) {
+                    NSString * name = [[self class] foldedName:tag.name ?: @""];
+                    if (term.prefix ? [name hasPrefix:term.value] : [name isEqualToString:term.value]) {
+                        [tagGuids addObject:tag.guid];
+                    }
+                }
+                term.objectGuids = tagGuids;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    
+    NSMutableArray * results = [[NSMutableArray alloc] init];
+    for (EDAMNoteMetadata * metadata in noteMetadata) {
+        ENNoteSearchMatch match = [self matchNoteMetadata:metadata terms:terms index:index];
+        if (match == ENNoteSearchMatchUnknown) {
+            return nil;
+        }
+        if (match == ENNoteSearchMatchYes) {
+            [results addObject:metadata];
+        }
+    }
+    return results;
+}
+
+- (ENNoteSearchMatch)matchNoteMetadata:(EDAMNoteMetadata *)metadata terms:(NSArray *)terms index:(ENNoteIndex *)index
+{
+    if (terms.count == 0) {
+        return ENNoteSearchMatchYes;
+    }
+    BOOL unknown = NO;
+    for (ENNoteSearchTerm * term in terms) {
+        ENNoteSearchMatch match = [self matchTerm:term noteMetadata:metadata index:index];
+        if (match == ENNoteSearchMatchUnknown) {
+            unknown = YES;
+        } else if ((match == ENNoteSearchMatchYes) == self.matchesAny) {
+            // The first match decides an any: search, and the first miss any other.
+            return match;
+        }
+    }
+    if (unknown) {
+        return ENNoteSearchMatchUnknown;
+    }
+    return self.matchesAny ? ENNoteSearchMatchNo : ENNoteSearchMatchYes;
+}
+
+- (ENNoteSearchMatch)matchTerm:(ENNoteSearchTerm *)term noteMetadata:(EDAMNoteMetadata *)metadata index:(ENNoteIndex *)index
+{
+    ENNoteSearchMatch match = ENNoteSearchMatchNo;
+    switch (term.type) {
+        case ENNoteSearchTermTypeWord:
+            if ([term.noteGuids containsObject:metadata.guid] ||
+                [term.objectGuids intersectsSet:[NSSet setWithArray:metadata.tagGuids ?: @[]]]) {
+                match = ENNoteSearchMatchYes;
+            } else if (![index hasTextForNoteGuid:metadata.guid]) {
+                match = ENNoteSearchMatchUnknown;
+            }
+            break;
+        case ENNoteSearchTermTypeInTitle:
+            match = [term.noteGuids containsObject:metadata.guid] ? ENNoteSearchMatchYes : ENNoteSearchMatchNo;
+            break;
+        case ENNoteSearchTermTypeNotebook:
+            match = [term.objectGuids containsObject:metadata.notebookGuid] ? ENNoteSearchMatchYes : ENNoteSearchMatchNo;
+            break;
+        case ENNoteSearchTermTypeTag:
+            match = [term.objectGuids intersectsSet:[NSSet setWithArray:metadata.tagGuids ?: @[]]] ? ENNoteSearchMatchYes : ENNoteSearchMatchNo;
+            break;
+        case ENNoteSearchTermTypeCreated:
+            match = ([metadata.created longLongValue] >= term.timestamp) ? ENNoteSearchMatchYes : ENNoteSearchMatchNo;
+            break;
+        case ENNoteSearchTermTypeUpdated:
+            match = ([metadata.updated longLongValue] >= term.timestamp) ? ENNoteSearchMatchYes : ENNoteSearchMatchNo;
+            break;
+        case ENNoteSearchTermTypeSourceApplication:
+            if (metadata.attributes.sourceApplication &&
+                [metadata.attributes.sourceApplication caseInsensitiveCompare:term.value] == NSOrderedSame) {
+                match = ENNoteSearchMatchYes;
+            }
+            break;
+    }
+    if (term.negated && match != ENNoteSearchMatchUnknown) {
+        match = (match == ENNoteSearchMatchYes) ? ENNoteSearchMatchNo : ENNoteSearchMatchYes;
+    }
+    return match;
+}
+
+@end
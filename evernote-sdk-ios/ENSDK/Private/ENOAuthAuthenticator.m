@@ -116,7 +116,7 @@ NSString * ENOAuthAuthenticatorAuthInfoAppNotebookIsLinked = @"ENOAuthAuthentica
     NSAssert(self.delegate, @"Must set authenticator delegate");
     
     if (self.inProgress) {
-        ENSDKLogError(@"Cannot reuse single instance of %@", [self class]);
+        ENSDKLog(Error, Auth, @"Cannot reuse single instance of %@", [self class]);
         return;
     }
     
@@ -296,7 +296,7 @@ NSString * ENOAuthAuthenticatorAuthInfoAppNotebookIsLinked = @"ENOAuthAuthentica
         string = [string substringToIndex:maxLength];
     }
     
-    NSRegularExpression * regex = [NSRegularExpression enRegexWithPattern: regexPattern];
+    NSRegularExpression * regex = [NSRegularExpression enCachedRegexWithPattern: regexPattern];
     if ([regex enFindInString: string] == NO) {
         NSMutableString * newString = [NSMutableString stringWithCapacity: [string length]];
         for (NSUInteger i = 0; i < [string length]; i++) {
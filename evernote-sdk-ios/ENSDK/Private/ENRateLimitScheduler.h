@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Rate-limit state shared by every store client in the process, keyed by store. When one client is told
+// to back off, the others calling the same store hold their calls too instead of each running into the
+// limit on its own.
+@interface ENRateLimitScheduler : NSObject
++ (ENRateLimitScheduler *)sharedScheduler;
+
+// Records a rate-limit error from the store asking callers to wait the given number of seconds. A store
+// that rate-limits again soon after its last window ended gets an extra, doubling margin on top.
+- (void)noteRateLimitForKey:(NSString *)key duration:(NSTimeInterval)duration;
+
+// How long calls to the store should still wait, or 0 if they may go now.
+- (NSTimeInterval)waitForKey:(nullable NSString *)key;
+
+// A random delay to add to a wait that ends now, so that clients held by the same window do not all
+// resume at the same instant.
+- (NSTimeInterval)jitterForWait:(NSTimeInterval)wait;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENRateLimitScheduler.h"
+#import "ENSDKPrivate.h"
+
+// The most extra wait added for a store that keeps rate-limiting.
+static NSTimeInterval ENRateLimitSchedulerMaximumBackoff = 60.0;
+
+// The most jitter added to a wait.
+static NSTimeInterval ENRateLimitSchedulerMaximumJitter = 2.0;
+
+@interface ENRateLimitState : NSObject
+@property (nonatomic, assign) NSTimeInterval resumeTime;
+@property (nonatomic, assign) NSUInteger strikes;
+@end
+
+@implementation ENRateLimitState
+@end
+
+@interface ENRateLimitScheduler ()
+@property (nonatomic, strong) NSMutableDictionary * states;
+@end
+
+@implementation ENRateLimitScheduler
+
++ (ENRateLimitScheduler *)sharedScheduler
+{
+    static ENRateLimitScheduler * sharedScheduler;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedScheduler = [[ENRateLimitScheduler alloc] init];
+    });
+    return sharedScheduler;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.states = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (void)noteRateLimitForKey:(NSString *)key duration:(NSTimeInterval)duration
+{
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    NSTimeInterval wait = 0;
+    @synchronized(self) {
+        ENRateLimitState * state = self.states[key];
+        if (!state) {
+            state = [[ENRateLimitState alloc] init];
+            self.states[key] = state;
+        }
+        if (state.resumeTime > now) {
+            // Another call already reported this window.
+            return;
+        }
+        // Limited again within a window's length of the last one ending: the store's own estimate was
+        // not enough, so back off further each time.
+        BOOL repeated = (state.strikes > 0 && now - state.resumeTime < duration);
+        state.strikes = repeated ? state.strikes + 1 : 1;
+        NSTimeInterval backoff = (state.strikes > 1) ? MIN(pow(2.0, state.strikes - 2), ENRateLimitSchedulerMaximumBackoff) : 0;
+        wait = duration + backoff;
+        state.resumeTime = now + wait;
+    }
+    ENSDKLog(Info, Transport, @"ENRateLimitScheduler holding calls to %@ for %.0fs", key, wait);
+}
+
+- (NSTimeInterval)waitForKey:(NSString *)key
+{
+    if (!key) {
+        return 0;
+    }
+    NSTimeInterval resumeTime = 0;
+    @synchronized(self) {
+        resumeTime = [self.states[key] resumeTime];
+    }
+    return MAX(resumeTime - [NSDate timeIntervalSinceReferenceDate], 0);
+}
+
+- (NSTimeInterval)jitterForWait:(NSTimeInterval)wait
+{
+    NSTimeInterval range = MIN(0.1 + wait * 0.1, ENRateLimitSchedulerMaximumJitter);
+    return range * arc4random_uniform(1000) / 1000.0;
+}
+
+@end
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// A content-addressed store of resource bodies on disk, keyed by the MD5 hash of each body, so that an
+// attachment that appears in many notes is kept once. Each body is referenced by the owners (note GUIDs)
+// that hold it, and removed along with the last of them. Bodies are handed out mapped from disk, and
+// the same buffer goes to every caller while any of them still holds it.
+@interface ENResourceBlobStore : NSObject
+- (id)initWithDirectoryURL:(NSURL *)directoryURL;
+
+// The body with the given hash, or nil if the store does not hold it.
+- (nullable NSData *)dataWithHash:(NSData *)hash;
+
+// Makes the owner reference exactly the given bodies, keyed by hash. Bodies the store does not hold yet
+// are written if they match their hash. Bodies the owner no longer references, and no one else does,
+// are removed. Returns NO, leaving the owner with no references, if a body could not be stored.
+- (BOOL)setBodies:(NSDictionary<NSData *, NSData *> *)bodiesByHash forOwner:(NSString *)owner;
+
+// Adds one body to those the owner references, writing it if it matches its hash. Returns YES if the
+// owner did not reference it before and now does.
+- (BOOL)addBody:(NSData *)body withHash:(NSData *)hash forOwner:(NSString *)owner;
+
+- (void)removeBodiesForOwner:(NSString *)owner;
+- (void)removeAllBodies;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENResourceBlobStore.h"
+#import "NSData+EvernoteSDK.h"
+#import "ENSDKPrivate.h"
+
+static NSString * ENResourceBlobStoreReferencesFilename = @"references.plist";
+
+@interface ENResourceBlobStore ()
+@property (nonatomic, strong) NSURL * directoryURL;
+// Owner to the array of hex body hashes it references, as saved on disk, and the reference count of
+// each hex hash, derived from it on load.
+@property (nonatomic, strong) NSMutableDictionary * hashesByOwner;
+@property (nonatomic, strong) NSCountedSet * referencedHashes;
+// Hex hash to the buffer last handed out for it, held weakly.
+@property (nonatomic, strong) NSMapTable * liveBodies;
+@end
+
+@implementation ENResourceBlobStore
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL
+{
+    self = [super init];
+    if (self) {
+        self.directoryURL = directoryURL;
+        self.liveBodies = [NSMapTable strongToWeakObjectsMapTable];
+    }
+    return self;
+}
+
+- (NSURL *)fileURLForHexHash:(NSString *)hexHash
+{
+    return [self.directoryURL URLByAppendingPathComponent:hexHash];
+}
+
+#pragma mark - References
+
+- (void)loadReferencesIfNeeded
+{
+    if (self.hashesByOwner) {
+        return;
+    }
+    self.hashesByOwner = [[NSMutableDictionary alloc] init];
+    self.referencedHashes = [[NSCountedSet alloc] init];
+    NSDictionary * references = [NSDictionary dictionaryWithContentsOfURL:[self.directoryURL URLByAppendingPathComponent:ENResourceBlobStoreReferencesFilename]];
+    [references enumerateKeysAndObjectsUsingBlock:^(NSString * owner, NSArray * hexHashes, BOOL * stop) {
+        if ([hexHashes isKindOfClass:[NSArray class]]) {
+            self.hashesByOwner[owner] = hexHashes;
+            [self.referencedHashes addObjectsFromArray:hexHashes];
+        }
+    }];
+}
+
+- (void)saveReferences
+{
+    NSError * error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+        ![self.hashesByOwner writeToURL:[self.directoryURL URLByAppendingPathComponent:ENResourceBlobStoreReferencesFilename] atomically:YES]) {
+        ENSDKLog(Error, General, @"Failed to write resource store references: %@", error);
+    }
+}
+
+// Drops the owner's references, removing bodies no one references any more.
+- (void)releaseHashesForOwner:(NSString *)owner
+{
+    for (NSString * hexHash in self.hashesByOwner[owner]) {
+        [self.referencedHashes removeObject:hexHash];
+        if ([self.referencedHashes countForObject:hexHash] == 0) {
+            [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForHexHash:hexHash] error:NULL];
+        }
+    }
+    [self.hashesByOwner removeObjectForKey:owner];
+}
+
+#pragma mark - Bodies
+
+- (NSData *)dataWithHash:(NSData *)hash
+{
+    NSString * hexHash = [hash enlowercaseHexDigits];
+    @synchronized(self) {
+        NSData * data = [self.liveBodies objectForKey:hexHash];
+        if (!data) {
+            data = [NSData dataWithContentsOfURL:[self fileURLForHexHash:hexHash] options:NSDataReadingMappedIfSafe error:NULL];
+            if (data) {
+                [self.liveBodies setObject:data forKey:hexHash];
+            }
+        }
+        return data;
+    }
+}
+
+- (BOOL)setBodies:(NSDictionary *)bodiesByHash forOwner:(NSString *)owner
+{
+    @synchronized(self) {
+        [self loadReferencesIfNeeded];
+        // Take the new references before dropping the old ones, so that bodies kept by the owner stay.
+        NSMutableArray * hexHashes = [[NSMutableArray alloc] init];
+        BOOL stored = YES;
+        for (NSData * hash in bodiesByHash) {
+            NSString * hexHash = [hash enlowercaseHexDigits];
+            if ([hexHashes containsObject:hexHash]) {
+                continue;
+            }
+            if ([self.referencedHashes countForObject:hexHash] == 0 && ![self writeBody:bodiesByHash[hash] withHash:hash hexHash:hexHash]) {
+                stored = NO;
+                break;
+            }
+            [self.referencedHashes addObject:hexHash];
+            [hexHashes addObject:hexHash];
+        }
+        [self releaseHashesForOwner:owner];
+        self.hashesByOwner[owner] = hexHashes;
+        if (!stored) {
+            [self releaseHashesForOwner:owner];
+        }
+        [self saveReferences];
+        return stored;
+    }
+}
+
+- (BOOL)addBody:(NSData *)body withHash:(NSData *)hash forOwner:(NSString *)owner
+{
+    NSString * hexHash = [hash enlowercaseHexDigits];
+    @synchronized(self) {
+        [self loadReferencesIfNeeded];
+        NSArray * hexHashes = self.hashesByOwner[owner] ?: @[];
+        if ([hexHashes containsObject:hexHash]) {
+            return NO;
+        }
+        if ([self.referencedHashes countForObject:hexHash] == 0 && ![self writeBody:body withHash:hash hexHash:hexHash]) {
+            return NO;
+        }
+        [self.referencedHashes addObject:hexHash];
+        self.hashesByOwner[owner] = [hexHashes arrayByAddingObject:hexHash];
+        [self saveReferences];
+        return YES;
+    }
+}
+
+- (BOOL)writeBody:(NSData *)body withHash:(NSData *)hash hexHash:(NSString *)hexHash
+{
+    // Checked once here, so that everything read back under this hash can be trusted to match it.
+    if (![[body enmd5] isEqualToData:hash]) {
+        ENSDKLog(Error, General, @"Resource body does not match its hash %@; not storing it.", hexHash);
+        return NO;
+    }
+    NSError * error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+        ![body writeToURL:[self fileURLForHexHash:hexHash] options:NSDataWritingAtomic error:&error]) {
+        ENSDKLog(Error, General, @"Failed to write resource body %@: %@", hexHash, error);
+        return NO;
+    }
+    return YES;
+}
+
+- (void)removeBodiesForOwner:(NSString *)owner
+{
+    @synchronized(self) {
+        [self loadReferencesIfNeeded];
+        if (self.hashesByOwner[owner]) {
+            [self releaseHashesForOwner:owner];
+            [self saveReferences];
+        }
+    }
+}
+
+- (void)removeAllBodies
+{
+    @synchronized(self) {
+        self.hashesByOwner = [[NSMutableDictionary alloc] init];
+        self.referencedHashes = [[NSCountedSet alloc] init];
+        [self.liveBodies removeAllObjects];
+        [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:NULL];
+    }
+}
+
+@end
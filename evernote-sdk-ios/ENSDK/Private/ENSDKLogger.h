@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENSDKLogging.h"
+
+// Active filter, kept in plain globals so the gate at each call site is two loads and a compare.
+// The level reads as None whenever no sink is installed.
+extern ENSDKLogLevel ENSDKLogActiveLevel;
+extern ENSDKLogCategory ENSDKLogActiveCategories;
+
+static inline BOOL ENSDKLogEnabled(ENSDKLogLevel level, ENSDKLogCategory category)
+{
+    return level <= ENSDKLogActiveLevel && (category & ENSDKLogActiveCategories) != 0;
+}
+
+// Delivers a message to the installed sinks. Call through the macros below, which check the gate first.
+extern void ENSDKLogEmit(ENSDKLogLevel level, ENSDKLogCategory category, NSString * format, ...) NS_FORMAT_FUNCTION(3,4);
+
+@interface ENSDKLogger : NSObject
++ (ENSDKLogger *)sharedLogger;
+
+@property (atomic, strong) id<ENSDKLogging> logger;
+@property (atomic, strong) id<ENSDKStructuredLogging> structuredLogger;
+@property (atomic, assign) ENSDKLogLevel level;
+@property (atomic, assign) ENSDKLogCategory categories;
+@end
+
+// Logging utility macros. Arguments are only evaluated when the level and category are enabled.
+#define ENSDKLog(lvl, cat, ...) \
+    do { \
+        if (ENSDKLogEnabled(ENSDKLogLevel##lvl, ENSDKLogCategory##cat)) { \
+            ENSDKLogEmit(ENSDKLogLevel##lvl, ENSDKLogCategory##cat, __VA_ARGS__); \
+        } \
+    } while(0)
+#define ENSDKLogError(...) ENSDKLog(Error, General, __VA_ARGS__)
+#define ENSDKLogInfo(...) ENSDKLog(Info, General, __VA_ARGS__)
+#define ENSDKLogDebug(...) ENSDKLog(Debug, General, __VA_ARGS__)
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENSDKLogger.h"
+
+ENSDKLogLevel ENSDKLogActiveLevel = ENSDKLogLevelNone;
+ENSDKLogCategory ENSDKLogActiveCategories = ENSDKLogCategoryAll;
+
+void ENSDKLogEmit(ENSDKLogLevel level, ENSDKLogCategory category, NSString * format, ...)
+{
+    ENSDKLogger * config = [ENSDKLogger sharedLogger];
+    id<ENSDKStructuredLogging> structuredLogger = config.structuredLogger;
+    id<ENSDKLogging> logger = config.logger;
+
+    va_list args;
+    if (structuredLogger) {
+        va_start(args, format);
+        [structuredLogger evernoteLogWithLevel:level category:category format:format arguments:args];
+        va_end(args);
+    }
+    if (logger) {
+        va_start(args, format);
+        NSString * message = [[NSString alloc] initWithFormat:format arguments:args];
+        va_end(args);
+        if (level == ENSDKLogLevelError) {
+            [logger evernoteLogErrorString:message];
+        } else {
+            [logger evernoteLogInfoString:message];
+        }
+    }
+}
+
+@implementation ENSDKLogger
+{
+    id<ENSDKLogging> _logger;
+    id<ENSDKStructuredLogging> _structuredLogger;
+    ENSDKLogLevel _level;
+    ENSDKLogCategory _categories;
+}
+
++ (ENSDKLogger *)sharedLogger
+{
+    static ENSDKLogger * sharedLogger = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedLogger = [[ENSDKLogger alloc] init];
+    });
+    return sharedLogger;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        _level = ENSDKLogLevelInfo;
+        _categories = ENSDKLogCategoryAll;
+    }
+    return self;
+}
+
+- (id<ENSDKLogging>)logger
+{
+    @synchronized(self) {
+        return _logger;
+    }
+}
+
+- (void)setLogger:(id<ENSDKLogging>)logger
+{
+    @synchronized(self) {
+        _logger = logger;
+        [self updateActiveFilter];
+    }
+}
+
+- (id<ENSDKStructuredLogging>)structuredLogger
+{
+    @synchronized(self) {
+        return _structuredLogger;
+    }
+}
+
+- (void)setStructuredLogger:(id<ENSDKStructuredLogging>)structuredLogger
+{
+    @synchronized(self) {
+        _structuredLogger = structuredLogger;
+        [self updateActiveFilter];
+    }
+}
+
+- (ENSDKLogLevel)level
+{
+    @synchronized(self) {
+        return _level;
+    }
+}
+
+- (void)setLevel:(ENSDKLogLevel)level
+{
+    @synchronized(self) {
+        _level = level;
+        [self updateActiveFilter];
+    }
+}
+
+- (ENSDKLogCategory)categories
+{
+    @synchronized(self) {
+        return _categories;
+    }
+}
+
+- (void)setCategories:(ENSDKLogCategory)categories
+{
+    @synchronized(self) {
+        _categories = categories;
+        [self updateActiveFilter];
+    }
+}
+
+- (void)updateActiveFilter
+{
+    // With no sink there is nothing to format for, so close the gate entirely.
+    BOOL hasSink = (_logger != nil || _structuredLogger != nil);
+    ENSDKLogActiveLevel = hasSink ? _level : ENSDKLogLevelNone;
+    ENSDKLogActiveCategories = _categories;
+}
+@end
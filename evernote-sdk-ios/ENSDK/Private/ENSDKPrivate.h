@@ -32,6 +32,9 @@
 #import "ENNoteRefInternal.h"
 #import "ENNoteStoreClient.h"
 #import "ENUserStoreClient.h"
+#import "ENSDKLogger.h"
+
+@class ENNoteSearchQuery;
 
 extern NSString * const ENBootstrapProfileNameInternational;
 extern NSString * const ENBootstrapProfileNameChina;
@@ -57,19 +60,35 @@ extern NSString * const ENBootstrapProfileNameChina;
 - (id)initWithSharedNotebook:(EDAMSharedNotebook *)sharedNotebook forLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook withBusinessNotebook:(EDAMNotebook *)notebook;
 @end
 
+// Fetches the data body of the resource with the given GUID, calling back on the main queue.
+typedef void (^ENResourceDataLoader)(NSString * resourceGuid, void (^completion)(NSData * data, NSError * error));
+
 @interface ENResource (Private)
 + (instancetype)resourceWithServiceResource:(EDAMResource *)serviceResource;
+// Like the above, but a service resource without its body makes a resource that loads it on demand.
++ (instancetype)resourceWithServiceResource:(EDAMResource *)serviceResource dataLoader:(ENResourceDataLoader)dataLoader;
+// Nil for a resource whose data has not loaded.
 - (EDAMResource *)EDAMResource;
+// Like the above, but a resource whose data has not loaded is written as its hash alone. Only for
+// replacing the note the resource was downloaded with.
+- (EDAMResource *)EDAMResourceReferencingServiceData;
 @end
 
 @interface ENNote (Private)
 - (id)initWithServiceNote:(EDAMNote *)note;
+- (id)initWithServiceNote:(EDAMNote *)note resourceDataLoader:(ENResourceDataLoader)resourceDataLoader;
 - (NSString *)enmlContent;
 - (void)setGuid:(NSString *)guid;
 - (void)setEnmlContent:(NSString *)enmlContent;
 - (void)setResources:(NSArray *)resources;
 - (EDAMNote *)EDAMNoteToReplaceServiceNoteGUID:(NSString *)guid;
 - (EDAMNote *)EDAMNote;
+// YES if writing the note to replace the given note (nil for a new one) needs resource data still on the
+// service. Its resources keep their hash alone only when replacing the note they were downloaded with.
+- (BOOL)needsResourceDataToReplaceServiceNoteGUID:(NSString *)guid;
+// Loads the data of every resource still on the service, calling back on the main queue with the first
+// error, if any.
+- (void)loadResourceDataWithCompletion:(void (^)(NSError * error))completion;
 - (BOOL)validateForLimits;
 @end
 
@@ -77,6 +96,10 @@ extern NSString * const ENBootstrapProfileNameChina;
 - (NSString *)enmlWithNote:(ENNote *)note;
 @end
 
+// Called on the decoding thread with a sync chunk's chunkHighUSN (nil for an empty chunk) and updateCount,
+// before the chunk's objects are decoded.
+typedef void (^ENNoteStoreClientSyncChunkHeadHandler)(NSNumber * chunkHighUSN, int32_t updateCount);
+
 @interface ENNoteStoreClient (Private)
 // This accessor is here to provide a declaration of the override point for subclasses that do
 // nontrivial token management.
@@ -90,6 +113,20 @@ extern NSString * const ENBootstrapProfileNameChina;
 // Should be called only from within protected code blocks
 - (EDAMAuthenticationResult *)authenticateToSharedNotebookWithGlobalId:(NSString *)globalId;
 
+// The sync chunk calls, with a handler that hears where the chunk ends before the whole of it is decoded,
+// so the next chunk can be asked for while this one is still being decoded.
+- (void)fetchFilteredSyncChunkAfterUSN:(int32_t)afterUSN
+                            maxEntries:(int32_t)maxEntries
+                                filter:(EDAMSyncChunkFilter *)filter
+                           headHandler:(ENNoteStoreClientSyncChunkHeadHandler)headHandler
+                            completion:(void(^)(EDAMSyncChunk *syncChunk, NSError *error))completion;
+- (void)fetchSyncChunkForLinkedNotebook:(EDAMLinkedNotebook *)linkedNotebook
+                               afterUSN:(int32_t)afterUSN
+                             maxEntries:(int32_t)maxEntries
+                           fullSyncOnly:(BOOL)fullSyncOnly
+                            headHandler:(ENNoteStoreClientSyncChunkHeadHandler)headHandler
+                             completion:(void(^)(EDAMSyncChunk *syncChunk, NSError *error))completion;
+
 // Private pesudo-recursive method that gets all matching notes batch by batch until exhausted.
 - (void)findNotesMetadataWithFilter:(EDAMNoteFilter *)filter
                          maxResults:(NSUInteger)maxResults
@@ -106,6 +143,30 @@ extern NSString * const ENBootstrapProfileNameChina;
 - (EDAMAuthenticationResult *)authenticateToBusiness;
 @end
 
+@interface ENSyncEngine (Private)
+- (id)initWithSession:(ENSession *)session directoryURL:(NSURL *)directoryURL;
+
+// Whether a sync also fetches and indexes the text of the notes that changed.
+@property (nonatomic, assign) BOOL indexesNoteText;
+
+// The notebook list stored for the account if none of the updateCounts it was built at has moved since,
+// else nil; along with the current updateCounts to store a fresh list under. These are the account's,
+// its business's and each linked notebook's, and are nil unless the account's scope is synced and current.
+- (void)fetchListedNotebooksWithCompletion:(void (^)(NSArray * notebooks, NSDictionary * updateCounts, NSError * error))completion;
+- (void)setListedNotebooks:(NSArray *)notebooks updateCounts:(NSDictionary *)updateCounts;
+
+// The note metadata in the given scopes that matches the query, if every scope is synced and unchanged
+// on the service, else nil, in which case a sync is started in the background. Also nil if the query
+// can't be answered without the text of a note that is not indexed. Called back on the main queue.
+- (void)fetchCurrentNoteMetadataInPersonalScope:(BOOL)includePersonal
+                                linkedNotebooks:(NSArray *)linkedNotebooks
+                                  matchingQuery:(ENNoteSearchQuery *)query
+                                     completion:(void (^)(NSArray * metadata))completion;
+
+// Starts a bulk-priority sync unless one is running.
+- (void)synchronizeInBackground;
+@end
+
 @interface ENPreferencesStore (Private)
 - (id)initWithStoreFilename:(NSString *)filename;
 @end
@@ -115,16 +176,6 @@ extern NSString * const ENBootstrapProfileNameChina;
 #define EN_FLAG_SET(v, f)	((v) |= (f))
 #define EN_FLAG_CLEAR(v, f)	((v) &= (~(f)))
 
-// Logging utility macros.
-#define ENSDKLogInfo(...) \
-    do { \
-        [[ENSession sharedSession].logger evernoteLogInfoString:[NSString stringWithFormat:__VA_ARGS__]]; \
-    } while(0);
-#define ENSDKLogError(...) \
-    do { \
-        [[ENSession sharedSession].logger evernoteLogErrorString:[NSString stringWithFormat:__VA_ARGS__]]; \
-    } while(0);
-
 #define ENSDKResourceBundle [NSBundle bundleWithPath:[[NSBundle bundleForClass:[self class]] pathForResource:@"ENSDKResources" ofType:@"bundle"]]
 
 #define ENSDKLocalizedString(key, comment) \
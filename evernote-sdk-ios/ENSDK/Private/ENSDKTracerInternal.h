@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENSDKTracer.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Mirrors [ENSDKTracer sharedTracer].enabled for cheap checks on hot paths.
+extern BOOL ENSDKTraceEnabled;
+
+// A timed span. Every method is safe to send to nil, which is what callers hold while tracing is off.
+@interface ENSDKSpan : NSObject
+// Starts a top-level span, nested under the current span if there is one. Returns nil when tracing is off.
++ (nullable ENSDKSpan *)spanWithName:(NSString *)name;
+
+- (ENSDKSpan *)childSpanWithName:(NSString *)name category:(NSString *)category;
+
+// Finishes the current step, if any, and starts a new step child named after the selector.
+- (ENSDKSpan *)beginStepWithSelector:(SEL)selector;
+
+- (void)setArgument:(id)value forKey:(NSString *)key;
+- (void)addInstantEventWithName:(NSString *)name category:(NSString *)category;
+
+// Finishes the current step and then this span. Later calls are ignored.
+- (void)finishWithError:(nullable NSError *)error;
+
+@property (nonatomic, readonly, nullable) ENSDKSpan * currentStep;
+@end
+
+// The span that new spans and enqueued store client calls attach to on this thread.
+extern ENSDKSpan * _Nullable ENSDKTraceCurrentSpan(void);
+
+// Makes a span current until the end of the enclosing scope.
+extern void * _Nullable ENSDKTracePushCurrentSpan(ENSDKSpan * _Nullable span);
+extern void ENSDKTracePopCurrentSpan(void * _Nullable * _Nonnull saved);
+#define ENSDKTraceScope(span) \
+    __attribute__((cleanup(ENSDKTracePopCurrentSpan), unused)) void * ENSDKTraceSavedSpan = ENSDKTracePushCurrentSpan(span)
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^ENSingleFlightCompletion)(id _Nullable value, NSError * _Nullable error);
+
+// Collapses identical calls made while one is in flight into that one call. The first caller for a key
+// does the work; callers arriving before it completes wait for its result instead of doing their own.
+@interface ENSingleFlightGroup : NSObject
++ (ENSingleFlightGroup *)sharedGroup;
+
+// Calls work, passing the block to call once with the result, unless a call for the key is already in
+// flight; then the completion gets that call's result, and this returns YES. Every caller gets the same
+// value object. The work runs with a token of the group's own current, which is cancelled only
+// once every caller has gone; a caller whose own current token is cancelled is completed with its error
+// at once, from an arbitrary queue. Otherwise completions are called wherever the work completes.
+- (BOOL)performWithKey:(NSString *)key
+                  work:(void (^)(ENSingleFlightCompletion done))work
+            completion:(ENSingleFlightCompletion)completion;
+
+// Calls made from now on with a key that has the prefix no longer join those in flight, which still
+// complete for the callers already waiting. For after a write that a call in flight may predate.
+- (void)detachKeysWithPrefix:(NSString *)prefix;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENSingleFlightGroup.h"
+#import "ENCancellationTokenInternal.h"
+
+@interface ENSingleFlightWaiter : NSObject
+@property (nonatomic, copy) ENSingleFlightCompletion completion;
+@property (nonatomic, strong) ENCancellationToken * token;
+@property (nonatomic, strong) id cancellationHandler;
+@end
+
+@implementation ENSingleFlightWaiter
+@end
+
+@interface ENSingleFlight : NSObject
+@property (nonatomic, copy) NSString * key;
+@property (nonatomic, strong) ENCancellationToken * token;
+@property (nonatomic, strong) NSMutableArray * waiters;
+@end
+
+@implementation ENSingleFlight
+@end
+
+@interface ENSingleFlightGroup ()
+@property (nonatomic, strong) NSMutableDictionary * flightsByKey;
+@end
+
+@implementation ENSingleFlightGroup
+
++ (ENSingleFlightGroup *)sharedGroup
+{
+    static ENSingleFlightGroup * sharedGroup;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedGroup = [[ENSingleFlightGroup alloc] init];
+    });
+    return sharedGroup;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self) {
+        self.flightsByKey = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (BOOL)performWithKey:(NSString *)key
+                  work:(void (^)(ENSingleFlightCompletion done))work
+            completion:(ENSingleFlightCompletion)completion
+{
+    ENSingleFlightWaiter * waiter = [[ENSingleFlightWaiter alloc] init];
+    waiter.completion = completion;
+    waiter.token = [ENCancellationToken currentToken];
+    ENSingleFlight * flight = nil;
+    BOOL joined = NO;
+    @synchronized(self) {
+        flight = self.flightsByKey[key];
+        joined = (flight != nil);
+        if (!flight) {
+            flight = [[ENSingleFlight alloc] init];
+            flight.key = key;
+            flight.token = [ENCancellationToken token];
+            flight.waiters = [[NSMutableArray alloc] init];
+            self.flightsByKey[key] = flight;
+        }
+        [flight.waiters addObject:waiter];
+        // Registered under the lock, so the result cannot go out before the handler is there to remove.
+        // A token already cancelled calls the handler at once; the lock is recursive.
+        __weak ENSingleFlightWaiter * weakWaiter = waiter;
+        waiter.cancellationHandler = [waiter.token addCancellationHandler:^{
+            [self cancelWaiter:weakWaiter inFlight:flight];
+        }];
+    }
+    if (joined) {
+        return YES;
+    }
+    ENCancellationTokenScope(flight.token);
+    work(^(id value, NSError * error) {
+        [self finishFlight:flight value:value error:error];
+    });
+    return NO;
+}
+
+- (void)detachKeysWithPrefix:(NSString *)prefix
+{
+    @synchronized(self) {
+        if (self.flightsByKey.count == 0) {
+            return;
+        }
+        for (NSString * key in [self.flightsByKey allKeys]) {
+            if ([key hasPrefix:prefix]) {
+                [self.flightsByKey removeObjectForKey:key];
+            }
+        }
+    }
+}
+
+// Called with the lock held, so that a later call does not join a flight that is over.
+- (void)detachFlight:(ENSingleFlight *)flight
+{
+    if (self.flightsByKey[flight.key] == flight) {
+        [self.flightsByKey removeObjectForKey:flight.key];
+    }
+}
+
+- (void)cancelWaiter:(ENSingleFlightWaiter *)waiter inFlight:(ENSingleFlight *)flight
+{
+    BOOL abandoned = NO;
+    @synchronized(self) {
+        NSUInteger index = waiter ? [flight.waiters indexOfObjectIdenticalTo:waiter] : NSNotFound;
+        if (index == NSNotFound) {
+            return;
+        }
+        [flight.waiters removeObjectAtIndex:index];
+        abandoned = (flight.waiters.count == 0);
+        if (abandoned) {
+            [self detachFlight:flight];
+        }
+    }
+    if (abandoned) {
+        // Nobody is left waiting for the result.
+        [flight.token cancel];
+    }
+    ENSingleFlightCompletion completion = waiter.completion;
+    NSError * error = waiter.token.error;
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        completion(nil, error);
+    });
+}
+
+- (void)finishFlight:(ENSingleFlight *)flight value:(id)value error:(NSError *)error
+{
+    NSArray * waiters = nil;
+    @synchronized(self) {
+        [self detachFlight:flight];
+        waiters = [flight.waiters copy];
+        [flight.waiters removeAllObjects];
+    }
+    for (ENSingleFlightWaiter * waiter in waiters) {
+        [waiter.token removeCancellationHandler:waiter.cancellationHandler];
+        waiter.completion(value, error);
+    }
+}
+
+@end
@@ -27,19 +27,95 @@
  */
 
 #import <Foundation/Foundation.h>
+#import "ENRequestPriority.h"
 @class ENStoreClient;
+@protocol ENTTransport;
 
 NS_ASSUME_NONNULL_BEGIN
 
 extern NSString * ENStoreClientDidFailWithAuthenticationErrorNotification;
 
+typedef id<ENTTransport> _Nonnull (^ENStoreClientTransportFactory)(NSURL * url);
+
 @interface ENStoreClient : NSObject
 
+// Store clients get their Thrift transport from the factory, which defaults to an ENTHTTPClient
+// for the URL. Replacing it (with a recording or replaying transport, say) only affects clients
+// created afterwards; pass nil to go back to the default.
++ (void)setTransportFactory:(nullable ENStoreClientTransportFactory)factory;
++ (id<ENTTransport>)transportWithURL:(NSURL *)url;
+
+// The most calls that run at once, each on its own Thrift client. Defaults to 16. How many of those run
+// is up to the adaptive limit of the store they go to, which every client calling it shares: it grows
+// while the store's latency stays flat and shrinks on latency spikes, 5xx responses and rate limits.
+@property (atomic, assign) NSUInteger maximumConcurrentCalls;
+
+// The priority of calls made on this client outside -[ENSession performWithRequestPriority:block:].
+// Queued calls start highest priority first. Defaults to ENRequestPriorityDefault.
+@property (atomic, assign) ENRequestPriority requestPriority;
+
+// The most bulk-priority calls that run at once, within maximumConcurrentCalls. Defaults to 2.
+@property (atomic, assign) NSUInteger maximumConcurrentBulkCalls;
+
+// Whether identical reads made at once share one call; see -invokeCoalescedAsyncObjectBlock:. Clients
+// start with the default, which is NO until changed with +setCoalescesIdenticalReadsByDefault:.
+@property (atomic, assign) BOOL coalescesIdenticalReads;
++ (void)setCoalescesIdenticalReadsByDefault:(BOOL)coalescesIdenticalReads;
+
+// When the service answers a call with a rate-limit error, every store client with the same
+// -storeKey holds its calls until the wait the service asked for is over; the call that was turned
+// away goes again first. Calls fail with ENErrorCodeRateLimitReached instead if the wait is longer than
+// this. Defaults to 60 seconds.
+@property (atomic, assign) NSTimeInterval maximumRateLimitWait;
+
+// Calls are cancelled with the ENCancellationToken current when they are made, if any: queued calls
+// complete at once and calls on the network have their request aborted, with the token's error.
+// Each block runs as an ENTAsyncInvocation: it may be run again from the start once a response
+// arrives, so it should do nothing but make its store call and return the result. A store call the
+// service answers with an EDAM exception returns nil rather than throwing, later calls in the block are
+// not sent, and the exception becomes the call's error.
+// These run in order: each waits for every earlier call and holds back every later one.
 - (void)invokeAsyncBoolBlock:(BOOL(^)(void))block completion:(void (^)(BOOL value, NSError *_Nullable error))completion;
 - (void)invokeAsyncObjectBlock:(nullable id(^)(void))block completion:(void (^)(id _Nullable value, NSError *_Nullable error))completion;
 - (void)invokeAsyncInt32Block:(int32_t(^)(void))block completion:(void (^)(int32_t value, NSError *_Nullable error))completion;
 - (void)invokeAsyncBlock:(void(^)(void))block completion:(void (^)(NSError *_Nullable error))completion;
 
+// Runs alongside other concurrent calls, up to maximumConcurrentCalls. For calls that only read.
+- (void)invokeConcurrentAsyncObjectBlock:(nullable id(^)(void))block completion:(void (^)(id _Nullable value, NSError *_Nullable error))completion;
+
+// A concurrent call that, when coalescesIdenticalReads is on, waits for the result of an identical call
+// already in flight instead of making its own: same method, same arguments (strings or numbers) and same
+// -credentialKey, from any store client. Callers share the value, so they must not modify it. A read
+// made after one of the client's serial calls has completed never joins a call from before it.
+- (void)invokeCoalescedAsyncObjectBlock:(nullable id(^)(void))block
+                             methodName:(NSString *)methodName
+                              arguments:(NSArray *)arguments
+                             completion:(void (^)(id _Nullable value, NSError *_Nullable error))completion;
+
+// Cancels the call that has been running longest, if any, which completes with ENErrorCodeCancelled.
+- (void)cancelFirstCall;
+
+// Subclasses return a new Thrift client for the pool that invocations draw from, and use
+// -thriftClientForCurrentCall from inside their blocks to get the one checked out for the call.
+- (nullable id)newThriftClient;
+- (nullable id)thriftClientForCurrentCall;
+
+// Called on the work queue before each call's block first runs. Returns YES if the call can go ahead.
+// Subclasses that authenticate on demand otherwise return NO, having started authenticating with an
+// asynchronous call of their own rather than by blocking the thread, and call the completion once done,
+// on any thread. The default returns YES.
+- (BOOL)prepareCallOrNotifyWithCompletion:(void (^)(NSError *_Nullable error))completion;
+
+// Identifies the store (one shard's note store, say) that calls go to. Clients returning the same key
+// share its rate-limit waits and its adaptive concurrency limit. Nil, the default, opts out of both.
+// Called once, from the work queue.
+- (nullable NSString *)storeKey;
+
+// Identifies the credentials calls are made with, for telling which calls are identical. It must be
+// cheap, since it is asked for on the caller's thread, and must not be shared by clients authenticated
+// as different users. Nil, the default, opts out of coalescing.
+- (nullable NSString *)credentialKey;
+
 @end
 
 NS_ASSUME_NONNULL_END
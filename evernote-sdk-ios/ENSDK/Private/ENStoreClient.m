@@ -31,102 +31,664 @@
 #import "EDAMErrors.h"
 #import "ENSDKPrivate.h"
 #import "ENSDKLogging.h"
+#import "ENStoreClientMetricsInternal.h"
+#import "ENTHTTPClient.h"
+#import "ENTAsyncInvocation.h"
+#import "ENCancellationTokenInternal.h"
+#import "ENRateLimitScheduler.h"
+#import "ENRequestPriorityInternal.h"
+#import "ENConcurrencyLimiter.h"
+#import "ENSingleFlightGroup.h"
 
 NSString * ENStoreClientDidFailWithAuthenticationErrorNotification = @"ENStoreClientDidFailWithAuthenticationErrorNotification";
 
+// The Thrift client an invocation has checked out, reachable from inside its block.
+@interface ENStoreClientCallContext : NSObject
+@property (nonatomic, weak) ENStoreClient * storeClient;
+@property (nonatomic, strong) id thriftClient;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, assign) ENRequestPriority priority;
+@end
+
+@implementation ENStoreClientCallContext
+@end
+
+@interface ENStoreClientPendingCall : NSObject
+@property (nonatomic, assign) BOOL concurrent;
+@property (nonatomic, assign) ENRequestPriority priority;
+@property (nonatomic, copy) void (^block)(void);
+@property (nonatomic, copy) void (^completion)(NSError * error);
+@property (nonatomic, assign) uint64_t enqueueTime;
+@property (nonatomic, strong) ENSDKSpan * parentSpan;
+@property (nonatomic, strong) ENCancellationToken * cancellationToken;
+@property (nonatomic, strong) id cancellationHandler;
+// The store's limiter, if the call holds a slot in it.
+@property (nonatomic, strong) ENConcurrencyLimiter * limiter;
+@property (nonatomic, assign) NSTimeInterval startTime;
+// The Thrift method the call's block made first, which its latency is measured against.
+@property (nonatomic, copy) NSString * methodName;
+@end
+
+@implementation ENStoreClientPendingCall
+@end
+
 @interface ENStoreClient ()
+// Guards the scheduling state below; invocations themselves run on the work queue.
 @property (nonatomic, strong) dispatch_queue_t queue;
+// Queued calls, one array per ENRequestPriority.
+@property (nonatomic, strong) NSArray * pendingCallsByPriority;
+@property (nonatomic, strong) NSMutableArray * idleThriftClients;
+@property (nonatomic, assign) NSUInteger activeCallCount;
+@property (nonatomic, assign) NSUInteger activeBulkCallCount;
+@property (nonatomic, assign) BOOL serialCallActive;
+// Set while a wake-up is scheduled for the end of a rate-limit wait.
+@property (nonatomic, assign) BOOL resumeScheduled;
+// Set after a rate-limit wait until a call succeeds; calls go one at a time meanwhile.
+@property (nonatomic, assign) BOOL probing;
+// -storeKey, looked up once from the work queue since subclasses may need to authenticate for it.
+@property (atomic, copy) NSString * resolvedStoreKey;
+@property (atomic, strong) ENConcurrencyLimiter * storeLimiter;
+@property (atomic, assign) BOOL storeKeyResolved;
+// Set while the store's limiter is due to call back once it has a free slot.
+@property (nonatomic, assign) BOOL waitingForStoreLimiter;
+// Invocations in the order they started, for -cancelFirstCall. Guarded by itself.
+@property (nonatomic, strong) NSMutableArray * runningInvocations;
 @end
 
+static ENStoreClientTransportFactory sTransportFactory = nil;
+static BOOL sCoalescesIdenticalReadsByDefault = NO;
+
+// Coalescing keys are built from length-prefixed components, so no component can run into the next
+// whatever characters it holds, and a key's leading components are a prefix of it.
+static NSString * ENStoreClientCoalescingKeyComponent(id component)
+{
+    NSString * string = [component description];
+    return [NSString stringWithFormat:@"%lu:%@", (unsigned long)string.length, string];
+}
+
+// What a call's outcome says about its store's load.
+static ENConcurrencyLimiterOutcome ENStoreClientLimiterOutcome(NSError * error)
+{
+    if (!error) {
+        return ENConcurrencyLimiterOutcomeSuccess;
+    }
+    if ([error.domain isEqualToString:ENErrorDomain] && error.code == ENErrorCodeRateLimitReached) {
+        return ENConcurrencyLimiterOutcomeOverload;
+    }
+    if ([error.userInfo[@"HTTPStatusCode"] integerValue] >= 500) {
+        return ENConcurrencyLimiterOutcomeOverload;
+    }
+    NSError * underlyingError = error.userInfo[@"error"];
+    if ([underlyingError.domain isEqualToString:NSURLErrorDomain] && underlyingError.code == NSURLErrorTimedOut) {
+        return ENConcurrencyLimiterOutcomeOverload;
+    }
+    if (error.userInfo[@"EDAMErrorCode"]) {
+        // The store answered, if not with what was asked for.
+        return ENConcurrencyLimiterOutcomeSuccess;
+    }
+    return ENConcurrencyLimiterOutcomeIgnored;
+}
+
 @implementation ENStoreClient
 
++ (void)setTransportFactory:(ENStoreClientTransportFactory)factory
+{
+    @synchronized(self) {
+        sTransportFactory = [factory copy];
+    }
+}
+
++ (id<ENTTransport>)transportWithURL:(NSURL *)url
+{
+    ENStoreClientTransportFactory factory = nil;
+    @synchronized(self) {
+        factory = sTransportFactory;
+    }
+    if (factory) {
+        return factory(url);
+    }
+    return [[ENTHTTPClient alloc] initWithURL:url];
+}
+
++ (void)setCoalescesIdenticalReadsByDefault:(BOOL)coalescesIdenticalReads
+{
+    @synchronized(self) {
+        sCoalescesIdenticalReadsByDefault = coalescesIdenticalReads;
+    }
+}
+
+// Store client invocations run here. Nothing on it waits for the network, so it needs only a few
+// threads however many calls are in flight.
+static dispatch_queue_t ENStoreClientWorkQueue(void)
+{
+    static dispatch_queue_t queue;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        queue = dispatch_queue_create("com.evernote.sdk.ENStoreClient.work", DISPATCH_QUEUE_CONCURRENT);
+    });
+    return queue;
+}
+
+// Runs work for a call on the work queue at a quality of service matching its priority.
+static void ENStoreClientDispatchWork(ENRequestPriority priority, dispatch_block_t block)
+{
+    dispatch_qos_class_t qos = QOS_CLASS_DEFAULT;
+    if (priority == ENRequestPriorityInteractive) {
+        qos = QOS_CLASS_USER_INITIATED;
+    } else if (priority == ENRequestPriorityBulk) {
+        qos = QOS_CLASS_UTILITY;
+    }
+    dispatch_async(ENStoreClientWorkQueue(), dispatch_block_create_with_qos_class(0, qos, 0, block));
+}
+
 - (id)init
 {
     self = [super init];
     if (self) {
         NSString * queueName = [NSString stringWithFormat:@"com.evernote.sdk.%@", NSStringFromClass([self class])];
         self.queue = dispatch_queue_create([queueName cStringUsingEncoding:NSASCIIStringEncoding], NULL);
+        NSMutableArray * pendingCallsByPriority = [NSMutableArray arrayWithCapacity:ENRequestPriorityCount];
+        for (NSInteger priority = 0; priority < ENRequestPriorityCount; priority++) {
+            [pendingCallsByPriority addObject:[[NSMutableArray alloc] init]];
+        }
+        self.pendingCallsByPriority = pendingCallsByPriority;
+        self.idleThriftClients = [[NSMutableArray alloc] init];
+        self.runningInvocations = [[NSMutableArray alloc] init];
+        self.maximumConcurrentCalls = 16;
+        self.maximumConcurrentBulkCalls = 2;
+        self.requestPriority = ENRequestPriorityDefault;
+        self.maximumRateLimitWait = 60;
+        @synchronized([ENStoreClient class]) {
+            self.coalescesIdenticalReads = sCoalescesIdenticalReadsByDefault;
+        }
     }
     return self;
 }
 
 - (void)invokeAsyncBoolBlock:(BOOL(^)())block completion:(void (^)(BOOL val, NSError *error))completion
 {
-    dispatch_async(self.queue, ^(void) {
-        __block BOOL retVal = NO;
-        @try {
-            retVal = block();
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(retVal, nil);
-            });
-        }
-        @catch (NSException *exception) {
-            NSError * error = [ENError errorFromException:exception];
+    __block BOOL retVal = NO;
+    [self invokeBlock:^{
+        retVal = block();
+    } concurrent:NO completion:^(NSError * error) {
+        if (error) {
             completion(NO, error);
-            [self handleError:error];
+            return;
         }
-    });
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(retVal, nil);
+        });
+    }];
 }
 
 - (void)invokeAsyncInt32Block:(int32_t(^)())block completion:(void (^)(int32_t val, NSError *_Nullable error))completion
 {
-    dispatch_async(self.queue, ^(void) {
-        __block int32_t retVal = -1;
-        @try {
-            retVal = block();
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(retVal, nil);
-            });
-        }
-        @catch (NSException *exception) {
-            NSError * error = [ENError errorFromException:exception];
+    __block int32_t retVal = -1;
+    [self invokeBlock:^{
+        retVal = block();
+    } concurrent:NO completion:^(NSError * error) {
+        if (error) {
             completion(-1, error);
-            [self handleError:error];
+            return;
         }
-    });
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(retVal, nil);
+        });
+    }];
 }
 
 // use id instead of NSObject* so block type-checking is happy
 - (void)invokeAsyncObjectBlock:(nullable id(^)())block completion:(void (^)(id _Nullable val, NSError *_Nullable error))completion
 
 {
-    dispatch_async(self.queue, ^(void) {
-        id retVal = nil;
-        @try {
-            retVal = block();
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(retVal, nil);
-            });
+    __block id retVal = nil;
+    [self invokeBlock:^{
+        retVal = block();
+    } concurrent:NO completion:^(NSError * error) {
+        if (error) {
+            completion(nil, error);
+            return;
         }
-        @catch (NSException *exception) {
-            NSError * error = [ENError errorFromException:exception];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(retVal, nil);
+        });
+    }];
+}
+
+- (void)invokeConcurrentAsyncObjectBlock:(nullable id(^)())block completion:(void (^)(id _Nullable val, NSError *_Nullable error))completion
+{
+    __block id retVal = nil;
+    [self invokeBlock:^{
+        retVal = block();
+    } concurrent:YES completion:^(NSError * error) {
+        if (error) {
             completion(nil, error);
-            [self handleError:error];
+            return;
         }
-    });
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(retVal, nil);
+        });
+    }];
+}
+
+- (void)invokeCoalescedAsyncObjectBlock:(nullable id(^)(void))block
+                             methodName:(NSString *)methodName
+                              arguments:(NSArray *)arguments
+                             completion:(void (^)(id _Nullable val, NSError *_Nullable error))completion
+{
+    NSString * credentialKey = self.coalescesIdenticalReads ? [self credentialKey] : nil;
+    if (!credentialKey) {
+        [self invokeConcurrentAsyncObjectBlock:block completion:completion];
+        return;
+    }
+    NSMutableString * key = [NSMutableString stringWithString:ENStoreClientCoalescingKeyComponent(credentialKey)];
+    [key appendString:ENStoreClientCoalescingKeyComponent(methodName)];
+    for (id argument in arguments) {
+        [key appendString:ENStoreClientCoalescingKeyComponent(argument)];
+    }
+    BOOL joined = [[ENSingleFlightGroup sharedGroup] performWithKey:key work:^(ENSingleFlightCompletion done) {
+        [self invokeConcurrentAsyncObjectBlock:block completion:done];
+    } completion:completion];
+    if (joined) {
+        ENStoreClientMetricsCoalescedCall([self metricsStoreType], methodName);
+    }
 }
 
 - (void)invokeAsyncBlock:(void(^)())block completion:(void (^)(NSError *_Nullable error))completion
 {
-    dispatch_async(self.queue, ^(void) {
+    [self invokeBlock:block concurrent:NO completion:^(NSError * error) {
+        if (error) {
+            completion(error);
+            return;
+        }
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(nil);
+        });
+    }];
+}
+
+#pragma mark - Invocations
+
+// Queues the block to run as an ENTAsyncInvocation on the work queue, with a Thrift client of its own
+// from the pool. Concurrent calls run alongside each other, up to maximumConcurrentCalls; any other call
+// waits for every call queued before it to finish and holds back every call queued after it, as all calls
+// did when a client had a single serial queue. No thread is held while a request is on the network: the
+// invocation is run again when the response arrives. The completion is called on whichever thread
+// finishes the invocation.
+- (void)invokeBlock:(void(^)(void))block concurrent:(BOOL)concurrent completion:(void (^)(NSError *_Nullable error))completion
+{
+    NSString * credentialKey = (!concurrent && self.coalescesIdenticalReads) ? [self credentialKey] : nil;
+    if (credentialKey) {
+        // Serial calls may write: reads made once this one is done must not get results from before it.
+        void (^callCompletion)(NSError *) = completion;
+        completion = ^(NSError * error) {
+            [[ENSingleFlightGroup sharedGroup] detachKeysWithPrefix:ENStoreClientCoalescingKeyComponent(credentialKey)];
+            callCompletion(error);
+        };
+    }
+    ENStoreClientPendingCall * call = [[ENStoreClientPendingCall alloc] init];
+    call.concurrent = concurrent;
+    call.priority = MIN(MAX(ENRequestPriorityCurrent(self.requestPriority), ENRequestPriorityInteractive), ENRequestPriorityBulk);
+    call.block = block;
+    call.completion = completion;
+    call.enqueueTime = ENStoreClientMetricsEnqueueTime();
+    call.parentSpan = ENSDKTraceCurrentSpan();
+    call.cancellationToken = [ENCancellationToken currentToken];
+    dispatch_async(self.queue, ^{
+        [self enqueueCall:call atFront:NO];
+        [self startPendingCalls];
+    });
+}
+
+// Called on the client's queue.
+- (void)enqueueCall:(ENStoreClientPendingCall *)call atFront:(BOOL)atFront
+{
+    NSMutableArray * pendingCalls = self.pendingCallsByPriority[call.priority];
+    if (atFront) {
+        [pendingCalls insertObject:call atIndex:0];
+    } else {
+        [pendingCalls addObject:call];
+    }
+    ENCancellationToken * token = call.cancellationToken;
+    if (token) {
+        __weak ENStoreClientPendingCall * weakCall = call;
+        call.cancellationHandler = [token addCancellationHandler:^{
+            dispatch_async(self.queue, ^{
+                [self cancelPendingCall:weakCall];
+            });
+        }];
+    }
+}
+
+// Called on the client's queue. A call that has not started yet completes at once rather than
+// waiting its turn.
+- (void)cancelPendingCall:(ENStoreClientPendingCall *)call
+{
+    NSMutableArray * pendingCalls = call ? self.pendingCallsByPriority[call.priority] : nil;
+    if (![pendingCalls containsObject:call]) {
+        return;
+    }
+    [pendingCalls removeObjectIdenticalTo:call];
+    [self failCall:call withError:call.cancellationToken.error];
+    // A serial call at the head of the queue may have been holding back the calls behind it.
+    [self startPendingCalls];
+}
+
+// Called on the client's queue, for a call no longer queued.
+- (void)failCall:(ENStoreClientPendingCall *)call withError:(NSError *)error
+{
+    [call.cancellationToken removeCancellationHandler:call.cancellationHandler];
+    void (^completion)(NSError *) = call.completion;
+    dispatch_async(ENStoreClientWorkQueue(), ^{
+        completion(error);
+    });
+}
+
+- (void)cancelFirstCall
+{
+    ENTAsyncInvocation * invocation = nil;
+    @synchronized(self.runningInvocations) {
+        invocation = [self.runningInvocations firstObject];
+    }
+    [invocation cancel];
+}
+
+// Called on the client's queue. The oldest call of the highest priority waiting goes next; when it
+// cannot start yet, nothing behind it does either, so that a serial call is not starved by a stream of
+// lower-priority ones. Besides the client's own limits, each call needs a slot from its store's
+// adaptive limiter, which every client calling the store shares.
+- (void)startPendingCalls
+{
+    if (![self nextPendingCall] || [self holdPendingCallsForRateLimit] || self.waitingForStoreLimiter) {
+        return;
+    }
+    // Until the first call has looked up the store, there is no limiter to hold the others back.
+    BOOL oneAtATime = self.probing || !self.storeKeyResolved;
+    NSUInteger limit = oneAtATime ? 1 : MAX(self.maximumConcurrentCalls, (NSUInteger)1);
+    ENConcurrencyLimiter * storeLimiter = self.storeLimiter;
+    NSUInteger bulkLimit = MAX(self.maximumConcurrentBulkCalls, (NSUInteger)1);
+    ENStoreClientPendingCall * call = nil;
+    while ((call = [self nextPendingCall])) {
+        BOOL canStart = call.concurrent ? (!self.serialCallActive && self.activeCallCount < limit) : (self.activeCallCount == 0);
+        if (canStart && call.priority == ENRequestPriorityBulk) {
+            canStart = (self.activeBulkCallCount < bulkLimit);
+        }
+        if (!canStart) {
+            break;
+        }
+        if (storeLimiter && ![storeLimiter acquireOrNotifyOnQueue:self.queue block:^{
+            self.waitingForStoreLimiter = NO;
+            [self startPendingCalls];
+        }]) {
+            self.waitingForStoreLimiter = YES;
+            break;
+        }
+        call.limiter = storeLimiter;
+        [self.pendingCallsByPriority[call.priority] removeObjectAtIndex:0];
+        [call.cancellationToken removeCancellationHandler:call.cancellationHandler];
+        self.activeCallCount++;
+        if (call.priority == ENRequestPriorityBulk) {
+            self.activeBulkCallCount++;
+        }
+        self.serialCallActive = !call.concurrent;
+        id thriftClient = [self.idleThriftClients lastObject];
+        if (thriftClient) {
+            [self.idleThriftClients removeLastObject];
+        }
+        ENStoreClientDispatchWork(call.priority, ^{
+            [self startCall:call thriftClient:thriftClient];
+        });
+    }
+}
+
+// Called on the client's queue.
+- (ENStoreClientPendingCall *)nextPendingCall
+{
+    for (NSMutableArray * pendingCalls in self.pendingCallsByPriority) {
+        if (pendingCalls.count > 0) {
+            return pendingCalls[0];
+        }
+    }
+    return nil;
+}
+
+// Called on the client's queue. Returns YES if the store has asked every client calling it to wait. The
+// pending calls then start once the wait is over, or fail now if it is longer than they should wait.
+- (BOOL)holdPendingCallsForRateLimit
+{
+    ENRateLimitScheduler * scheduler = [ENRateLimitScheduler sharedScheduler];
+    NSTimeInterval wait = [scheduler waitForKey:self.resolvedStoreKey];
+    if (wait <= 0) {
+        return NO;
+    }
+    if (wait > self.maximumRateLimitWait) {
+        NSError * error = [ENError rateLimitReachedErrorWithDuration:wait];
+        for (NSMutableArray * pendingCalls in self.pendingCallsByPriority) {
+            for (ENStoreClientPendingCall * call in pendingCalls) {
+                [self failCall:call withError:error];
+            }
+            [pendingCalls removeAllObjects];
+        }
+        return YES;
+    }
+    if (!self.resumeScheduled) {
+        self.resumeScheduled = YES;
+        NSTimeInterval delay = wait + [scheduler jitterForWait:wait];
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.queue, ^{
+            self.resumeScheduled = NO;
+            // Send one call until one gets through, rather than a burst that may be turned away again.
+            self.probing = YES;
+            [self startPendingCalls];
+        });
+    }
+    return YES;
+}
+
+// Called on the work queue.
+- (void)startCall:(ENStoreClientPendingCall *)call thriftClient:(id)thriftClient
+{
+    ENCancellationToken * token = call.cancellationToken;
+    if (token.isCancelled) {
+        call.completion(token.error);
+        [self finishCall:call returningThriftClient:thriftClient error:token.error requeue:NO];
+        return;
+    }
+    BOOL prepared = [self prepareCallOrNotifyWithCompletion:^(NSError * error) {
+        if (error) {
+            call.completion(error);
+            [self finishCall:call returningThriftClient:thriftClient error:error requeue:NO];
+            return;
+        }
+        ENStoreClientDispatchWork(call.priority, ^{
+            [self startPreparedCall:call thriftClient:thriftClient];
+        });
+    }];
+    if (prepared) {
+        [self startPreparedCall:call thriftClient:thriftClient];
+    }
+}
+
+- (BOOL)prepareCallOrNotifyWithCompletion:(void (^)(NSError *))completion
+{
+    return YES;
+}
+
+// Called on the work queue.
+- (void)startPreparedCall:(ENStoreClientPendingCall *)call thriftClient:(id)thriftClient
+{
+    ENCancellationToken * token = call.cancellationToken;
+    if (!self.storeKeyResolved) {
+        NSString * storeKey = [self storeKey];
+        self.resolvedStoreKey = storeKey;
+        self.storeLimiter = [ENConcurrencyLimiter limiterForKey:storeKey];
+        self.storeKeyResolved = YES;
+        // Calls held back until now can go, within the limiter.
+        dispatch_async(self.queue, ^{
+            [self startPendingCalls];
+        });
+    }
+    call.startTime = [NSDate timeIntervalSinceReferenceDate];
+    ENStoreClientInvocationMetrics * metrics = ENStoreClientMetricsBeginInvocation([self metricsStoreType], call.priority, call.enqueueTime, call.parentSpan);
+    ENStoreClientCallContext * context = [[ENStoreClientCallContext alloc] init];
+    context.storeClient = self;
+    context.thriftClient = thriftClient ?: [self newThriftClient];
+    context.cancellationToken = token;
+    context.priority = call.priority;
+    void (^block)(void) = call.block;
+    ENTAsyncInvocation * invocation = [[ENTAsyncInvocation alloc] initWithBlock:^{
+        ENStoreClientMetricsAttachInvocation(metrics);
         @try {
             block();
-            dispatch_async(dispatch_get_main_queue(), ^{
-                completion(nil);
-            });
         }
-        @catch (NSException *exception) {
-            NSError * error = [ENError errorFromException:exception];
-            completion(error);
-            [self handleError:error];
+        @finally {
+            ENStoreClientMetricsDetachInvocation(metrics);
+        }
+    }];
+    invocation.context = context;
+    // Service errors come back as values, so an expected one (a note not found, say) unwinds nothing.
+    invocation.returnsServiceExceptions = YES;
+    @synchronized(self.runningInvocations) {
+        [self.runningInvocations addObject:invocation];
+    }
+    id cancellationHandler = [token addCancellationHandler:^{
+        [invocation cancel];
+    }];
+    [self runInvocation:invocation metrics:metrics completion:^(NSError * error) {
+        [token removeCancellationHandler:cancellationHandler];
+        call.methodName = invocation.firstMessageName;
+        @synchronized(self.runningInvocations) {
+            [self.runningInvocations removeObjectIdenticalTo:invocation];
+        }
+        if ([self shouldRetryCall:call afterError:error]) {
+            [self finishCall:call returningThriftClient:context.thriftClient error:error requeue:YES];
+            return;
         }
+        call.completion(error);
+        [self finishCall:call returningThriftClient:context.thriftClient error:error requeue:NO];
+    }];
+}
+
+// A call the store turned away for its rate limit goes again once the wait is over, unless that is
+// longer than callers should wait.
+- (BOOL)shouldRetryCall:(ENStoreClientPendingCall *)call afterError:(NSError *)error
+{
+    if (error.code != ENErrorCodeRateLimitReached || ![error.domain isEqualToString:ENErrorDomain]) {
+        return NO;
+    }
+    if (!self.resolvedStoreKey || call.cancellationToken.isCancelled) {
+        return NO;
+    }
+    // Without a duration nothing holds the retry back.
+    NSNumber * rateLimitDuration = error.userInfo[@"rateLimitDuration"];
+    return rateLimitDuration && [rateLimitDuration doubleValue] <= self.maximumRateLimitWait;
+}
+
+// Gives back the call's slots. A requeued call goes back ahead of everything queued since, so serial
+// calls keep their order.
+- (void)finishCall:(ENStoreClientPendingCall *)call returningThriftClient:(id)thriftClient error:(NSError *)error requeue:(BOOL)requeue
+{
+    ENConcurrencyLimiter * limiter = call.limiter;
+    if (limiter) {
+        call.limiter = nil;
+        // A call that never reached the store, cancelled or failing to authenticate first, says nothing
+        // about its load.
+        [limiter releaseWithLatency:[NSDate timeIntervalSinceReferenceDate] - call.startTime
+                          forMethod:call.methodName
+                            outcome:(call.startTime > 0 ? ENStoreClientLimiterOutcome(error) : ENConcurrencyLimiterOutcomeIgnored)];
+    }
+    call.startTime = 0;
+    dispatch_async(self.queue, ^{
+        if (requeue) {
+            [self enqueueCall:call atFront:YES];
+        }
+        if (thriftClient && self.idleThriftClients.count < MAX(self.maximumConcurrentCalls, (NSUInteger)1)) {
+            [self.idleThriftClients addObject:thriftClient];
+        }
+        self.activeCallCount--;
+        if (call.priority == ENRequestPriorityBulk) {
+            self.activeBulkCallCount--;
+        }
+        // A serial call runs alone, so if one was active it is the call that just finished.
+        self.serialCallActive = NO;
+        if (!error) {
+            self.probing = NO;
+        }
+        [self startPendingCalls];
     });
 }
 
+- (id)newThriftClient
+{
+    return nil;
+}
+
+- (nullable NSString *)storeKey
+{
+    return nil;
+}
+
+- (nullable NSString *)credentialKey
+{
+    return nil;
+}
+
+- (nullable id)thriftClientForCurrentCall
+{
+    ENStoreClientCallContext * context = [ENTAsyncInvocation currentInvocation].context;
+    return (context.storeClient == self) ? context.thriftClient : nil;
+}
+
+- (void)runInvocation:(ENTAsyncInvocation *)invocation
+              metrics:(ENStoreClientInvocationMetrics *)metrics
+           completion:(void (^)(NSError *_Nullable error))completion
+{
+    NSError * error = nil;
+    @try {
+        BOOL finished = [invocation runWithResumeHandler:^{
+            ENStoreClientCallContext * context = invocation.context;
+            ENStoreClientDispatchWork(context.priority, ^{
+                [self runInvocation:invocation metrics:metrics completion:completion];
+            });
+        }];
+        if (!finished) {
+            return;
+        }
+        if (invocation.serviceException) {
+            error = [ENError errorFromException:invocation.serviceException];
+        }
+    }
+    @catch (NSException *exception) {
+        if (invocation.isCancelled) {
+            // Whatever the abort surfaced as, report why the call was cut short.
+            ENStoreClientCallContext * context = invocation.context;
+            error = context.cancellationToken.error ?: [ENError cancelledError];
+        } else {
+            error = [ENError errorFromException:exception];
+        }
+    }
+    ENStoreClientMetricsEndInvocation(metrics, error);
+    if (error) {
+        [self handleError:error];
+    }
+    completion(error);
+}
+
 #pragma mark - Private routines
 
+- (ENStoreClientType)metricsStoreType
+{
+    return ENStoreClientTypePersonal;
+}
+
 - (void)handleError:(NSError *)error
 {
+    // Hold back every client's calls to this store for as long as the service asked.
+    NSNumber * rateLimitDuration = error.userInfo[@"rateLimitDuration"];
+    NSString * storeKey = self.resolvedStoreKey;
+    if (error.code == ENErrorCodeRateLimitReached && rateLimitDuration && storeKey) {
+        [[ENRateLimitScheduler sharedScheduler] noteRateLimitForKey:storeKey duration:[rateLimitDuration doubleValue]];
+    }
+    
     // If this is a hard auth error, then send a notification about it. This is intended to trigger for
     // tokens that have either expired or that have been revoked. This does NOT include permissions
     // denials (ie, the auth token is valid, but not for the operation you're trying to do with it). Those
@@ -135,7 +697,7 @@ NSString * ENStoreClientDidFailWithAuthenticationErrorNotification = @"ENStoreCl
     if (edamErrorCode > 0 &&
         (edamErrorCode == EDAMErrorCode_AUTH_EXPIRED ||
          edamErrorCode == EDAMErrorCode_INVALID_AUTH)) {
-        ENSDKLogError(@"ENStoreClient got authentication EDAM error %u", edamErrorCode);
+        ENSDKLog(Error, Transport, @"ENStoreClient got authentication EDAM error %u", edamErrorCode);
         dispatch_async(dispatch_get_main_queue(), ^{
             [[NSNotificationCenter defaultCenter] postNotificationName:ENStoreClientDidFailWithAuthenticationErrorNotification object:self];
         });
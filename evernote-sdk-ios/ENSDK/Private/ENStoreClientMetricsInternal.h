@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+#import "ENStoreClientMetrics.h"
+#import "ENStoreClient.h"
+#import "ENSDKTracerInternal.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class ENStoreClientInvocationMetrics;
+
+// YES while an observer is registered or aggregation is on. Checked before any clock is read.
+extern BOOL ENStoreClientMetricsActive;
+
+typedef NS_ENUM(NSInteger, ENStoreClientMetricsPhase) {
+    ENStoreClientMetricsPhaseSerialized,
+    ENStoreClientMetricsPhaseReceived,
+};
+
+// Invocation scope: one block run for a store client, possibly over several runs on different threads
+// while it waits for responses. The enqueue time is 0 when neither metrics nor tracing are on, and an
+// invocation begun with it is nil. Each run is bracketed by attach and detach, which make the invocation
+// and its parent span current on the thread; each Thrift call gets a child span under the parent.
+extern uint64_t ENStoreClientMetricsEnqueueTime(void);
+extern ENStoreClientInvocationMetrics * _Nullable ENStoreClientMetricsBeginInvocation(ENStoreClientType storeType, ENRequestPriority priority, uint64_t enqueueTime, ENSDKSpan * _Nullable parentSpan);
+extern void ENStoreClientMetricsAttachInvocation(ENStoreClientInvocationMetrics * _Nullable invocation);
+extern void ENStoreClientMetricsDetachInvocation(ENStoreClientInvocationMetrics * _Nullable invocation);
+extern void ENStoreClientMetricsEndInvocation(ENStoreClientInvocationMetrics * _Nullable invocation, NSError * _Nullable error);
+
+// Thrift call hooks, used by ENTProtocolUtil and ENTHTTPClient. They do nothing unless the current
+// thread is inside an instrumented invocation.
+extern void ENStoreClientMetricsCallBegin(NSString * methodName);
+extern void ENStoreClientMetricsCallMark(ENStoreClientMetricsPhase phase);
+extern void ENStoreClientMetricsCallAddBytes(uint64_t requestBytes, uint64_t responseBytes);
+extern void ENStoreClientMetricsCallEnd(NSException * _Nullable exception);
+
+// Counts a call that made no request of its own, having joined an identical one in flight.
+extern void ENStoreClientMetricsCoalescedCall(ENStoreClientType storeType, NSString * methodName);
+
+@interface ENStoreClient (Metrics)
+- (ENStoreClientType)metricsStoreType;
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class ENNoteIndex, EDAMSyncChunk, EDAMNotebook, EDAMTag, EDAMSavedSearch, EDAMLinkedNotebook, EDAMNoteMetadata;
+
+// The synced state of one sync scope: the user's own account, their business, or a single linked
+// notebook. It holds metadata only (no note content or resource data) and the highest USN applied, so
+// that an interrupted sync picks up after the last chunk saved rather than starting over.
+@interface ENSyncStoreScope : NSObject <NSCoding>
+@property (nonatomic, readonly) NSString * key;
+
+// The highest USN applied. The scope is current when this equals the service's updateCount.
+@property (nonatomic, readonly) int32_t lastUSN;
+
+// The service's time (an EDAMTimestamp) when the scope last took a chunk, to compare with fullSyncBefore.
+@property (nonatomic, readonly) long long lastSyncTime;
+
+// YES once a sync of the scope has caught up with the service at least once.
+@property (nonatomic, readonly) BOOL hasCompletedFullSync;
+
+// The notebook list ENSession last built for the account, and the updateCounts it was built at, keyed by
+// the scope each came from. Only used on the personal scope.
+@property (nonatomic, readonly, nullable) NSArray * listedNotebooks;
+@property (nonatomic, readonly, nullable) NSDictionary<NSString *, NSNumber *> * listedNotebooksUpdateCounts;
+
+- (NSArray<EDAMNotebook *> *)notebooks;
+- (NSArray<EDAMTag *> *)tags;
+- (NSArray<EDAMSavedSearch *> *)savedSearches;
+- (NSArray<EDAMLinkedNotebook *> *)linkedNotebooks;
+
+// Metadata for the active notes in the scope, optionally only those in the given notebooks.
+- (NSArray<EDAMNoteMetadata *> *)noteMetadataInNotebooksWithGuids:(nullable NSSet<NSString *> *)notebookGuids;
+@end
+
+// The on-disk store behind ENSyncEngine. Each scope is archived to its own file. The chunks applied since
+// go to a journal beside it, and the archive is only rewritten once the journal outgrows it, or when the
+// scope is marked, reset or given a notebook list.
+@interface ENSyncStore : NSObject
++ (NSString *)personalScopeKey;
++ (NSString *)businessScopeKey;
++ (NSString *)scopeKeyForLinkedNotebookGuid:(NSString *)guid;
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL;
+
+// The scope for the key, loaded from disk the first time, or a new empty scope.
+- (ENSyncStoreScope *)scopeForKey:(NSString *)key;
+
+// The scope's note index, loaded from disk and caught up with the scope the first time. Once loaded, it
+// takes the chunks applied to the scope. Nil for a scope that has been removed.
+- (ENNoteIndex *)noteIndexForScope:(ENSyncStoreScope *)scope;
+- (void)saveNoteIndexForScope:(ENSyncStoreScope *)scope;
+
+// Each of these saves the scope before returning, applying a chunk by journaling it; marking and resetting
+// also save its note index. They write to disk, so are best kept off the main queue.
+- (void)applySyncChunk:(EDAMSyncChunk *)chunk toScope:(ENSyncStoreScope *)scope;
+- (void)markScope:(ENSyncStoreScope *)scope synchronizedWithUpdateCount:(int32_t)updateCount;
+- (void)resetScope:(ENSyncStoreScope *)scope;
+- (void)setListedNotebooks:(nullable NSArray *)notebooks updateCounts:(nullable NSDictionary<NSString *, NSNumber *> *)updateCounts forScope:(ENSyncStoreScope *)scope;
+
+// Removes the linked notebook scopes whose keys are not in the set, in memory and on disk.
+- (void)removeLinkedScopesExceptKeys:(NSSet<NSString *> *)keys;
+- (void)removeAllScopes;
+@end
+
+NS_ASSUME_NONNULL_END
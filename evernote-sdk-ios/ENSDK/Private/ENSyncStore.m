@@ -0,0 +1,626 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENSyncStore.h"
+#import "ENNoteIndex.h"
+#import "EDAM.h"
+#import "ENTBinaryProtocol.h"
+#import "ENTMemoryBuffer.h"
+#import "ENSDKPrivate.h"
+
+static NSString * ENSyncStorePersonalScopeKey = @"personal";
+static NSString * ENSyncStoreBusinessScopeKey = @"business";
+static NSString * ENSyncStoreLinkedScopeKeyPrefix = @"linked-";
+static NSString * ENSyncStoreScopeFileExtension = @"archive";
+static NSString * ENSyncStoreNoteIndexFileExtension = @"index";
+static NSString * ENSyncStoreJournalFileExtension = @"journal";
+
+// The journal is folded into the archive once it outgrows the archive, so that the bytes written over a
+// sync stay proportional to what the scope holds, but not while both are this small.
+static const unsigned long long ENSyncStoreMinJournalCompactionSize = 1024 * 1024;
+
+@interface ENSyncStoreScope ()
+@property (nonatomic, copy) NSString * key;
+@property (nonatomic, assign) int32_t lastUSN;
+@property (nonatomic, assign) long long lastSyncTime;
+@property (nonatomic, assign) BOOL hasCompletedFullSync;
+@property (nonatomic, strong) NSArray * listedNotebooks;
+@property (nonatomic, copy) NSDictionary * listedNotebooksUpdateCounts;
+@property (nonatomic, strong) NSMutableDictionary * notebooksByGuid;
+@property (nonatomic, strong) NSMutableDictionary * tagsByGuid;
+@property (nonatomic, strong) NSMutableDictionary * searchesByGuid;
+@property (nonatomic, strong) NSMutableDictionary * linkedNotebooksByGuid;
+@property (nonatomic, strong) NSMutableDictionary * noteMetadataByGuid;
+// Set once the store has dropped the scope, so that a sync still holding it does not write it back.
+@property (nonatomic, assign) BOOL discarded;
+// The sizes of the scope's files on disk. Not archived.
+@property (nonatomic, assign) unsigned long long archiveSize;
+@property (nonatomic, assign) unsigned long long journalSize;
+@end
+
+@implementation ENSyncStoreScope
+
+- (id)initWithKey:(NSString *)key
+{
+    self = [super init];
+    if (self) {
+        self.key = key;
+        [self removeAllObjects];
+    }
+    return self;
+}
+
+- (void)removeAllObjects
+{
+    self.lastUSN = 0;
+    self.lastSyncTime = 0;
+    self.hasCompletedFullSync = NO;
+    self.listedNotebooks = nil;
+    self.listedNotebooksUpdateCounts = nil;
+    self.notebooksByGuid = [[NSMutableDictionary alloc] init];
+    self.tagsByGuid = [[NSMutableDictionary alloc] init];
+    self.searchesByGuid = [[NSMutableDictionary alloc] init];
+    self.linkedNotebooksByGuid = [[NSMutableDictionary alloc] init];
+    self.noteMetadataByGuid = [[NSMutableDictionary alloc] init];
+}
+
++ (EDAMNoteMetadata *)noteMetadataFromNote:(EDAMNote *)note
+{
+    EDAMNoteMetadata * metadata = [[EDAMNoteMetadata alloc] init];
+    metadata.guid = note.guid;
+    metadata.title = note.title;
+    metadata.contentLength = note.contentLength;
+    metadata.created = note.created;
+    metadata.updated = note.updated;
+    metadata.deleted = note.deleted;
+    metadata.updateSequenceNum = note.updateSequenceNum;
+    metadata.notebookGuid = note.notebookGuid;
+    metadata.tagGuids = note.tagGuids;
+    metadata.attributes = note.attributes;
+    // Sync chunks carry resource metadata without the bodies, which is enough to find the largest.
+    EDAMResource * largestResource = nil;
+    for (EDAMResource * resource in note.resources) {
+        if (!largestResource || [resource.data.size intValue] > [largestResource.data.size intValue]) {
+            largestResource = resource;
+        }
+    }
+    if (largestResource) {
+        metadata.largestResourceMime = largestResource.mime;
+        metadata.largestResourceSize = largestResource.data.size;
+    }
+    return metadata;
+}
+
+- (void)applySyncChunk:(EDAMSyncChunk *)chunk
+{
+    @synchronized(self) {
+        for (EDAMNotebook * notebook in chunk.notebooks) {
+            self.notebooksByGuid[notebook.guid] = notebook;
+        }
+        for (EDAMTag * tag in chunk.tags) {
+            self.tagsByGuid[tag.guid] = tag;
+        }
+        for (EDAMSavedSearch * search in chunk.searches) {
+            self.searchesByGuid[search.guid] = search;
+        }
+        for (EDAMLinkedNotebook * linkedNotebook in chunk.linkedNotebooks) {
+            self.linkedNotebooksByGuid[linkedNotebook.guid] = linkedNotebook;
+        }
+        for (EDAMNote * note in chunk.notes) {
+            // Notes in the trash come down as inactive. Searches leave them out, and so does the store.
+            if (note.active && ![note.active boolValue]) {
+                [self.noteMetadataByGuid removeObjectForKey:note.guid];
+            } else {
+                self.noteMetadataByGuid[note.guid] = [[self class] noteMetadataFromNote:note];
+            }
+        }
+        
+        [self.notebooksByGuid removeObjectsForKeys:chunk.expungedNotebooks ?: @[]];
+        [self.tagsByGuid removeObjectsForKeys:chunk.expungedTags ?: @[]];
+        [self.searchesByGuid removeObjectsForKeys:chunk.expungedSearches ?: @[]];
+        [self.linkedNotebooksByGuid removeObjectsForKeys:chunk.expungedLinkedNotebooks ?: @[]];
+        [self.noteMetadataByGuid removeObjectsForKeys:chunk.expungedNotes ?: @[]];
+        if (chunk.expungedNotebooks.count > 0) {
+            // The notes in an expunged notebook go with it, whether or not the chunk lists them.
+            NSSet * expungedNotebookGuids = [NSSet setWithArray:chunk.expungedNotebooks];
+            NSMutableArray * orphanedNoteGuids = [[NSMutableArray alloc] init];
+            [self.noteMetadataByGuid enumerateKeysAndObjectsUsingBlock:^(NSString * guid, EDAMNoteMetadata * metadata, BOOL * stop) {
+                if ([expungedNotebookGuids containsObject:metadata.notebookGuid]) {
+                    [orphanedNoteGuids addObject:guid];
+                }
+            }];
+            [self.noteMetadataByGuid removeObjectsForKeys:orphanedNoteGuids];
+        }
+        
+        if (chunk.chunkHighUSN) {
+            self.lastUSN = MAX(self.lastUSN, [chunk.chunkHighUSN intValue]);
+        }
+        if (chunk.currentTime) {
+            self.lastSyncTime = [chunk.currentTime longLongValue];
+        }
+    }
+}
+
+- (NSArray *)notebooks
+{
+    @synchronized(self) {
+        return [self.notebooksByGuid allValues];
+    }
+}
+
+- (NSArray *)tags
+{
+    @synchronized(self) {
+        return [self.tagsByGuid allValues];
+    }
+}
+
+- (NSArray *)savedSearches
+{
+    @synchronized(self) {
+        return [self.searchesByGuid allValues];
+    }
+}
+
+- (NSArray *)linkedNotebooks
+{
+    @synchronized(self) {
+        return [self.linkedNotebooksByGuid allValues];
+    }
+}
+
+- (NSArray *)noteMetadataInNotebooksWithGuids:(NSSet *)notebookGuids
+{
+    @synchronized(self) {
+        if (!notebookGuids) {
+            return [self.noteMetadataByGuid allValues];
+        }
+        NSMutableArray * results = [[NSMutableArray alloc] init];
+        for (EDAMNoteMetadata * metadata in [self.noteMetadataByGuid objectEnumerator]) {
+            if ([notebookGuids containsObject:metadata.notebookGuid]) {
+                [results addObject:metadata];
+            }
+        }
+        return results;
+    }
+}
+
+#pragma mark - NSCoding
+
+- (void)encodeWithCoder:(NSCoder *)encoder
+{
+    @synchronized(self) {
+        [encoder encodeObject:self.key forKey:@"key"];
+        [encoder encodeInt32:self.lastUSN forKey:@"lastUSN"];
+        [encoder encodeInt64:self.lastSyncTime forKey:@"lastSyncTime"];
+        [encoder encodeBool:self.hasCompletedFullSync forKey:@"hasCompletedFullSync"];
+        [encoder encodeObject:self.listedNotebooks forKey:@"listedNotebooks"];
+        [encoder encodeObject:self.listedNotebooksUpdateCounts forKey:@"listedNotebooksUpdateCounts"];
+        [encoder encodeObject:self.notebooksByGuid forKey:@"notebooks"];
+        [encoder encodeObject:self.tagsByGuid forKey:@"tags"];
+        [encoder encodeObject:self.searchesByGuid forKey:@"searches"];
+        [encoder encodeObject:self.linkedNotebooksByGuid forKey:@"linkedNotebooks"];
+        [encoder encodeObject:self.noteMetadataByGuid forKey:@"noteMetadata"];
+    }
+}
+
+- (id)initWithCoder:(NSCoder *)decoder
+{
+    self = [super init];
+    if (self) {
+        self.key = [decoder decodeObjectForKey:@"key"];
+        self.lastUSN = [decoder decodeInt32ForKey:@"lastUSN"];
+        self.lastSyncTime = [decoder decodeInt64ForKey:@"lastSyncTime"];
+        self.hasCompletedFullSync = [decoder decodeBoolForKey:@"hasCompletedFullSync"];
+        self.listedNotebooks = [decoder decodeObjectForKey:@"listedNotebooks"];
+        self.listedNotebooksUpdateCounts = [decoder decodeObjectForKey:@"listedNotebooksUpdateCounts"];
+        self.notebooksByGuid = [[decoder decodeObjectForKey:@"notebooks"] mutableCopy] ?: [[NSMutableDictionary alloc] init];
+        self.tagsByGuid = [[decoder decodeObjectForKey:@"tags"] mutableCopy] ?: [[NSMutableDictionary alloc] init];
+        self.searchesByGuid = [[decoder decodeObjectForKey:@"searches"] mutableCopy] ?: [[NSMutableDictionary alloc] init];
+        self.linkedNotebooksByGuid = [[decoder decodeObjectForKey:@"linkedNotebooks"] mutableCopy] ?: [[NSMutableDictionary alloc] init];
+        self.noteMetadataByGuid = [[decoder decodeObjectForKey:@"noteMetadata"] mutableCopy] ?: [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+@end
+
+@interface ENSyncStore ()
+@property (nonatomic, strong) NSURL * directoryURL;
+@property (nonatomic, strong) NSMutableDictionary * scopesByKey;
+@property (nonatomic, strong) NSMutableDictionary * noteIndexesByKey;
+@end
+
+@implementation ENSyncStore
+
++ (NSString *)personalScopeKey
+{
+    return ENSyncStorePersonalScopeKey;
+}
+
++ (NSString *)businessScopeKey
+{
+    return ENSyncStoreBusinessScopeKey;
+}
+
++ (NSString *)scopeKeyForLinkedNotebookGuid:(NSString *)guid
+{
+    return [ENSyncStoreLinkedScopeKeyPrefix stringByAppendingString:guid];
+}
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL
+{
+    self = [super init];
+    if (self) {
+        self.directoryURL = directoryURL;
+        self.scopesByKey = [[NSMutableDictionary alloc] init];
+        self.noteIndexesByKey = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSURL *)fileURLForScopeKey:(NSString *)key
+{
+    return [[self.directoryURL URLByAppendingPathComponent:key] URLByAppendingPathExtension:ENSyncStoreScopeFileExtension];
+}
+
+- (NSURL *)fileURLForNoteIndexKey:(NSString *)key
+{
+    return [[self.directoryURL URLByAppendingPathComponent:key] URLByAppendingPathExtension:ENSyncStoreNoteIndexFileExtension];
+}
+
+- (NSURL *)fileURLForJournalKey:(NSString *)key
+{
+    return [[self.directoryURL URLByAppendingPathComponent:key] URLByAppendingPathExtension:ENSyncStoreJournalFileExtension];
+}
+
+- (ENSyncStoreScope *)scopeForKey:(NSString *)key
+{
+    @synchronized(self) {
+        ENSyncStoreScope * scope = self.scopesByKey[key];
+        if (scope) {
+            return scope;
+        }
+        NSData * data = [NSData dataWithContentsOfURL:[self fileURLForScopeKey:key]];
+        if (data) {
+            @try {
+                scope = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+            } @catch (id e) {
+                ENSDKLog(Error, Sync, @"Failed to unarchive sync scope %@; starting it over. %@", key, e);
+                scope = nil;
+            }
+            if (![scope isKindOfClass:[ENSyncStoreScope class]] || ![scope.key isEqualToString:key]) {
+                scope = nil;
+            }
+        }
+        if (scope || !data) {
+            scope = scope ?: [[ENSyncStoreScope alloc] initWithKey:key];
+            scope.archiveSize = data.length;
+            [self replayJournalOntoScope:scope];
+        } else {
+            // The journal follows on from an archive that is gone, so it is no use on its own.
+            [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForJournalKey:key] error:NULL];
+            scope = [[ENSyncStoreScope alloc] initWithKey:key];
+        }
+        self.scopesByKey[key] = scope;
+        return scope;
+    }
+}
+
+// The journal holds the chunks applied since the archive was written, each as a big-endian length and
+// the chunk in Thrift binary. A record cut short by a crash ends the replay, and the sync fetches its
+// chunk again.
+- (void)replayJournalOntoScope:(ENSyncStoreScope *)scope
+{
+    NSData * data = [NSData dataWithContentsOfURL:[self fileURLForJournalKey:scope.key] options:NSDataReadingMappedIfSafe error:NULL];
+    const uint8_t * bytes = data.bytes;
+    NSUInteger offset = 0;
+    NSUInteger count = 0;
+    while (offset + sizeof(uint32_t) <= data.length) {
+        uint32_t length = CFSwapInt32BigToHost(*(const uint32_t *)(bytes + offset));
+        if (length > data.length - offset - sizeof(uint32_t)) {
+            break;
+        }
+        NSData * record = [data subdataWithRange:NSMakeRange(offset + sizeof(uint32_t), length)];
+        EDAMSyncChunk * chunk = [[EDAMSyncChunk alloc] init];
+        @try {
+            [ENTProtocolUtil readFromProtocol:[[ENTBinaryProtocol alloc] initWithTransport:[[ENTMemoryBuffer alloc] initWithData:record]] ontoObject:chunk];
+        } @catch (id e) {
+            ENSDKLog(Error, Sync, @"Failed to read sync journal %@ after %lu chunks: %@", scope.key, (unsigned long)count, e);
+            break;
+        }
+        [scope applySyncChunk:chunk];
+        offset += sizeof(uint32_t) + length;
+        count++;
+    }
+    scope.journalSize = offset;
+    if (offset < data.length) {
+        // Cut back to the last whole record, so that what is appended next can be read.
+        NSFileHandle * handle = [NSFileHandle fileHandleForWritingToURL:[self fileURLForJournalKey:scope.key] error:NULL];
+        [handle truncateFileAtOffset:offset];
+        [handle closeFile];
+    }
+}
+
+- (void)saveScope:(ENSyncStoreScope *)scope
+{
+    // Written under the scope's lock, so that a scope discarded meanwhile is not written back after its
+    // file is removed.
+    @synchronized(scope) {
+        if (scope.discarded) {
+            return;
+        }
+        NSData * data = nil;
+        @try {
+            data = [NSKeyedArchiver archivedDataWithRootObject:scope];
+        } @catch (id e) {
+            ENSDKLog(Error, Sync, @"Failed to archive sync scope %@: %@", scope.key, e);
+            return;
+        }
+        NSError * error = nil;
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+            ![data writeToURL:[self fileURLForScopeKey:scope.key] options:NSDataWritingAtomic error:&error]) {
+            ENSDKLog(Error, Sync, @"Failed to write sync scope %@: %@", scope.key, error);
+            return;
+        }
+        scope.archiveSize = data.length;
+        // The archive now holds the journal's chunks. Should this not happen, replaying them again over
+        // the archive in order leaves it as it is.
+        if (scope.journalSize > 0) {
+            [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForJournalKey:scope.key] error:NULL];
+            scope.journalSize = 0;
+        }
+    }
+}
+
+// Appends the chunk to the scope's journal, or archives the whole scope if the journal has grown past it.
+- (void)journalSyncChunk:(EDAMSyncChunk *)chunk forScope:(ENSyncStoreScope *)scope
+{
+    ENTMemoryBuffer * buffer = [[ENTMemoryBuffer alloc] init];
+    @try {
+        [ENTProtocolUtil writeObject:chunk ontoProtocol:[[ENTBinaryProtocol alloc] initWithTransport:buffer]];
+    } @catch (id e) {
+        ENSDKLog(Error, Sync, @"Failed to encode sync chunk for %@: %@", scope.key, e);
+        [self saveScope:scope];
+        return;
+    }
+    NSData * body = [buffer getBuffer];
+    uint32_t length = CFSwapInt32HostToBig((uint32_t)body.length);
+    NSMutableData * record = [NSMutableData dataWithBytes:&length length:sizeof(length)];
+    [record appendData:body];
+    
+    BOOL compact = NO;
+    @synchronized(scope) {
+        if (scope.discarded) {
+            return;
+        }
+        if (scope.journalSize + record.length > MAX(scope.archiveSize, ENSyncStoreMinJournalCompactionSize)) {
+            compact = YES;
+        } else {
+            NSURL * journalURL = [self fileURLForJournalKey:scope.key];
+            NSError * error = nil;
+            if (scope.journalSize == 0) {
+                // Nothing to keep: whatever is there is left from an archive written since.
+                [[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:NULL];
+                if (![[NSData data] writeToURL:journalURL options:0 error:&error]) {
+                    ENSDKLog(Error, Sync, @"Failed to create sync journal %@: %@", scope.key, error);
+                    compact = YES;
+                }
+            }
+            NSFileHandle * handle = compact ? nil : [NSFileHandle fileHandleForWritingToURL:journalURL error:&error];
+            if (handle) {
+                @try {
+                    [handle seekToFileOffset:scope.journalSize];
+                    [handle writeData:record];
+                    scope.journalSize += record.length;
+                } @catch (id e) {
+                    ENSDKLog(Error, Sync, @"Failed to append to sync journal %@: %@", scope.key, e);
+                    compact = YES;
+                }
+                [handle closeFile];
+            } else if (!compact) {
+                ENSDKLog(Error, Sync, @"Failed to open sync journal %@: %@", scope.key, error);
+                compact = YES;
+            }
+        }
+    }
+    if (compact) {
+        [self saveScope:scope];
+    }
+}
+
+- (ENNoteIndex *)loadedNoteIndexForScope:(ENSyncStoreScope *)scope
+{
+    @synchronized(self) {
+        return self.noteIndexesByKey[scope.key];
+    }
+}
+
+- (ENNoteIndex *)noteIndexForScope:(ENSyncStoreScope *)scope
+{
+    @synchronized(self) {
+        // Steps queued before a logout may still hold a removed scope; it must not get an index back.
+        @synchronized(scope) {
+            if (scope.discarded) {
+                return nil;
+            }
+        }
+        ENNoteIndex * noteIndex = self.noteIndexesByKey[scope.key];
+        if (noteIndex) {
+            return noteIndex;
+        }
+        NSData * data = [NSData dataWithContentsOfURL:[self fileURLForNoteIndexKey:scope.key]];
+        if (data) {
+            @try {
+                noteIndex = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+            } @catch (id e) {
+                ENSDKLog(Error, Sync, @"Failed to unarchive note index %@; rebuilding it. %@", scope.key, e);
+                noteIndex = nil;
+            }
+            if (![noteIndex isKindOfClass:[ENNoteIndex class]]) {
+                noteIndex = nil;
+            }
+        }
+        if (!noteIndex) {
+            noteIndex = [[ENNoteIndex alloc] init];
+        }
+        // The index is saved less often than the scope, so it may be a few chunks behind, or missing.
+        @synchronized(scope) {
+            if (noteIndex.lastUSN != scope.lastUSN) {
+                [noteIndex reconcileWithNoteMetadata:[scope noteMetadataInNotebooksWithGuids:nil] lastUSN:scope.lastUSN];
+            }
+        }
+        self.noteIndexesByKey[scope.key] = noteIndex;
+        return noteIndex;
+    }
+}
+
+- (void)saveNoteIndexForScope:(ENSyncStoreScope *)scope
+{
+    ENNoteIndex * noteIndex = [self loadedNoteIndexForScope:scope];
+    if (!noteIndex) {
+        return;
+    }
+    @synchronized(noteIndex) {
+        if (noteIndex.discarded) {
+            return;
+        }
+        NSData * data = nil;
+        @try {
+            data = [NSKeyedArchiver archivedDataWithRootObject:noteIndex];
+        } @catch (id e) {
+            ENSDKLog(Error, Sync, @"Failed to archive note index %@: %@", scope.key, e);
+            return;
+        }
+        NSError * error = nil;
+        if (![[NSFileManager defaultManager] createDirectoryAtURL:self.directoryURL withIntermediateDirectories:YES attributes:nil error:&error] ||
+            ![data writeToURL:[self fileURLForNoteIndexKey:scope.key] options:NSDataWritingAtomic error:&error]) {
+            ENSDKLog(Error, Sync, @"Failed to write note index %@: %@", scope.key, error);
+        }
+    }
+}
+
+- (void)applySyncChunk:(EDAMSyncChunk *)chunk toScope:(ENSyncStoreScope *)scope
+{
+    [scope applySyncChunk:chunk];
+    // The index holds every note's words and is not rewritten after each chunk; it catches up from the
+    // scope if it is loaded again before being saved.
+    [[self loadedNoteIndexForScope:scope] applySyncChunk:chunk];
+    [self journalSyncChunk:chunk forScope:scope];
+}
+
+- (void)markScope:(ENSyncStoreScope *)scope synchronizedWithUpdateCount:(int32_t)updateCount
+{
+    @synchronized(scope) {
+        // updateCount can be past the last chunk's high USN when the newest changes were expunges.
+        scope.lastUSN = MAX(scope.lastUSN, updateCount);
+        scope.hasCompletedFullSync = YES;
+    }
+    [self saveScope:scope];
+    [self saveNoteIndexForScope:scope];
+}
+
+- (void)resetScope:(ENSyncStoreScope *)scope
+{
+    @synchronized(scope) {
+        [scope removeAllObjects];
+    }
+    [[self loadedNoteIndexForScope:scope] removeAllNotes];
+    [self saveScope:scope];
+    [self saveNoteIndexForScope:scope];
+}
+
+- (void)setListedNotebooks:(NSArray *)notebooks updateCounts:(NSDictionary *)updateCounts forScope:(ENSyncStoreScope *)scope
+{
+    @synchronized(scope) {
+        scope.listedNotebooks = [notebooks copy];
+        scope.listedNotebooksUpdateCounts = updateCounts;
+    }
+    [self saveScope:scope];
+}
+
+- (void)discardScopeForKey:(NSString *)key
+{
+    ENSyncStoreScope * scope = self.scopesByKey[key];
+    if (scope) {
+        @synchronized(scope) {
+            scope.discarded = YES;
+        }
+        [self.scopesByKey removeObjectForKey:key];
+    }
+    ENNoteIndex * noteIndex = self.noteIndexesByKey[key];
+    if (noteIndex) {
+        @synchronized(noteIndex) {
+            noteIndex.discarded = YES;
+        }
+        [self.noteIndexesByKey removeObjectForKey:key];
+    }
+    [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForScopeKey:key] error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForNoteIndexKey:key] error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:[self fileURLForJournalKey:key] error:NULL];
+}
+
+- (void)removeLinkedScopesExceptKeys:(NSSet *)keys
+{
+    @synchronized(self) {
+        NSArray * filenames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[self.directoryURL path] error:NULL];
+        NSMutableSet * storedKeys = [NSMutableSet setWithArray:[self.scopesByKey allKeys]];
+        for (NSString * filename in filenames) {
+            NSString * extension = [filename pathExtension];
+            if ([extension isEqualToString:ENSyncStoreScopeFileExtension] || [extension isEqualToString:ENSyncStoreJournalFileExtension]) {
+                [storedKeys addObject:[filename stringByDeletingPathExtension]];
+            }
+        }
+        for (NSString * key in storedKeys) {
+            if ([key hasPrefix:ENSyncStoreLinkedScopeKeyPrefix] && ![keys containsObject:key]) {
+                [self discardScopeForKey:key];
+            }
+        }
+    }
+}
+
+- (void)removeAllScopes
+{
+    @synchronized(self) {
+        for (ENSyncStoreScope * scope in [self.scopesByKey allValues]) {
+            @synchronized(scope) {
+                scope.discarded = YES;
+            }
+        }
+        [self.scopesByKey removeAllObjects];
+        for (ENNoteIndex * noteIndex in [self.noteIndexesByKey allValues]) {
+            @synchronized(noteIndex) {
+                noteIndex.discarded = YES;
+            }
+        }
+        [self.noteIndexesByKey removeAllObjects];
+        [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:NULL];
+    }
+}
+
+@end
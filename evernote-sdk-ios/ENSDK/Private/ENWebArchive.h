@@ -32,8 +32,16 @@
 extern NSString * const ENWebArchivePboardType;
 extern NSString * const ENWebArchiveDataMIMEType;
 
+extern NSString * const ENWebArchiveDictionaryMainResourceKey;
+extern NSString * const ENWebArchiveDictionarySubresourcesKey;
+extern NSString * const ENWebArchiveDictionarySubframeArchivesKey;
+
 @interface ENWebArchive : NSObject
+// Binary archives are read in place: resources are only decoded when first asked for, and their data
+// are slices of the archive data rather than copies. Use a mapped NSData (or +webArchiveWithContentsOfURL:)
+// to keep large archives out of resident memory.
 + (ENWebArchive *)webArchiveWithData:(NSData *)data;
++ (ENWebArchive *)webArchiveWithContentsOfURL:(NSURL *)url;
 - (id)initWithMainResource:(ENWebResource *)mainResource
               subresources:(NSArray *)subresources
           subframeArchives:(NSArray *)subframeArchives;
@@ -42,4 +50,5 @@ extern NSString * const ENWebArchiveDataMIMEType;
 - (NSArray *)subframeArchives;
 
 - (NSData *)data;
+- (BOOL)writeToURL:(NSURL *)url error:(NSError **)outError;
 @end
@@ -27,23 +27,39 @@
  */
 
 #import "ENWebArchive.h"
+#import "ENBinaryPlistReader.h"
+#import "ENWebArchiveWriter.h"
 
 NSString * const ENWebArchivePboardType = @"Apple Web Archive pasteboard type";
 NSString * const ENWebArchiveDataMIMEType = @"application/x-webarchive";
 
-static NSString * const ENWebArchiveDictionaryMainResourceKey = @"WebMainResource";
-static NSString * const ENWebArchiveDictionarySubresourcesKey = @"WebSubresources";
-static NSString * const ENWebArchiveDictionarySubframeArchivesKey = @"WebSubframeArchives";
+NSString * const ENWebArchiveDictionaryMainResourceKey = @"WebMainResource";
+NSString * const ENWebArchiveDictionarySubresourcesKey = @"WebSubresources";
+NSString * const ENWebArchiveDictionarySubframeArchivesKey = @"WebSubframeArchives";
 
 @interface ENWebArchive ()
 @property (nonatomic, strong) ENWebResource * mainResource;
 @property (nonatomic, strong) NSArray * subresources;
 @property (nonatomic, strong) NSArray * subframeArchives;
+
+// Set when the archive was read from binary data; the properties above are then filled in on demand.
+@property (nonatomic, strong) ENBinaryPlistReader * reader;
+@property (nonatomic, assign) ENBinaryPlistObjectRef readerObject;
+@property (nonatomic, strong) NSData * sourceData;
 @end
 
 @implementation ENWebArchive
 + (ENWebArchive *)webArchiveWithData:(NSData *)data
 {
+    if ([ENBinaryPlistReader isBinaryPlistData:data]) {
+        ENBinaryPlistReader * reader = [[ENBinaryPlistReader alloc] initWithData:data];
+        if (reader && [reader typeOfObject:reader.topObject] == ENBinaryPlistObjectTypeDictionary) {
+            ENWebArchive * archive = [[ENWebArchive alloc] initWithReader:reader object:reader.topObject];
+            archive.sourceData = data;
+            return archive;
+        }
+    }
+
     NSError * error = nil;
     NSDictionary * dictionary = [NSPropertyListSerialization propertyListWithData:data
                                                                           options:NSPropertyListImmutable
@@ -57,6 +73,17 @@ static NSString * const ENWebArchiveDictionarySubframeArchivesKey = @"WebSubfram
     return [ENWebArchive webArchiveWithDictionary:dictionary];
 }
 
++ (ENWebArchive *)webArchiveWithContentsOfURL:(NSURL *)url
+{
+    NSError * error = nil;
+    NSData * data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:&error];
+    if (!data) {
+        NSLog(@"Error reading web archive from %@: %@", url, error);
+        return nil;
+    }
+    return [ENWebArchive webArchiveWithData:data];
+}
+
 + (ENWebArchive *)webArchiveWithDictionary:(NSDictionary *)dictionary
 {
     NSDictionary * mainResourceDict = dictionary[ENWebArchiveDictionaryMainResourceKey];
@@ -89,34 +116,119 @@ static NSString * const ENWebArchiveDictionarySubframeArchivesKey = @"WebSubfram
     return self;
 }
 
-- (id)propertyList
+- (id)initWithReader:(ENBinaryPlistReader *)reader object:(ENBinaryPlistObjectRef)object
+{
+    self = [super init];
+    if (self) {
+        self.reader = reader;
+        self.readerObject = object;
+    }
+    return self;
+}
+
+#pragma mark - Lazy materialization
+
+- (ENWebResource *)mainResource
 {
-    NSMutableDictionary * dictionary = [[NSMutableDictionary alloc] init];
-    if (self.mainResource) {
-        dictionary[ENWebArchiveDictionaryMainResourceKey] = [self.mainResource propertyList];
+    if (!_mainResource && self.reader) {
+        ENBinaryPlistObjectRef resourceObject = 0;
+        if ([self.reader getObject:&resourceObject forKey:ENWebArchiveDictionaryMainResourceKey inDictionary:self.readerObject]) {
+            _mainResource = [self webResourceWithObject:resourceObject];
+        }
     }
-    NSMutableArray * subresourcesArray = [[NSMutableArray alloc] init];
-    for (ENWebResource * subresource in self.subresources) {
-        [subresourcesArray addObject:[subresource propertyList]];
+    return _mainResource;
+}
+
+- (NSArray *)subresources
+{
+    if (!_subresources && self.reader) {
+        NSMutableArray * subresources = [[NSMutableArray alloc] init];
+        for (NSNumber * object in [self objectsInArrayForKey:ENWebArchiveDictionarySubresourcesKey]) {
+            ENWebResource * resource = [self webResourceWithObject:[object unsignedLongLongValue]];
+            if (resource) {
+                [subresources addObject:resource];
+            }
+        }
+        _subresources = subresources;
+    }
+    return _subresources;
+}
+
+- (NSArray *)subframeArchives
+{
+    if (!_subframeArchives && self.reader) {
+        NSMutableArray * subframeArchives = [[NSMutableArray alloc] init];
+        for (NSNumber * object in [self objectsInArrayForKey:ENWebArchiveDictionarySubframeArchivesKey]) {
+            ENBinaryPlistObjectRef archiveObject = [object unsignedLongLongValue];
+            if ([self.reader typeOfObject:archiveObject] == ENBinaryPlistObjectTypeDictionary) {
+                [subframeArchives addObject:[[ENWebArchive alloc] initWithReader:self.reader object:archiveObject]];
+            }
+        }
+        _subframeArchives = subframeArchives;
+    }
+    return _subframeArchives;
+}
+
+- (NSArray *)objectsInArrayForKey:(NSString *)key
+{
+    ENBinaryPlistObjectRef arrayObject = 0;
+    if (![self.reader getObject:&arrayObject forKey:key inDictionary:self.readerObject]) {
+        return nil;
+    }
+    NSUInteger count = [self.reader countOfObject:arrayObject];
+    NSMutableArray * objects = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        ENBinaryPlistObjectRef element = 0;
+        if ([self.reader getObject:&element atIndex:i inArray:arrayObject]) {
+            [objects addObject:@(element)];
+        }
+    }
+    return objects;
+}
+
+- (ENWebResource *)webResourceWithObject:(ENBinaryPlistObjectRef)object
+{
+    ENBinaryPlistReader * reader = self.reader;
+    if ([reader typeOfObject:object] != ENBinaryPlistObjectTypeDictionary) {
+        return nil;
     }
-    dictionary[ENWebArchiveDictionarySubresourcesKey] = subresourcesArray;
     
-    NSMutableArray * subframeArchivesArray = [[NSMutableArray alloc] init];
-    for (ENWebResource * subframeArchive in self.subframeArchives) {
-        [subframeArchivesArray addObject:[subframeArchive propertyList]];
+    ENBinaryPlistObjectRef value = 0;
+    NSData * data = nil;
+    NSString * URLString = nil, * MIMEType = nil, * textEncodingName = nil, * frameName = nil;
+    if ([reader getObject:&value forKey:ENWebResourceDictionaryDataKey inDictionary:object]) {
+        data = [reader dataForObject:value];
     }
-    dictionary[ENWebArchiveDictionarySubframeArchivesKey] = subframeArchivesArray;
-    return dictionary;
+    if ([reader getObject:&value forKey:ENWebResourceDictionaryURLKey inDictionary:object]) {
+        URLString = [reader stringForObject:value];
+    }
+    if ([reader getObject:&value forKey:ENWebResourceDictionaryMIMETypeKey inDictionary:object]) {
+        MIMEType = [reader stringForObject:value];
+    }
+    if ([reader getObject:&value forKey:ENWebResourceDictionaryTextEncodingNameKey inDictionary:object]) {
+        textEncodingName = [reader stringForObject:value];
+    }
+    if ([reader getObject:&value forKey:ENWebResourceDictionaryFrameNameKey inDictionary:object]) {
+        frameName = [reader stringForObject:value];
+    }
+    return [[ENWebResource alloc] initWithData:data
+                                           URL:(URLString ? [NSURL URLWithString:URLString] : nil)
+                                      MIMEType:MIMEType
+                              textEncodingName:textEncodingName
+                                     frameName:frameName];
 }
 
+#pragma mark - Serialization
+
 - (NSData *)data
 {
-    NSDictionary * propertyList = [self propertyList];
+    // Archives are immutable, so one that was read from data can just hand that data back.
+    if (self.sourceData) {
+        return self.sourceData;
+    }
+    
     NSError * error = nil;
-    NSData * data = [NSPropertyListSerialization dataWithPropertyList:propertyList
-                                                               format:NSPropertyListBinaryFormat_v1_0
-                                                              options:0
-                                                                error:&error];
+    NSData * data = [ENWebArchiveWriter dataWithWebArchive:self error:&error];
     if (!data) {
         NSLog(@"Error serializing web archive to data: %@", error);
         return nil;
@@ -124,4 +236,12 @@ static NSString * const ENWebArchiveDictionarySubframeArchivesKey = @"WebSubfram
     
     return data;
 }
+
+- (BOOL)writeToURL:(NSURL *)url error:(NSError **)outError
+{
+    if (self.sourceData) {
+        return [self.sourceData writeToURL:url options:NSDataWritingAtomic error:outError];
+    }
+    return [ENWebArchiveWriter writeWebArchive:self toURL:url error:outError];
+}
 @end
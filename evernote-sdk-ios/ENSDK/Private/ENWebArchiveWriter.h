@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+@class ENWebArchive;
+
+/**
+ *  Serializes an ENWebArchive as a binary property list directly onto an output stream. Resource bodies
+ *  are streamed through in chunks instead of being gathered into an intermediate property list, so an
+ *  archive can be written to disk without ever holding a second copy of its contents in memory.
+ */
+@interface ENWebArchiveWriter : NSObject
++ (BOOL)writeWebArchive:(ENWebArchive *)webArchive toURL:(NSURL *)url error:(NSError **)outError;
++ (NSData *)dataWithWebArchive:(ENWebArchive *)webArchive error:(NSError **)outError;
+
+// The stream is opened if needed; closing it is left to the caller.
+- (id)initWithOutputStream:(NSOutputStream *)outputStream;
+- (BOOL)writeWebArchive:(ENWebArchive *)webArchive error:(NSError **)outError;
+@end
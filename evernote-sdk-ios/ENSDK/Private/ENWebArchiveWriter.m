@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2014 by Evernote Corporation, All rights reserved.
+ *
+ * Use of the source code and binary libraries included in this package
+ * is permitted under the following terms:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "ENWebArchiveWriter.h"
+#import "ENWebArchive.h"
+#import "ENError.h"
+
+static const NSUInteger ENWebArchiveWriterChunkSize = 64 * 1024;
+static const NSUInteger ENBinaryPlistTrailerLength = 32;
+
+static NSUInteger ENBinaryPlistIntSizeForValue(uint64_t value)
+{
+    if (value <= UINT8_MAX) {
+        return 1;
+    } else if (value <= UINT16_MAX) {
+        return 2;
+    } else if (value <= UINT32_MAX) {
+        return 4;
+    }
+    return 8;
+}
+
+static void ENBinaryPlistStoreInt(uint8_t * p, uint64_t value, NSUInteger size)
+{
+    for (NSUInteger i = 0; i < size; i++) {
+        p[size - 1 - i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+@interface ENWebArchiveWriter ()
+{
+    uint64_t _bytesWritten;
+    uint64_t _objectCount;
+    NSUInteger _objectRefSize;
+}
+@property (nonatomic, strong) NSOutputStream * outputStream;
+@property (nonatomic, strong) NSMutableData * offsets;
+@property (nonatomic, strong) NSMutableDictionary * keyObjects;
+@property (nonatomic, strong) NSError * error;
+@end
+
+@implementation ENWebArchiveWriter
++ (NSArray *)keys
+{
+    return @[ENWebArchiveDictionaryMainResourceKey,
+             ENWebArchiveDictionarySubresourcesKey,
+             ENWebArchiveDictionarySubframeArchivesKey,
+             ENWebResourceDictionaryDataKey,
+             ENWebResourceDictionaryURLKey,
+             ENWebResourceDictionaryMIMETypeKey,
+             ENWebResourceDictionaryTextEncodingNameKey,
+             ENWebResourceDictionaryFrameNameKey];
+}
+
++ (BOOL)writeWebArchive:(ENWebArchive *)webArchive toURL:(NSURL *)url error:(NSError **)outError
+{
+    NSOutputStream * stream = [NSOutputStream outputStreamWithURL:url append:NO];
+    ENWebArchiveWriter * writer = [[ENWebArchiveWriter alloc] initWithOutputStream:stream];
+    BOOL success = [writer writeWebArchive:webArchive error:outError];
+    [stream close];
+    if (!success) {
+        [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+    }
+    return success;
+}
+
++ (NSData *)dataWithWebArchive:(ENWebArchive *)webArchive error:(NSError **)outError
+{
+    NSOutputStream * stream = [NSOutputStream outputStreamToMemory];
+    ENWebArchiveWriter * writer = [[ENWebArchiveWriter alloc] initWithOutputStream:stream];
+    NSData * data = nil;
+    if ([writer writeWebArchive:webArchive error:outError]) {
+        data = [stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+    }
+    [stream close];
+    return data;
+}
+
+- (id)initWithOutputStream:(NSOutputStream *)outputStream
+{
+    self = [super init];
+    if (self) {
+        self.outputStream = outputStream;
+    }
+    return self;
+}
+
+- (BOOL)writeWebArchive:(ENWebArchive *)webArchive error:(NSError **)outError
+{
+    if (self.outputStream.streamStatus == NSStreamStatusNotOpen) {
+        [self.outputStream open];
+    }
+    
+    // Object references are fixed-width, so size them from a counting pass before anything is written.
+    NSArray * keys = [[self class] keys];
+    _objectCount = keys.count + [self objectCountForArchive:webArchive];
+    _objectRefSize = ENBinaryPlistIntSizeForValue(_objectCount);
+    _bytesWritten = 0;
+    self.offsets = [[NSMutableData alloc] initWithCapacity:(NSUInteger)_objectCount * sizeof(uint64_t)];
+    self.keyObjects = [[NSMutableDictionary alloc] init];
+    self.error = nil;
+    
+    [self writeBytes:"bplist00" length:8];
+    for (NSString * key in keys) {
+        self.keyObjects[key] = @([self writeString:key]);
+    }
+    uint64_t topObject = [self writeArchive:webArchive];
+    [self writeTrailerWithTopObject:topObject];
+    
+    if (!self.error && self.offsets.length / sizeof(uint64_t) != _objectCount) {
+        self.error = [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeUnknown userInfo:nil];
+    }
+    if (self.error) {
+        if (outError) {
+            *outError = self.error;
+        }
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Counting
+
+- (uint64_t)objectCountForResource:(ENWebResource *)resource
+{
+    return 1 + (resource.data ? 1 : 0) + (resource.URL ? 1 : 0) + (resource.MIMEType ? 1 : 0) +
+           (resource.textEncodingName ? 1 : 0) + (resource.frameName ? 1 : 0);
+}
+
+- (uint64_t)objectCountForArchive:(ENWebArchive *)archive
+{
+    // The archive dictionary and its two arrays.
+    uint64_t count = 3;
+    if (archive.mainResource) {
+        count += [self objectCountForResource:archive.mainResource];
+    }
+    for (ENWebResource * subresource in archive.subresources) {
+        count += [self objectCountForResource:subresource];
+    }
+    for (ENWebArchive * subframeArchive in archive.subframeArchives) {
+        count += [self objectCountForArchive:subframeArchive];
+    }
+    return count;
+}
+
+#pragma mark - Objects
+
+- (uint64_t)writeArchive:(ENWebArchive *)archive
+{
+    NSMutableArray * keys = [[NSMutableArray alloc] init];
+    NSMutableArray * values = [[NSMutableArray alloc] init];
+    if (archive.mainResource) {
+        [keys addObject:self.keyObjects[ENWebArchiveDictionaryMainResourceKey]];
+        [values addObject:@([self writeResource:archive.mainResource])];
+    }
+    
+    NSMutableArray * subresources = [[NSMutableArray alloc] init];
+    for (ENWebResource * subresource in archive.subresources) {
+        [subresources addObject:@([self writeResource:subresource])];
+    }
+    [keys addObject:self.keyObjects[ENWebArchiveDictionarySubresourcesKey]];
+    [values addObject:@([self writeContainerWithMarker:0xA references:subresources])];
+    
+    NSMutableArray * subframeArchives = [[NSMutableArray alloc] init];
+    for (ENWebArchive * subframeArchive in archive.subframeArchives) {
+        [subframeArchives addObject:@([self writeArchive:subframeArchive])];
+    }
+    [keys addObject:self.keyObjects[ENWebArchiveDictionarySubframeArchivesKey]];
+    [values addObject:@([self writeContainerWithMarker:0xA references:subframeArchives])];
+    
+    return [self writeContainerWithMarker:0xD references:[keys arrayByAddingObjectsFromArray:values]];
+}
+
+- (uint64_t)writeResource:(ENWebResource *)resource
+{
+    NSMutableArray * keys = [[NSMutableArray alloc] init];
+    NSMutableArray * values = [[NSMutableArray alloc] init];
+    if (resource.data) {
+        [keys addObject:self.keyObjects[ENWebResourceDictionaryDataKey]];
+        [values addObject:@([self writeData:resource.data])];
+    }
+    if (resource.URL) {
+        [keys addObject:self.keyObjects[ENWebResourceDictionaryURLKey]];
+        [values addObject:@([self writeString:[resource.URL absoluteString]])];
+    }
+    if (resource.MIMEType) {
+        [keys addObject:self.keyObjects[ENWebResourceDictionaryMIMETypeKey]];
+        [values addObject:@([self writeString:resource.MIMEType])];
+    }
+    if (resource.textEncodingName) {
+        [keys addObject:self.keyObjects[ENWebResourceDictionaryTextEncodingNameKey]];
+        [values addObject:@([self writeString:resource.textEncodingName])];
+    }
+    if (resource.frameName) {
+        [keys addObject:self.keyObjects[ENWebResourceDictionaryFrameNameKey]];
+        [values addObject:@([self writeString:resource.frameName])];
+    }
+    return [self writeContainerWithMarker:0xD references:[keys arrayByAddingObjectsFromArray:values]];
+}
+
+- (uint64_t)beginObject
+{
+    uint64_t offset = _bytesWritten;
+    [self.offsets appendBytes:&offset length:sizeof(offset)];
+    return self.offsets.length / sizeof(uint64_t) - 1;
+}
+
+- (uint64_t)writeString:(NSString *)string
+{
+    uint64_t object = [self beginObject];
+    if ([string canBeConvertedToEncoding:NSASCIIStringEncoding]) {
+        NSData * bytes = [string dataUsingEncoding:NSASCIIStringEncoding];
+        [self writeMarker:0x5 count:bytes.length];
+        [self writeBytes:bytes.bytes length:bytes.length];
+    } else {
+        NSData * bytes = [string dataUsingEncoding:NSUTF16BigEndianStringEncoding];
+        [self writeMarker:0x6 count:bytes.length / 2];
+        [self writeBytes:bytes.bytes length:bytes.length];
+    }
+    return object;
+}
+
+- (uint64_t)writeData:(NSData *)data
+{
+    uint64_t object = [self beginObject];
+    [self writeMarker:0x4 count:data.length];
+    [data enumerateByteRangesUsingBlock:^(const void * bytes, NSRange byteRange, BOOL * stop) {
+        if (![self writeBytes:bytes length:byteRange.length]) {
+            *stop = YES;
+        }
+    }];
+    return object;
+}
+
+// Arrays (marker 0xA) take a list of element references; dictionaries (0xD) take all key
+// references followed by all value references.
+- (uint64_t)writeContainerWithMarker:(uint8_t)marker references:(NSArray *)references
+{
+    uint64_t object = [self beginObject];
+    NSUInteger count = (marker == 0xD) ? references.count / 2 : references.count;
+    [self writeMarker:marker count:count];
+    NSMutableData * buffer = [[NSMutableData alloc] initWithLength:references.count * _objectRefSize];
+    uint8_t * p = buffer.mutableBytes;
+    for (NSNumber * reference in references) {
+        ENBinaryPlistStoreInt(p, [reference unsignedLongLongValue], _objectRefSize);
+        p += _objectRefSize;
+    }
+    [self writeBytes:buffer.bytes length:buffer.length];
+    return object;
+}
+
+#pragma mark - Encoding
+
+- (void)writeMarker:(uint8_t)kind count:(uint64_t)count
+{
+    uint8_t buffer[10];
+    if (count < 0x0F) {
+        buffer[0] = (uint8_t)((kind << 4) | count);
+        [self writeBytes:buffer length:1];
+        return;
+    }
+    NSUInteger size = ENBinaryPlistIntSizeForValue(count);
+    uint8_t sizeExponent = (size == 1) ? 0 : (size == 2) ? 1 : (size == 4) ? 2 : 3;
+    buffer[0] = (uint8_t)((kind << 4) | 0x0F);
+    buffer[1] = 0x10 | sizeExponent;
+    ENBinaryPlistStoreInt(buffer + 2, count, size);
+    [self writeBytes:buffer length:2 + size];
+}
+
+- (void)writeTrailerWithTopObject:(uint64_t)topObject
+{
+    uint64_t offsetTableOffset = _bytesWritten;
+    NSUInteger offsetIntSize = ENBinaryPlistIntSizeForValue(offsetTableOffset);
+    NSUInteger offsetCount = self.offsets.length / sizeof(uint64_t);
+    const uint64_t * offsets = self.offsets.bytes;
+    
+    NSMutableData * table = [[NSMutableData alloc] initWithLength:offsetCount * offsetIntSize + ENBinaryPlistTrailerLength];
+    uint8_t * p = table.mutableBytes;
+    for (NSUInteger i = 0; i < offsetCount; i++) {
+        ENBinaryPlistStoreInt(p, offsets[i], offsetIntSize);
+        p += offsetIntSize;
+    }
+    
+    // Trailer: 6 unused bytes, offset size, object reference size, object count, top object, table offset.
+    p[6] = (uint8_t)offsetIntSize;
+    p[7] = (uint8_t)_objectRefSize;
+    ENBinaryPlistStoreInt(p + 8, offsetCount, 8);
+    ENBinaryPlistStoreInt(p + 16, topObject, 8);
+    ENBinaryPlistStoreInt(p + 24, offsetTableOffset, 8);
+    [self writeBytes:table.bytes length:table.length];
+}
+
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)length
+{
+    const uint8_t * p = bytes;
+    while (length > 0 && !self.error) {
+        NSInteger written = [self.outputStream write:p maxLength:MIN(length, ENWebArchiveWriterChunkSize)];
+        if (written <= 0) {
+            self.error = self.outputStream.streamError ?: [NSError errorWithDomain:ENErrorDomain code:ENErrorCodeUnknown userInfo:nil];
+            break;
+        }
+        p += written;
+        length -= (NSUInteger)written;
+        _bytesWritten += (uint64_t)written;
+    }
+    return !self.error;
+}
+@end
@@ -30,6 +30,12 @@
 
 extern NSString * const ENWebResourceTextEncodingNameUTF8;
 
+extern NSString * const ENWebResourceDictionaryDataKey;
+extern NSString * const ENWebResourceDictionaryURLKey;
+extern NSString * const ENWebResourceDictionaryMIMETypeKey;
+extern NSString * const ENWebResourceDictionaryTextEncodingNameKey;
+extern NSString * const ENWebResourceDictionaryFrameNameKey;
+
 @interface ENWebResource : NSObject
 + (ENWebResource *)webResourceWithDictionary:(NSDictionary *)dictionary;
 - (id)initWithData:(NSData *)data
@@ -30,11 +30,11 @@
 
 NSString * const ENWebResourceTextEncodingNameUTF8 = @"UTF-8";
 
-static NSString * const ENWebResourceDictionaryDataKey = @"WebResourceData";
-static NSString * const ENWebResourceDictionaryURLKey = @"WebResourceURL";
-static NSString * const ENWebResourceDictionaryMIMETypeKey = @"WebResourceMIMEType";
-static NSString * const ENWebResourceDictionaryTextEncodingNameKey = @"WebResourceTextEncodingName";
-static NSString * const ENWebResourceDictionaryFrameNameKey = @"WebResourceFrameName";
+NSString * const ENWebResourceDictionaryDataKey = @"WebResourceData";
+NSString * const ENWebResourceDictionaryURLKey = @"WebResourceURL";
+NSString * const ENWebResourceDictionaryMIMETypeKey = @"WebResourceMIMEType";
+NSString * const ENWebResourceDictionaryTextEncodingNameKey = @"WebResourceTextEncodingName";
+NSString * const ENWebResourceDictionaryFrameNameKey = @"WebResourceFrameName";
 
 @interface ENWebResource ()
 @property (nonatomic, strong) NSData * data;
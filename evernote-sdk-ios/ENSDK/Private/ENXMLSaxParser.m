@@ -50,16 +50,21 @@ NSString * const ENXMLSaxParserErrorDomain = @"ENXMLSaxParserErrorDomain";
 @implementation ENXMLSaxParser
 
 static void fatalErrorCallback(void *ctx, const char *msg, ...) { 
+  ENXMLSaxParser *parser = (__bridge ENXMLSaxParser *)ctx;
+  id<ENXMLSaxParserDelegate> delegate = parser->_delegate;
+  BOOL delegateWantsError = (delegate != nil && [delegate respondsToSelector:@selector(parser:didFailWithError:)]);
+  // The message is only formatted if something will read it.
+  if (!delegateWantsError && !ENSDKLogEnabled(ENSDKLogLevelError, ENSDKLogCategoryENML)) {
+    return;
+  }
   va_list args;
   va_start(args, msg);
   NSString *message = [NSString stringWithCString:msg encoding:NSUTF8StringEncoding];
   NSString *errorMessage = [[NSString alloc] initWithFormat:message arguments:args];
   va_end(args);
-  ENSDKLogError(@"ENXMLSaxParser: fatal error %@", errorMessage);
+  ENSDKLog(Error, ENML, @"ENXMLSaxParser: fatal error %@", errorMessage);
 
-  ENXMLSaxParser *parser = (__bridge ENXMLSaxParser *)ctx;
-  id<ENXMLSaxParserDelegate> delegate = parser->_delegate;
-  if (delegate != nil && [delegate respondsToSelector:@selector(parser:didFailWithError:)]) {
+  if (delegateWantsError) {
     NSError *error = [NSError errorWithDomain:ENXMLSaxParserErrorDomain 
                                          code:ENXMLSaxParserLibXMLFatalError 
                                      userInfo:[NSDictionary dictionaryWithObject:errorMessage
@@ -68,12 +73,15 @@ static void fatalErrorCallback(void *ctx, const char *msg, ...) {
   }
 }
 static void errorCallback(void *ctx, const char *msg, ...) {
+  if (!ENSDKLogEnabled(ENSDKLogLevelInfo, ENSDKLogCategoryENML)) {
+    return;
+  }
   va_list args;
   va_start(args, msg);
   NSString *message = [NSString stringWithCString:msg encoding:NSUTF8StringEncoding];
   NSString *errorMessage = [[NSString alloc] initWithFormat:message arguments:args];
   va_end(args);
-  ENSDKLogInfo(@"ENXMLSaxParser: %@ (nonfatal)", errorMessage);
+  ENSDKLog(Info, ENML, @"ENXMLSaxParser: %@ (nonfatal)", errorMessage);
 #if 0
   ENXMLSaxParser *parser = (__bridge ENXMLSaxParser *)ctx;
   id<ENXMLSaxParserDelegate> delegate = parser->_delegate;
@@ -184,7 +192,7 @@ static xmlEntityPtr getEntitySAXCallback (void * ctx,
     return result;
   }
 
-  ENSDKLogInfo(@"Ignoring unknown entity '%s'", name);
+  ENSDKLog(Info, ENML, @"Ignoring unknown entity '%s'", name);
   return NULL;
 }
 
@@ -327,11 +335,11 @@ static xmlEntityPtr getEntitySAXCallback (void * ctx,
   NSError *attrError = nil;
   NSDictionary *fileAttributes = [[NSFileManager defaultManager] attributesOfItemAtPath:file error:&attrError];
   if (fileAttributes == nil) {
-    ENSDKLogError(@"attributesOfItemAtPath:%@ returned error:%@", file, attrError);
+    ENSDKLog(Error, ENML, @"attributesOfItemAtPath:%@ returned error:%@", file, attrError);
     return NO;
   }
   if ([fileAttributes fileSize] == 0) {
-    ENSDKLogError(@"The file %@ is 0 bytes!", file);
+    ENSDKLog(Error, ENML, @"The file %@ is 0 bytes!", file);
     return NO;
   }
   
@@ -352,7 +360,7 @@ static xmlEntityPtr getEntitySAXCallback (void * ctx,
                              maxLength:pagesize];
     
     if (amountRead < 0) {
-      ENSDKLogInfo(@"read:maxLength: returned: %i", amountRead);
+      ENSDKLog(Info, ENML, @"read:maxLength: returned: %i", amountRead);
       _parserHalted = YES;
     }
     else if (amountRead == 0) {
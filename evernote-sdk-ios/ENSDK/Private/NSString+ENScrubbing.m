@@ -27,6 +27,74 @@
  */
 
 #import "NSString+ENScrubbing.h"
+#import "NSRegularExpression+ENAGRegex.h"
+
+typedef NS_ENUM(uint8_t, ENScrubbingCharacterState) {
+    ENScrubbingCharacterStateUnknown = 0,
+    ENScrubbingCharacterStateInvalid,
+    ENScrubbingCharacterStateValid
+};
+
+/**
+ *  The set of UTF-16 code units that a pattern accepts as a complete one-character string. It is learned
+ *  lazily: each code unit is run through the regex the first time it is seen and the answer is kept, so
+ *  scrubbing becomes a single table-driven pass over the string.
+ */
+@interface ENScrubbingCharacterClass : NSObject
+{
+    uint8_t * _states;
+}
+@property (nonatomic, strong) NSRegularExpression * regex;
++ (ENScrubbingCharacterClass *)characterClassForRegex:(NSRegularExpression *)regex;
+- (BOOL)isValidCharacter:(unichar)c;
+@end
+
+@implementation ENScrubbingCharacterClass
++ (ENScrubbingCharacterClass *)characterClassForRegex:(NSRegularExpression *)regex
+{
+    static NSMutableDictionary * classes = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        classes = [[NSMutableDictionary alloc] init];
+    });
+    @synchronized(classes) {
+        ENScrubbingCharacterClass * characterClass = classes[regex.pattern];
+        if (!characterClass) {
+            characterClass = [[ENScrubbingCharacterClass alloc] initWithRegex:regex];
+            classes[regex.pattern] = characterClass;
+        }
+        return characterClass;
+    }
+}
+
+- (id)initWithRegex:(NSRegularExpression *)regex
+{
+    self = [super init];
+    if (self) {
+        self.regex = regex;
+        _states = calloc((NSUInteger)UINT16_MAX + 1, sizeof(uint8_t));
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_states);
+}
+
+- (BOOL)isValidCharacter:(unichar)c
+{
+    // Racing threads can only ever store the same answer for a code unit, so relaxed atomics suffice.
+    uint8_t state = __atomic_load_n(&_states[c], __ATOMIC_RELAXED);
+    if (state == ENScrubbingCharacterStateUnknown) {
+        NSString * oneCharString = [NSString stringWithCharacters:&c length:1];
+        BOOL valid = ([self.regex firstMatchInString:oneCharString options:0 range:NSMakeRange(0, 1)] != nil);
+        state = valid ? ENScrubbingCharacterStateValid : ENScrubbingCharacterStateInvalid;
+        __atomic_store_n(&_states[c], state, __ATOMIC_RELAXED);
+    }
+    return (state == ENScrubbingCharacterStateValid);
+}
+@end
 
 @implementation NSString (ENScrubbing)
 
@@ -43,19 +111,32 @@
         string = [string substringToIndex:maxLength];
     }
     
-    NSRegularExpression * regex = [NSRegularExpression regularExpressionWithPattern:regexPattern options:0 error:NULL];
-    NSArray * matches = [regex matchesInString:string options:0 range:NSMakeRange(0, string.length)];
-    if (matches.count == 0) {
-        NSMutableString * newString = [NSMutableString stringWithCapacity:[string length]];
-        for (NSUInteger i = 0; i < [string length]; i++) {
-            NSString * oneCharSubString = [string substringWithRange:NSMakeRange(i, 1)];
-            matches = [regex matchesInString:oneCharSubString options:0 range:NSMakeRange(0, 1)];
-            if (matches.count > 0) {
-                [newString appendString:oneCharSubString];
-            } else if (replacement != nil) {
-                [newString appendString:replacement];
+    NSRegularExpression * regex = [NSRegularExpression enCachedRegexWithPattern:regexPattern];
+    NSUInteger length = [string length];
+    if ([regex firstMatchInString:string options:0 range:NSMakeRange(0, length)] == nil) {
+        // Keep only the characters that the pattern would accept on their own. (Without a usable regex,
+        // nothing is accepted.)
+        ENScrubbingCharacterClass * characterClass = regex ? [ENScrubbingCharacterClass characterClassForRegex:regex] : nil;
+        unichar stackBuffer[256];
+        unichar * characters = (length <= 256) ? stackBuffer : malloc(length * sizeof(unichar));
+        [string getCharacters:characters range:NSMakeRange(0, length)];
+        
+        NSMutableString * newString = [NSMutableString stringWithCapacity:length];
+        NSUInteger runStart = 0;
+        for (NSUInteger i = 0; i < length; i++) {
+            if (![characterClass isValidCharacter:characters[i]]) {
+                CFStringAppendCharacters((__bridge CFMutableStringRef)newString, characters + runStart, (CFIndex)(i - runStart));
+                if (replacement != nil) {
+                    [newString appendString:replacement];
+                }
+                runStart = i + 1;
             }
         }
+        CFStringAppendCharacters((__bridge CFMutableStringRef)newString, characters + runStart, (CFIndex)(length - runStart));
+        
+        if (characters != stackBuffer) {
+            free(characters);
+        }
         string = newString;
     }
     
@@ -0,0 +1,91 @@
+#!/bin/sh
+# Builds and runs the command-line benchmarks in Benchmarks/ against the SDK sources.
+# Requires macOS with the Xcode command line tools. No UI, network or device is needed.
+set -e
+
+SRCROOT="$(cd "$(dirname "$0")/.." && pwd)"
+SDK_DIR="${SRCROOT}/evernote-sdk-ios/ENSDK"
+BUILD_DIR="${SRCROOT}/build/Benchmarks"
+
+# Every SDK source directory is a header search path, as it is in the Xcode project.
+INCLUDES=""
+for dir in $(find "${SDK_DIR}" -type d); do
+    INCLUDES="${INCLUDES} -I${dir}"
+done
+
+CFLAGS="-fobjc-arc -O2 -Wall -isystem $(xcrun --show-sdk-path)/usr/include/libxml2"
+
+mkdir -p "${BUILD_DIR}"
+
+# Builds Benchmarks/<name>.m together with the given SDK sources and runs it.
+run_benchmark() {
+    NAME=$1
+    shift
+    SOURCES=""
+    for source in "$@"; do
+        SOURCES="${SOURCES} ${SDK_DIR}/${source}"
+    done
+    echo "Building ${NAME}."
+    clang ${CFLAGS} ${INCLUDES} -framework Foundation -o "${BUILD_DIR}/${NAME}" "${SRCROOT}/Benchmarks/${NAME}.m" ${SOURCES}
+    "${BUILD_DIR}/${NAME}"
+}
+
+run_benchmark ENScrubbingBenchmark \
+    Private/NSString+ENScrubbing.m \
+    Advanced/Utilities/ENMLWriter/NSRegularExpression+ENAGRegex.m \
+    Advanced/EDAM/EDAMLimits.m
+
+run_benchmark ENURLValidationBenchmark \
+    Advanced/Utilities/ENMLWriter/ENURLUtils.m
+
+# The suite exercises classes that import UIKit, so it builds against the whole SDK as a Mac Catalyst
+# command-line tool. Each case runs in its own process so its peak memory is its own. Results are
+# written one JSON object per line, tagged with the current commit.
+MACOS_SDK="$(xcrun --sdk macosx --show-sdk-path)"
+IOS_SUPPORT="${MACOS_SDK}/System/iOSSupport"
+CATALYST_FLAGS="-target $(uname -m)-apple-ios14.0-macabi -isysroot ${MACOS_SDK} \
+    -iframework ${IOS_SUPPORT}/System/Library/Frameworks -F${IOS_SUPPORT}/System/Library/Frameworks \
+    -L${IOS_SUPPORT}/usr/lib -isystem ${MACOS_SDK}/usr/include/libxml2"
+CATALYST_LIBS="-framework Foundation -framework UIKit -framework WebKit -framework Security \
+    -framework SystemConfiguration -framework MobileCoreServices -framework CoreGraphics -lxml2"
+
+SUITE="${BUILD_DIR}/ENSDKBenchmarkSuite"
+echo "Building ENSDKBenchmarkSuite."
+clang -fobjc-arc -O2 -Wall -Wno-deprecated-declarations ${CATALYST_FLAGS} ${INCLUDES} ${CATALYST_LIBS} \
+    -o "${SUITE}" "${SRCROOT}/Benchmarks/ENSDKBenchmarkSuite.m" $(find "${SDK_DIR}" -name '*.m')
+
+EN_BENCHMARK_COMMIT="$(git -C "${SRCROOT}" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+export EN_BENCHMARK_COMMIT
+RESULTS="${BUILD_DIR}/ENSDKBenchmarkSuite-${EN_BENCHMARK_COMMIT}.jsonl"
+: > "${RESULTS}"
+for benchmark in $("${SUITE}" --list); do
+    "${SUITE}" --case "${benchmark}" --seconds "${EN_BENCHMARK_SECONDS:-1}" | tee -a "${RESULTS}"
+done
+echo "Results written to ${RESULTS}."
+
+# Store client and session throughput against a local EDAM stub server. Pass fault options through
+# EN_LOAD_BENCHMARK_ARGS, e.g. "--latency-ms 80 --jitter-ms 20 --concurrency 8".
+LOAD="${BUILD_DIR}/ENStoreClientLoadBenchmark"
+echo "Building ENStoreClientLoadBenchmark."
+clang -fobjc-arc -O2 -Wall -Wno-deprecated-declarations ${CATALYST_FLAGS} ${INCLUDES} ${CATALYST_LIBS} \
+    -o "${LOAD}" "${SRCROOT}/Benchmarks/ENStoreClientLoadBenchmark.m" "${SRCROOT}/Benchmarks/ENEDAMStubServer.m" \
+    $(find "${SDK_DIR}" -name '*.m')
+LOAD_RESULTS="${BUILD_DIR}/ENStoreClientLoadBenchmark-${EN_BENCHMARK_COMMIT}.jsonl"
+: > "${LOAD_RESULTS}"
+for benchmark in $("${LOAD}" --list); do
+    "${LOAD}" --case "${benchmark}" --seconds "${EN_BENCHMARK_SECONDS:-5}" ${EN_LOAD_BENCHMARK_ARGS} | tee -a "${LOAD_RESULTS}"
+done
+echo "Results written to ${LOAD_RESULTS}."
+
+# Session orchestration and decoding without a network: record the scenario once against the stub
+# server (or replay an existing recording given as EN_REPLAY_LOG), then replay it.
+REPLAY="${BUILD_DIR}/ENSessionReplayBenchmark"
+echo "Building ENSessionReplayBenchmark."
+clang -fobjc-arc -O2 -Wall -Wno-deprecated-declarations ${CATALYST_FLAGS} ${INCLUDES} ${CATALYST_LIBS} \
+    -o "${REPLAY}" "${SRCROOT}/Benchmarks/ENSessionReplayBenchmark.m" "${SRCROOT}/Benchmarks/ENEDAMStubServer.m" \
+    $(find "${SDK_DIR}" -name '*.m')
+REPLAY_LOG="${EN_REPLAY_LOG:-${BUILD_DIR}/session.entl}"
+if [ ! -f "${REPLAY_LOG}" ]; then
+    "${REPLAY}" --record "${REPLAY_LOG}"
+fi
+"${REPLAY}" --replay "${REPLAY_LOG}" | tee "${BUILD_DIR}/ENSessionReplayBenchmark-${EN_BENCHMARK_COMMIT}.jsonl"